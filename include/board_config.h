@@ -0,0 +1,123 @@
+/*
+  The hardware variants of the station
+
+  A variant is a type with the pins and the chips as constants, the code uses Board::ssr etc.
+  The drivers are templates on the board (include/thermocouple.h, include/fast_gpio.h), so the
+  pin numbers are known to the compiler: a pin write is a single register write, and the code
+  for a chip that is not on the board is not compiled in.
+
+  Every variant has its own environment in platformio.ini, which selects it with a build flag
+  (-D BOARD_DEVKIT_MAX31855=1 etc.) and sets the matching TFT_eSPI driver. The pins are checked
+  at compile time: no pin used twice, nothing on the serial port or the flash pins, and no
+  output on the input-only pins.
+
+  A new variant derives from the one it is closest to and overrides what is different.
+  Plain C++11 without Arduino dependencies.
+*/
+#ifndef BOARD_CONFIG_H
+#define BOARD_CONFIG_H
+
+#include <stdint.h>
+
+enum ThermocoupleChip {
+    CHIP_MAX6675,   // 12 bits, 0-1023.75°C, a 16-bit read
+    CHIP_MAX31855   // 14 bits signed, with cold junction and fault bits, a 32-bit read
+};
+
+enum PanelDriver {
+    PANEL_ILI9341,  // 320x240
+    PANEL_ILI9488,  // 480x320
+    PANEL_ST7796    // 480x320
+};
+
+// The station as built: ESP32 DevKit V1, MAX6675 and a 2.4" ILI9341
+struct DevkitBoard {
+    static constexpr uint8_t ssr = 2;         // the SSR of the heater, also the built-in LED
+    static constexpr uint8_t fan = 26;        // the fans, via a MOSFET
+    static constexpr uint8_t dsoTrig = 4;     // optional: to trace real-time activity on a scope
+    static constexpr uint8_t rotaryClk = 27;  // CLK of the rotary encoder
+    static constexpr uint8_t rotaryDt = 32;   // DT of the rotary encoder
+    static constexpr uint8_t rotarySw = 33;   // the button of the rotary encoder
+    static constexpr uint8_t maxCs = 13;      // CS of the thermocouple chip of the plate
+    static constexpr uint8_t maxSo = 21;      // SO (MISO) of both thermocouple chips, on the HSPI host
+    static constexpr uint8_t maxClk = 22;     // SCK of both thermocouple chips
+    static constexpr uint8_t probeCs = 25;    // CS of the optional chip of the board probe
+    static constexpr uint8_t tftOn = 15;      // the power and backlight of the TFT
+    static constexpr uint8_t tftCs = 5;       // the TFT on the VSPI bus, the pins are also set
+    static constexpr uint8_t tftDc = 16;      // in platformio.ini for TFT_eSPI
+    static constexpr uint8_t tftRst = 17;
+    static constexpr uint8_t tftMosi = 23;
+    static constexpr uint8_t tftClk = 18;
+
+    static constexpr ThermocoupleChip chip = CHIP_MAX6675;
+    static constexpr uint32_t chipClockHz = 4000000;  // the MAX6675 allows 4.3MHz
+    static constexpr PanelDriver panel = PANEL_ILI9341;
+};
+
+// The 14-bit MAX31855K on the same pins
+struct DevkitMax31855Board : DevkitBoard {
+    static constexpr ThermocoupleChip chip = CHIP_MAX31855;
+    static constexpr uint32_t chipClockHz = 5000000;
+};
+
+// A 3.5" 480x320 ILI9488 panel on the same pins
+struct DevkitIli9488Board : DevkitBoard {
+    static constexpr PanelDriver panel = PANEL_ILI9488;
+};
+
+// a pin that can be used on an ESP32 module: not the flash (6-11), not the serial port (1, 3)
+constexpr bool boardPinUsable(uint8_t pin) {
+    return pin <= 39 && pin != 1 && pin != 3 && (pin < 6 || pin > 11) && pin != 20 && pin != 24 &&
+           (pin < 28 || pin > 31);
+}
+
+// 34-39 are inputs only
+constexpr bool boardPinOutput(uint8_t pin) {
+    return boardPinUsable(pin) && pin < 34;
+}
+
+constexpr bool boardPinNotIn(uint8_t) {
+    return true;
+}
+
+template <class... Pins>
+constexpr bool boardPinNotIn(uint8_t pin, uint8_t first, Pins... rest) {
+    return pin != first && boardPinNotIn(pin, rest...);
+}
+
+constexpr bool boardPinsDistinct() {
+    return true;
+}
+
+template <class... Pins>
+constexpr bool boardPinsDistinct(uint8_t first, Pins... rest) {
+    return boardPinNotIn(first, rest...) && boardPinsDistinct(rest...);
+}
+
+template <class Board>
+constexpr bool boardPinsValid() {
+    return boardPinsDistinct(Board::ssr, Board::fan, Board::dsoTrig, Board::rotaryClk, Board::rotaryDt,
+                             Board::rotarySw, Board::maxCs, Board::maxSo, Board::maxClk, Board::probeCs,
+                             Board::tftOn, Board::tftCs, Board::tftDc, Board::tftRst, Board::tftMosi, Board::tftClk) &&
+           boardPinOutput(Board::ssr) && boardPinOutput(Board::fan) && boardPinOutput(Board::dsoTrig) &&
+           boardPinUsable(Board::rotaryClk) && boardPinUsable(Board::rotaryDt) && boardPinUsable(Board::rotarySw) &&
+           boardPinOutput(Board::maxCs) && boardPinUsable(Board::maxSo) && boardPinOutput(Board::maxClk) &&
+           boardPinOutput(Board::probeCs) && boardPinOutput(Board::tftOn) && boardPinOutput(Board::tftCs) &&
+           boardPinOutput(Board::tftDc) && boardPinOutput(Board::tftRst) && boardPinOutput(Board::tftMosi) &&
+           boardPinOutput(Board::tftClk);
+}
+
+static_assert(boardPinsValid<DevkitBoard>(), "DevkitBoard: a pin is used twice or cannot be used");
+static_assert(boardPinsValid<DevkitMax31855Board>(), "DevkitMax31855Board: a pin is used twice or cannot be used");
+static_assert(boardPinsValid<DevkitIli9488Board>(), "DevkitIli9488Board: a pin is used twice or cannot be used");
+
+// the variant of this build, set by the environment in platformio.ini
+#if defined(BOARD_DEVKIT_MAX31855)
+typedef DevkitMax31855Board Board;
+#elif defined(BOARD_DEVKIT_ILI9488)
+typedef DevkitIli9488Board Board;
+#else
+typedef DevkitBoard Board;
+#endif
+
+#endif  // BOARD_CONFIG_H
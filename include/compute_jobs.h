@@ -0,0 +1,157 @@
+/*
+  The background jobs of the UI: computations that would hold up the main loop
+
+    computeSubmit(jobs, JOB_PREDICT, 2, millis());       // the inputs of the job have changed
+
+    ComputeJob job;                                      // the worker, on the other core
+    if (computeTake(jobs, &job, millis())) {
+        ... if (computeCancelled(jobs, job)) give up ...
+        computeFinished(jobs, job, completed, millis());
+    }
+
+    ComputeResult result;                                // the main loop
+    while (computeResult(jobs, &result, millis())) ... use the result of result.kind ...
+
+  There is at most one job of a kind: a submission makes a new generation of the kind, which
+  supersedes the job of the same kind that is queued or running. The queued one is dropped,
+  the running one sees it at its next computeCancelled() and stops. Both count as cancelled.
+  The worker takes the queued job with the highest priority, the oldest one first.
+
+  A finished job puts an event on the result queue. The main loop takes the events, an event
+  of a generation that was superseded in the meantime is dropped (and counted as cancelled), so
+  the loop only gets the result of the latest inputs. The results themselves are in buffers of
+  the application, a buffer of a kind always has the result of the latest finished generation.
+
+  The statistics per kind: the jobs that were delivered, the cancelled ones, the latency from
+  the submission to the delivery (total and maximum) and the longest run time.
+
+  Not thread safe: the firmware holds a lock around every call, except computeCancelled()
+  which is a single 32-bit read. Plain C++11 without Arduino dependencies.
+*/
+#ifndef COMPUTE_JOBS_H
+#define COMPUTE_JOBS_H
+
+#include <stdint.h>
+
+#define COMPUTE_KINDS 4    // the kinds of jobs the application can have
+#define COMPUTE_RESULTS 8  // events in the result queue, a power of 2
+
+static_assert(COMPUTE_RESULTS >= COMPUTE_KINDS, "the result queue holds an event of every kind");
+
+struct ComputeJob {
+    uint8_t kind;
+    uint32_t generation;  // the inputs it was submitted for
+    uint32_t submitted;   // ms
+    uint32_t started;     // ms
+};
+
+struct ComputeResult {
+    uint8_t kind;
+    uint32_t generation;
+    uint32_t submitted;  // ms, for the latency
+};
+
+struct ComputeStats {
+    uint32_t done;          // results delivered to the main loop
+    uint32_t cancelled;     // superseded before they were delivered
+    uint32_t latencyTotal;  // ms from the submission to the delivery, of the delivered ones
+    uint32_t latencyMax;    // ms
+    uint32_t runMax;        // ms, the longest run of a job that finished
+};
+
+struct ComputeQueue {
+    volatile uint32_t generation[COMPUTE_KINDS];  // the latest submission of a kind
+    uint32_t submitted[COMPUTE_KINDS];            // ms
+    uint8_t priority[COMPUTE_KINDS];              // higher goes first
+    bool queued[COMPUTE_KINDS];                   // waiting for the worker
+    ComputeResult results[COMPUTE_RESULTS];
+    uint32_t resultHead, resultTail;  // count up
+    ComputeStats stats[COMPUTE_KINDS];
+};
+
+// supersede the job of the kind with a new one, returns its generation
+inline uint32_t computeSubmit(ComputeQueue& q, uint8_t kind, uint8_t priority, uint32_t now) {
+    if (q.queued[kind]) q.stats[kind].cancelled++;
+    q.generation[kind] = q.generation[kind] + 1;
+    q.submitted[kind] = now;
+    q.priority[kind] = priority;
+    q.queued[kind] = true;
+    return q.generation[kind];
+}
+
+// supersede the job of the kind without a new one: the inputs are gone
+inline void computeCancel(ComputeQueue& q, uint8_t kind) {
+    if (q.queued[kind]) q.stats[kind].cancelled++;
+    q.generation[kind] = q.generation[kind] + 1;
+    q.queued[kind] = false;
+}
+
+// the next job for the worker, false when there is none
+inline bool computeTake(ComputeQueue& q, ComputeJob* job, uint32_t now) {
+    int best = -1;
+    for (int kind = 0; kind < COMPUTE_KINDS; kind++) {
+        if (!q.queued[kind]) continue;
+        if (best < 0 || q.priority[kind] > q.priority[best] ||
+            (q.priority[kind] == q.priority[best] && (int32_t)(q.submitted[kind] - q.submitted[best]) < 0)) {
+            best = kind;
+        }
+    }
+    if (best < 0) return false;
+    q.queued[best] = false;
+    job->kind = (uint8_t)best;
+    job->generation = q.generation[best];
+    job->submitted = q.submitted[best];
+    job->started = now;
+    return true;
+}
+
+// the job was superseded, the worker checks this at its checkpoints
+inline bool computeCancelled(const ComputeQueue& q, const ComputeJob& job) {
+    return q.generation[job.kind] != job.generation;
+}
+
+// the end of a job: completed puts its result on the queue, otherwise it was cancelled
+inline void computeFinished(ComputeQueue& q, const ComputeJob& job, bool completed, uint32_t now) {
+    ComputeStats& stats = q.stats[job.kind];
+    if (!completed || computeCancelled(q, job)) {
+        stats.cancelled++;
+        return;
+    }
+    if (now - job.started > stats.runMax) stats.runMax = now - job.started;
+    // an older result of the kind that the loop did not take yet is replaced, so there is
+    // never more than one event of a kind in the queue and it cannot overflow
+    for (uint32_t i = q.resultTail; i != q.resultHead; i++) {
+        ComputeResult& older = q.results[i % COMPUTE_RESULTS];
+        if (older.kind != job.kind) continue;
+        older.generation = job.generation;
+        older.submitted = job.submitted;
+        stats.cancelled++;
+        return;
+    }
+    ComputeResult& result = q.results[q.resultHead % COMPUTE_RESULTS];
+    result.kind = job.kind;
+    result.generation = job.generation;
+    result.submitted = job.submitted;
+    q.resultHead++;
+}
+
+// the next result for the main loop, false when there is none
+inline bool computeResult(ComputeQueue& q, ComputeResult* result, uint32_t now) {
+    while (q.resultTail != q.resultHead) {
+        *result = q.results[q.resultTail % COMPUTE_RESULTS];
+        q.resultTail++;
+        ComputeStats& stats = q.stats[result->kind];
+        if (q.generation[result->kind] != result->generation) {
+            stats.cancelled++;
+            continue;
+        }
+        uint32_t latency = now - result->submitted;
+        stats.done++;
+        stats.latencyTotal += latency;
+        if (latency > stats.latencyMax) stats.latencyMax = latency;
+        return true;
+    }
+    return false;
+}
+
+#endif  // COMPUTE_JOBS_H
@@ -0,0 +1,159 @@
+/*
+  Logging with the formatting on the host
+
+    LOG("Temp: %.2f", TCCelsius);
+
+  The format string is not in the firmware: it goes into the .dlog section of the ELF file,
+  which has no address in the flash (the section flags are overridden, the "#" comments out
+  the ones the compiler adds). The offset of the string in that section is its id. A LOG only
+  writes a record with the id, the time and the raw values of the arguments to a ring buffer in
+  RAM, which the main loop sends to the serial port. tools/dlog reads the format strings from
+  the ELF file of the build and prints the records as text.
+
+  A record: DLOG_START, the length of the rest, the id (16 bits), the time in ms (32 bits),
+  the arguments and the sum of the bytes after the length. An integer argument is sent as 32 bits
+  (%d %i %u %x %X %o %c), a float or a double as a float (%f %e %g), a string (%s) as its
+  length and at most DLOG_MAX_STRING characters. A LOG is a line, it has no "\n" at the end.
+
+  With DLOG_TEXT defined, LOG formats the text on the device and gives it to dlogTextOut(),
+  for a build without the host tool and for the scenario runner of tools/scenario.
+
+  The firmware defines the buffer (DLog dlog;) and the time (millis()), and in text mode
+  dlogTextOut(). Plain C++11 without Arduino dependencies.
+*/
+#ifndef DLOG_H
+#define DLOG_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <type_traits>
+
+#define DLOG_START 0xA5        // the first byte of a record, the debug text is ASCII
+#define DLOG_BUFFER 1024       // bytes in the ring buffer, a power of 2
+#define DLOG_MAX_RECORD 64     // bytes of a record with its start, length and sum
+#define DLOG_MAX_STRING 24     // characters of a string argument that are sent
+#define DLOG_HEADER 8          // start, length, id and time
+
+struct DLog {
+    uint8_t data[DLOG_BUFFER];
+    uint32_t head;     // where the next record is written, counts up
+    uint32_t tail;     // the first byte that was not sent yet
+    uint32_t dropped;  // records that did not fit in the buffer
+};
+
+// the arguments of a record, in the order of the format
+inline void dlogPut(uint8_t*& p, const uint8_t* end, const void* value, size_t size) {
+    if (p + size > end) {
+        p = nullptr;  // the record is too long
+        return;
+    }
+    memcpy(p, value, size);
+    p += size;
+}
+
+inline void dlogArgument(uint8_t*& p, const uint8_t* end, double value) {
+    float f = (float)value;
+    dlogPut(p, end, &f, sizeof(f));
+}
+
+inline void dlogArgument(uint8_t*& p, const uint8_t* end, const char* value) {
+    size_t n = value ? strlen(value) : 0;
+    uint8_t length = (uint8_t)(n < DLOG_MAX_STRING ? n : DLOG_MAX_STRING);
+    dlogPut(p, end, &length, 1);
+    if (p) dlogPut(p, end, value, length);
+}
+
+template <class T>
+typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value>::type dlogArgument(uint8_t*& p,
+                                                                                              const uint8_t* end,
+                                                                                              T value) {
+    int32_t v = (int32_t)value;
+    dlogPut(p, end, &v, sizeof(v));
+}
+
+inline void dlogArguments(uint8_t*&, const uint8_t*) {}
+
+template <class T, class... Rest>
+void dlogArguments(uint8_t*& p, const uint8_t* end, T value, Rest... rest) {
+    dlogArgument(p, end, value);
+    if (p) dlogArguments(p, end, rest...);
+}
+
+// write a record to the buffer, it is dropped when the buffer is full
+template <class... Args>
+void dlogWrite(DLog& log, uint16_t id, uint32_t time, Args... args) {
+    uint8_t record[DLOG_MAX_RECORD];
+    uint8_t* p = record + DLOG_HEADER;
+    dlogArguments(p, record + DLOG_MAX_RECORD - 1, args...);
+    if (!p) {
+        log.dropped++;
+        return;
+    }
+    size_t size = p - record + 1;
+    record[0] = DLOG_START;
+    record[1] = (uint8_t)(size - 3);
+    memcpy(record + 2, &id, sizeof(id));
+    memcpy(record + 4, &time, sizeof(time));
+    uint8_t sum = 0;
+    for (size_t i = 2; i < size - 1; i++) sum += record[i];
+    record[size - 1] = sum;
+
+    if (log.head - log.tail + size > DLOG_BUFFER) {
+        log.dropped++;
+        return;
+    }
+    for (size_t i = 0; i < size; i++) log.data[(log.head + i) & (DLOG_BUFFER - 1)] = record[i];
+    log.head += size;
+}
+
+// copy the whole records that fit in room bytes to out and remove them from the buffer
+inline size_t dlogTake(DLog& log, uint8_t* out, size_t room) {
+    size_t n = 0;
+    while (log.tail + n != log.head) {
+        size_t size = log.data[(log.tail + n + 1) & (DLOG_BUFFER - 1)] + 3;
+        if (n + size > room) break;
+        n += size;
+    }
+    for (size_t i = 0; i < n; i++) out[i] = log.data[(log.tail + i) & (DLOG_BUFFER - 1)];
+    log.tail += n;
+    return n;
+}
+
+#ifdef DLOG_TEXT
+
+void dlogTextOut(const char* text);
+
+// the same conversions as the host: integers as 32 bits, floats as float, strings cut off. An integer keeps
+// the type of the argument, the format has the length modifier of that type (%lu with an unsigned long)
+inline int dlogTextValue(int v) { return v; }
+inline unsigned dlogTextValue(unsigned v) { return v; }
+inline long dlogTextValue(long v) { return (int32_t)v; }
+inline unsigned long dlogTextValue(unsigned long v) { return (uint32_t)v; }
+inline double dlogTextValue(double v) { return (float)v; }
+inline const char* dlogTextValue(const char* v) { return v; }
+
+template <class... Args>
+void dlogText(const char* format, Args... args) {
+    char text[128];
+    snprintf(text, sizeof(text), format, dlogTextValue(args)...);
+    dlogTextOut(text);
+}
+
+#define LOG(format, ...) dlogText(format "\r\n", ##__VA_ARGS__)
+
+#else
+
+#define DLOG_SECTION __attribute__((section(".dlog,\"\",@progbits #"), used))
+
+#define LOG(format, ...)                                                                   \
+    do {                                                                                   \
+        static const char dlogFormat[] DLOG_SECTION = format;                              \
+        dlogWrite(dlog, (uint16_t)(uintptr_t)dlogFormat, (uint32_t)millis(), ##__VA_ARGS__); \
+    } while (0)
+
+#endif  // DLOG_TEXT
+
+#endif  // DLOG_H
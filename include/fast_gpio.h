@@ -0,0 +1,82 @@
+/*
+  GPIO with the pin number as a template parameter
+
+    OutputPin<Board::fan>::high();
+    if (InputPin<Board::maxSo>::read()) ...
+
+  On the ESP32 a write is one store to the set or clear register of the GPIO block and a read is
+  one load, instead of the digitalWrite() and digitalRead() calls that look up the pin at run
+  time. The pin must be set up with pinMode() first. Elsewhere (the scenario runner of
+  tools/scenario) the Arduino functions are used.
+
+  spinNanoseconds() waits a short time for the bus timing of a chip, by the cycle counter of
+  the CPU (at the F_CPU of the build) on the ESP32.
+*/
+#ifndef FAST_GPIO_H
+#define FAST_GPIO_H
+
+#include <stdint.h>
+
+#if defined(ESP32)
+#include <soc/gpio_struct.h>
+#include <xtensa/core-macros.h>
+
+template <uint8_t Pin>
+struct OutputPin {
+    static_assert(Pin < 34, "GPIO34-39 are inputs only");
+    static inline void high() {
+        if (Pin < 32) {
+            GPIO.out_w1ts = 1UL << (Pin & 31);
+        } else {
+            GPIO.out1_w1ts.val = 1UL << (Pin & 31);
+        }
+    }
+    static inline void low() {
+        if (Pin < 32) {
+            GPIO.out_w1tc = 1UL << (Pin & 31);
+        } else {
+            GPIO.out1_w1tc.val = 1UL << (Pin & 31);
+        }
+    }
+    static inline void write(bool level) {
+        if (level) {
+            high();
+        } else {
+            low();
+        }
+    }
+};
+
+template <uint8_t Pin>
+struct InputPin {
+    static inline bool read() {
+        return Pin < 32 ? (GPIO.in >> (Pin & 31)) & 1 : (GPIO.in1.val >> (Pin & 31)) & 1;
+    }
+};
+
+inline void spinNanoseconds(uint32_t ns) {
+    uint32_t cycles = ns * (F_CPU / 1000000) / 1000;
+    uint32_t start = XTHAL_GET_CCOUNT();
+    while (XTHAL_GET_CCOUNT() - start < cycles) {
+    }
+}
+
+#else
+
+template <uint8_t Pin>
+struct OutputPin {
+    static inline void high() { digitalWrite(Pin, HIGH); }
+    static inline void low() { digitalWrite(Pin, LOW); }
+    static inline void write(bool level) { digitalWrite(Pin, level ? HIGH : LOW); }
+};
+
+template <uint8_t Pin>
+struct InputPin {
+    static inline bool read() { return digitalRead(Pin) != 0; }
+};
+
+inline void spinNanoseconds(uint32_t) {}
+
+#endif  // ESP32
+
+#endif  // FAST_GPIO_H
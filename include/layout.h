@@ -0,0 +1,70 @@
+/*
+  Screen layout from a description of the fields
+
+  The fields of the screen are described by their distance to the edges of the display
+  instead of by absolute coordinates, so the same description works for the 320x240 ILI9341
+  and a larger 480x320 ILI9488 or ST7796 panel. The rectangles are calculated once at boot,
+  when the size of the panel is known, the drawing code only uses the calculated boxes.
+
+  A field is placed from the left or the right edge and from the top or the bottom edge,
+  and has a fixed size or stretches to a margin from the other edge:
+
+    {FROM_RIGHT, 60, 0, 60, 15, 5, 0}                   60px wide button at the right edge
+    {STRETCH_WIDTH | STRETCH_HEIGHT, 18, 60, 2, 13}     the chart: fills the rest, with margins
+
+  The last two values are the position of the text in the field.
+
+  No Arduino dependencies, plain C++11.
+*/
+#ifndef LAYOUT_H
+#define LAYOUT_H
+
+#include <stdint.h>
+
+enum LayoutFlags {
+    FROM_LEFT = 0x00,       // x is the distance from the left edge to the left side
+    FROM_RIGHT = 0x01,      // x is the distance from the right edge to the left side
+    FROM_TOP = 0x00,        // y is the distance from the top edge to the top
+    FROM_BOTTOM = 0x02,     // y is the distance from the bottom edge to the top
+    STRETCH_WIDTH = 0x04,   // w is the margin to the right edge instead of the width
+    STRETCH_HEIGHT = 0x08   // h is the margin to the bottom edge instead of the height
+};
+
+struct LayoutSpec {
+    uint8_t flags;       // LayoutFlags
+    int16_t x, y, w, h;  // px
+    int8_t textX, textY; // px, the text position relative to the field
+};
+
+// A field on the screen
+struct LayoutBox {
+    int16_t x, y, w, h;
+    int16_t textX, textY;  // the text position on the screen
+
+    int16_t right() const { return x + w; }
+    int16_t bottom() const { return y + h; }
+};
+
+inline LayoutBox layoutBox(const LayoutSpec& s, int width, int height) {
+    LayoutBox b;
+    b.x = (s.flags & FROM_RIGHT) ? width - s.x : s.x;
+    b.y = (s.flags & FROM_BOTTOM) ? height - s.y : s.y;
+    b.w = (s.flags & STRETCH_WIDTH) ? width - s.w - b.x : s.w;
+    b.h = (s.flags & STRETCH_HEIGHT) ? height - s.h - b.y : s.h;
+    b.textX = b.x + s.textX;
+    b.textY = b.y + s.textY;
+    return b;
+}
+
+// Calculate the boxes for a width x height screen, returns the number of boxes that are not on the screen
+inline int layoutScreen(const LayoutSpec* specs, int count, int width, int height, LayoutBox* boxes) {
+    int outside = 0;
+    for (int i = 0; i < count; i++) {
+        boxes[i] = layoutBox(specs[i], width, height);
+        const LayoutBox& b = boxes[i];
+        if (b.x < 0 || b.y < 0 || b.w <= 0 || b.h <= 0 || b.right() > width || b.bottom() > height) outside++;
+    }
+    return outside;
+}
+
+#endif  // LAYOUT_H
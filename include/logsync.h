@@ -0,0 +1,103 @@
+/*
+  Incremental synchronization of the run logs over the serial port
+
+  The host keeps a high-water mark per station: the run and the block of that run it needs
+  next (block 0 is the RunLogHeader of the file, 1.. are the blocks of include/runlog.h).
+  It sends a text line
+
+    SYNC <runId> <block>
+
+  and the controller streams everything from that point as binary frames: a start frame with
+  the mark of the request, the header of every run, the blocks as they are in the file, a closed
+  frame at the end of every finished run and an end frame with the mark the host has reached.
+  The blocks of the active run are sent as far as they are written, the next SYNC continues
+  from there. Every frame continues exactly at the mark of the host, with two exceptions: after
+  a closed frame the next run may have a higher id (a run without a log), and the first frame
+  after the start may skip to a later run when the runs of the mark were removed to make room.
+
+  A frame is a LogSyncFrame, the data and a CRC-32 of both. The frames share the port with the
+  debug prints of the firmware, the host looks for the magic and drops what does not check out.
+  After a lost or damaged frame, a time-out or a reset of the controller, the host sends its
+  mark again, so an interrupted transfer resumes at the last block it has verified.
+
+  Shared between the firmware and tools/runlog, plain C++11 without Arduino dependencies.
+*/
+#ifndef LOGSYNC_H
+#define LOGSYNC_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "runlog.h"
+
+#define LOGSYNC_MAGIC 0x59534C52  // "RLSY" on the wire
+#define LOGSYNC_START 'S'         // no data, runId and block are the mark of the SYNC
+#define LOGSYNC_HEADER 'H'        // data is the RunLogHeader of the run, block is 0
+#define LOGSYNC_BLOCK 'B'         // data is a block as in the file: header, payload and padding
+#define LOGSYNC_CLOSED 'C'        // no data, the run is finished, block is the number of blocks + 1
+#define LOGSYNC_END 'E'           // no data, runId and block are the next mark of the host
+#define LOGSYNC_STATUS 'T'        // data is a StationStatus, the answer to STATUS (include/station_status.h)
+#define LOGSYNC_PASTE 'P'         // data is a StationPaste, block is its index, the answer to PASTES
+#define LOGSYNC_MAX_DATA (sizeof(RunLogBlockHeader) + RUNLOG_MAX_PAYLOAD + 3)
+
+struct LogSyncFrame {
+    uint32_t magic;   // LOGSYNC_MAGIC
+    uint8_t type;     // LOGSYNC_START .. LOGSYNC_END
+    uint8_t reserved; // 0
+    uint16_t length;  // bytes of data after this header
+    uint32_t runId;
+    uint32_t block;   // 0 for the header of the run, 1.. for the blocks
+};
+
+static_assert(sizeof(LogSyncFrame) == 16, "LogSyncFrame must be 16 bytes");
+
+// the size of the largest frame: header, data and CRC
+#define LOGSYNC_MAX_FRAME (sizeof(LogSyncFrame) + LOGSYNC_MAX_DATA + 4)
+
+// the bytes a block takes in the file, with the padding to a multiple of 4
+inline uint32_t logSyncBlockSize(const RunLogBlockHeader& block) {
+    return sizeof(RunLogBlockHeader) + (block.payloadSize + 3) / 4 * 4;
+}
+
+/*
+  Complete a frame in place: the data must already be at frame + sizeof(LogSyncFrame).
+  Returns the size of the frame to send.
+*/
+inline size_t logSyncSeal(uint8_t* frame, uint8_t type, uint32_t runId, uint32_t block, uint16_t length) {
+    LogSyncFrame header;
+    header.magic = LOGSYNC_MAGIC;
+    header.type = type;
+    header.reserved = 0;
+    header.length = length;
+    header.runId = runId;
+    header.block = block;
+    memcpy(frame, &header, sizeof(header));
+    size_t size = sizeof(header) + length;
+    uint32_t crc = runLogCrc32(frame, size);
+    memcpy(frame + size, &crc, sizeof(crc));
+    return size + sizeof(crc);
+}
+
+/*
+  Look for a frame at the start of the received bytes. Returns the size of a complete frame
+  with a good CRC (its header is copied to *header), 0 when more bytes are needed, or -1 when
+  this is not the start of a frame: drop a byte and look again.
+*/
+inline int logSyncCheck(const uint8_t* bytes, size_t available, LogSyncFrame* header) {
+    const uint32_t magic = LOGSYNC_MAGIC;
+    for (size_t i = 0; i < available && i < sizeof(magic); i++) {
+        if (bytes[i] != ((const uint8_t*)&magic)[i]) return -1;
+    }
+    if (available < sizeof(LogSyncFrame)) return 0;
+    memcpy(header, bytes, sizeof(LogSyncFrame));
+    if (header->length > LOGSYNC_MAX_DATA) return -1;
+    size_t size = sizeof(LogSyncFrame) + header->length;
+    if (available < size + 4) return 0;
+    uint32_t crc;
+    memcpy(&crc, bytes + size, sizeof(crc));
+    if (crc != runLogCrc32(bytes, size)) return -1;
+    return (int)(size + 4);
+}
+
+#endif  // LOGSYNC_H
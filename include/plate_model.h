@@ -0,0 +1,135 @@
+/*
+  A simple thermal model of the hotplate, to try the controller without heating anything
+
+  The plate is modelled with lumped elements:
+  - the heating element, heated by the SSR (the PWM value is taken as the average power)
+    and coupled to the plate
+  - the aluminium plate, that loses heat to the air, more when the fans are running
+  - the board on the plate, the same first order lag with heat loss as in profile_plan.h
+  - the thermocouple, a first order lag on the plate temperature, read by the MAX6675
+    in steps of 0.25°C and with some noise
+
+  The default parameters are a rough fit of the UYUE 946C 400W 200x200mm plate: about
+  2.5°C/s at full power from room temperature and 0.85°C/s natural cooling at 250°C.
+
+  No Arduino dependencies, plain C++11, so it can be used in the host tools.
+*/
+#ifndef PLATE_MODEL_H
+#define PLATE_MODEL_H
+
+#include <math.h>
+#include <stdint.h>
+
+struct PlateParams {
+    double heaterPower;       // W at PWM 255
+    double elementCapacity;   // J/°C
+    double elementCoupling;   // W/°C from the element to the plate
+    double plateCapacity;     // J/°C
+    double plateLoss;         // W/°C from the plate to the air
+    double fanLoss;           // W/°C extra with the fans on
+    double ambient;           // °C
+    double sensorTau;         // s, the thermocouple lag
+    double sensorNoise;       // °C, standard deviation of the reading noise
+    double sensorResolution;  // °C, 0.25 for the MAX6675
+    double boardTau;          // s, see BoardModel
+    double boardLoss;         // see BoardModel
+};
+
+inline PlateParams defaultPlateParams() {
+    PlateParams p;
+    p.heaterPower = 400;
+    p.elementCapacity = 40;
+    p.elementCoupling = 15;
+    p.plateCapacity = 120;
+    p.plateLoss = 0.6;
+    p.fanLoss = 2.0;
+    p.ambient = 20;
+    p.sensorTau = 2.0;
+    p.sensorNoise = 0.2;
+    p.sensorResolution = 0.25;
+    p.boardTau = 15.0;
+    p.boardLoss = 0.05;
+    return p;
+}
+
+// The state of the simulated plate, all temperatures in °C
+struct PlateState {
+    double element;
+    double plate;
+    double board;
+    double sensor;    // the temperature of the thermocouple junction
+    uint32_t random;  // state of the noise generator
+};
+
+// Everything at the ambient temperature, the seed makes the noise repeatable
+inline PlateState plateAtRest(const PlateParams& p, uint32_t seed) {
+    PlateState s;
+    s.element = s.plate = s.board = s.sensor = p.ambient;
+    s.random = seed ? seed : 1;
+    return s;
+}
+
+/*
+  Advance the model by dt seconds with the SSR PWM value (0..255) and the fans on or off.
+  Keep dt at 0.1s or less, the element is a fast node.
+*/
+inline void plateStep(const PlateParams& p, PlateState& s, double pwm, bool fan, double dt) {
+    double heat = p.heaterPower * pwm / 255.0;
+    double toPlate = p.elementCoupling * (s.element - s.plate);
+    double toAir = (p.plateLoss + (fan ? p.fanLoss : 0)) * (s.plate - p.ambient);
+
+    s.element += dt * (heat - toPlate) / p.elementCapacity;
+    s.plate += dt * (toPlate - toAir) / p.plateCapacity;
+    s.board += dt * ((s.plate - s.board) - p.boardLoss * (s.board - p.ambient)) / p.boardTau;
+    s.sensor += dt * (s.plate - s.sensor) / p.sensorTau;
+}
+
+// The dT/dt of the plate the model expects with this power and fans, on a steady ramp (the
+// element follows the plate): the heat of the element less the losses over both capacities
+inline double plateRate(const PlateParams& p, double pwm, bool fan, double temperature) {
+    double heat = p.heaterPower * pwm / 255.0;
+    double toAir = (p.plateLoss + (fan ? p.fanLoss : 0)) * (temperature - p.ambient);
+    return (heat - toAir) / (p.elementCapacity + p.plateCapacity);
+}
+
+/*
+  plateRate() as the filtered dT/dt of the readings shows it: after a step of the power the plate
+  only follows the element with a lag, the thermocouple follows the plate and the dT/dt is
+  filtered (filter, s). The expected dT/dt of an on/off regulation is then not a step ahead of the
+  readings. The state starts at zero, a plate at rest.
+*/
+struct PlateRateLag {
+    double plate;   // °C/s, the rate of the plate
+    double sensor;  // °C/s, the rate of the thermocouple
+    double rate;    // °C/s, the filtered rate
+};
+
+inline double plateRateLag(const PlateParams& p, PlateRateLag& l, double rate, double filter, double dt) {
+    double plateTau = p.elementCapacity * p.plateCapacity / (p.elementCoupling * (p.elementCapacity + p.plateCapacity));
+    l.plate += dt / (plateTau + dt) * (rate - l.plate);
+    l.sensor += dt / (p.sensorTau + dt) * (l.plate - l.sensor);
+    l.rate += dt / (filter + dt) * (l.sensor - l.rate);
+    return l.rate;
+}
+
+// A uniform random number in [0, 1) (xorshift32)
+inline double plateRandom(PlateState& s) {
+    s.random ^= s.random << 13;
+    s.random ^= s.random >> 17;
+    s.random ^= s.random << 5;
+    return (s.random >> 8) * (1.0 / 16777216.0);
+}
+
+// What the MAX6675 reports: the sensor temperature with noise, in steps of the resolution
+inline double plateReading(const PlateParams& p, PlateState& s) {
+    double noise = 0;
+    if (p.sensorNoise > 0) {
+        // sum of 4 uniform numbers, close enough to a normal distribution for this purpose
+        noise = (plateRandom(s) + plateRandom(s) + plateRandom(s) + plateRandom(s) - 2.0) * p.sensorNoise * sqrt(3.0);
+    }
+    double reading = s.sensor + noise;
+    if (p.sensorResolution > 0) reading = floor(reading / p.sensorResolution) * p.sensorResolution;
+    return reading;
+}
+
+#endif  // PLATE_MODEL_H
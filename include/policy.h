@@ -0,0 +1,79 @@
+/*
+  Lookup table control policy
+
+  tools/policy solves the control problem of the plate offline: for every setpoint, error and
+  rate of the plate it finds the PWM value that follows the profile with the least (mostly
+  overshoot) error, by dynamic programming on the plate model. The result is a table of PWM
+  values on a coarse grid, generated as include/policy_table.h. The controller only has to
+  look up the 8 grid points around the state and interpolate between them.
+
+  The table is solved for one profile, the setpoint moves along that profile in the model.
+
+  No Arduino dependencies, plain C++11.
+*/
+#ifndef POLICY_H
+#define POLICY_H
+
+#include <stdint.h>
+
+#include "profile_plan.h"
+
+// A grid axis: count values from first in steps of step
+struct PolicyAxis {
+    float first;
+    float step;
+    uint8_t count;
+};
+
+struct PolicyTable {
+    ReflowProfile profile;  // the profile the policy was solved for
+    PolicyAxis setpoint;    // °C
+    PolicyAxis error;       // °C, temperature - setpoint
+    PolicyAxis rate;        // °C/s, the filtered dT/dt of the plate
+    const uint8_t* pwm;     // [setpoint][error][rate]
+};
+
+// The grid point below value on the axis and the fraction to the next one, clamped to the ends of the axis
+inline int policyIndex(const PolicyAxis& a, double value, double* fraction) {
+    double position = (value - a.first) / a.step;
+    if (position <= 0) {
+        *fraction = 0;
+        return 0;
+    }
+    if (position >= a.count - 1) {
+        *fraction = 1;
+        return a.count - 2;
+    }
+    int i = (int)position;
+    *fraction = position - i;
+    return i;
+}
+
+// The PWM value of the policy for the state, interpolated between the grid points
+inline double policyOutput(const PolicyTable& p, double setpoint, double temperature, double rate) {
+    double fs, fe, fr;
+    int s = policyIndex(p.setpoint, setpoint, &fs);
+    int e = policyIndex(p.error, temperature - setpoint, &fe);
+    int r = policyIndex(p.rate, rate, &fr);
+    int ne = p.error.count, nr = p.rate.count;
+    double output = 0;
+    for (int ds = 0; ds < 2; ds++) {
+        for (int de = 0; de < 2; de++) {
+            const uint8_t* row = p.pwm + ((s + ds) * ne + e + de) * nr + r;
+            double w = (ds ? fs : 1 - fs) * (de ? fe : 1 - fe);
+            output += w * ((1 - fr) * row[0] + fr * row[1]);
+        }
+    }
+    return output;
+}
+
+// True when the table was solved for this profile
+inline bool policyMatches(const PolicyTable& p, const ReflowProfile& profile) {
+    const ReflowProfile& q = p.profile;
+    return q.preheatTemp == profile.preheatTemp && q.preheatTime == profile.preheatTime &&
+           q.soakingTemp == profile.soakingTemp && q.soakingTime == profile.soakingTime &&
+           q.reflowTemp == profile.reflowTemp && q.reflowTime == profile.reflowTime &&
+           q.coolingTemp == profile.coolingTemp && q.coolingTime == profile.coolingTime;
+}
+
+#endif  // POLICY_H
@@ -0,0 +1,177 @@
+/*
+  Board-side profile planning
+
+  The solder paste profile tells us what the solder joints should see, but the controller
+  regulates the temperature of the plate. The board lags the plate, certainly on the ramps,
+  and stays a bit below it because it loses heat to the air. This planner calculates the plate
+  setpoints that make the board follow the paste profile.
+
+  The board is modelled as a first order lag on the plate temperature with a heat loss to
+  the ambient air:
+
+    tau * dTboard/dt = (Tplate - Tboard) - loss * (Tboard - Tambient)
+
+  Inverting this for a desired board temperature gives the plate setpoint:
+
+    Tplate = Tboard + tau * dTboard/dt + loss * (Tboard - Tambient)
+
+  The result is then limited to what the heater can do: a maximum plate temperature, a
+  maximum heating rate and a maximum (natural) cooling rate. The heating limit is handled
+  by a backward pass that starts a steep ramp earlier, so the plate is already on its way
+  when the profile asks for the heat. A ramp cannot start before the run: the plate starts at
+  the ambient temperature and a forward pass heats it from there at the maximum rate, the
+  board is late on that part and the distortion says by how much.
+
+  This header has no Arduino dependencies, so it can also be used in the host tools.
+*/
+#ifndef PROFILE_PLAN_H
+#define PROFILE_PLAN_H
+
+#include <math.h>
+#include <stdint.h>
+
+#define PLAN_SECONDS 341  // one setpoint per second for the 340s of the time scale
+
+// The reflow profile points of a solder paste: temperatures in °C, times in seconds from the start
+struct ReflowProfile {
+    int preheatTemp;
+    int preheatTime;
+    int soakingTemp;
+    int soakingTime;
+    int reflowTemp;
+    int reflowTime;
+    int coolingTemp;
+    int coolingTime;
+};
+
+// Plate to board transfer model, fitted from a run with a thermocouple on the board
+struct BoardModel {
+    double tau;      // lag time constant of the board in seconds
+    double loss;     // heat loss of the board to the air, relative to the plate coupling
+    double ambient;  // ambient temperature in °C
+};
+
+// What the heater and the plate can do
+struct PlateLimits {
+    double maxTemp;      // °C
+    double maxHeating;   // °C/s, with the heater at full power
+    double maxCooling;   // °C/s, with the heater off (positive number)
+};
+
+/*
+  The temperature of the profile at time t (s), the straight lines of the reflow curve.
+  It starts at the ambient temperature, after the cooling time the profile wants the
+  temperature to go down to the ambient temperature at the maximum cooling rate.
+*/
+inline double profileTemperature(const ReflowProfile& p, double t, double ambient, double coolingRate) {
+    if (t <= 0) return ambient;
+    if (t < p.preheatTime) return ambient + t / p.preheatTime * (p.preheatTemp - ambient);
+    if (t < p.soakingTime) return p.preheatTemp + (t - p.preheatTime) / (p.soakingTime - p.preheatTime) * (p.soakingTemp - p.preheatTemp);
+    if (t < p.reflowTime) return p.soakingTemp + (t - p.soakingTime) / (p.reflowTime - p.soakingTime) * (p.reflowTemp - p.soakingTemp);
+    if (t < p.coolingTime) return p.reflowTemp + (t - p.reflowTime) / (p.coolingTime - p.reflowTime) * (p.coolingTemp - p.reflowTemp);
+    double cooled = p.coolingTemp - (t - p.coolingTime) * coolingRate;
+    return cooled > ambient ? cooled : ambient;
+}
+
+/*
+  Fill table[0..n-1] with the plate setpoint for every second, in 0.1°C.
+  Returns the largest difference (°C) between the unconstrained setpoint and the
+  planned one, a measure of how much the heater limits distort the board profile.
+*/
+inline double planPlateSetpoints(const ReflowProfile& profile, const BoardModel& model, const PlateLimits& limits,
+                                 int16_t* table, int n) {
+    double plan[PLAN_SECONDS];
+    double ideal[PLAN_SECONDS];
+    if (n > PLAN_SECONDS) n = PLAN_SECONDS;
+
+    // invert the board model, using a central difference for the slope of the profile
+    for (int t = 0; t < n; t++) {
+        double board = profileTemperature(profile, t, model.ambient, limits.maxCooling);
+        double slope = (profileTemperature(profile, t + 1, model.ambient, limits.maxCooling) -
+                        profileTemperature(profile, t - 1, model.ambient, limits.maxCooling)) / 2.0;
+        ideal[t] = board + model.tau * slope + model.loss * (board - model.ambient);
+        if (ideal[t] > limits.maxTemp) ideal[t] = limits.maxTemp;
+        if (ideal[t] < model.ambient) ideal[t] = model.ambient;
+        plan[t] = ideal[t];
+    }
+    // the plate cannot heat faster than maxHeating: start the ramps earlier
+    for (int t = n - 1; t > 0; t--) {
+        if (plan[t - 1] < plan[t] - limits.maxHeating) plan[t - 1] = plan[t] - limits.maxHeating;
+    }
+    // the start of the run is where the plate is, so we cannot start earlier than t = 0: from the ambient
+    // temperature it heats at maxHeating at most, and it cannot cool faster than maxCooling: the plate
+    // stays warmer for a while
+    plan[0] = model.ambient;
+    for (int t = 1; t < n; t++) {
+        if (plan[t] > plan[t - 1] + limits.maxHeating) plan[t] = plan[t - 1] + limits.maxHeating;
+        if (plan[t] < plan[t - 1] - limits.maxCooling) plan[t] = plan[t - 1] - limits.maxCooling;
+    }
+    double distortion = 0;
+    for (int t = 0; t < n; t++) {
+        if (plan[t] > limits.maxTemp) plan[t] = limits.maxTemp;
+        double difference = plan[t] > ideal[t] ? plan[t] - ideal[t] : ideal[t] - plan[t];
+        if (difference > distortion) distortion = difference;
+        table[t] = (int16_t)(plan[t] * 10 + 0.5);
+    }
+    return distortion;
+}
+
+// The plate setpoint at time t (s) from the table, linear between the seconds
+inline double plannedSetpoint(const int16_t* table, int n, double t) {
+    if (t <= 0) return table[0] / 10.0;
+    int i = (int)t;
+    if (i >= n - 1) return table[n - 1] / 10.0;
+    double fraction = t - i;
+    return (table[i] + fraction * (table[i + 1] - table[i])) / 10.0;
+}
+
+/*
+  Fit the board model to a run with a thermocouple on the board.
+  plate and board are the temperatures in 0.1°C, one sample per second. The model is linear
+  in 1/tau and loss/tau:
+
+    dTboard/dt = (Tplate - Tboard) / tau - loss / tau * (Tboard - Tambient)
+
+  so a least squares fit of the measured slope of the board temperature gives both. The slope
+  is taken over 4 seconds to keep the 0.25°C steps of the MAX6675 out of it. The ambient
+  temperature is the board temperature at the start.
+  Returns the rms error of the fitted slope in °C/s, or -1 when the run does not give a
+  plausible model (too short, or no heating).
+*/
+inline double fitBoardModel(const int16_t* plate, const int16_t* board, int n, BoardModel* model) {
+    if (n < 30) return -1;
+    double ambient = board[0] / 10.0;
+    double sxx = 0, sxy = 0, syy = 0, sxz = 0, syz = 0;
+    for (int i = 2; i < n - 2; i++) {
+        double tb = board[i] / 10.0;
+        double x = plate[i] / 10.0 - tb;  // the coupling term
+        double y = -(tb - ambient);       // the loss term
+        double z = (board[i + 2] - board[i - 2]) / 40.0;  // the slope
+        sxx += x * x;
+        sxy += x * y;
+        syy += y * y;
+        sxz += x * z;
+        syz += y * z;
+    }
+    double determinant = sxx * syy - sxy * sxy;
+    if (determinant <= 0) return -1;
+    double a = (sxz * syy - syz * sxy) / determinant;  // 1 / tau
+    double c = (syz * sxx - sxz * sxy) / determinant;  // loss / tau
+    if (a <= 0) return -1;
+    double tau = 1 / a;
+    double loss = c / a;
+    if (tau < 1 || tau > 300 || loss < 0 || loss > 1) return -1;
+
+    double error = 0;
+    for (int i = 2; i < n - 2; i++) {
+        double tb = board[i] / 10.0;
+        double residual = (board[i + 2] - board[i - 2]) / 40.0 - a * (plate[i] / 10.0 - tb) + c * (tb - ambient);
+        error += residual * residual;
+    }
+    model->tau = tau;
+    model->loss = loss;
+    model->ambient = ambient;
+    return sqrt(error / (n - 4));
+}
+
+#endif  // PROFILE_PLAN_H
@@ -0,0 +1,174 @@
+/*
+  Cooperative tasks in the style of protothreads
+
+  A task is a function that is written as sequential code, but returns to the main loop
+  every time it has to wait: for a time, for an event or for a condition. When it is run
+  again, it continues after the wait. This uses the switch statement trick of Adam Dunkels'
+  protothreads, the toolchain of the ESP32 Arduino core has no C++20 coroutines.
+
+    bool blinkTask(Task& t) {
+        TASK_BEGIN(t);
+        while (true) {
+            digitalWrite(LED, HIGH);
+            TASK_DELAY(t, 500);
+            digitalWrite(LED, LOW);
+            TASK_WAIT_EVENT(t, EVENT_BUTTON);
+        }
+        TASK_END(t);
+    }
+
+  The rules:
+  - local variables do not survive a wait, use static or global variables for the state
+  - do not use a switch statement around a wait, the macros use one
+  - a wait may only be used in the task function itself, not in a function it calls
+
+  The task list only runs the tasks that can continue: the wait time has passed, or one of
+  the events they wait for was signalled. The tasks that wait for a condition (TASK_WAIT_UNTIL
+  and TASK_YIELD) are run every time, so use an event when there is one.
+
+  No Arduino dependencies, the time in ms is passed to runTasks().
+*/
+#ifndef PROTOTHREAD_H
+#define PROTOTHREAD_H
+
+#include <stdint.h>
+
+enum TaskState {
+    TASK_STOPPED = 0,  // not running
+    TASK_READY,        // run it the next time
+    TASK_WAIT_TIME,    // waiting for the wake time
+    TASK_WAIT_EVENT    // waiting for one of the events
+};
+
+struct Task;
+typedef bool (*TaskFunction)(Task&);  // returns false when the task has ended
+
+struct Task {
+    TaskFunction function;
+    const char* name;    // for the diagnostics
+    uint16_t resume;     // the line number where the task continues, 0 is the start
+    uint8_t state;       // TaskState
+    uint32_t events;     // the events the task is waiting for
+    uint32_t wakeTime;   // ms
+    uint32_t now;        // ms, the time of this run, for the waits
+};
+
+// a stopped task, to initialize a Task: Task blink = TASK(blinkTask, "blink");
+#define TASK(function, name) {function, name, 0, TASK_STOPPED, 0, 0, 0}
+
+#define TASK_BEGIN(t) \
+    switch ((t).resume) { \
+        case 0:
+
+#define TASK_END(t) \
+    } \
+    (t).resume = 0; \
+    (t).state = TASK_STOPPED; \
+    return false
+
+// continue at this line the next time the task is run
+#define TASK_WAIT_HERE(t) \
+    (t).resume = __LINE__; \
+    return true; \
+    case __LINE__:
+
+// wait for ms milliseconds from now
+#define TASK_DELAY(t, ms) \
+    do { \
+        (t).wakeTime = (t).now + (uint32_t)(ms); \
+        (t).state = TASK_WAIT_TIME; \
+        TASK_WAIT_HERE(t); \
+    } while (0)
+
+// wait until one of the events in the mask is signalled
+#define TASK_WAIT_EVENT(t, mask) \
+    do { \
+        (t).events = (mask); \
+        (t).state = TASK_WAIT_EVENT; \
+        TASK_WAIT_HERE(t); \
+    } while (0)
+
+// wait until the condition is true, it is tested every time the tasks are run
+#define TASK_WAIT_UNTIL(t, condition) \
+    do { \
+        (t).state = TASK_READY; \
+        TASK_WAIT_HERE(t); \
+        if (!(condition)) return true; \
+    } while (0)
+
+// let the other tasks and the main loop run
+#define TASK_YIELD(t) \
+    do { \
+        (t).state = TASK_READY; \
+        TASK_WAIT_HERE(t); \
+    } while (0)
+
+// leave the task before its end
+#define TASK_EXIT(t) \
+    do { \
+        (t).resume = 0; \
+        (t).state = TASK_STOPPED; \
+        return false; \
+    } while (0)
+
+// The tasks of the application and the events that were signalled since they last ran
+struct TaskList {
+    Task** tasks;
+    int count;
+    uint32_t signalled;
+};
+
+// (re)start a task from the beginning
+inline void startTask(Task& t) {
+    t.resume = 0;
+    t.state = TASK_READY;
+    t.events = 0;
+}
+
+// stop a task, it will not run again until it is started
+inline void stopTask(Task& t) {
+    t.resume = 0;
+    t.state = TASK_STOPPED;
+}
+
+inline bool taskRunning(const Task& t) {
+    return t.state != TASK_STOPPED;
+}
+
+// signal events to the tasks that wait for them, from the main loop (not from an ISR)
+inline void signalTasks(TaskList& list, uint32_t events) {
+    list.signalled |= events;
+}
+
+/*
+  Run the tasks that can continue. The events are cleared after this pass, so an event wakes
+  up all the tasks that were waiting for it at the time it was signalled, and is then gone.
+*/
+inline void runTasks(TaskList& list, uint32_t now) {
+    uint32_t events = list.signalled;
+    list.signalled &= ~events;
+    for (int i = 0; i < list.count; i++) {
+        Task& t = *list.tasks[i];
+        bool run;
+        switch (t.state) {
+            case TASK_READY:
+                run = true;
+                break;
+            case TASK_WAIT_TIME:
+                run = (int32_t)(now - t.wakeTime) >= 0;
+                break;
+            case TASK_WAIT_EVENT:
+                run = (t.events & events) != 0;
+                break;
+            default:
+                run = false;
+                break;
+        }
+        if (run) {
+            t.now = now;
+            t.function(t);
+        }
+    }
+}
+
+#endif  // PROTOTHREAD_H
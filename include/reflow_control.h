@@ -0,0 +1,468 @@
+/*
+  The control logic of the reflow controller, without any hardware or display code
+
+  This is what runReflow(), freeHeating() and runWarmup() decide every 250ms: the target
+  temperature, the PWM value for the SSR, the fan and the next reflow phase. It is kept
+  separate from the display and I/O code so the same logic can run in the host tools, on
+  logged data or against the plate simulator (tools/pysim).
+
+  No Arduino dependencies, plain C++11.
+*/
+#ifndef REFLOW_CONTROL_H
+#define REFLOW_CONTROL_H
+
+#include <stdint.h>
+
+#include "policy.h"
+#include "profile_plan.h"
+
+// the reflow phases
+enum ReflowPhase {
+    PREHEAT = 0,
+    SOAK,
+    REFLOW,
+    HOLD,
+    COOLING
+};
+
+// forward looking prediction for the heating cut-off in the preheat and reflow phases.
+// When the heater is on it is ramping up the temperature. We need to turn the heater off before it
+// reaches the target temperature to avoid overshoot due to the inertia of the hardware.
+const int preheatCutOffTime = 15;  // cut off the heater 15s before the end of the preheat phase
+const int reflowCutOffTime = 15;   // cut off the heater 15s before the end of the reflow phase
+
+/*
+  Time warp of the profile
+
+  Without it the profile runs on the wall clock: when the plate lags, a phase ends later
+  (it also waits for the temperature), the next phase then starts with a jump of the target
+  and is shorter than the profile says. With the time warp the controller keeps its own
+  profile time: on a flexible phase (the ramps) it advances slower when the plate falls
+  behind the target and faster when the plate is ahead, so the ramp stretches or compresses
+  and the phases after it keep their length. A phase with flex 0 (the soak and the hold,
+  which sets the time above liquidus) always runs on the wall clock.
+*/
+struct TimeWarp {
+    double flex[4];    // per phase PREHEAT..HOLD, 0..1: how much the phase may stretch or compress
+    double tolerance;  // °C, an error within this does not warp
+    double band;       // °C, beyond the tolerance the warp is at its limit on a fully flexible phase
+    double minRate;    // the slowest progress, profile seconds per second
+    double maxRate;    // the fastest progress
+};
+
+const TimeWarp defaultTimeWarp = {{1.0, 0.0, 1.0, 0.0}, 2.0, 10.0, 0.2, 1.5};
+
+// The reflow controller: the settings and the state of a run
+struct ReflowControl {
+    ReflowProfile profile;  // the paste profile
+    const int16_t* plan;    // planned plate setpoints (PLAN_SECONDS, 0.1°C) for a board-side profile, or 0
+    double coolingTarget;   // the fan runs until the plate is below this temperature
+    const TimeWarp* warp;   // the time warp settings, or 0 to run the profile on the wall clock
+    // the state, updated by reflowStep()
+    ReflowPhase phase;  // the phase we're in
+    double target;      // the target temperature of the last step
+    int output;         // the PWM value for the SSR
+    bool fan;           // the fan should be on
+    double profileTime;     // s, the progress along the profile, the wall clock without the time warp
+    double lastTime;        // s, the wall clock time of the last step
+    double phaseStart[5];   // s, the wall clock time at the start of every phase, -1 before it started
+};
+
+// Get ready for a new run
+inline void reflowStart(ReflowControl& c) {
+    c.phase = PREHEAT;
+    c.target = 0;
+    c.output = 0;
+    c.fan = false;
+    c.profileTime = 0;
+    c.lastTime = 0;
+    c.phaseStart[PREHEAT] = 0;
+    for (int i = SOAK; i <= COOLING; i++) c.phaseStart[i] = -1;
+}
+
+// The time of the profile at which a phase ends
+inline int reflowPhaseEndTime(const ReflowProfile& p, ReflowPhase phase) {
+    switch (phase) {
+        case PREHEAT: return p.preheatTime;
+        case SOAK: return p.soakingTime;
+        case REFLOW: return p.reflowTime;
+        default: return p.coolingTime;
+    }
+}
+
+// The planned and the actual (wall clock) duration of a phase PREHEAT..HOLD, the actual one is -1 when it did not end yet
+inline int reflowPlannedDuration(const ReflowProfile& p, ReflowPhase phase) {
+    return reflowPhaseEndTime(p, phase) - (phase == PREHEAT ? 0 : reflowPhaseEndTime(p, (ReflowPhase)(phase - 1)));
+}
+
+inline double reflowActualDuration(const ReflowControl& c, ReflowPhase phase) {
+    if (c.phaseStart[phase] < 0 || c.phaseStart[phase + 1] < 0) return -1;
+    return c.phaseStart[phase + 1] - c.phaseStart[phase];
+}
+
+/*
+  The target temperature for the plate in a phase at time t.
+  This follows the straight lines of the reflow curve, but a phase that takes longer than
+  the profile continues on its line (the phases end on temperature and time).
+  With a board-side plan, the target is the planned plate setpoint.
+*/
+inline double reflowPhaseTarget(const ReflowControl& c, ReflowPhase phase, double t) {
+    if (c.plan) return plannedSetpoint(c.plan, PLAN_SECONDS, t);
+    const ReflowProfile& p = c.profile;
+    switch (phase) {
+        case PREHEAT:
+            return 20 + (t * (1.0 / p.preheatTime) * (p.preheatTemp - 20));
+        case SOAK:
+            return p.preheatTemp + ((t - p.preheatTime) / (p.soakingTime - p.preheatTime)) * (p.soakingTemp - p.preheatTemp);
+        case REFLOW:
+            return p.soakingTemp + ((t - p.soakingTime) / (p.reflowTime - p.soakingTime)) * (p.reflowTemp - p.soakingTemp);
+        case HOLD:
+            return p.reflowTemp + ((t - p.reflowTime) / (p.coolingTime - p.reflowTime)) * (p.coolingTemp - p.reflowTemp);
+        default:
+            return c.coolingTarget;
+    }
+}
+
+// The plate temperature that ends a phase: the profile temperature, or the planned setpoint at the end of the phase
+inline double reflowPhaseEndTemp(const ReflowControl& c, int profileTemp, int profileTime) {
+    if (c.plan) return plannedSetpoint(c.plan, PLAN_SECONDS, profileTime);
+    return profileTemp;
+}
+
+/*
+  Advance the profile time to the wall clock time t, with the time warp when it is set.
+  The progress rate depends on the error of the plate to the target of the current phase, while
+  the heater is at full power (behind) or off (ahead). When a phase starts, the profile time is
+  set to the start of that phase, so a stretched ramp does not shorten the soak or the hold.
+*/
+inline double reflowProgress(ReflowControl& c, double t, double temperature) {
+    double dt = t - c.lastTime;
+    c.lastTime = t;
+    if (!c.warp || c.phase == COOLING || dt <= 0) {
+        c.profileTime += dt > 0 ? dt : 0;
+        return c.profileTime;
+    }
+    const TimeWarp& w = *c.warp;
+    double error = temperature - reflowPhaseTarget(c, c.phase, c.profileTime);
+    double rate = 1;
+    // only when the heater cannot do more, not when the controller lets the plate coast on purpose
+    if (error < -w.tolerance && c.output >= 255) {
+        double lag = (-error - w.tolerance) / w.band;
+        rate = 1 - w.flex[c.phase] * (lag < 1 ? lag : 1) * (1 - w.minRate);
+    } else if (error > w.tolerance && c.output == 0) {
+        double lead = (error - w.tolerance) / w.band;
+        rate = 1 + w.flex[c.phase] * (lead < 1 ? lead : 1) * (w.maxRate - 1);
+    }
+    c.profileTime += rate * dt;
+    return c.profileTime;
+}
+
+/*
+  One control step of the reflow mode at wall clock time t (s) with the measured temperature.
+  The target and the phase ends use the profile time, which is the wall clock time without the
+  time warp.
+
+  The heater is controlled by PWM with a fixed power per phase. In the preheat and reflow
+  phases there is an early cut-off: close to the end of the phase and within 15°C of the
+  target, the heater is turned off to let the inertia of the plate do the rest.
+  A phase ends when both the temperature and the time of the profile are reached, only
+  the reflow phase ends on either of them.
+*/
+inline void reflowStep(ReflowControl& c, double wallTime, double temperature) {
+    const ReflowProfile& p = c.profile;
+    double t = reflowProgress(c, wallTime, temperature);
+    ReflowPhase before = c.phase;
+    c.target = reflowPhaseTarget(c, c.phase, t);
+
+    switch (c.phase) {
+        case PREHEAT:
+            if (((t >= p.preheatTime - preheatCutOffTime) && (temperature >= c.target - 15)) || (temperature >= c.target)) {
+                c.output = 0;
+            } else {
+                c.output = 255;
+            }
+            if (temperature > reflowPhaseEndTemp(c, p.preheatTemp, p.preheatTime) && t > p.preheatTime) {
+                c.phase = SOAK;
+            }
+            break;
+
+        case SOAK:
+            c.output = (temperature < c.target) ? 150 : 0;  // reduced power
+            if (temperature > reflowPhaseEndTemp(c, p.soakingTemp, p.soakingTime) && t > p.soakingTime) {
+                c.phase = REFLOW;
+            }
+            break;
+
+        case REFLOW:
+            if (((t >= p.reflowTime - reflowCutOffTime) && (temperature >= c.target - 15)) || (temperature >= c.target)) {
+                c.output = 0;
+            } else {
+                c.output = 255;  // max power
+            }
+            // when we have reached the reflowTemp or past the time, we can move to the hold phase
+            if (temperature > reflowPhaseEndTemp(c, p.reflowTemp, p.reflowTime) || t > p.reflowTime) {
+                c.phase = HOLD;
+            }
+            break;
+
+        case HOLD:
+            c.output = (temperature < c.target) ? 50 : 0;  // reduced power to maintain the temperature
+            if (temperature > reflowPhaseEndTemp(c, p.coolingTemp, p.coolingTime) && t > p.coolingTime) {
+                c.phase = COOLING;
+            }
+            break;
+
+        case COOLING:
+            // heater off, the fans cool the plate down to the cooling target
+            c.output = 0;
+            c.fan = temperature > c.coolingTarget;
+            break;
+    }
+    if (c.phase != before) {
+        c.phaseStart[c.phase] = wallTime;
+        if (c.warp && c.phase != COOLING) c.profileTime = reflowPhaseEndTime(p, before);
+    }
+}
+
+// The phase at time t when the phases follow the times of the profile
+inline ReflowPhase reflowTimePhase(const ReflowProfile& p, double t) {
+    if (t < p.preheatTime) return PREHEAT;
+    if (t < p.soakingTime) return SOAK;
+    if (t < p.reflowTime) return REFLOW;
+    if (t < p.coolingTime) return HOLD;
+    return COOLING;
+}
+
+/*
+  A PI controller with output limits and anti-windup: the integral only follows the error
+  while the output is within the limits, or when the error drives the output back from a limit.
+*/
+struct PIControl {
+    double kp;              // output per unit of error
+    double ki;              // output per unit of error per second
+    double outMin, outMax;  // output limits
+    double integral;        // the state
+};
+
+inline double piStep(PIControl& c, double error, double dt) {
+    double integral = c.integral + c.ki * error * dt;
+    double output = c.kp * error + integral;
+    if (output > c.outMax) {
+        output = c.outMax;
+        if (error < 0) c.integral = integral;
+    } else if (output < c.outMin) {
+        output = c.outMin;
+        if (error > 0) c.integral = integral;
+    } else {
+        c.integral = integral;
+    }
+    return output;
+}
+
+/*
+  Cascade control of the reflow on the board temperature (a thermocouple on the board)
+
+  Regulating the heater directly on the board temperature is slow and unstable, the board
+  lags the plate by many seconds. The cascade has two loops:
+  - the outer loop runs every outerInterval and sets the plate setpoint: the board profile,
+    plus the plate temperature the board model needs to follow it (feedforward), plus a PI
+    correction on the board error
+  - the inner loop runs every control step and sets the PWM value with a PI on the plate error
+  Both have limits and anti-windup: the plate setpoint stays below maxPlate and the PWM value
+  within 0..255. The phases follow the time of the profile, the cooling is the same as in
+  reflowStep().
+*/
+struct CascadeControl {
+    PIControl outer;       // board error (°C) -> plate setpoint correction (°C)
+    PIControl inner;       // plate error (°C) -> PWM value
+    double outerInterval;  // s
+    double maxPlate;       // °C, the highest plate setpoint
+    BoardModel model;      // for the feedforward, see profile_plan.h
+    // the state, updated by reflowCascadeStep()
+    double nextOuter;      // s, the time of the next outer step
+    double plateSetpoint;  // °C
+};
+
+// The settings of the cascade, tuned on the plate model of tools/pysim
+inline CascadeControl cascadeControl(const BoardModel& model) {
+    CascadeControl k;
+    k.outer.kp = 1.0;
+    k.outer.ki = 0.05;
+    k.outer.outMin = -20;
+    k.outer.outMax = 40;
+    k.inner.kp = 20;
+    k.inner.ki = 1.0;
+    k.inner.outMin = 0;
+    k.inner.outMax = 255;
+    k.outerInterval = 1.0;
+    k.maxPlate = 260;
+    k.model = model;
+    return k;
+}
+
+// Get ready for a new run, the plate starts at the temperature it has
+inline void cascadeStart(CascadeControl& k, double plate) {
+    k.outer.integral = 0;
+    k.inner.integral = 0;
+    k.nextOuter = 0;
+    k.plateSetpoint = plate;
+}
+
+/*
+  One control step of the cascade at time t (s), dt (s) after the previous one, with the
+  plate and board temperatures. The target of the ReflowControl is the board target.
+*/
+inline void reflowCascadeStep(ReflowControl& c, CascadeControl& k, double t, double dt, double plate, double board) {
+    const ReflowProfile& p = c.profile;
+    ReflowPhase phase = reflowTimePhase(p, t);
+    if (phase != c.phase) c.phaseStart[phase] = t;
+    c.phase = phase;
+    c.profileTime = c.lastTime = t;
+    if (c.phase == COOLING) {
+        c.target = c.coolingTarget;
+        c.output = 0;
+        c.fan = plate > c.coolingTarget;
+        return;
+    }
+
+    double ambient = k.model.ambient;
+    c.target = profileTemperature(p, t, ambient, 0);
+    if (t >= k.nextOuter) {
+        // the plate temperature that makes the board follow the profile: tau dB/dt = (P - B) - loss (B - ambient)
+        double slope = (profileTemperature(p, t + 1, ambient, 0) - profileTemperature(p, t - 1, ambient, 0)) / 2;
+        double feedforward = c.target + k.model.tau * slope + k.model.loss * (c.target - ambient);
+        if (feedforward > k.maxPlate) feedforward = k.maxPlate;
+        // the correction may not push the setpoint above the limit, so it stops integrating there
+        PIControl& outer = k.outer;
+        double outMax = outer.outMax;
+        if (feedforward + outMax > k.maxPlate) outer.outMax = k.maxPlate - feedforward;
+        k.plateSetpoint = feedforward + piStep(outer, c.target - board, k.outerInterval);
+        outer.outMax = outMax;
+        k.nextOuter = t + k.outerInterval;
+    }
+    c.output = (int)(piStep(k.inner, k.plateSetpoint - plate, dt) + 0.5);
+    c.fan = false;
+}
+
+/*
+  One control step with the lookup table policy of tools/policy (policy.h) at time t, with the
+  plate temperature and its filtered rate (°C/s). The setpoint is the profile, the phases follow
+  its times and the cooling is the same as in reflowStep().
+*/
+inline void reflowPolicyStep(ReflowControl& c, const PolicyTable& table, double t, double temperature, double rate) {
+    ReflowPhase phase = reflowTimePhase(c.profile, t);
+    if (phase != c.phase) c.phaseStart[phase] = t;
+    c.phase = phase;
+    c.profileTime = c.lastTime = t;
+    if (c.phase == COOLING) {
+        c.target = c.coolingTarget;
+        c.output = 0;
+        c.fan = temperature > c.coolingTarget;
+        return;
+    }
+    c.target = profileTemperature(c.profile, t, 20, 0);
+    c.output = (int)(policyOutput(table, c.target, temperature, rate) + 0.5);
+    c.fan = false;
+}
+
+// The stages of the free heating and warmup modes
+enum HeatingStage {
+    RAMPUP = 0,  // full (or limited) power towards the target
+    SLOWDOWN,    // close to the target, creep up with a low power
+    REGULATE     // at the target, on/off regulation with a reduced power
+};
+
+/*
+  The free heating and warmup controller.
+  It ramps up with rampPower, slows down to slowPower when it gets within slowGap of the
+  target and switches to on/off regulation with regulatePower once the target is reached, or
+  when the plate stops rising below it: a low slowPower does not get a cold plate to a low target
+  (the warmup stalled at about 44°C of a 50°C standby and cooled down again).
+*/
+struct HeatingControl {
+    double target;      // target temperature in °C
+    int rampPower;      // PWM value for the ramp up
+    double slowGap;     // °C below the target where we slow down
+    int slowPower;      // PWM value to creep up to the target
+    int regulatePower;  // PWM value for the regulation
+    int stallSteps;     // steps of the slow down without a new highest temperature before we regulate
+    // the state, updated by heatingStep()
+    bool rampup;
+    bool slowdown;
+    double peak;  // the highest temperature of the slow down
+    int stalled;  // steps since the last new highest temperature
+    int output;
+};
+
+// The settings for the free heating mode, the slow down power depends on the target
+inline HeatingControl freeHeatingControl(double target) {
+    HeatingControl c;
+    c.target = target;
+    c.rampPower = 255;
+    c.slowGap = 25;
+    c.slowPower = (target < 100) ? 10 : (target < 200) ? 20 : 30;
+    c.regulatePower = 40;  // curb the power to make the regulation smoother
+    c.stallSteps = 40;  // 10s of 250ms steps
+    c.rampup = true;
+    c.slowdown = false;
+    c.peak = 0;
+    c.stalled = 0;
+    c.output = 0;
+    return c;
+}
+
+// The settings for the warmup mode, a more gentle warmup for lower temperatures
+inline HeatingControl warmupControl(double target) {
+    HeatingControl c;
+    c.target = target;
+    c.rampPower = 125;  // half power
+    c.slowGap = 10;
+    c.slowPower = 4;
+    c.regulatePower = (target <= 60) ? 20 : 40;  // about twice the losses, the standby of an automatic run stays calm
+    c.stallSteps = 40;  // 10s of 250ms steps
+    c.rampup = true;
+    c.slowdown = false;
+    c.peak = 0;
+    c.stalled = 0;
+    c.output = 0;
+    return c;
+}
+
+// One control step with the measured temperature, returns the stage for the display
+inline HeatingStage heatingStep(HeatingControl& c, double temperature) {
+    double gap = c.target - temperature;
+    if (gap < 0) gap = -gap;
+
+    // initial rampup
+    if (c.slowdown == false && c.rampup == true) {
+        c.output = c.rampPower;
+    }
+    // when we are ramping up and close to the target, but still below it, slow down
+    if (gap < c.slowGap && temperature < c.target && c.rampup == true) {
+        c.output = c.slowPower;
+        if (c.slowdown == false || temperature > c.peak) {
+            c.peak = temperature;
+            c.stalled = 0;
+        }
+        c.slowdown = true;
+        // the slow down power does not get us there, regulate from here
+        if (++c.stalled > c.stallSteps) {
+            c.slowdown = false;
+            c.rampup = false;
+        }
+    }
+    // if we are now above the target, return to normal regulation; also when the mode was started on a plate
+    // above the target (the standby after an automatic run), which never went through the slow down
+    if (temperature >= c.target && c.rampup == true) {
+        c.slowdown = false;
+        c.rampup = false;
+    }
+    // normal regulation
+    if (c.slowdown == false && c.rampup == false) {
+        c.output = (temperature < c.target) ? c.regulatePower : 0;
+        return REGULATE;
+    }
+    return c.slowdown ? SLOWDOWN : RAMPUP;
+}
+
+#endif  // REFLOW_CONTROL_H
@@ -0,0 +1,176 @@
+/*
+  Binary run log format
+
+  The reflow controller writes a log file for every reflow run to the LittleFS partition
+  of the ESP32 (/runs/<runId>.rlg). The host tools in tools/runlog read the same files,
+  so this header is shared between the firmware and the host side. Keep it plain C++11
+  without Arduino dependencies.
+
+  File layout:
+    RunLogHeader                      64 bytes, the run and profile information
+    RunLogBlockHeader + payload       a block of up to RUNLOG_BLOCK_SAMPLES samples
+    RunLogBlockHeader + payload       ...
+
+  The samples in a block are stored column by column (all times, then all temperatures, etc.)
+  so the host can read a column without touching the other ones.
+  A block is either stored raw (the RunLogSamples struct as is, also for a partial last block)
+  or delta encoded: per column the difference with the previous value as a zigzag varint.
+  The firmware writes delta encoded blocks, a run of 340s is then only about 4kB of flash.
+  A payload is followed by 0-3 zero bytes, so every block starts at a multiple of 4 bytes
+  and the raw columns of a memory mapped file are aligned.
+
+  All values are little-endian, which is what both the ESP32 and the x86/ARM hosts use.
+*/
+#ifndef RUNLOG_H
+#define RUNLOG_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define RUNLOG_MAGIC 0x474C5252     // "RRLG" in the file
+#define RUNLOG_VERSION 1            // increase when the layout changes
+#define RUNLOG_BLOCK_SAMPLES 64     // samples per block, 16s at the 250ms sample interval
+#define RUNLOG_ENCODING_RAW 0       // payload is a RunLogSamples struct
+#define RUNLOG_ENCODING_DELTA 1     // payload is zigzag varint deltas per column
+#define RUNLOG_MAX_PAYLOAD (5 * 5 * RUNLOG_BLOCK_SAMPLES)  // worst case delta payload: 5 columns, 5 bytes per value
+
+// The columns of a run log, in the order they are stored in a block
+enum RunLogColumn {
+    RUNLOG_TIME = 0,     // uint32_t, ms since the start of the run
+    RUNLOG_TEMPERATURE,  // int16_t, measured plate temperature in 0.1°C
+    RUNLOG_SETPOINT,     // int16_t, target temperature in 0.1°C
+    RUNLOG_POWER,        // uint8_t, PWM value 0-255 to the SSR
+    RUNLOG_PHASE,        // uint8_t, the ReflowPhase
+    RUNLOG_COLUMNS
+};
+
+struct RunLogHeader {
+    uint32_t magic;             // RUNLOG_MAGIC
+    uint16_t version;           // RUNLOG_VERSION
+    uint16_t blockSamples;      // RUNLOG_BLOCK_SAMPLES
+    uint32_t runId;             // sequence number of the run on this station
+    uint32_t sampleInterval;    // ms between the samples
+    char pasteName[32];         // the selected solder paste, zero terminated
+    int16_t profile[8];         // preheat, soaking, reflow and cooling temp/time pairs (°C, s)
+};
+
+struct RunLogBlockHeader {
+    uint16_t count;        // number of valid samples in the block
+    uint8_t encoding;      // RUNLOG_ENCODING_RAW or RUNLOG_ENCODING_DELTA
+    uint8_t reserved;      // 0
+    uint32_t payloadSize;  // bytes following this header, without the padding to a multiple of 4
+    uint32_t crc;          // CRC-32 of the payload
+};
+
+// The samples of one block, also the layout of a raw payload
+struct RunLogSamples {
+    uint32_t time[RUNLOG_BLOCK_SAMPLES];
+    int16_t temperature[RUNLOG_BLOCK_SAMPLES];
+    int16_t setpoint[RUNLOG_BLOCK_SAMPLES];
+    uint8_t power[RUNLOG_BLOCK_SAMPLES];
+    uint8_t phase[RUNLOG_BLOCK_SAMPLES];
+};
+
+// The sizes are multiples of 4, so with the block padding the raw columns of a mapped file are aligned
+static_assert(sizeof(RunLogHeader) == 64, "RunLogHeader must be 64 bytes");
+static_assert(sizeof(RunLogBlockHeader) == 12, "RunLogBlockHeader must be 12 bytes");
+static_assert(sizeof(RunLogSamples) == 10 * RUNLOG_BLOCK_SAMPLES, "RunLogSamples must not have padding");
+
+// CRC-32 (IEEE 802.3), bitwise so we don't need a table in RAM
+inline uint32_t runLogCrc32(const uint8_t* data, size_t length, uint32_t crc = 0) {
+    crc = ~crc;
+    for (size_t i = 0; i < length; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+        }
+    }
+    return ~crc;
+}
+
+// Value of a column of a sample as a signed 32-bit number
+inline int32_t runLogValue(const RunLogSamples& samples, int column, int i) {
+    switch (column) {
+        case RUNLOG_TIME:
+            return (int32_t)samples.time[i];
+        case RUNLOG_TEMPERATURE:
+            return samples.temperature[i];
+        case RUNLOG_SETPOINT:
+            return samples.setpoint[i];
+        case RUNLOG_POWER:
+            return samples.power[i];
+        default:
+            return samples.phase[i];
+    }
+}
+
+inline void runLogSetValue(RunLogSamples& samples, int column, int i, int32_t value) {
+    switch (column) {
+        case RUNLOG_TIME:
+            samples.time[i] = (uint32_t)value;
+            break;
+        case RUNLOG_TEMPERATURE:
+            samples.temperature[i] = (int16_t)value;
+            break;
+        case RUNLOG_SETPOINT:
+            samples.setpoint[i] = (int16_t)value;
+            break;
+        case RUNLOG_POWER:
+            samples.power[i] = (uint8_t)value;
+            break;
+        default:
+            samples.phase[i] = (uint8_t)value;
+            break;
+    }
+}
+
+/*
+  Delta encode the first count samples into out (at least RUNLOG_MAX_PAYLOAD bytes).
+  Returns the number of bytes used.
+*/
+inline size_t runLogEncodeDelta(const RunLogSamples& samples, int count, uint8_t* out) {
+    size_t size = 0;
+    for (int column = 0; column < RUNLOG_COLUMNS; column++) {
+        int32_t previous = 0;
+        for (int i = 0; i < count; i++) {
+            int32_t value = runLogValue(samples, column, i);
+            int32_t delta = value - previous;
+            uint32_t zigzag = ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31);
+            previous = value;
+            do {
+                uint8_t byte = zigzag & 0x7F;
+                zigzag >>= 7;
+                out[size++] = zigzag ? (byte | 0x80) : byte;
+            } while (zigzag);
+        }
+    }
+    return size;
+}
+
+/*
+  Decode a delta encoded payload of count samples.
+  Returns false when the payload is too short or malformed.
+*/
+inline bool runLogDecodeDelta(const uint8_t* in, size_t size, int count, RunLogSamples& samples) {
+    size_t pos = 0;
+    for (int column = 0; column < RUNLOG_COLUMNS; column++) {
+        int32_t previous = 0;
+        for (int i = 0; i < count; i++) {
+            uint32_t zigzag = 0;
+            int shift = 0;
+            uint8_t byte;
+            do {
+                if (pos >= size || shift > 28) return false;
+                byte = in[pos++];
+                zigzag |= (uint32_t)(byte & 0x7F) << shift;
+                shift += 7;
+            } while (byte & 0x80);
+            int32_t delta = (int32_t)(zigzag >> 1) ^ -(int32_t)(zigzag & 1);
+            previous += delta;
+            runLogSetValue(samples, column, i, previous);
+        }
+    }
+    return pos == size;
+}
+
+#endif  // RUNLOG_H
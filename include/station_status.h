@@ -0,0 +1,61 @@
+/*
+  The telemetry of a station for the bench scheduler of tools/scheduler
+
+  The host sends text lines, the controller answers with frames of include/logsync.h:
+
+    STATUS         a LOGSYNC_STATUS frame with a StationStatus: the mode, the plate, the loaded
+                   profile and the time until the board of the run can be taken off
+    PASTES         a LOGSYNC_PASTE frame with a StationPaste for every solder paste of the table
+    PROFILE <n>    select paste n, like the paste field does; refused while a board is on the
+                   plate (the countdown and the reflow run) and while the paste field is edited
+
+  In a status frame runId and block are 0, in a paste frame runId is the number of pastes and
+  block the index of the paste. The frames share the port with the run log synchronization, a
+  tool that only wants the one or the other drops the frames it did not ask for.
+
+  Shared between the firmware and tools/scheduler, plain C++11 without Arduino dependencies.
+*/
+#ifndef STATION_STATUS_H
+#define STATION_STATUS_H
+
+#include <stdint.h>
+
+enum StationMode {
+    STATION_IDLE = 0,   // no mode runs, the plate cools down on its own
+    STATION_WARMUP,     // the standby: a board placed on the plate starts a run (the automatic runs)
+    STATION_COUNTDOWN,  // a board was placed, the run starts in a few seconds
+    STATION_REFLOW,     // a reflow run, until the board is taken off or it is stopped
+    STATION_BUSY        // free heating, free cooling or the noise analysis
+};
+
+#define STATION_AUTO 0x01      // the automatic runs are on (AUTO on)
+#define STATION_RELEASED 0x02  // the plate of the run is below the release temperature, the board can come off
+#define STATION_EDITING 0x04   // the paste or a value of the profile is being edited on the station
+#define STATION_ANOMALY 0x08   // the run reads away from the plate model, see include/run_anomaly.h
+
+struct StationStatus {
+    uint8_t mode;         // StationMode
+    uint8_t phase;        // the ReflowPhase of the run
+    uint8_t paste;        // the index of the selected paste
+    uint8_t flags;        // STATION_AUTO etc.
+    float temperature;    // °C, the plate
+    float standby;        // °C, the warmup temperature, a board is seen within a few degrees of it
+    float elapsed;        // s of the run
+    float readyIn;        // s until the board of the run can be taken off, 0 when released or without a run
+    uint32_t runs;        // the id of the next run log, it counts the finished runs
+    int16_t profile[8];   // the profile as it is loaded: preheat, soak, reflow and cooling, temperature and time
+};
+
+static_assert(sizeof(StationStatus) == 40, "StationStatus must be 40 bytes");
+
+struct StationPaste {
+    char name[30];
+    uint8_t cascade;      // the profile runs on the board probe
+    uint8_t reserved;     // 0
+    int16_t profile[8];   // as in StationStatus
+    float rampRateLimit;  // °C/s
+};
+
+static_assert(sizeof(StationPaste) == 52, "StationPaste must be 52 bytes");
+
+#endif  // STATION_STATUS_H
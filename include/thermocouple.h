@@ -0,0 +1,241 @@
+/*
+  The thermocouple chips on their own SPI bus
+
+    Thermocouple<Board, Board::maxCs> plate;
+    plate.begin();
+    if (plate.read() == STATUS_OK) temperature = plate.getTemperature();
+
+  The driver is a template on the board of include/board_config.h and the chip select pin: the
+  bus pins are constants and only the code for the chip of the board (Board::chip) is compiled.
+
+  On the ESP32 the chips are on the second SPI host (HSPI, SPI2_HOST), the TFT has VSPI. A read
+  is a transaction in the queue of the IDF SPI master driver: the host clocks in the bits at
+  Board::chipClockHz and its interrupt completes the transaction, so the CPU does not wait for
+  the bits and the TFT traffic goes on at the same time. request() starts a read and ready()
+  takes the result once it is there, read() does both and sleeps until the result is there.
+  Elsewhere (the scenario runner of tools/scenario) the bus is bit-banged with
+  include/fast_gpio.h and a request is done right away.
+
+  The status of a read is the way the MAX6675 library had it, so the callers did not change:
+  STATUS_OK, STATUS_ERROR with the open thermocouple bit (MAX6675) or the fault bits (MAX31855),
+  STATUS_NO_COMMUNICATION when the bus only reads ones (no chip, SO has a pull-up).
+  getTemperature() is the last temperature that was read, in °C.
+
+  The chip starts a conversion when its chip select goes high. The chip select is not driven by
+  the SPI host: a request with hold leaves it low, so the next conversion only starts at
+  release(). The firmware switches the heater and the fans in between, and the conversion does
+  not see those edges. On the ESP32 the callbacks of the driver set it around the transaction
+  (pre_cb and post_cb), so it is only low while the transaction is on the bus, not while it waits
+  in the queue.
+
+  The chips share SO, a chip drives it while its chip select is low. So one chip has the bus at a
+  time, from its request to the end of its read, or to release() with hold: a request of another
+  chip is refused (false) until then. Only the chip that is read last may be held.
+*/
+#ifndef THERMOCOUPLE_H
+#define THERMOCOUPLE_H
+
+#include <stdint.h>
+
+#include "fast_gpio.h"
+
+#if defined(ESP32)
+#include <driver/gpio.h>
+#include <driver/spi_master.h>
+#endif
+
+#define STATUS_OK 0x00
+#define STATUS_ERROR 0x04                // MAX6675: the thermocouple is open
+#define STATUS_OPEN_CIRCUIT 0x01         // MAX31855 fault bits
+#define STATUS_SHORT_TO_GND 0x02
+#define STATUS_SHORT_TO_VCC 0x04
+#define STATUS_NOREAD 0x80
+#define STATUS_NO_COMMUNICATION 0x81
+
+// the chip select of the chip that has the bus of the board, noBusOwner when it is free
+const uint8_t noBusOwner = 0xFF;
+
+template <class Board>
+uint8_t& thermocoupleOwner() {
+    static uint8_t owner = noBusOwner;
+    return owner;
+}
+
+#if defined(ESP32)
+// the SPI host of the thermocouple chips, set up for the first chip
+template <class Board>
+bool thermocoupleBus() {
+    static bool ready = false;
+    if (ready) return true;
+    spi_bus_config_t bus = {};
+    bus.mosi_io_num = -1;  // the chips only talk
+    bus.miso_io_num = Board::maxSo;
+    bus.sclk_io_num = Board::maxClk;
+    bus.quadwp_io_num = -1;
+    bus.quadhd_io_num = -1;
+    bus.max_transfer_sz = 4;
+    ready = spi_bus_initialize(SPI2_HOST, &bus, SPI_DMA_DISABLED) == ESP_OK;
+    gpio_set_pull_mode((gpio_num_t)Board::maxSo, GPIO_PULLUP_ONLY);  // a missing chip reads as all ones
+    return ready;
+}
+#endif
+
+template <class Board, uint8_t Select>
+class Thermocouple {
+public:
+    void begin() {
+        pinMode(Select, OUTPUT);
+        OutputPin<Select>::high();
+#if defined(ESP32)
+        spi_device_interface_config_t device = {};
+        device.mode = 0;  // SO changes at the falling edge, the host samples at the rising edge
+        device.clock_speed_hz = Board::chipClockHz;
+        device.spics_io_num = -1;  // the chip select is ours, see release()
+        device.queue_size = 1;
+        device.pre_cb = selectChip;
+        device.post_cb = deselectChip;
+        if (!thermocoupleBus<Board>() || spi_bus_add_device(SPI2_HOST, &device, &handle) != ESP_OK) handle = NULL;
+#else
+        pinMode(Board::maxClk, OUTPUT);
+        pinMode(Board::maxSo, INPUT_PULLUP);  // a missing chip reads as all ones
+        OutputPin<Board::maxClk>::low();
+#endif
+    }
+
+    // start a read, with hold the chip select stays low until release(); false while another chip has the bus
+    bool request(bool hold = false) {
+        if (pending) return true;
+        uint8_t& owner = thermocoupleOwner<Board>();
+        if (owner != noBusOwner && owner != Select) return false;
+        owner = Select;
+        held = hold;
+        pending = true;
+#if defined(ESP32)
+        transaction = spi_transaction_t();
+        transaction.flags = SPI_TRANS_USE_RXDATA;
+        transaction.length = bits();
+        transaction.user = this;
+        if (!handle || spi_device_queue_trans(handle, &transaction, 0) != ESP_OK) finish(0xFFFFFFFF);
+#else
+        OutputPin<Select>::low();
+        spinNanoseconds(100);
+        finish(transfer(bits()));
+#endif
+        return true;
+    }
+
+    // true once when the read of request() is done, the status and the temperature are updated
+    bool ready() {
+        if (pending) complete(0);
+        if (!done) return false;
+        done = false;
+        return true;
+    }
+
+    // a read that waits for the result: on the ESP32 the task sleeps until the transaction is done
+    uint8_t read(bool hold = false) {
+        if (!request(hold)) return STATUS_NOREAD;
+        wait();
+        done = false;
+        return status;
+    }
+
+    // wait until the read of request() is done, ready() still reports it
+    void wait() {
+        while (pending) complete(forever);
+    }
+
+    // start the next conversion after a read with hold, and free the bus. A read that is still on the
+    // bus keeps its chip select until it is done.
+    void release() {
+        if (pending) {
+            held = false;
+            return;
+        }
+        OutputPin<Select>::high();
+        uint8_t& owner = thermocoupleOwner<Board>();
+        if (owner == Select) owner = noBusOwner;
+    }
+
+    float getTemperature() const { return temperature; }
+    uint8_t getStatus() const { return status; }
+
+private:
+    static int bits() { return Board::chip == CHIP_MAX31855 ? 32 : 16; }
+
+#if defined(ESP32)
+    static constexpr TickType_t forever = portMAX_DELAY;
+
+    // the interrupt of the host, when it starts and ends the transaction of this chip (the bus interrupt is not
+    // in IRAM, neither are these)
+    static void selectChip(spi_transaction_t*) {
+        OutputPin<Select>::low();
+        spinNanoseconds(100);  // the first bit is there 100ns after the chip select
+    }
+
+    static void deselectChip(spi_transaction_t* t) {
+        if (!static_cast<Thermocouple*>(t->user)->held) OutputPin<Select>::high();
+    }
+
+    // take the transaction from the driver when it is done
+    void complete(TickType_t wait) {
+        spi_transaction_t* result;
+        if (spi_device_get_trans_result(handle, &result, wait) != ESP_OK) return;
+        const uint8_t* d = transaction.rx_data;  // MSB first
+        finish(bits() == 32 ? (uint32_t)d[0] << 24 | (uint32_t)d[1] << 16 | (uint32_t)d[2] << 8 | d[3]
+                            : (uint32_t)d[0] << 8 | d[1]);
+    }
+#else
+    static constexpr int forever = 0;
+    void complete(int) {}
+
+    // the chip puts a bit on SO at the falling edge of the clock, it is read while the clock is high
+    static uint32_t transfer(int bits) {
+        const uint32_t halfPeriod = 500000000UL / Board::chipClockHz;  // ns
+        uint32_t value = 0;
+        for (int i = 0; i < bits; i++) {
+            OutputPin<Board::maxClk>::high();
+            spinNanoseconds(halfPeriod);
+            value = (value << 1) | (InputPin<Board::maxSo>::read() ? 1 : 0);
+            OutputPin<Board::maxClk>::low();
+            spinNanoseconds(halfPeriod);
+        }
+        return value;
+    }
+#endif
+
+    // the end of a read: the chip select and the value of the chip
+    void finish(uint32_t value) {
+        pending = false;
+        done = true;
+        if (!held) release();
+        if (Board::chip == CHIP_MAX31855) {
+            if (value == 0xFFFFFFFF || value == 0) {
+                status = STATUS_NO_COMMUNICATION;
+            } else {
+                status = value & 0x07;  // OC, SCG and SCV
+                temperature = (float)((int32_t)value >> 18) * 0.25f;
+            }
+        } else {
+            value &= 0xFFFF;
+            if (value == 0xFFFF) {
+                status = STATUS_NO_COMMUNICATION;
+            } else {
+                status = value & 0x04;
+                temperature = (float)((value >> 3) & 0x1FFF) * 0.25f;
+            }
+        }
+    }
+
+#if defined(ESP32)
+    spi_device_handle_t handle = NULL;
+    spi_transaction_t transaction;  // in the queue of the driver until it is done
+#endif
+    bool pending = false;        // a request that is not done yet
+    bool done = false;           // a request that is done and ready() did not report yet
+    volatile bool held = false;  // the chip select stays low after the read, deselectChip() reads it
+    uint8_t status = STATUS_NOREAD;
+    float temperature = 0;
+};
+
+#endif  // THERMOCOUPLE_H
@@ -11,7 +11,7 @@
 // Adopting the code for a commercial hotplate UYUE 946C 400W 200x200mm
 
 //
-const String FW_VERSION = "V5.6.3";  // Firmware version
+const String FW_VERSION = "V5.30.0";  // Firmware version
 /*
   Changelog:
   Version V2.0.0:
@@ -137,6 +137,190 @@ const String FW_VERSION = "V5.6.3";  // Firmware version
   Changed the error condition for the K-Type thermocouple to always display a value, even when it is
   obviously incorrect. If a suspicious condition is detected, the terminal will display the Max chip status.
 
+  Version 5.7.0
+  Added two thin strip charts below the temperature curve, in the 0-20°C band that the plate never reaches.
+  The upper strip shows the heater power (PWM value, averaged per pixel column) as a color from blue (low)
+  to red (full power), or cyan when the fan is running. The lower strip shows the filtered temperature rise
+  per second (dT/dt) as a bar around a zero line, green within the ramp limit of the paste, orange and red above.
+  Each column is written with a single small SPI transfer when the time axis moves to the next pixel.
+  Added the maximum ramp rate to the solder paste profiles.
+
+  Version 5.8.0
+  Every reflow run is now logged to a binary file on the LittleFS partition (/runs/<run id>.rlg).
+  The file has the profile in the header and blocks of 64 samples with the time, temperature, target,
+  PWM value and phase, stored column by column and delta encoded. The format is in include/runlog.h and
+  is shared with the host tools in tools/runlog that read the logs for analysis.
+  When the file system gets full, the oldest run logs are removed.
+
+  Version 5.9.0
+  Added a planner that calculates the plate setpoints that make the board, rather than the plate, follow the
+  paste profile. The board lags the plate on the ramps and stays a bit below it, the planner inverts a simple
+  plate-to-board model and keeps the result within the heater limits (include/profile_plan.h).
+  The setpoint table (one value per second) is recalculated when the profile changes. It is only used when
+  boardPlanEnabled is set, the planned plate curve is then shown as a grey dotted line on the chart.
+
+  Version 5.10.0
+  The solder paste selection now opens a list on top of the chart, showing 8 pastes at a time with a scroll bar.
+  Turning the encoder only redraws the two rows that change, or the visible rows when the list scrolls
+  (the ILI9341 can only scroll in hardware along the long side of the panel, which is the horizontal direction
+  in our landscape orientation). The chart is redrawn once when the selection is confirmed with a press.
+  The solder paste array is now const, so it stays in flash and the names are read from there when a row is
+  drawn. This keeps the selection responsive with hundreds of profiles.
+
+  Version 5.11.0
+  Added a NOISE button for a thermocouple noise analysis, to help with grounding and SSR switching issues.
+  It records 128 temperature readings at the normal acquisition rate (about 32s) while the heater is switched
+  with a low PWM value, removes the trend and runs a 128 point fixed-point FFT. The spectrum is shown on the
+  chart together with the noise level and the dominant interference frequency.
+  A notch filter for that frequency is then put in the temperature acquisition, and the noise level after the
+  filter is reported. The notch stays active only when it reduces the noise by more than 1dB.
+  Note that the MAX6675 needs about 220ms for a conversion, so we can only see interference up to 2Hz. Higher
+  frequencies like 50/60Hz mains pickup show up aliased, the analysis reports where they end up.
+
+  Version 5.12.0
+  Moved the control logic of the reflow, free heating and warmup modes to include/reflow_control.h, so the
+  same code can run in the host tools. runReflow(), freeHeating() and runWarmup() now only do the display and
+  the I/O. The behavior is the same, except that the rampup and slow down states of the free heating and warmup
+  modes are now reset when the mode is started. Before, a second run started in the regulate state.
+  Added a thermal model of the plate (include/plate_model.h) and tools/pysim, a simulator to try profiles and
+  the controller on the model or on logged runs.
+
+  Version 5.13.0
+  The modes now run as cooperative tasks in the style of protothreads (include/protothread.h). A task is
+  written as sequential code that waits for a time or an event, the main loop only runs the tasks whose wait
+  is over instead of testing the flags of every mode. The reflow task closes the run log once at the end of the
+  time scale, and the noise analysis waits for the new readings instead of checking for them in every loop.
+  The reflow, enableFreeHeating, enableFreeCooling and enableWarmup flags and the SSRTimer are no longer needed.
+
+  Version 5.14.0
+  Added the characterization of a product with a second MAX6675 (CS on GPIO25, sharing SO and CLK with the plate
+  sensor) and a thermocouple taped to a board. When the probe is found at the start of a reflow run, the board
+  temperature is recorded and shown as a magenta curve. At the end of the run, the board model (lag and heat loss)
+  is fitted and stored in the NVS with the selected profile. The reflow runs of that profile then automatically use
+  the board-side plan, also after a reboot. A profile without a learned model runs the original way.
+
+  Version 5.15.0
+  The rotary encoder is now decoded by the PCNT pulse counter of the ESP32 instead of an ISR on the CLK pin. It
+  counts all 4 edges of a detent, with the hardware glitch filter against contact bounce, and the main loop takes
+  the new counts. This costs no CPU time per edge and no steps are missed during the long tft transfers. The
+  Schmitt-trigger gate on the CLK pin is no longer needed, an existing build with the gate inverts the CLK signal
+  and turns the direction around: swap the CLK and DT pin numbers.
+
+  Version 5.16.0
+  The positions of the fields on the screen are no longer absolute coordinates. They are described by their
+  distance to the edges of the display (include/layout.h) and calculated at boot for the size of the panel, so a
+  larger 480x320 ILI9488 or ST7796 panel only needs the other driver in platformio.ini. The chart fills the rest
+  of the screen and the temperature and time pixel factors are calculated from its size. The screen looks the
+  same on the 320x240 panel, only the time axis now runs to the right side of the chart.
+
+  Version 5.17.0
+  Added cascade control for the reflow with a thermocouple on the board (the board probe). The outer loop
+  runs every second and sets the plate setpoint from the board profile, the board model (feedforward) and a
+  PI correction on the board temperature. The inner loop runs every 250ms and sets the PWM value with a PI on
+  the plate temperature. Both loops have limits and anti-windup, the plate setpoint stays below 260 degrees.
+  A solder paste selects it with the new cascadeControl field, it is used when the board probe is found at
+  the start of the run, otherwise (or when the probe is lost) the normal plate controller runs.
+  The controller is in reflow_control.h, the gains were tuned with tools/pysim (sim_run --cascade).
+
+  Version 5.18.0
+  Added a control policy that is solved offline: tools/policy solves the control problem for a profile by
+  dynamic programming on the plate model and writes a table of PWM values over the setpoint, the error and
+  the dT/dt of the plate (include/policy_table.h, 6.8kB in flash). runReflow() looks up the 8 grid points
+  around the state and interpolates, when the table was solved for the selected profile. On the plate model
+  it follows the Sn42/Bi57.6/Ag0.4 profile with 1.6 degrees rms error, the normal controller has 4.6 degrees.
+
+  Version 5.19.0
+  Added a time warp for the reflow profile. The controller keeps its own profile time: on the ramps it
+  advances slower when the plate falls behind with the heater at full power, and faster when the plate is
+  ahead with the heater off. When a phase starts, the profile time is set to the start of that phase, so
+  the soak and the hold keep their length instead of being shortened by a late ramp. The flex per phase
+  is in TimeWarp (reflow_control.h). The planned and actual duration of the phases are printed on the
+  serial monitor at the end of a run. Switch it off with timeWarpEnabled.
+
+  Version 5.20.0
+  Added tools/scenario: behavioral tests of the firmware on the host. Scenarios in a small text language
+  (rotate, press, select a field, wait, change the plate, detach a thermocouple, expect a phase, the SSR, a
+  temperature or a text on the screen within a time) run against this code, compiled with mock Arduino
+  headers, a framebuffer display and the plate model, in virtual time. A failing scenario saves the screen,
+  a trace and the serial output.
+
+  Version 5.21.0
+  Added the synchronization of the run logs over the serial port (include/logsync.h, tools/runlog/runlog_sync).
+  The host sends the run and block it needs next, the controller sends only the new headers and blocks, each
+  in a frame with a CRC, and the host stores a block and its mark when it checks out, so an interrupted
+  transfer resumes at the last good block. The frames are sent by a task that only writes a whole frame when
+  it fits in the transmit buffer, so a reflow run is not disturbed by a transfer.
+  Hardware change: the MAX6675 clock moved from GPIO3 to GPIO22, GPIO3 is the RX of the serial port that
+  receives the commands. The serial port now runs at 115200 baud.
+
+  Version 5.22.0
+  The diagnostics on the serial port use LOG() of include/dlog.h instead of Serial.print(). The format strings
+  are kept in a section of the ELF file that is not flashed, the controller only sends the id of the format,
+  the time and the raw values, and tools/dlog prints the text from the ELF file of the build. A LOG() only
+  writes a few bytes to a buffer in RAM, the main loop sends it when there is room in the UART. Build with
+  -D DLOG_TEXT=1 to get the text on the device as before.
+
+  Version 5.23.0
+  The hardware variants are types in include/board_config.h with the pins and the chips as constants
+  (Board::ssr, Board::chip, ...), selected by an environment per variant in platformio.ini: the station as
+  built, a MAX31855K and a 480x320 ILI9488 panel. The pins are checked at compile time, also against the TFT
+  pins and driver of the build flags. The thermocouple chips are read by a driver that is a template on the
+  board (include/thermocouple.h) with register writes for the pins (include/fast_gpio.h), instead of the
+  MAX6675 library, so only the code of the chip on the board is compiled in. The fan pin also uses a
+  register write.
+
+  Version 5.24.0
+  The computations for the UI run as background jobs in a task on core 0 (include/compute_jobs.h), so they
+  don't hold up the main loop. The plate setpoints of the board plan are planned in the background when the
+  profile is drawn, and while a value of the profile is edited a prediction of the run (the reflow controller
+  on the plate model) is drawn as a cyan dotted line. Every detent supersedes the job of the previous one,
+  which stops at its next check. The serial command JOBS prints the done and cancelled jobs, the latency and
+  the run time.
+
+  Version 5.25.0
+  The SSR is no longer a 1kHz PWM output: it is switched in slots of a temperature reading (250ms) with a
+  sigma-delta modulator for the power, and the SSR and fan edges are made at the reads of the thermocouple
+  while the chip selects are low. The next conversion starts 20ms later, so it does not see the switching.
+  A reading that did see an edge (a stop turns the heater off right away) is flagged and left out of the
+  filter once. The noise analysis reports the flagged conversions, the serial command QUIET off runs the
+  slots on their own clock to compare.
+
+  Version 5.26.0
+  The thermocouple chips are on the second hardware SPI host of the ESP32 (HSPI), through the SPI master
+  driver of the IDF. A read is a queued transaction that the interrupt of the host completes, the main loop
+  starts the reads and processes the reading in a later pass, while the TFT keeps the VSPI bus. The chip
+  selects stay under the control of the firmware for the quiet sampling.
+
+  Version 5.27.0
+  Automatic runs: in the warmup mode the plate is the standby for the next board. A board that is placed on it
+  is seen in the dT/dt of the plate (include/board_detect.h) and starts a reflow run after a countdown of 5s in
+  the status field, a press of the button cancels it. When the run is over, the removal of the board finishes
+  the run (the run log, the characterization and the timing report, like the STOP button) and the plate goes
+  back to the standby. The automatic runs are off after the power-up, serial command AUTO on|off. A placement
+  is only looked for after 30s of regulation at the standby, and the expected dT/dt follows the power with the
+  lag of the plate. At the end of the time scale the heater is now off and the fans cool the plate down to the
+  cooling target. The free heating and warmup controllers no longer stay in the ramp up when they are started
+  on a plate above the target, and they regulate when the slow down stops rising below it: the warmup got a
+  cold plate no further than about 44°C. The warmup regulates with 20 instead of 40, a calmer standby.
+
+  Version 5.28.0
+  The progress of a reflow run: a bar at the bottom of the chart has a segment per phase, under the phase on
+  the time axis, that fills with the progress of the phase, and the stage field shows the time until the board
+  can be taken off (the plate below autoReleaseTemp). A background job predicts the end of the remaining phases
+  and of the cooldown every 5s, with the controller of the run on the plate model. In between, only the clock
+  moves the bar and the time on, and a step only draws the new pixels. The serial output reports the release
+  time with the prediction at the start of the run.
+
+  Version 5.29.0
+  Telemetry for a bench of stations: STATUS and PASTES answer with binary frames
+  (include/station_status.h), PROFILE <n> selects a paste from the host.
+  tools/scheduler plans a queue of boards on the stations.
+
+  Version 5.30.0
+  The readings of a reflow run are compared with the plate model, heated by the power of the controller
+  (include/run_anomaly.h): a thermocouple off the plate, a failing element or a stuck SSR is reported and
+  the status field turns red. Serial command ANOMALY off|warn|abort, abort stops the heating and cools down.
+
   Todo:
   No open or desired issues at the moment.
 
@@ -151,43 +335,67 @@ const String FW_VERSION = "V5.6.3";  // Firmware version
 #include <TFT_eSPI.h>  // 2,4" SPI 240x320 - https://github.com/Ambercroft/TFT_eSPI/wiki
 #include <ezButton.h>  // for the rotary button press detection
 #include <math.h>      // for the round() function
-
-#include "MAX6675.h"  // can also use the 14-bit MAX31855K, but the 12-bit MAX6675 is cheaper and works fine
-// #include "MAX31855.h"  // 14-bit version of the MAX6675
-
-#define DSO_TRIG 4  // optional: to trace real-time activity on a scope
-
-#define RotaryCLK 27  // CLK pin on the rotary encoder (must be an interrupt pin)
-#define RotaryDT 32   // DT pin on the rotary encoder
-#define RotarySW 33   // SW pin on the rotary encoder (Button function)
-
-#define SSR_pin 2   // Switching the heater ON/OFF; also the built-in LED so we can see when the SSR is on.
-#define Fan_pin 26  // GPIO pin for switching the fans ON/OFF (via a MOSFET)
-
-#define MAX_CS 13  // CS pin for the MAX6675K
-#define MAX_SO 21  // MISO for MAX6675
-#define MAX_CLK 3  // SPI clock
-
-// the definitions below are now defined in the platformio.ini file
-// #define TFT_MOSI  23  // TFT SDA conn pin 3
-// #define TFT_CLK   18  // TFT SCL conn pin 4
-// #define TFT_CS    5   // TFF CS conn pin 5
-// #define TFT_DC    16  // TFT DC conn pin 6
-// #define TFT_RST   17  // TFT RES conn pin 7
-// #define TFT_MISO  19  // TFT not used
-#define TFT_ON 15  // TFT power and backlight control
+#include <LittleFS.h>  // for the run logs
+#include <Preferences.h>  // for the learned board models, in the NVS partition
+#include <driver/pcnt.h>  // the pulse counter that decodes the rotary encoder
+
+#include "runlog.h"        // binary run log format, shared with the host tools
+#include "profile_plan.h"  // plate setpoints for a board-side profile
+#include "reflow_control.h"  // the control logic of the reflow, free heating and warmup modes
+#include "protothread.h"     // cooperative tasks for the modes
+#include "layout.h"          // the positions of the fields on the screen
+#include "policy_table.h"    // the generated control policy of tools/policy
+#include "logsync.h"          // the log synchronization frames, shared with tools/runlog
+#include "dlog.h"             // LOG(), the diagnostics are formatted on the host by tools/dlog
+
+#include "board_config.h"  // the pins and chips of the hardware variant, Board::ssr etc.
+#include "fast_gpio.h"     // pin writes as register writes
+#include "thermocouple.h"  // the MAX6675 or MAX31855 of the variant
+#include "compute_jobs.h"  // the queue of the background jobs
+#include "plate_model.h"   // the thermal model of the plate, for the prediction of a run
+#include "board_detect.h"  // a board placed on the plate or taken off
+#include "station_status.h"  // the telemetry for the bench scheduler of tools/scheduler
+#include "run_anomaly.h"     // a run whose readings drift away from the plate model
+
+// the TFT_eSPI pins are build flags in platformio.ini, they must match the variant
+#ifdef TFT_CS
+static_assert(TFT_CS == Board::tftCs && TFT_DC == Board::tftDc && TFT_RST == Board::tftRst,
+              "the TFT pins in platformio.ini do not match the board variant");
+#endif
+#if defined(ILI9488_DRIVER)
+static_assert(Board::panel == PANEL_ILI9488, "the ILI9488 driver is selected for another panel");
+#elif defined(ST7796_DRIVER)
+static_assert(Board::panel == PANEL_ST7796, "the ST7796 driver is selected for another panel");
+#elif defined(ILI9341_DRIVER)
+static_assert(Board::panel == PANEL_ILI9341, "the ILI9341 driver is selected for another panel");
+#endif
 
 // function prototypes
+struct ComputeInput;
 void setup();
 void loop();
 void rotaryButtonISR();
-void rotaryEncoderISR();
+void setupEncoder();
+void processEncoder();
+void rotateEncoder(int step);
 void processRotaryButton();
+void startWarmup();
+void stopWarmup();
+void startReflowRun();
+void stopReflowRun();
 void updateHighlighting();
 void runReflow();
 void freeHeating();
 void freeCooling();
 void runWarmup();
+bool reflowTask(Task&);
+bool freeHeatingTask(Task&);
+bool warmupTask(Task&);
+bool freeCoolingTask(Task&);
+bool noiseTask(Task&);
+bool autoRunTask(Task&);
+void autoRunStep();
+void cancelAutoStart();
 void drawAxis();
 void drawCurve();
 // next three are optional to replace drawCurve() using straight lines to
@@ -207,23 +415,141 @@ void printTargetTemperature();
 void printElapsedTime();
 void printPWM();
 void printFan();
-
-// setup the MAX library
-// MAX31855 thermoCouple(MAX_CS, MAX_SO, MAX_CLK);
-MAX6675 thermoCouple(MAX_CS, MAX_SO, MAX_CLK);
+void appendStripCharts();
+void resetStripCharts();
+uint16_t powerColor(int);
+void findRunLogs();
+void startRunLog();
+void appendRunLog();
+void writeRunLogBlock();
+void endRunLog();
+void readSerialCommand();
+void flushLog();
+bool syncTask(Task&);
+bool nextSyncFrame();
+bool seekSyncBlock();
+bool telemetryTask(Task&);
+size_t sealStationStatus();
+size_t sealStationPaste(int);
+void selectSolderPaste(int);
+void selectProfileCommand(int);
+uint8_t stationMode();
+void planBoardProfile();
+ComputeInput profileInput();
+bool samePlan(const ComputeInput&, const ComputeInput&);
+void submitPlan();
+void submitPrediction();
+bool editingProfile();
+void computeLock();
+void computeUnlock();
+bool runComputeJob();
+void computeTask(void*);
+bool predictReflow(const ComputeInput&, const ComputeJob&, int16_t*, int16_t*);
+bool predictRemaining(const ComputeInput&, const ComputeJob&, double*);
+void submitEta();
+void startProgress();
+void updateProgress();
+void progressSegment(int, int*, int*);
+void deliverComputeResults();
+void drawPlan();
+void drawPrediction(uint16_t);
+void clearPrediction();
+void reportComputeStats();
+void setHeater(int);
+void heaterOff();
+void setFan(bool);
+void switchHeater(bool);
+void switchFan(bool);
+void heaterSlot();
+void releaseConversions();
+void openPasteList();
+void updatePasteList();
+void closePasteList();
+void drawPasteListRow(int, bool);
+void drawPasteListScrollBar();
+void analyzeNoise();
+void fixedFFT(int16_t*, int16_t*, int);
+void setupNotch(double, double);
+double notchFilter(double);
+double noiseRMS(const double*, int, int);
+void startReflowControl();
+void reportReflowTiming();
+bool probeConnected();
+void recordProbe();
+void finishCharacterization();
+void loadBoardModel();
+String boardModelKey(int);
+void showHeatingStage(HeatingStage);
+void checkRunAnomaly();
+uint16_t runStatusColor();
+void setupLayout();
+void fillField(const LayoutBox&, uint16_t);
+void drawFieldText(const LayoutBox&, const String&, uint8_t);
+
+// the thermocouple chips share SO and SCK, the chip is set by the board variant
+Thermocouple<Board, Board::maxCs> thermoCouple;
+Thermocouple<Board, Board::probeCs> boardProbe;  // only connected to characterize a product
 
 // Constructor for the TFT screen
 // using hardware SPI
 TFT_eSPI tft = TFT_eSPI();
-const int tftX = 320;          // the width of the TFT
-const int tftY = 240;          // the height of the TFT
-const int yGraph = tftY - 13;  // the bottom of the graph
-const int xGraph = 18;         // the left side of the graph
+int tftX = 320;          // the width of the TFT, set from the panel in setup()
+int tftY = 240;          // the height of the TFT
+int yGraph = tftY - 13;  // the bottom of the graph, set from the layout in setup()
+int xGraph = 18;         // the left side of the graph
+
+// The fields of the screen, see include/layout.h. The boxes are calculated in setup() for the
+// size of the panel, so a 480x320 panel only needs its variant (env:devkit-ili9488 in platformio.ini).
+enum UiField {
+    UI_PASTE_NAME,
+    UI_PASTE_LIST,
+    UI_WARMUP_VALUE,
+    UI_WARMUP_BUTTON,
+    UI_REFLOW_BUTTON,
+    UI_HEATING_VALUE,
+    UI_HEATING_BUTTON,
+    UI_COOLING_VALUE,
+    UI_COOLING_BUTTON,
+    UI_NOISE_BUTTON,
+    UI_TEMP,
+    UI_TARGET,
+    UI_TIME,
+    UI_POWER,
+    UI_STAGE,
+    UI_NOISE_RESULT,
+    UI_STATUS,
+    UI_CHART,
+    UI_FIELDS  // the number of fields
+};
+
+// in the order of UiField: flags, x, y, w, h, text x, text y (the values are for the 320x240 screen)
+const LayoutSpec uiSpec[UI_FIELDS] = {
+    {FROM_LEFT, 48, 0, 150, 18, 2, 1},                         // paste name
+    {FROM_LEFT, 48, 20, 150, 8 * 16 + 4, 4, 2},                // paste list, 8 rows of 16px
+    {FROM_RIGHT, 100, 2, 32, 12, 8, 2},                        // warmup temperature
+    {FROM_RIGHT, 60, 0, 60, 15, 5, 0},                         // warmup button
+    {FROM_RIGHT, 60, 20, 60, 15, 5, 0},                        // reflow button
+    {FROM_RIGHT, 100, 42, 32, 12, 8, 2},                       // free heating temperature
+    {FROM_RIGHT, 60, 40, 60, 15, 5, 0},                        // free heating button
+    {FROM_RIGHT, 100, 62, 32, 12, 8, 2},                       // free cooling temperature
+    {FROM_RIGHT, 60, 60, 60, 15, 5, 0},                        // free cooling button
+    {FROM_RIGHT, 60, 80, 60, 15, 5, 0},                        // noise analysis button
+    {FROM_LEFT, 30, 40, 90, 16, 2, 0},                         // measured temperature
+    {FROM_LEFT, 30, 60, 80, 16, 2, 0},                         // target temperature
+    {FROM_LEFT, 120, 40, 80, 16, 2, 0},                        // elapsed time
+    {FROM_LEFT, 120, 60, 80, 16, 2, 0},                        // PWM or fan
+    {FROM_LEFT, 130, 80, 80, 20, 2, 0},                        // stage of the heating controller
+    {FROM_LEFT, 30, 80, 180, 50, 2, 0},                        // noise analysis results
+    {FROM_BOTTOM, 160, 50, 70, 18, 10, 0},                     // status
+    {STRETCH_WIDTH | STRETCH_HEIGHT, 18, 60, 2, 13, 0, 0},     // chart, 2px from the right and 13px from the bottom
+};
+LayoutBox ui[UI_FIELDS];  // calculated in setup()
 
-// Graph characteristics for the 240x320 TFT
-// graph area is 18px from the right and 15px from the bottom, we leave 2px free from the right and 60 from the top
+// Graph characteristics (for the 240x320 TFT)
+// graph area is 18px from the left and 13px from the bottom, we leave 2px free from the right and 60 from the top
 // width: (320)  x: [18-318] -> 300px
-// height: (240) y: [15-237] -> 222px
+// height: (240) y: [60-227] -> 167px
+// a larger panel gets a larger chart, the pixel factors are calculated in setup()
 // temperature range: 0°C to 250°C
 // time range: 0 s to 330 s -> 330 s (5 1/2min)
 // The coordinate system of the display has inverted Y-axis.
@@ -276,36 +602,83 @@ const int xGraph = 18;         // the left side of the graph
 // #define TFT_VIOLET      0x915C      /* 180,  46, 226 */
 
 #define OFF 0
-#define ON 255  // for the analogWrite() PWM function
+#define ON 255  // the full power of the heater, see setHeater()
 
 // Rotary encoder related
 int selectedItem = 1;       // item number for the active menu item
-ezButton button(RotarySW);  // create an ezButton object
+ezButton button(Board::rotarySw);  // create an ezButton object
 
-// Statuses of the DT and CLK pins on the encoder
-int CLKNow;
-int CLKPrevious;
-int DTNow;
-int DTPrevious;
+// The encoder is decoded by a pulse counter (PCNT) unit, 4 counts per detent
+const pcnt_unit_t encoderUnit = PCNT_UNIT_0;
+const int encoderCountsPerStep = 4;
+const uint16_t encoderFilter = 1000;  // APB clock cycles (12.5us), shorter pulses are ignored as contact bounce
+const int16_t encoderLimit = 10000;   // the counter returns to 0 at +/- this value
+int16_t encoderLast = 0;              // the counter at the previous read
+int encoderCounts = 0;                // the counts that are not a full step yet
 
 //---Thermocouple MAX6675
 int TCRaw = 0;                       // raw value coming from the thermocouple module
 double TCCelsius = 0;                // Celsius value of the temperature reading
 unsigned long temperatureTimer = 0;  // Timer for measuring the temperature
+unsigned long rateTimer = 0;         // millis() of the reading of prevTCCelsius
+bool readingRequested = false;       // the reads of the chips are on the SPI bus
+bool probeRequested = false;         // and one of them is the board probe
+bool probeDone = false;              // the read of the board probe is done
+bool plateRequested = false;         // the read of the plate chip is on the bus, after the board probe
+double TCRate = 0;                   // filtered temperature change in °C per second (dT/dt)
+double prevTCCelsius = 0;            // the previous reading, to calculate the rate
+const double TCRateFilter = 0.2;     // filter factor for dT/dt; the raw 4Hz difference is very noisy
 
 bool coolingFanEnabled = false;  // status that tells the code if the fan is enabled or not
 String Fan = "OFF";
 bool heatingEnabled = false;  // tells the code if the heating was enabled or not
-bool reflow = false;          // tells if the reflow process has been enabled
-bool enableFreeHeating = false;
-bool enableFreeCooling = false;
-bool enableWarmup = false;
-unsigned long SSRTimer = 0;       // Timer for switching the SSR
 unsigned long SSRInterval = 250;  // 250ms; update interval for switching the SSR
 double elapsedHeatingTime = 0;    // Time spent in the heating phase (unit is ms)
 double earlyStop;                 // slow down the heating process just before reaching targetTemp
 double Output;                    // holds the value for the PWM output to the SSR
 
+//---The heater and fan outputs, synchronized with the thermocouple conversions
+// The SSR is switched in slots of a temperature reading: a slot is on or off, a sigma-delta modulator spreads
+// the power over the slots. The SSR and fan edges are made at the reads, while the chip select of the plate is
+// low and its conversion does not run, and the next conversion starts switchGuard ms later. The board probe
+// shares the bus and is read before the plate without hold, its conversion does see the edges. A conversion that does see an edge
+// (heaterOff() and the fan test switch right away) is flagged and left out of the filter once.
+int heaterPower = 0;                    // 0-255, the average power over the slots
+int heaterSum = 0;                      // the sigma-delta accumulator
+bool heaterOn = false;                  // the SSR in this slot
+bool fanRequest = false;                // the fans from the next slot
+bool fanOn = false;                     // the fans now
+bool quietSampling = true;              // serial command QUIET on|off; off: the slots run on their own clock
+unsigned long slotTimer = 0;            // millis() of the last slot without the quiet sampling
+const unsigned long switchGuard = 20;   // ms, the zero-cross SSR switches within 10ms and the fans spin up
+bool conversionHeld = false;            // the chip select of the plate is low until the guard time has passed
+bool conversionDisturbed = false;       // an edge while a conversion ran
+bool lastFlagged = false;               // the previous reading was flagged, the next one is always used
+uint32_t flaggedReadings = 0;           // readings that saw an edge, since the power-up
+
+//---Automatic runs
+// In the warmup mode the plate is the standby for the next board: a board placed on it is seen in the dT/dt
+// (include/board_detect.h) and starts a reflow run after a countdown, a press of the button cancels it. When the
+// heating of the run is over, the removal of the board finishes the run and the plate goes back to the standby.
+enum AutoRunState {
+    AUTO_WATCH,      // in the warmup mode: waiting for a board
+    AUTO_COUNTDOWN,  // a board was placed, the run starts at the end of the countdown
+    AUTO_RUN         // a run that was started by a board: waiting for the removal
+};
+bool autoRunEnabled = false;                // serial command AUTO on|off
+AutoRunState autoRunState = AUTO_WATCH;
+BoardDetect boardDetect;                    // the detector, reset when what it watches changes
+const PlateParams autoPlate = defaultPlateParams();  // the model for the expected dT/dt
+PlateRateLag autoRateLag = {0, 0, 0};       // the expected dT/dt behind the lags of the plate and the readings
+unsigned long autoTimer = 0;                // millis() of the previous reading
+unsigned long autoCountdownStart = 0;       // millis() when the board was placed
+unsigned long autoStandbyStart = 0;         // millis() when the warmup started to regulate at the standby
+const unsigned long autoStandbySettle = 30000;  // ms of regulation before a placement is seen, the plate settles
+const unsigned long autoCountdown = 5000;   // ms from the placement to the start of the run
+const double autoStandbyBand = 5;           // °C around the warmup temperature where a placement is seen
+const double autoReleaseTemp = 100;         // °C, the solder is solid and the board can be taken off (the ETA)
+bool autoFan = false;                       // the fans at the previous reading, a switch resets the detector
+
 // ==================================================================
 // Reflow Curve parts for Chipquick Sn42/Bi57.6/Ag0.4 - 138C : I have this paste in a syringe
 String pasteName = "Sn42/Bi57.6/Ag0.4";
@@ -327,25 +700,34 @@ volatile int reflowTime = 0;
 volatile int coolingTemp = 0;
 volatile int coolingTime = 0;
 
+// Maximum ramp rate in °C/s, used to color the dT/dt strip chart
+double rampRateLimit = 0;
+
+// The profile asks for cascade control on the board probe
+bool cascadeEnabled = false;
+
 // struct to group the used values for each solderpaste variation
 struct solderpaste {
     char pasteName[30];
-    volatile int preheatTemp;  // Temps in degrees C. Preheat is from room temperature to soaking temperature
-    volatile int preheatTime;  // Note: times in seconds are always as compared to zero and not the length of the process step.
-    volatile int soakingTemp;  // Soaking temperature (nearly flat curve)
-    volatile int soakingTime;
-    volatile int reflowTemp;  // Soaking temperature to peak temperature (slight overshoot to peak temperature)
-    volatile int reflowTime;
-    volatile int coolingTemp;  // Cooling temperature - Same temperature as the peak, because this part is more like keeping the solder around Tmelt for a short (~10s) time
-    volatile int coolingTime;
+    int preheatTemp;  // Temps in degrees C. Preheat is from room temperature to soaking temperature
+    int preheatTime;  // Note: times in seconds are always as compared to zero and not the length of the process step.
+    int soakingTemp;  // Soaking temperature (nearly flat curve)
+    int soakingTime;
+    int reflowTemp;  // Soaking temperature to peak temperature (slight overshoot to peak temperature)
+    int reflowTime;
+    int coolingTemp;  // Cooling temperature - Same temperature as the peak, because this part is more like keeping the solder around Tmelt for a short (~10s) time
+    int coolingTime;
+    double rampRateLimit;  // maximum heating/cooling ramp rate in °C/s from the datasheet of the paste
+    bool cascadeControl;   // regulate on the board probe (cascade control) when it is connected
 };
 
 // Create an array of struct's for the various solder pastes.
-// The separator is the number of fields in the struct (9), so the array is created correctly.
+// The separator is the number of fields in the struct (11), so the array is created correctly.
 // it can hold any number of solderpastes, the code handles that.
 // https://www.chipquik.com/store/product_info.php?products_id=473036 for many different pastes and their profiles
 //
-solderpaste solderpastes[] = {
+// The array is const, so the compiler leaves it in flash, only the selected profile is copied to RAM.
+const solderpaste solderpastes[] = {
     // Paste 0
     "Sn42/Bi57.6/Ag0.4",  // Solderpaste
     90,                   // preheatTemp
@@ -356,6 +738,8 @@ solderpaste solderpastes[] = {
     240,                  // reflowTime
     165,                  // coolingTemp
     250,                  // coolingTime start
+    2.0,                  // rampRateLimit in °C/s
+    false,                // cascadeControl: true to follow the profile with the board probe, see reflowCascadeStep()
 
     // paste 1
     "Sn42/Bi57/Ag1",  // the same as the previous paste, but with a bit more silver
@@ -367,6 +751,8 @@ solderpaste solderpastes[] = {
     240,
     165,
     250,
+    2.0,
+    false,
 
     // Paste 2
     "Sn63/Pb37",
@@ -378,6 +764,8 @@ solderpaste solderpastes[] = {
     210,
     235,
     220,
+    3.0,
+    false,
 
     // Paste 3
     "Sn63/Pb37 Mod",
@@ -388,7 +776,9 @@ solderpaste solderpastes[] = {
     235,
     210,
     235,
-    220};
+    220,
+    3.0,
+    false};
 
 int solderPasteSelected = 0;       // hold the index to the array of solderpastes
 int prev_solderPasteSelected = 0;  // previous selected solder paste index to avoid screen redraws
@@ -405,9 +795,12 @@ volatile int prev_reflowTime = reflowTime;
 volatile int prev_coolingTemp = coolingTemp;
 volatile int prev_coolingTime = coolingTime;
 
-// position of the paste name on the TFT screen
-const int pasteNamePosX = 50;  // position from the left
-const int pasteNamePosY = 1;   // position from the top of the TFT.
+// The list of solder pastes that is shown on top of the chart during the selection.
+// Only the visible rows are drawn, so the number of pastes doesn't matter. The list is UI_PASTE_LIST.
+const int pasteListRowH = 16;  // height of a row, font 2
+const int pasteListRows = 8;   // number of visible rows
+int pasteListTop = 0;          // index of the paste in the first visible row
+int pasteListShown = -1;       // index of the highlighted paste on the display, -1 when the list is closed
 
 double targetTemp = 0;  // A variable that holds the target values temporarily,
 // based on the actually calculated part of the active heating phase
@@ -416,11 +809,11 @@ volatile int freeCoolingTemp = 40;   // Free cooling default target target tempe
 volatile int warmupTemp = 38;        // Free heating warm-up default target temperature
 
 // Conversion formulas for converting the physical values (Temp and time) into pixel values.
-//  Display is (YxX) 240x320px
+// They are set from the height and width of the chart in setup(), these are the values for 320x240.
 //  Y-Axis has 250 degrees max
 //  px range is 13 from bottom and 60 from top
 double tempPixelFactor = 250.0 / (tftY - (60 + 13));  // y = 250 / 167 = 1.497 ~ 1.5°C per pixel on Y
-// X-Axis is shifted by 18 from the bottom.
+// X-Axis is shifted by 18 from the left.
 // 360 seconds max
 // px range is 18 from left and 2 from the right (320-2)
 double timePixelFactor = 360.0 / (tftX - (18 + 2));  // x = 360 / 300 = 1.2s per pixel on X
@@ -439,6 +832,17 @@ int coolingTime_px;
 int measuredTemp_px;
 int measuredTime_px;
 
+// Strip charts for the heater power and the ramp rate, in the band between 0°C and 20°C of the chart.
+// The plate never gets below room temperature, so the curve does not use this part of the chart.
+int powerStripY = yGraph - 12;        // top of the power strip, moves with the chart
+const int powerStripH = 4;            // height of the power strip
+int rateStripY = yGraph - 7;          // top of the dT/dt strip, 1px below the power strip
+const int rateStripH = 7;             // height of the dT/dt strip, the zero line is in the middle
+int progressBarY = yGraph - 16;       // top of the progress bar of a reflow run, 1px above the power strip
+int stripColumn = -1;                 // the x position of the column we're collecting samples for
+int stripSamples = 0;                 // number of samples in the current column
+long stripPowerSum = 0;               // sum of the PWM values in the current column
+
 //---Menu related----
 volatile int itemCounter = -1;         // this tells the code the active menu position
 volatile int previousItemCounter = 0;  // this tells the code the previous menu position (needed for the highlighting)
@@ -463,77 +867,221 @@ bool freeHeatingTargetSelected = false;
 bool freeHeatingOnOffSelected = false;
 bool freeCoolingTargetSelected = false;
 bool freeCoolingOnOffSelected = false;
+bool noiseButtonSelected = false;
+
+const int lastMenuItem = 16;  // the number of the last field in the menu
+
+//---Run log
+bool runLogReady = false;                 // the file system for the run logs is mounted
+File runLogFile;                          // the log file of the active reflow run
+uint32_t runLogId = 0;                    // the id of the next run
+uint32_t runLogOldest = 0;                // the id of the oldest run log that is still stored
+RunLogSamples runLogSamples;              // the samples of the block that is being filled
+int runLogCount = 0;                      // the number of samples in runLogSamples
+uint8_t runLogPayload[RUNLOG_MAX_PAYLOAD];  // the encoded block
+const size_t runLogReserve = 32768;       // free space we want before starting a new log
+
+//---Run log synchronization, see include/logsync.h
+char serialLine[32];                      // the command the host is sending
+int serialLineLength = 0;
+File syncFile;                            // the run log that is being sent
+uint32_t syncRunId = 0;                   // the run and the block to send next
+uint32_t syncBlock = 0;
+uint8_t syncFrame[LOGSYNC_MAX_FRAME];     // the frame that is waiting for room in the serial buffer
+size_t syncFrameLength = 0;
+const int serialTxBuffer = 2048;          // a frame is only written when all of it fits, never mixed with other prints
+const int serialTxReserve = 256;          // room that we leave for the debug prints
+// the largest block that can be sent: a frame of LOGSYNC_MAX_FRAME would never fit next to the reserve, a block
+// beyond this ends its log (nextSyncFrame()) instead of holding up the transfer forever
+const size_t syncMaxBlock = serialTxBuffer - serialTxReserve - sizeof(LogSyncFrame) - 4;
+
+//---Telemetry for the bench scheduler, see include/station_status.h
+// STATUS and PASTES are answered with frames by the telemetry task, PROFILE selects a paste from the host.
+uint8_t telemetryFrame[sizeof(LogSyncFrame) + sizeof(StationPaste) + 4];  // the frame that waits for room
+size_t telemetryFrameLength = 0;
+bool statusRequested = false;             // a StationStatus frame is to be sent
+int pasteRequested = -1;                  // the next paste of a PASTES to send, -1 when there is none
+
+//---Anomalies of a reflow run, see include/run_anomaly.h
+// The readings of the run are compared with the plate model, heated by the power of the controller. An anomaly
+// (a thermocouple off the plate, a failing element, a stuck SSR) is reported and the status field turns red;
+// with ANOMALY abort the heating stops and the run goes on with the cooling.
+enum AnomalyAction {
+    ANOMALY_OFF,    // the detector runs, but nothing is reported
+    ANOMALY_WARN,   // report it
+    ANOMALY_ABORT   // report it and stop the heating
+};
+AnomalyAction anomalyAction = ANOMALY_WARN;   // serial command ANOMALY off|warn|abort
+const PlateParams anomalyPlate = defaultPlateParams();  // the model the readings are compared with
+RunAnomaly runAnomaly;                        // the detector, reset at the start of a run
+RunAnomalyKind anomalyFound = ANOMALY_NONE;   // the anomaly of this run, it is reported once
+bool runAborted = false;                      // the heating of this run was stopped by an anomaly
+
+//---Diagnostics, see include/dlog.h
+DLog dlog;                                // the records of LOG() that were not sent yet
+uint8_t dlogOut[DLOG_BUFFER];             // the records that go to the serial port in this pass
+
+//---Board-side profile planning
+// When enabled, the reflow mode regulates the plate to the planned setpoints so the board follows the profile.
+// It is enabled for a product (a profile) once its board model was fitted in a characterization run.
+bool boardPlanEnabled = false;                // false: the plate follows the profile (the original behavior)
+const BoardModel defaultBoardModel = {15.0, 0.05, 20.0};  // typical for a 1.6mm FR4 board
+BoardModel boardModel = defaultBoardModel;   // tau (s), loss, ambient temperature (°C)
+PlateLimits plateLimits = {260.0, 1.5, 1.0};  // max temp (°C), max heating and cooling rate (°C/s)
+int16_t plateSetpoints[PLAN_SECONDS];         // the planned plate setpoint for every second in 0.1°C
+
+//---Background jobs, see include/compute_jobs.h
+// The computations for the UI run in a task on core 0, the main loop with the control runs on core 1.
+// A job gets a copy of its inputs, the result goes to a buffer that the main loop copies under the lock.
+enum ComputeKind {
+    JOB_PLAN,     // the plate setpoints of the profile, shown with the curve and used by the reflow mode
+    JOB_PREDICT,  // the plate temperature of a run of the profile that is being edited
+    JOB_ETA       // the end of the phases of the reflow run, for the progress bar
+};
+struct ComputeInput {
+    ReflowProfile profile;
+    BoardModel model;
+    bool plan;        // the run follows the board plan
+    bool warp;        // the run has the time warp
+    double start;     // °C, the plate temperature at the start of the run
+    ReflowControl run;  // JOB_ETA: the controller of the reflow run at the submission
+    double time;        // JOB_ETA: s of the run at the submission
+    bool policy;        // JOB_ETA: the run is on the policy table
+    double rate;        // JOB_ETA: °C/s, the filtered dT/dt at the submission, for the policy table
+};
+ComputeQueue computeJobs;                     // only used with the lock
+ComputeInput computeInputs[COMPUTE_KINDS];    // the inputs of the latest submission of a kind
+ComputeInput computeDone[COMPUTE_KINDS];      // the inputs of the result of a kind
+int16_t planResult[PLAN_SECONDS];             // the latest plan of the worker
+double planDistortion = 0;                    // °C, of planResult
+int16_t predictResult[PLAN_SECONDS];          // the latest prediction of the worker
+int16_t prediction[PLAN_SECONDS];             // the prediction on the chart, every second in 0.1°C
+double etaResult[5];                          // the latest end times of the phases of the worker
+ComputeInput plannedFor;                      // the inputs of plateSetpoints
+bool planned = false;                         // plateSetpoints was calculated
+bool predicting = false;                      // a prediction was submitted for the edited value
+bool predictionShown = false;                 // the prediction is on the chart
+#ifndef COMPUTE_INLINE
+TaskHandle_t computeWorker = NULL;            // the task of the jobs on core 0
+portMUX_TYPE computeMux = portMUX_INITIALIZER_UNLOCKED;
+#endif
+
+//---Progress of a reflow run
+// A bar at the bottom of the chart with a segment per phase, under the phase on the time axis of the curve, fills
+// with the progress of the phase, and the stage field shows the time until the board can be taken off. The end
+// of the phases comes from the plate model (predictRemaining(), a background job every etaInterval); between
+// the predictions only the clock moves the bar and the time on. A step draws the new pixels of the bar and the
+// text only when the second changes.
+double phaseEnds[5];               // s of the run, the predicted end of every phase, COOLING: below autoReleaseTemp
+int progressFilled[5];             // px, the right side of the filled part of every segment
+int progressShown = -1;            // s, the time to the release on the screen
+double etaSubmitted = -1;          // s of the run of the last submission
+double etaFirst = -1;              // s, the release of the first prediction of the run, for the report
+bool released = false;             // the plate was below autoReleaseTemp after the heating
+const double etaInterval = 5;      // s between the predictions
+const int etaHorizon = 600;        // s, how far a prediction looks ahead
+const int progressBarH = 3;        // px, from progressBarY
+
+//---Product characterization
+// With a second thermocouple on the board (Board::probeCs), a reflow run also records the board temperature.
+// The board model is fitted at the end of the run and stored in the NVS with the profile.
+Preferences boardModels;                    // namespace "boards", a key per profile
+bool characterizing = false;                // the board probe was found at the start of the reflow run
+CascadeControl cascade;                     // the cascade controller, reflow on the board probe
+bool cascadeRunning = false;                // this run uses the cascade controller
+bool policyControl = true;                  // use the generated policy table when it was solved for the profile
+bool policyRunning = false;                 // this run uses the policy table
+bool timeWarpEnabled = true;                // stretch the ramps when the plate falls behind, see TimeWarp
+double probeCelsius = 0;                    // the last reading of the board probe
+int16_t probePlate[PLAN_SECONDS];           // plate and board temperature every second in 0.1°C
+int16_t probeBoard[PLAN_SECONDS];
+int probeCount = 0;                         // the number of samples
+const int probeMinSamples = 120;            // a shorter (stopped) run is not used for a fit
+
+//---Thermocouple noise analysis
+#define NOISE_SAMPLES 128               // number of readings for the FFT, must be a power of 2
+bool enableNoiseAnalysis = false;       // the noise analysis is running
+double noiseSamples[NOISE_SAMPLES];     // the raw temperature readings
+int noiseCount = 0;                     // number of readings in noiseSamples
+unsigned long noiseStart = 0;           // millis() of the first reading, to calculate the real sample rate
+const int noiseTestPower = 40;          // PWM value for the heater during the recording, so we also see the SSR switching
+int noiseFlagged = 0;                   // readings of the recording that saw a switching edge
+int16_t twiddleCos[NOISE_SAMPLES / 2];  // the FFT coefficients in Q15, calculated the first time
+int16_t twiddleSin[NOISE_SAMPLES / 2];
+
+// Notch filter in the temperature acquisition, a biquad in floating point (the ESP32 has an FPU)
+bool notchEnabled = false;
+double notchFrequency = 0;                  // Hz
+double notchB1, notchA1, notchA2, notchGain;  // coefficients, b0 and b2 are 1
+double notchX1, notchX2, notchY1, notchY2;  // the filter state
 
 //--------------------------------------
 bool redrawCurve = true;  // tells the code if the reflow curve has to be redrawn
 int RectRadius = 2;       // The radius for the rounding of the menu fields
 
-// the reflow phases
-enum ReflowPhase {
-    PREHEAT = 0,
-    SOAK,
-    REFLOW,
-    HOLD,
-    COOLING
-};
-ReflowPhase currentPhase = PREHEAT;  // Default phase
-
-// forward looking prediction for the heating cut-off in the preheat and reflow phases.
-// When the heater is on it is ramping up the temperature. We need to turn the heater off before it
-// reaches the target temperature to avoid overshoot due to the inertia of the hardware.
-int preheatCutOff = 0;             // the temperature where we want to cut off the heater in the preheat phase
-int const preheatCutOffTime = 15;  // cut off the heater 15s before the target temperature
-int reflowCutOff = 0;              // the temperature where we want to cut off the heater in the reflow phase
-int const reflowCutOffTime = 15;   // cut off the heater 15s before the target temperature
-// The actual cutoff times are based on the selected solderpaste and will be defined in setup() or when a
-// new solderpaste is selected.
+// the reflow and heating controllers, the logic lives in include/reflow_control.h
+ReflowControl reflowControl;    // the settings and the state of the reflow run, set up at the start of a run
+HeatingControl heatingControl;  // the free heating or warmup controller, set up when the mode is started
+
+// the modes run as tasks, the main loop only runs the ones that are not waiting
+#define TASK_EVENT_TEMPERATURE 0x01  // measureTemperature() has a new reading
+Task reflowRun = TASK(reflowTask, "reflow");
+Task freeHeatingRun = TASK(freeHeatingTask, "free heating");
+Task warmupRun = TASK(warmupTask, "warmup");
+Task freeCoolingRun = TASK(freeCoolingTask, "free cooling");
+Task noiseRun = TASK(noiseTask, "noise");
+Task autoRun = TASK(autoRunTask, "auto run");  // always running, it starts and ends the automatic runs
+Task telemetryRun = TASK(telemetryTask, "telemetry");  // the answers to STATUS and PASTES
+Task syncRun = TASK(syncTask, "log sync");  // last, it only uses what the modes leave of the serial port
+Task* taskTable[] = {&reflowRun, &freeHeatingRun, &warmupRun, &freeCoolingRun, &noiseRun, &autoRun, &telemetryRun, &syncRun};
+TaskList tasks = {taskTable, sizeof(taskTable) / sizeof(taskTable[0]), 0};
 
 //==================================================
 
 void setup() {
-    pinMode(TFT_ON, OUTPUT);    // Define output pin for switching the power to the TFT
-    digitalWrite(TFT_ON, LOW);  // Disable power to the TFT until we are ready to use it
+    pinMode(Board::tftOn, OUTPUT);    // Define output pin for switching the power to the TFT
+    digitalWrite(Board::tftOn, LOW);  // Disable power to the TFT until we are ready to use it
 
-    Serial.begin(9600);
+    Serial.setTxBufferSize(serialTxBuffer);  // before begin()
+    Serial.begin(115200);
     while (!Serial);
     delay(5000);
-    Serial.print("\n\r\n\rReflow controller ");
-    Serial.println(FW_VERSION);
-
-    Serial.print("tempPixelFactor = ");
-    Serial.println(tempPixelFactor, 3);
-    Serial.print("timePixelFactor = ");
-    Serial.println(timePixelFactor, 3);
+    LOG("Reflow controller %s", FW_VERSION.c_str());
 
     SPI.begin();  // start hardware SPI
 
     //------
     // PORT/PIN definitions
-    pinMode(DSO_TRIG, OUTPUT);  // optional for tracing real-time events with a DSO
+    pinMode(Board::dsoTrig, OUTPUT);  // optional for tracing real-time events with a DSO
     // Rotary encoder-related
-    pinMode(RotaryCLK, INPUT);  // CLK - has pull-up resistor
-    pinMode(RotaryDT, INPUT);
+    setupEncoder();
     // the Rotary button is done by the library
-    button.setDebounceTime(20);                                                   // set debounce time for the rotary button to 20 milliseconds
-    attachInterrupt(digitalPinToInterrupt(RotaryCLK), rotaryEncoderISR, CHANGE);  // CLK pin is inverted by a Schmitt-trigger gate
-    // Reading the current status of the encoder for preparing it for the first movement/change
-    CLKPrevious = digitalRead(RotaryCLK);
-    DTPrevious = digitalRead(RotaryDT);
+    button.setDebounceTime(20);  // set debounce time for the rotary button to 20 milliseconds
     //-----
-    pinMode(SSR_pin, OUTPUT);   // Define output pin for switching the SSR
-    analogWrite(SSR_pin, OFF);  // SSR is OFF by default
+    pinMode(Board::ssr, OUTPUT);     // Define output pin for switching the SSR
+    OutputPin<Board::ssr>::low();    // SSR is OFF by default
     //----
-    pinMode(Fan_pin, OUTPUT);     // Define output pin for switching the fan (transistor)
-    digitalWrite(Fan_pin, HIGH);  // Enable fan - turn them on as a test to see if they spin up
+    pinMode(Board::fan, OUTPUT);    // Define output pin for switching the fan (transistor)
+    switchFan(true);                // Enable fan - turn them on as a test to see if they spin up
     //-----
-    Serial.println("setting up tft");
-    digitalWrite(TFT_ON, HIGH);  // Enable power for the TFT
+    LOG("setting up tft");
+    digitalWrite(Board::tftOn, HIGH);  // Enable power for the TFT
     tft.init();                  // Initialize the display
     tft.setRotation(3);          // Select the Landscape alignment - Use 3 to flip horizontally
     tft.fillScreen(BLACK);       // Clear the screen and set it to black
+    tft.setSwapBytes(true);      // pushImage() gets the colors in the native 16-bit order
+    setupLayout();               // place the fields for the size of this panel
     //-----
     thermoCouple.begin();
-    thermoCouple.setSPIspeed(40000000);
+    boardProbe.begin();
+    //-----
+    // mount the file system for the run logs, it gets formatted the first time
+    if (LittleFS.begin(true)) {
+        runLogReady = true;
+        findRunLogs();
+    } else {
+        LOG("LittleFS mount failed, the runs will not be logged");
+    }
 
     //----- set the initial solderpaste and values
     numSolderpastes = sizeof(solderpastes) / sizeof(solderpaste);  // the size of the array of solderpastes
@@ -551,14 +1099,21 @@ void setup() {
     reflowTime = current.reflowTime;
     coolingTemp = current.coolingTemp;
     coolingTime = current.coolingTime;
+    rampRateLimit = current.rampRateLimit;
+    cascadeEnabled = current.cascadeControl;
 
     //-----
-    // forward prediction for the heating cut-off in the preheat and reflow phases
-    preheatCutOff = preheatTime - preheatCutOffTime;  // cut off the heater before the target temperature
-    reflowCutOff = reflowTime - reflowCutOffTime;     // cut off the heater before the target temperature
+    // the learned board models of the products
+    boardModels.begin("boards", false);
+    loadBoardModel();
+
+#ifndef COMPUTE_INLINE
+    // the background jobs on core 0, the main loop runs on core 1
+    xTaskCreatePinnedToCore(computeTask, "jobs", 4096, NULL, 1, &computeWorker, 0);
+#endif
 
     //-----
-    Serial.println("show welcome screen on tft");
+    LOG("show welcome screen on tft");
     tft.setTextColor(WHITE);
 
     tft.setTextDatum(MC_DATUM);  // center text on display; works on current font only
@@ -570,20 +1125,21 @@ void setup() {
 
     vTaskDelay(3000 / portTICK_PERIOD_MS);  // wait 3 seconds so you can read it
 
-    Serial.println("writing reflow curve");
+    LOG("writing reflow curve");
     // Erase the screen, then draw the starting graph
     tft.fillScreen(BLACK);
     drawReflowCurve();
     drawActionButtons();
-    digitalWrite(Fan_pin, LOW);  // Disable fan - turn off the "spinning test" of the fans
+    switchFan(false);  // Disable fan - turn off the "spinning test" of the fans
+    startTask(autoRun);
 
-    Serial.println("setup is done...");
+    LOG("setup is done...");
 }
 
 /*
   The main loop of the code
   Statemachines will activate the functionality of the code.
-  There are interrupts for the rotary encoder and the rotary button.
+  The rotary encoder is counted by the hardware and the rotary button is polled.
   The code will measure the temperature and update the display.
   The reflow, warmup, heating and cooling modes will execute when the user
   selects them.
@@ -595,240 +1151,253 @@ void loop() {
     button.loop();  // must call the ezButton loop() function first
 
     measureTemperature();
+    processEncoder();
     updateHighlighting();
-    runReflow();
-    runWarmup();
-    freeHeating();
-    freeCooling();
+    readSerialCommand();
+    runTasks(tasks, millis());  // the running modes
+    deliverComputeResults();    // the results of the background jobs
+    flushLog();
     if (button.isPressed()) processRotaryButton();
 }
 
 /*
-  Interrupt Service Routine for the Rotary Encoder
+  Set up a pulse counter unit to decode the rotary encoder
 
-  This is the routine that is used to move from field to field and when the button is pressed,
-  it enters the edit mode in which the information in the field can be changed by rotation.
+  The two channels of the unit count every edge of both signals (4x quadrature): channel 0
+  counts the CLK edges with DT as the direction, channel 1 the DT edges with CLK as the
+  direction. The glitch filter of the PCNT drops the short pulses of the contact bounce, so the
+  Schmitt-trigger gate on the CLK pin is no longer needed. The counting costs no CPU time and
+  no edges are missed while the code is busy with the display or the MAX6675.
+*/
+void setupEncoder() {
+    pcnt_config_t config = {};
+    config.unit = encoderUnit;
+    config.counter_h_lim = encoderLimit;
+    config.counter_l_lim = -encoderLimit;
+
+    config.channel = PCNT_CHANNEL_0;
+    config.pulse_gpio_num = Board::rotaryClk;
+    config.ctrl_gpio_num = Board::rotaryDt;
+    config.pos_mode = PCNT_COUNT_DEC;
+    config.neg_mode = PCNT_COUNT_INC;
+    config.lctrl_mode = PCNT_MODE_REVERSE;
+    config.hctrl_mode = PCNT_MODE_KEEP;
+    pcnt_unit_config(&config);
+
+    config.channel = PCNT_CHANNEL_1;
+    config.pulse_gpio_num = Board::rotaryDt;
+    config.ctrl_gpio_num = Board::rotaryClk;
+    config.pos_mode = PCNT_COUNT_INC;
+    config.neg_mode = PCNT_COUNT_DEC;
+    pcnt_unit_config(&config);
+
+    pcnt_set_filter_value(encoderUnit, encoderFilter);
+    pcnt_filter_enable(encoderUnit);
+    pcnt_counter_pause(encoderUnit);
+    pcnt_counter_clear(encoderUnit);
+    pcnt_counter_resume(encoderUnit);
+}
 
-  The interrupt is generated when a change on the RotaryCLK signal is detected.
-  The ISR takes a little time and we also have a hardware r/c delay, so by reading it again now,
-  we should have a stable level.
+/*
+  Take the new counts of the encoder and process them a detent at a time. The counter keeps
+  running (clearing it could lose an edge), the difference with the previous read is used.
+*/
+void processEncoder() {
+    int16_t now;
+    pcnt_get_counter_value(encoderUnit, &now);
+    if (now == encoderLast) return;
+    int counts = now - encoderLast;
+    if (counts > encoderLimit / 2) counts -= encoderLimit;  // the counter passed a limit and restarted at 0
+    if (counts < -encoderLimit / 2) counts += encoderLimit;
+    encoderLast = now;
+    encoderCounts += counts;
+    while (encoderCounts >= encoderCountsPerStep) {
+        rotateEncoder(1);
+        encoderCounts -= encoderCountsPerStep;
+    }
+    while (encoderCounts <= -encoderCountsPerStep) {
+        rotateEncoder(-1);
+        encoderCounts += encoderCountsPerStep;
+    }
+}
 
-  Depending on the field we're in, we can adjust the value of temp and time
+/*
+  A step of the rotary encoder, -1 or +1 (one detent)
 
-  The recommended method is to limit the execution time in an ISR to the absolute minimum.
-  In this case however, we're not expecting other interrupts, and the actual time spent in the ISR
-  is very short, despite the many lines of code.
+  This is the routine that is used to move from field to field and when the button is pressed,
+  it enters the edit mode in which the information in the field can be changed by rotation.
 
+  The steps come from processEncoder(), in the main loop. Depending on the field we're in, we
+  can adjust the value of temp and time.
 */
-void IRAM_ATTR rotaryEncoderISR() {  // IRAM_ATTR
-    // we get here because the ISR detected a change on the CLK pin
-    // digitalWrite(DSO_TRIG, HIGH); // track duration, typically 1.5us
-
-    CLKNow = digitalRead(RotaryCLK);  // Read the state of the CLK pin again
+void rotateEncoder(int step) {
     if (preheatTempSelected == true) {
-        if (CLKNow != CLKPrevious && CLKNow == 1) {
-            if (digitalRead(RotaryDT) != CLKNow)  // read the DT level and determine the direction (CW or CCW)
-            {
-                if (preheatTemp > 20) {
-                    preheatTemp = preheatTemp - 1;
-                }
-            } else {
-                if (preheatTemp < 150) {  // typical max value for preheat phase - feel free to change it
-                    preheatTemp = preheatTemp + 1;
-                }
+        if (step < 0) {
+            if (preheatTemp > 20) {
+                preheatTemp = preheatTemp - 1;
+            }
+        } else {
+            if (preheatTemp < 150) {  // typical max value for preheat phase - feel free to change it
+                preheatTemp = preheatTemp + 1;
             }
         }
         menuChanged = true;
-        CLKPrevious = CLKNow;  // Store last CLK state
     } else if (preheatTimeSelected == true) {
-        if (CLKNow != CLKPrevious && CLKNow == 1) {
-            if (digitalRead(RotaryDT) != CLKNow) {
-                if (preheatTime > 0) {
-                    preheatTime = preheatTime - 1;
-                }
-            } else {
-                if (preheatTime < 90) {  // Typical preheat time
-                    preheatTime = preheatTime + 1;
-                }
+        if (step < 0) {
+            if (preheatTime > 0) {
+                preheatTime = preheatTime - 1;
+            }
+        } else {
+            if (preheatTime < 90) {  // Typical preheat time
+                preheatTime = preheatTime + 1;
             }
         }
         menuChanged = true;
-        CLKPrevious = CLKNow;  // Store last CLK state
     } else if (soakingTempSelected == true) {
-        if (CLKNow != CLKPrevious && CLKNow == 1) {
-            if (digitalRead(RotaryDT) != CLKNow) {
-                if (soakingTemp > 20) {
-                    soakingTemp = soakingTemp - 1;
-                }
-            } else {
-                if (soakingTemp < 180) {  // typical soaking temperature
-                    soakingTemp = soakingTemp + 1;
-                }
+        if (step < 0) {
+            if (soakingTemp > 20) {
+                soakingTemp = soakingTemp - 1;
+            }
+        } else {
+            if (soakingTemp < 180) {  // typical soaking temperature
+                soakingTemp = soakingTemp + 1;
             }
         }
         menuChanged = true;
-        CLKPrevious = CLKNow;  // Store last CLK state
     } else if (soakingTimeSelected == true) {
-        if (CLKNow != CLKPrevious && CLKNow == 1) {
-            if (digitalRead(RotaryDT) != CLKNow) {
-                if (soakingTime > 0) {
-                    soakingTime = soakingTime - 1;
-                }
-            } else {
-                if (soakingTime < 180) {  // typical (total) time at the end of the soaking period
-                    soakingTime = soakingTime + 1;
-                }
+        if (step < 0) {
+            if (soakingTime > 0) {
+                soakingTime = soakingTime - 1;
+            }
+        } else {
+            if (soakingTime < 180) {  // typical (total) time at the end of the soaking period
+                soakingTime = soakingTime + 1;
             }
         }
         menuChanged = true;
-        CLKPrevious = CLKNow;  // Store last CLK state
     } else if (reflowTempSelected == true) {
-        if (CLKNow != CLKPrevious && CLKNow == 1) {
-            if (digitalRead(RotaryDT) != CLKNow) {
-                if (reflowTemp > 0) {
-                    reflowTemp = reflowTemp - 1;
-                }
-            } else {
-                if (reflowTemp < 250) {  // typical peak temp for reflow
-                    reflowTemp = reflowTemp + 1;
-                }
+        if (step < 0) {
+            if (reflowTemp > 0) {
+                reflowTemp = reflowTemp - 1;
+            }
+        } else {
+            if (reflowTemp < 250) {  // typical peak temp for reflow
+                reflowTemp = reflowTemp + 1;
             }
         }
         menuChanged = true;
-        CLKPrevious = CLKNow;  // Store last CLK state
     } else if (reflowTimeSelected == true) {
-        if (CLKNow != CLKPrevious && CLKNow == 1) {
-            if (digitalRead(RotaryDT) != CLKNow) {
-                if (reflowTime > 0) {
-                    reflowTime = reflowTime - 1;
-                }
-            } else {
-                if (reflowTime < 240) {
-                    reflowTime = reflowTime + 1;
-                }
+        if (step < 0) {
+            if (reflowTime > 0) {
+                reflowTime = reflowTime - 1;
+            }
+        } else {
+            if (reflowTime < 240) {
+                reflowTime = reflowTime + 1;
             }
         }
         menuChanged = true;
-        CLKPrevious = CLKNow;  // Store last CLK state
     } else if (coolingTempSelected == true) {
-        if (CLKNow != CLKPrevious && CLKNow == 1) {
-            if (digitalRead(RotaryDT) != CLKNow) {
-                if (coolingTemp > 0) {
-                    coolingTemp = coolingTemp - 1;
-                }
-            } else {
-                if (coolingTemp < 250) {  // holding temperature before enterint the cooling phase
-                    coolingTemp = coolingTemp + 1;
-                }
+        if (step < 0) {
+            if (coolingTemp > 0) {
+                coolingTemp = coolingTemp - 1;
+            }
+        } else {
+            if (coolingTemp < 250) {  // holding temperature before enterint the cooling phase
+                coolingTemp = coolingTemp + 1;
             }
         }
         menuChanged = true;
-        CLKPrevious = CLKNow;  // Store last CLK state
 
     } else if (coolingTimeSelected == true) {
-        if (CLKNow != CLKPrevious && CLKNow == 1) {
-            if (digitalRead(RotaryDT) != CLKNow) {
-                if (coolingTime > 0) {
-                    coolingTime = coolingTime - 1;
-                }
-            } else {
-                if (coolingTime < 250) {  // total elapsed seconds before entering the cooling phase
-                    coolingTime = coolingTime + 1;
-                }
+        if (step < 0) {
+            if (coolingTime > 0) {
+                coolingTime = coolingTime - 1;
+            }
+        } else {
+            if (coolingTime < 250) {  // total elapsed seconds before entering the cooling phase
+                coolingTime = coolingTime + 1;
             }
         }
         menuChanged = true;
-        CLKPrevious = CLKNow;  // Store last CLK state
     } else if (warmupTempSelected == true) {
-        if (CLKNow != CLKPrevious && CLKNow == 1) {
-            if (digitalRead(RotaryDT) != CLKNow) {
-                if (warmupTemp > 20) {  // lowest at 20°C
-                    warmupTemp = warmupTemp - 1;
-                }
-            } else {
-                if (warmupTemp < 60) {  // Up to 60°C
-                    warmupTemp = warmupTemp + 1;
-                }
+        if (step < 0) {
+            if (warmupTemp > 20) {  // lowest at 20°C
+                warmupTemp = warmupTemp - 1;
+            }
+        } else {
+            if (warmupTemp < 60) {  // Up to 60°C
+                warmupTemp = warmupTemp + 1;
             }
         }
         menuChanged = true;
-        CLKPrevious = CLKNow;  // Store last CLK state
     } else if (freeWarmUpButtonSelected == true) {
         // freeWarmUpButtonSelected does not do anything with the rotation of the encoder
     } else if (freeHeatingTargetSelected == true) {
-        if (CLKNow != CLKPrevious && CLKNow == 1) {
-            if (digitalRead(RotaryDT) != CLKNow) {
-                if (freeHeatingTemp > 20) {
-                    freeHeatingTemp = freeHeatingTemp - 1;
-                }
-            } else {
-                if (freeHeatingTemp < 300) {  // Here we allow a little higher temperature than the reflow curve temperature
-                    freeHeatingTemp = freeHeatingTemp + 1;
-                }
+        if (step < 0) {
+            if (freeHeatingTemp > 20) {
+                freeHeatingTemp = freeHeatingTemp - 1;
+            }
+        } else {
+            if (freeHeatingTemp < 300) {  // Here we allow a little higher temperature than the reflow curve temperature
+                freeHeatingTemp = freeHeatingTemp + 1;
             }
         }
         menuChanged = true;
-        CLKPrevious = CLKNow;  // Store last CLK state
     } else if (startStopButtonSelected == true) {
         // start/stop button does not do anything with the rotation of the encoder
     } else if (freeCoolingTargetSelected == true) {
-        if (CLKNow != CLKPrevious && CLKNow == 1) {
-            if (digitalRead(RotaryDT) != CLKNow) {
-                if (freeCoolingTemp > 20) {
-                    freeCoolingTemp = freeCoolingTemp - 1;
-                }
-            } else {
-                if (freeCoolingTemp < 200) {  // Here we allow a little higher temperature than the reflow curve temperature
-                    freeCoolingTemp = freeCoolingTemp + 1;
-                }
+        if (step < 0) {
+            if (freeCoolingTemp > 20) {
+                freeCoolingTemp = freeCoolingTemp - 1;
+            }
+        } else {
+            if (freeCoolingTemp < 200) {  // Here we allow a little higher temperature than the reflow curve temperature
+                freeCoolingTemp = freeCoolingTemp + 1;
             }
         }
         menuChanged = true;
-        CLKPrevious = CLKNow;  // Store last CLK state
     } else if (freeHeatingOnOffSelected == true) {
         // freeHeatingOnOffSelected does not do anything with the rotation of the encoder
     } else if (freeCoolingOnOffSelected == true) {
         // freeCoolingOnOffSelected does not do anything with the rotation of the encoder
+    } else if (noiseButtonSelected == true) {
+        // the noise analysis button does not do anything with the rotation of the encoder
     } else if (solderpasteFieldSelected == true) {  // Add the new field logic here
-        if (CLKNow != CLKPrevious && CLKNow == 1) {
-            if (digitalRead(RotaryDT) != CLKNow) {
-                if (solderPasteSelected > 0) {
-                    solderPasteSelected = solderPasteSelected - 1;
-                } else {
-                    solderPasteSelected = numSolderpastes - 1;  // Wrap around to the last index
-                }
+        if (step < 0) {
+            if (solderPasteSelected > 0) {
+                solderPasteSelected = solderPasteSelected - 1;
             } else {
-                if (solderPasteSelected < numSolderpastes - 1) {
-                    solderPasteSelected = solderPasteSelected + 1;
-                } else {
-                    solderPasteSelected = 0;  // Wrap around to the first index
-                }
+                solderPasteSelected = numSolderpastes - 1;  // Wrap around to the last index
+            }
+        } else {
+            if (solderPasteSelected < numSolderpastes - 1) {
+                solderPasteSelected = solderPasteSelected + 1;
+            } else {
+                solderPasteSelected = 0;  // Wrap around to the first index
             }
         }
         menuChanged = true;
-        CLKPrevious = CLKNow;  // Store last CLK state
     } else {                   // This navigates through the fields in the menu
 
-        if (CLKNow != CLKPrevious && CLKNow == 1) {
-            previousItemCounter = itemCounter;
-            if (digitalRead(RotaryDT) != CLKNow) {
-                if (itemCounter > 0) {
-                    itemCounter = itemCounter - 1;
-                } else {
-                    itemCounter = 15;  // after the first menu item, we go back to the last menu item
-                }
+        previousItemCounter = itemCounter;
+        if (step < 0) {
+            if (itemCounter > 0) {
+                itemCounter = itemCounter - 1;
             } else {
-                if (itemCounter < 15) {
-                    itemCounter = itemCounter + 1;
-                } else {
-                    itemCounter = 0;  // after the last menu item, we go back to the first menu item
-                }
+                itemCounter = lastMenuItem;  // after the first menu item, we go back to the last menu item
+            }
+        } else {
+            if (itemCounter < lastMenuItem) {
+                itemCounter = itemCounter + 1;
+            } else {
+                itemCounter = 0;  // after the last menu item, we go back to the first menu item
             }
         }
         menuChanged = true;
-        CLKPrevious = CLKNow;  // Store last CLK state
     }
-    // digitalWrite(DSO_TRIG, LOW); // track duration
+    // a new value of the profile: predict the run in the background, the next detent cancels it
+    if (editingProfile()) submitPrediction();
 }
 
 /*
@@ -860,6 +1429,11 @@ void IRAM_ATTR rotaryEncoderISR() {  // IRAM_ATTR
 
 */
 void processRotaryButton() {
+    // a press in the countdown of an automatic run only cancels the start
+    if (autoRunState == AUTO_COUNTDOWN) {
+        cancelAutoStart();
+        return;
+    }
     switch (itemCounter)  // selects the menu item that was selected
     {
         //--Preheat temperature
@@ -1093,92 +1667,30 @@ void processRotaryButton() {
 
             if (warmupTempSelected == true) {
                 editMode = true;
-                tft.fillRoundRect(220, 2, 32, 12, RectRadius, GREEN);  // X,Y, W,H, Color
+                fillField(ui[UI_WARMUP_VALUE], GREEN);
                 tft.setTextColor(RED);
-                tft.drawString(String(warmupTemp), 228, 4, 1);
+                drawFieldText(ui[UI_WARMUP_VALUE], String(warmupTemp), 1);
             } else {
-                tft.fillRoundRect(220, 2, 32, 12, RectRadius, YELLOW);  // X,Y, W,H, Color
+                fillField(ui[UI_WARMUP_VALUE], YELLOW);
                 tft.setTextColor(RED);
-                tft.drawString(String(warmupTemp), 228, 4, 1);
+                drawFieldText(ui[UI_WARMUP_VALUE], String(warmupTemp), 1);
                 editMode = false;
             }
             break;
 
         case 9:  //--Warmup button
-            freeWarmUpButtonSelected = !freeWarmUpButtonSelected;
-
-            if (freeWarmUpButtonSelected == true) {
-                reflow = false;
-                // clean the curve area
-                drawFreeCurve();
-
-                tft.fillRoundRect(260, 0, 60, 15, RectRadius, DGREEN);  // X,Y, W,H, Color
-                tft.setTextColor(WHITE);
-                tft.drawString("STOP", 265, 0, 2);
-                enableWarmup = true;
-                heatingEnabled = true;   // start heating
-                elapsedHeatingTime = 0;  // set the elapsed time to 0
+            if (!freeWarmUpButtonSelected) {
+                startWarmup();
             } else {
-                // First draw all the buttons (the easy way out)
-                drawActionButtons();
-                // Then update the warmup field so it's still marked as selected so we know where we are
-                tft.fillRoundRect(260, 0, 60, 15, RectRadius, YELLOW);
-                tft.setTextColor(WHITE);
-                tft.drawString("WARMUP", 265, 0, 2);
-                enableWarmup = false;
-                analogWrite(SSR_pin, OFF);  // turn the heater off
-                //---------------------------
-                // Put back all the values after stop
-                reflow = false;                    // Reset reflow status flag to false (so free heating can run)
-                redrawCurve = true;                // simply redraw the whole graph
-                heatingEnabled = false;            // stop heating
-                tft.fillCircle(237, 7, 6, BLACK);  // remove the SSR on/off signal
-                drawReflowCurve();                 // redraw the curve with the values
-                // Reapply the highlight to the selected field
-                menuChanged = true;  // Ensure menuChanged is set to true
-                updateHighlighting();
+                stopWarmup();
             }
             break;
 
         case 10:  //--Start/Stop reflow
-            startStopButtonSelected = !startStopButtonSelected;
-
-            if (startStopButtonSelected == true) {
-                editMode = true;
-                // Remove all the numbers -> It makes the display cleaner, easier to read
-                removeFieldsFromDisplay();
-                drawCurve();  // redraw the curve
-
-                // Update the Reflow button to a green background and label it stop
-                tft.fillRoundRect(260, 20, 60, 15, RectRadius, GREEN);  // X,Y, W,H, Color
-                tft.setTextColor(RED);
-                tft.drawString("STOP", 265, 20, 2);
-
-                currentPhase = PREHEAT;  // Set the current phase to preheat (in case we do a second reflow round)
-                reflow = true;           // Enable reflow
-                heatingEnabled = true;   // start heating
-                elapsedHeatingTime = 0;  // set the elapsed time to 0
+            if (!startStopButtonSelected) {
+                startReflowRun();
             } else {
-                // First, update all the buttons (easy way out)
-                drawActionButtons();
-                // update the reflow field so it's still marked as selected so we know where we are
-                tft.fillRoundRect(260, 20, 60, 15, RectRadius, YELLOW);  // still highlighted
-                tft.setTextColor(WHITE);
-                tft.drawString("REFLOW", 265, 20, 2);
-                analogWrite(SSR_pin, OFF);  // turn the heater off
-                //---------------------------
-                // Put back all the values after stop
-                reflow = false;              // Reset reflow status flag to false (so free heating can run)
-                redrawCurve = true;          // simply redraw the whole graph
-                heatingEnabled = false;      // stop heating
-                digitalWrite(Fan_pin, LOW);  // turn the cooling fan off, the user can select the free cooling mode if desired
-                // ending edit mode
-                editMode = false;
-                drawReflowCurve();               // redraw the curve with the values
-                updateStatus(BLACK, BLACK, "");  // erase the status field
-                // Reapply the highlight to the selected field
-                menuChanged = true;  // Ensure menuChanged is set to true
-                updateHighlighting();
+                stopReflowRun();
             }
             break;
 
@@ -1187,13 +1699,13 @@ void processRotaryButton() {
 
             if (freeHeatingTargetSelected == true) {
                 editMode = true;
-                tft.fillRoundRect(220, 42, 32, 12, RectRadius, GREEN);  // X,Y, W,H, Color
+                fillField(ui[UI_HEATING_VALUE], GREEN);
                 tft.setTextColor(RED);
-                tft.drawString(String(freeHeatingTemp), 228, 44, 1);
+                drawFieldText(ui[UI_HEATING_VALUE], String(freeHeatingTemp), 1);
             } else {
-                tft.fillRoundRect(220, 42, 32, 12, RectRadius, YELLOW);  // X,Y, W,H, Color
+                fillField(ui[UI_HEATING_VALUE], YELLOW);
                 tft.setTextColor(RED);
-                tft.drawString(String(freeHeatingTemp), 228, 44, 1);
+                drawFieldText(ui[UI_HEATING_VALUE], String(freeHeatingTemp), 1);
                 editMode = false;
             }
             break;
@@ -1202,29 +1714,28 @@ void processRotaryButton() {
             freeHeatingOnOffSelected = !freeHeatingOnOffSelected;
 
             if (freeHeatingOnOffSelected == true) {
-                reflow = false;
                 // clean the curve area
                 drawFreeCurve();
 
-                tft.fillRoundRect(260, 40, 60, 15, RectRadius, RED);  // X,Y, W,H, Color
+                fillField(ui[UI_HEATING_BUTTON], RED);
                 tft.setTextColor(WHITE);
-                tft.drawString("STOP", 265, 40, 2);
-                enableFreeHeating = true;
+                drawFieldText(ui[UI_HEATING_BUTTON], "STOP", 2);
+                heatingControl = freeHeatingControl(freeHeatingTemp);
+                startTask(freeHeatingRun);
                 heatingEnabled = true;   // start heating
                 elapsedHeatingTime = 0;  // set the elapsed time to 0
             } else {
                 // First draw all the buttons (easy way out)
                 drawActionButtons();
                 // update the heating field so it's still marked as selected so we know where we are
-                tft.fillRoundRect(260, 40, 60, 15, RectRadius, YELLOW);  // still highlighted
+                fillField(ui[UI_HEATING_BUTTON], YELLOW);  // still highlighted
                 tft.setTextColor(WHITE);
-                tft.drawString("HEATING", 265, 40, 2);
-                enableFreeHeating = false;
+                drawFieldText(ui[UI_HEATING_BUTTON], "HEATING", 2);
+                stopTask(freeHeatingRun);
                 freeHeatingOnOffSelected = false;
                 //---------------------------
                 // Put back all the values after stop
-                analogWrite(SSR_pin, OFF);  // turn the heater off
-                reflow = false;             // Reset reflow status flag to false (so free heating can run)
+                heaterOff();  // turn the heater off
                 redrawCurve = true;         // simply redraw the whole graph
                 heatingEnabled = false;     // stop heating
                 drawReflowCurve();          // redraw the curve with the values
@@ -1240,14 +1751,14 @@ void processRotaryButton() {
 
             if (freeCoolingTargetSelected == true) {
                 editMode = true;
-                tft.fillRoundRect(220, 62, 32, 12, RectRadius, GREEN);  // X,Y, W,H, Color
+                fillField(ui[UI_COOLING_VALUE], GREEN);
                 tft.setTextColor(BLUE);
-                tft.drawString(String(freeCoolingTemp), 228, 64, 1);
+                drawFieldText(ui[UI_COOLING_VALUE], String(freeCoolingTemp), 1);
             } else {
                 // ending edit mode
-                tft.fillRoundRect(220, 62, 32, 12, RectRadius, YELLOW);  // X,Y, W,H, Color
+                fillField(ui[UI_COOLING_VALUE], YELLOW);
                 tft.setTextColor(BLUE);
-                tft.drawString(String(freeCoolingTemp), 228, 64, 1);
+                drawFieldText(ui[UI_COOLING_VALUE], String(freeCoolingTemp), 1);
                 editMode = false;
             }
             break;
@@ -1256,32 +1767,30 @@ void processRotaryButton() {
             freeCoolingOnOffSelected = !freeCoolingOnOffSelected;
 
             if (freeCoolingOnOffSelected == true) {
-                reflow = false;
                 // clean the curve area
                 drawFreeCurve();
 
-                tft.fillRoundRect(260, 60, 60, 15, RectRadius, BLUE);  // X,Y, W,H, Color
+                fillField(ui[UI_COOLING_BUTTON], BLUE);
                 tft.setTextColor(WHITE);
-                tft.drawString("STOP", 265, 60, 2);
-                enableFreeCooling = true;
+                drawFieldText(ui[UI_COOLING_BUTTON], "STOP", 2);
+                startTask(freeCoolingRun);
                 elapsedHeatingTime = 0;     // set the elapsed time to 0
-                analogWrite(SSR_pin, OFF);  // just in case it's still on when we select freecooling after freeheating
+                heaterOff();  // just in case it's still on when we select freecooling after freeheating
             } else {
                 // First draw all the buttons (easy way out)
                 drawActionButtons();
                 // Then update the cooling field so it's still marked as selected so we know where we are
-                tft.fillRoundRect(260, 60, 60, 15, RectRadius, YELLOW);
+                fillField(ui[UI_COOLING_BUTTON], YELLOW);
                 tft.setTextColor(WHITE);
-                tft.drawString("COOLING", 265, 60, 2);
-                enableFreeCooling = false;
+                drawFieldText(ui[UI_COOLING_BUTTON], "COOLING", 2);
+                stopTask(freeCoolingRun);
                 freeCoolingOnOffSelected = false;
                 heatingEnabled = false;  // stop heating if still on
                 //---------------------------
                 // Put back all the values after stop
-                reflow = false;              // Reset reflow status flag to false (so free heating can run)
                 redrawCurve = true;          // simply redraw the whole graph
                 heatingEnabled = false;      // stop heating
-                digitalWrite(Fan_pin, LOW);  // Turn off the fan(s)
+                setFan(false);  // Turn off the fan(s)
                 Fan = "OFF";                 // Update the status field
                 coolingFanEnabled = false;   // stop cooling fan.
                 drawReflowCurve();           // redraw the curve with the values
@@ -1297,45 +1806,182 @@ void processRotaryButton() {
             if (solderpasteFieldSelected == true) {
                 editMode = true;
                 // highlighting the edit mode
-                tft.fillRoundRect(48, 0, 150, 18, RectRadius, GREEN);  // X,Y, W,H, Color
+                fillField(ui[UI_PASTE_NAME], GREEN);
                 tft.setTextColor(RED);
                 // Fetch the paste name from the array using solderPasteSelected
                 pasteName = solderpastes[solderPasteSelected].pasteName;
-                tft.drawString(pasteName, pasteNamePosX, pasteNamePosY, 2);
+                drawFieldText(ui[UI_PASTE_NAME], pasteName, 2);
+                // show the list of pastes on top of the chart
+                openPasteList();
             } else {
-                if (prev_solderPasteSelected != solderPasteSelected)  // only redraw when there is a change
+                // the list covers the chart, so it always has to be redrawn
+                closePasteList();
+                redrawCurve = true;
+                if (prev_solderPasteSelected != solderPasteSelected)  // only change the values when there is a change
                 {
-                    redrawCurve = true;
-                    // Fetch the values from the array using solderPasteSelected
-                    // and transpose the values to make them active
-                    preheatTemp = solderpastes[solderPasteSelected].preheatTemp;
-                    preheatTime = solderpastes[solderPasteSelected].preheatTime;
-                    soakingTemp = solderpastes[solderPasteSelected].soakingTemp;
-                    soakingTime = solderpastes[solderPasteSelected].soakingTime;
-                    reflowTemp = solderpastes[solderPasteSelected].reflowTemp;
-                    reflowTime = solderpastes[solderPasteSelected].reflowTime;
-                    coolingTemp = solderpastes[solderPasteSelected].coolingTemp;
-                    coolingTime = solderpastes[solderPasteSelected].coolingTime;
-
-                    drawReflowCurve();
-                    prev_solderPasteSelected = solderPasteSelected;
-
-                    // forward prediction for the heating cut-off in the preheat and reflow phases
-                    preheatCutOff = preheatTime - preheatCutOffTime;  // cut off the heater 10 seconds before the target temperature
-                    reflowCutOff = reflowTime - reflowCutOffTime;     // cut off the heater 10 seconds before the target temperature
+                    selectSolderPaste(solderPasteSelected);
                 }
+                pasteName = solderpastes[solderPasteSelected].pasteName;
+                drawReflowCurve();
                 // ending edit mode
-                tft.fillRoundRect(48, 0, 150, 18, RectRadius, YELLOW);  // X,Y, W,H, Color
+                fillField(ui[UI_PASTE_NAME], YELLOW);
                 tft.setTextColor(RED);
                 pasteName = solderpastes[solderPasteSelected].pasteName;
-                tft.drawString(pasteName, pasteNamePosX, pasteNamePosY, 2);
+                drawFieldText(ui[UI_PASTE_NAME], pasteName, 2);
                 editMode = false;
             }
             break;
+
+        case 16:  //-- Start/stop the noise analysis
+            noiseButtonSelected = !noiseButtonSelected;
+
+            if (noiseButtonSelected == true) {
+                // clean the curve area
+                drawFreeCurve();
+
+                fillField(ui[UI_NOISE_BUTTON], MAGENTA);
+                tft.setTextColor(WHITE);
+                drawFieldText(ui[UI_NOISE_BUTTON], "STOP", 2);
+                updateStatus(DGREEN, WHITE, "Noise");
+
+                // record without the notch, otherwise we would measure the filter
+                notchEnabled = false;
+                noiseCount = 0;
+                noiseFlagged = 0;
+                enableNoiseAnalysis = true;
+                startTask(noiseRun);
+                // switch the heater the same way as during the regulation, as long as the plate is not hot
+                Output = (TCCelsius < 100) ? noiseTestPower : 0;
+                setHeater(Output);
+            } else {
+                // First draw all the buttons (easy way out)
+                drawActionButtons();
+                // Then update the noise field so it's still marked as selected so we know where we are
+                fillField(ui[UI_NOISE_BUTTON], YELLOW);
+                tft.setTextColor(WHITE);
+                drawFieldText(ui[UI_NOISE_BUTTON], "NOISE", 2);
+                enableNoiseAnalysis = false;
+                stopTask(noiseRun);
+                Output = 0;
+                heaterOff();  // turn the heater off
+                //---------------------------
+                // Put back all the values after stop
+                redrawCurve = true;
+                drawReflowCurve();
+                updateStatus(BLACK, BLACK, "");  // erase the status field
+                menuChanged = true;
+                updateHighlighting();
+            }
+            break;
     }
     menuChanged = false;
 }
 
+// the warmup mode, started and stopped with its button or by an automatic run
+void startWarmup() {
+    freeWarmUpButtonSelected = true;
+    // clean the curve area
+    drawFreeCurve();
+
+    fillField(ui[UI_WARMUP_BUTTON], DGREEN);
+    tft.setTextColor(WHITE);
+    drawFieldText(ui[UI_WARMUP_BUTTON], "STOP", 2);
+    heatingControl = warmupControl(warmupTemp);
+    startTask(warmupRun);
+    heatingEnabled = true;   // start heating
+    elapsedHeatingTime = 0;  // set the elapsed time to 0
+}
+
+void stopWarmup() {
+    freeWarmUpButtonSelected = false;
+    // First draw all the buttons (the easy way out)
+    drawActionButtons();
+    // Then update the warmup field so it's still marked as selected so we know where we are
+    fillField(ui[UI_WARMUP_BUTTON], YELLOW);
+    tft.setTextColor(WHITE);
+    drawFieldText(ui[UI_WARMUP_BUTTON], "WARMUP", 2);
+    stopTask(warmupRun);
+    heaterOff();  // turn the heater off
+    //---------------------------
+    // Put back all the values after stop
+    redrawCurve = true;                // simply redraw the whole graph
+    heatingEnabled = false;            // stop heating
+    tft.fillCircle(ui[UI_WARMUP_VALUE].x + 17, ui[UI_WARMUP_VALUE].y + 5, 6, BLACK);  // remove the SSR on/off signal
+    drawReflowCurve();                 // redraw the curve with the values
+    // Reapply the highlight to the selected field
+    menuChanged = true;  // Ensure menuChanged is set to true
+    updateHighlighting();
+}
+
+// the reflow run, started and stopped with its button or by an automatic run
+void startReflowRun() {
+    startStopButtonSelected = true;
+    editMode = true;
+    // Remove all the numbers -> It makes the display cleaner, easier to read
+    removeFieldsFromDisplay();
+    drawCurve();  // redraw the curve
+
+    // Update the Reflow button to a green background and label it stop
+    fillField(ui[UI_REFLOW_BUTTON], GREEN);
+    tft.setTextColor(RED);
+    drawFieldText(ui[UI_REFLOW_BUTTON], "STOP", 2);
+
+    characterizing = probeConnected();  // with a thermocouple on the board, this is a characterization run
+    probeCount = 0;
+    startReflowControl();    // start in the preheat phase with the current profile
+    startProgress();         // the empty progress bar
+    heatingEnabled = true;   // start heating
+    elapsedHeatingTime = 0;  // set the elapsed time to 0
+    startRunLog();           // open a new run log
+    startTask(reflowRun);    // and go
+}
+
+void stopReflowRun() {
+    startStopButtonSelected = false;
+    // First, update all the buttons (easy way out)
+    drawActionButtons();
+    // update the reflow field so it's still marked as selected so we know where we are
+    fillField(ui[UI_REFLOW_BUTTON], YELLOW);  // still highlighted
+    tft.setTextColor(WHITE);
+    drawFieldText(ui[UI_REFLOW_BUTTON], "REFLOW", 2);
+    heaterOff();  // turn the heater off
+    //---------------------------
+    // Put back all the values after stop
+    stopTask(reflowRun);
+    redrawCurve = true;          // simply redraw the whole graph
+    heatingEnabled = false;      // stop heating
+    setFan(false);  // turn the cooling fan off, the user can select the free cooling mode if desired
+    endRunLog();                 // write the last samples and close the run log
+    finishCharacterization();    // fit the board model when there is enough data
+    reportReflowTiming();        // planned vs actual duration of the phases
+    // ending edit mode
+    editMode = false;
+    drawReflowCurve();               // redraw the curve with the values
+    updateStatus(BLACK, BLACK, "");  // erase the status field
+    // Reapply the highlight to the selected field
+    menuChanged = true;  // Ensure menuChanged is set to true
+    updateHighlighting();
+}
+
+// make a paste of the table the profile: the values and the board model of the product
+void selectSolderPaste(int index) {
+    const solderpaste& paste = solderpastes[index];
+    solderPasteSelected = index;
+    pasteName = paste.pasteName;
+    preheatTemp = paste.preheatTemp;
+    preheatTime = paste.preheatTime;
+    soakingTemp = paste.soakingTemp;
+    soakingTime = paste.soakingTime;
+    reflowTemp = paste.reflowTemp;
+    reflowTime = paste.reflowTime;
+    coolingTemp = paste.coolingTemp;
+    coolingTime = paste.coolingTime;
+    rampRateLimit = paste.rampRateLimit;
+    cascadeEnabled = paste.cascadeControl;
+    loadBoardModel();  // use the board model of this product, if it was characterized
+    prev_solderPasteSelected = index;
+}
+
 /*
   updateHighlighting
 
@@ -1443,84 +2089,92 @@ void updateHighlighting() {
 
             case 8:  // warmup temp
                 if (editMode) {
-                    tft.fillRoundRect(220, 2, 32, 12, RectRadius, GREEN);  // X,Y, W,H, Color
+                    fillField(ui[UI_WARMUP_VALUE], GREEN);
                 } else {
-                    tft.fillRoundRect(220, 2, 32, 12, RectRadius, YELLOW);  // X,Y, W,H, Color
+                    fillField(ui[UI_WARMUP_VALUE], YELLOW);
                 }
                 tft.setTextColor(BLUE);
-                tft.drawString(String(warmupTemp), 228, 4, 1);
+                drawFieldText(ui[UI_WARMUP_VALUE], String(warmupTemp), 1);
                 break;
 
             case 9:  // Warmup on/off
                 if (editMode) {
-                    tft.fillRoundRect(260, 0, 60, 15, RectRadius, GREEN);  // X,Y, W,H, Color
+                    fillField(ui[UI_WARMUP_BUTTON], GREEN);
                 } else {
-                    tft.fillRoundRect(260, 0, 60, 15, RectRadius, YELLOW);  // X,Y, W,H, Color
+                    fillField(ui[UI_WARMUP_BUTTON], YELLOW);
                 }
                 tft.setTextColor(BLACK);
-                tft.drawString("WARMUP", 265, 0, 2);
+                drawFieldText(ui[UI_WARMUP_BUTTON], "WARMUP", 2);
                 break;
 
             case 10:  // Reflow start/stop
                 if (editMode) {
-                    tft.fillRoundRect(260, 20, 60, 15, RectRadius, GREEN);  // X,Y, W,H, Color
+                    fillField(ui[UI_REFLOW_BUTTON], GREEN);
                 } else {
-                    tft.fillRoundRect(260, 20, 60, 15, RectRadius, YELLOW);  // X,Y, W,H, Color
+                    fillField(ui[UI_REFLOW_BUTTON], YELLOW);
                 }
                 tft.setTextColor(BLACK);
-                tft.drawString("REFLOW", 265, 20, 2);
+                drawFieldText(ui[UI_REFLOW_BUTTON], "REFLOW", 2);
                 break;
 
             case 11:  // free heating target temp
                 if (editMode) {
-                    tft.fillRoundRect(220, 42, 32, 12, RectRadius, GREEN);  // X,Y, W,H, Color
+                    fillField(ui[UI_HEATING_VALUE], GREEN);
                 } else {
-                    tft.fillRoundRect(220, 42, 32, 12, RectRadius, YELLOW);  // X,Y, W,H, Color
+                    fillField(ui[UI_HEATING_VALUE], YELLOW);
                 }
                 tft.setTextColor(RED);
-                tft.drawString(String(freeHeatingTemp), 228, 44, 1);
+                drawFieldText(ui[UI_HEATING_VALUE], String(freeHeatingTemp), 1);
                 break;
 
             case 12:  // Free heating on/off
                 if (editMode) {
-                    tft.fillRoundRect(260, 40, 60, 15, RectRadius, GREEN);  // X,Y, W,H, Color
+                    fillField(ui[UI_HEATING_BUTTON], GREEN);
                 } else {
-                    tft.fillRoundRect(260, 40, 60, 15, RectRadius, YELLOW);  // X,Y, W,H, Color
+                    fillField(ui[UI_HEATING_BUTTON], YELLOW);
                 }
                 tft.setTextColor(BLACK);
-                tft.drawString("HEATING", 265, 40, 2);
+                drawFieldText(ui[UI_HEATING_BUTTON], "HEATING", 2);
                 break;
 
             case 13:  // free cooling temp
                 if (editMode) {
-                    tft.fillRoundRect(220, 62, 32, 12, RectRadius, GREEN);  // X,Y, W,H, Color
+                    fillField(ui[UI_COOLING_VALUE], GREEN);
                 } else {
-                    tft.fillRoundRect(220, 62, 32, 12, RectRadius, YELLOW);  // X,Y, W,H, Color
+                    fillField(ui[UI_COOLING_VALUE], YELLOW);
                 }
                 tft.setTextColor(BLUE);
-                tft.drawString(String(freeCoolingTemp), 228, 64, 1);
+                drawFieldText(ui[UI_COOLING_VALUE], String(freeCoolingTemp), 1);
                 break;
 
             case 14:  // Free cooling selected on/off
                 if (editMode) {
-                    tft.fillRoundRect(260, 60, 60, 15, RectRadius, GREEN);  // X,Y, W,H, Color
+                    fillField(ui[UI_COOLING_BUTTON], GREEN);
                 } else {
-                    tft.fillRoundRect(260, 60, 60, 15, RectRadius, YELLOW);  // X,Y, W,H, Color
+                    fillField(ui[UI_COOLING_BUTTON], YELLOW);
                 }
                 tft.setTextColor(BLACK);
-                tft.drawString("COOLING", 265, 60, 2);
+                drawFieldText(ui[UI_COOLING_BUTTON], "COOLING", 2);
 
                 break;
 
             case 15:  // solderpast field
                 if (editMode) {
-                    tft.fillRoundRect(48, 0, 150, 18, RectRadius, GREEN);  // X,Y, W,H, Color
+                    fillField(ui[UI_PASTE_NAME], GREEN);
                 } else {
-                    tft.fillRoundRect(48, 0, 150, 18, RectRadius, YELLOW);  // X,Y, W,H, Color
+                    fillField(ui[UI_PASTE_NAME], YELLOW);
                 }
                 tft.setTextColor(RED);
                 pasteName = solderpastes[solderPasteSelected].pasteName;
-                tft.drawString(pasteName, pasteNamePosX, pasteNamePosY, 2);
+                drawFieldText(ui[UI_PASTE_NAME], pasteName, 2);
+                // follow the encoder in the list
+                if (pasteListShown >= 0) updatePasteList();
+                break;
+
+            case 16:  // noise analysis on/off
+                fillField(ui[UI_NOISE_BUTTON], YELLOW);
+                tft.setTextColor(BLACK);
+                drawFieldText(ui[UI_NOISE_BUTTON], "NOISE", 2);
                 break;
         }
         //--------------------------------------------------------------------------------------------
@@ -1584,46 +2238,53 @@ void updateHighlighting() {
                 tft.print(coolingTime);
                 tft.print("s");
                 break;
-            case 8:                                                    // warmup temp
-                tft.fillRoundRect(220, 2, 32, 12, RectRadius, BLACK);  // X,Y, W,H, Color
+            case 8:  // warmup temp
+                fillField(ui[UI_WARMUP_VALUE], BLACK);
                 tft.setTextColor(RED);
-                tft.drawString(String(warmupTemp) + "C", 228, 4, 1);
+                drawFieldText(ui[UI_WARMUP_VALUE], String(warmupTemp) + "C", 1);
                 break;
-            case 9:                                                     // warmup on/off
-                tft.fillRoundRect(260, 0, 60, 15, RectRadius, DGREEN);  // X,Y, W,H, Color
+            case 9:  // warmup on/off
+                fillField(ui[UI_WARMUP_BUTTON], DGREEN);
                 tft.setTextColor(WHITE);
-                tft.drawString("WARMUP", 265, 0, 2);
+                drawFieldText(ui[UI_WARMUP_BUTTON], "WARMUP", 2);
                 break;
-            case 10:                                                     // Reflow start/stop
-                tft.fillRoundRect(260, 20, 60, 15, RectRadius, ORANGE);  // X,Y, W,H, Color
+            case 10:  // Reflow start/stop
+                fillField(ui[UI_REFLOW_BUTTON], ORANGE);
                 tft.setTextColor(WHITE);
-                tft.drawString("REFLOW", 265, 20, 2);
+                drawFieldText(ui[UI_REFLOW_BUTTON], "REFLOW", 2);
                 break;
-            case 11:                                                    // free heating target temp
-                tft.fillRoundRect(220, 42, 32, 12, RectRadius, BLACK);  // X,Y, W,H, Color
+            case 11:  // free heating target temp
+                fillField(ui[UI_HEATING_VALUE], BLACK);
                 tft.setTextColor(RED);
-                tft.drawString(String(freeHeatingTemp) + "C", 228, 44, 1);
+                drawFieldText(ui[UI_HEATING_VALUE], String(freeHeatingTemp) + "C", 1);
                 break;
-            case 12:                                                  // free heating on/off
-                tft.fillRoundRect(260, 40, 60, 15, RectRadius, RED);  // X,Y, W,H, Color
+            case 12:  // free heating on/off
+                fillField(ui[UI_HEATING_BUTTON], RED);
                 tft.setTextColor(WHITE);
-                tft.drawString("HEATING", 265, 40, 2);
+                drawFieldText(ui[UI_HEATING_BUTTON], "HEATING", 2);
                 break;
-            case 13:                                                    // free cooling temp
-                tft.fillRoundRect(220, 62, 32, 12, RectRadius, BLACK);  // X,Y, W,H, Color
+            case 13:  // free cooling temp
+                fillField(ui[UI_COOLING_VALUE], BLACK);
                 tft.setTextColor(BLUE);
-                tft.drawString(String(freeCoolingTemp) + "C", 228, 64, 1);
+                drawFieldText(ui[UI_COOLING_VALUE], String(freeCoolingTemp) + "C", 1);
                 break;
-            case 14:                                                   // free cooling on/off
-                tft.fillRoundRect(260, 60, 60, 15, RectRadius, BLUE);  // X,Y, W,H, Color
+            case 14:  // free cooling on/off
+                fillField(ui[UI_COOLING_BUTTON], BLUE);
                 tft.setTextColor(WHITE);
-                tft.drawString("COOLING", 265, 60, 2);
+                drawFieldText(ui[UI_COOLING_BUTTON], "COOLING", 2);
                 break;
-            case 15:                                                   // solderpaste field
-                tft.fillRoundRect(46, 0, 152, 20, RectRadius, BLACK);  // erase the previous
+            case 15:  // solderpaste field
+                // erase the previous, a little larger than the field
+                tft.fillRoundRect(ui[UI_PASTE_NAME].x - 2, ui[UI_PASTE_NAME].y, ui[UI_PASTE_NAME].w + 2, ui[UI_PASTE_NAME].h + 2,
+                                  RectRadius, BLACK);
                 tft.setTextColor(WHITE);
                 pasteName = solderpastes[solderPasteSelected].pasteName;
-                tft.drawString(pasteName, pasteNamePosX, pasteNamePosY, 2);
+                drawFieldText(ui[UI_PASTE_NAME], pasteName, 2);
+                break;
+            case 16:  // noise analysis on/off
+                fillField(ui[UI_NOISE_BUTTON], MAGENTA);
+                tft.setTextColor(WHITE);
+                drawFieldText(ui[UI_NOISE_BUTTON], "NOISE", 2);
                 break;
         }
         menuChanged = false;
@@ -1656,406 +2317,433 @@ There are "early" calculations to prevent the temperature from overshooting the
 */
 
 void runReflow() {
-    if (reflow == true)  // Only proceed if the reflow was enabled by the press of the start button.
-    {
-        if (elapsedHeatingTime < 340)  // continue to run until the end of the time scale or when user stopped it
-        {
-            unsigned long timeNow = millis();
+    // *** Simulate the temperature value in TCCelsius
+    // TCCelsius = targetTemp; // To simulate, link the calculated temperature to the target temperature
+
+    // Calculate the x-y coordinate of a pixel to show the temperature measurement over time
+    measuredTemp_px = (int)((yGraph) - ((TCCelsius / tempPixelFactor)));
+    measuredTime_px = (int)(xGraph + (elapsedHeatingTime / timePixelFactor));
+
+    // Draw the pixel (time vs. temperature) on the graph
+    tft.drawPixel(measuredTime_px, measuredTemp_px, CYAN);
+    // you can draw a thicker line by activating the next statement
+    // by putting another pixel next (on Y) the original, to fake "a thicker line"
+    // tft.drawPixel(measuredTime_px, measuredTemp_px + 1, CYAN);
+
+    printElapsedTime();  // Print the elapsed time in seconds
+
+    // run the controller: it calculates the target temperature from the reflow profile, based on the
+    // elapsed time, and thus trying to follow the reflow curve in real-time, sets the heater power and
+    // determines if we can switch to the next phase
+    ReflowPhase phase = reflowControl.phase;  // the phase of this step, the controller may move on to the next one
+    checkRunAnomaly();  // the reading against the plate model, with the power and the fans of the last step
+    if (runAborted) return;  // reflowTask() goes on with the cooling
+    if (cascadeRunning && (probeCelsius < 0 || probeCelsius > 400)) {
+        // the probe fell off the board or the thermocouple is open: continue on the plate temperature
+        LOG("Cascade: board probe lost, back to the plate controller");
+        cascadeRunning = false;
+    }
+    if (cascadeRunning) {
+        // the inner loop runs every step, the outer loop on the board probe every cascade.outerInterval
+        reflowCascadeStep(reflowControl, cascade, elapsedHeatingTime, SSRInterval / 1000.0, TCCelsius, probeCelsius);
+        phase = reflowControl.phase;  // the phases follow the time of the profile
+    } else if (policyRunning) {
+        // a couple of table lookups on the plate temperature and the filtered dT/dt
+        reflowPolicyStep(reflowControl, policyTable, elapsedHeatingTime, TCCelsius, TCRate);
+        phase = reflowControl.phase;
+    } else {
+        reflowStep(reflowControl, elapsedHeatingTime, TCCelsius);
+    }
+    targetTemp = reflowControl.target;
+    Output = reflowControl.output;
+    setHeater(Output);
 
-            if (timeNow - SSRTimer > SSRInterval)  // Update frequency = 250 ms - should be less frequent than the temperature readings
-            {
-                // *** Simulate the temperature value in TCCelsius
-                // TCCelsius = targetTemp; // To simulate, link the calculated temperature to the target temperature
+    switch (phase)  // show the progress along the reflow curve
+    {
+        case PREHEAT:
+            updateStatus(runStatusColor(), WHITE, "Preheat");
+            printTargetTemperature();
+            break;
 
-                // Calculate the x-y coordinate of a pixel to show the temperature measurement over time
-                measuredTemp_px = (int)((yGraph) - ((TCCelsius / tempPixelFactor)));
-                measuredTime_px = (int)(xGraph + (elapsedHeatingTime / timePixelFactor));
+        case SOAK:
+            updateStatus(runStatusColor(), WHITE, "Soaking");
+            printTargetTemperature();
+            break;
 
-                // Draw the pixel (time vs. temperature) on the graph
-                tft.drawPixel(measuredTime_px, measuredTemp_px, CYAN);
-                // you can draw a thicker line by activating the next statement
-                // by putting another pixel next (on Y) the original, to fake "a thicker line"
-                // tft.drawPixel(measuredTime_px, measuredTemp_px + 1, CYAN);
+        case REFLOW:
+            updateStatus(runStatusColor(), WHITE, "Reflow");
+            printTargetTemperature();
+            break;
 
-                printElapsedTime();  // Print the elapsed time in seconds
+        case HOLD:
+            updateStatus(runStatusColor(), WHITE, "Holding");
+            printTargetTemperature();
+            break;
 
-                switch (currentPhase)  // This part determines the code's progress along the reflow curve
-                {
-                    case PREHEAT:
-                        // calculate the desired temperature from the reflow profile, based on the elapsed time,
-                        // and thus trying to follow the reflow curve in real-time
-                        targetTemp = 20 + (elapsedHeatingTime * (1.0 / preheatTime) * (preheatTemp - 20));
-
-                        // show the phase on the display
-                        updateStatus(DGREEN, WHITE, "Preheat");
-                        // print the target temperature on the display
-                        printTargetTemperature();
-
-                        // Do some kind of early turn-off to avoid temperature overshooting
-                        // if we are almost there and close to the targetTemp, we can stop heating
-                        // We start to see if we can stop heating a little while before we reach the end of the time,
-                        // and check to see if we are within a certain range of the target temperature.
-                        // We should be above the target temperature and not too far below it.
-                        // Note that the target temperature changes every cycle, so we have to check it every loop.
-                        if ((elapsedHeatingTime >= preheatCutOff) && (TCCelsius >= targetTemp - 15) || (TCCelsius >= targetTemp)) {
-                            Output = 0;
-                        } else {
-                            Output = 255;
-                        }
-                        analogWrite(SSR_pin, Output);
-
-                        // determine if we can switch to the next phase
-                        if (TCCelsius > preheatTemp && elapsedHeatingTime > preheatTime) {
-                            currentPhase = SOAK;
-                        }
-                        break;
-
-                    case SOAK:
-                        // calculate the desired temperature from the reflow profile, based on the elapsed time and the temp from the profile
-                        targetTemp = preheatTemp + ((elapsedHeatingTime - preheatTime) / (soakingTime - preheatTime)) * (soakingTemp - preheatTemp);
-                        printTargetTemperature();
-                        updateStatus(DGREEN, WHITE, "Soaking");
-                        if (TCCelsius < targetTemp) {
-                            Output = 150;  // reduce the power
-                        } else {
-                            Output = 0;
-                        }
-                        analogWrite(SSR_pin, Output);
-
-                        if (TCCelsius > soakingTemp && elapsedHeatingTime > soakingTime) {
-                            currentPhase = REFLOW;
-                        }
-                        break;
-
-                    case REFLOW:
-                        // calculate the desired temperature from the reflow profile, based on the elapsed time and the temp from the profile
-                        targetTemp = soakingTemp + ((elapsedHeatingTime - soakingTime) / (reflowTime - soakingTime)) * (reflowTemp - soakingTemp);
-                        printTargetTemperature();
-                        updateStatus(DGREEN, WHITE, "Reflow");
-
-                        // if we are almost there and above the targetTemp, we can stop heating to avoid overshooting
-                        if ((elapsedHeatingTime >= reflowCutOff) && (TCCelsius >= targetTemp - 15) || (TCCelsius >= targetTemp)) {
-                            Output = 0;
-                        } else {
-                            Output = 255;  // max power
-                        }
-                        analogWrite(SSR_pin, Output);
-
-                        if (TCCelsius > reflowTemp || elapsedHeatingTime > reflowTime)
-                        // when we have reached the reflowTemp or past the time, we can move to the hold phase
-                        {
-                            currentPhase = HOLD;
-                        }
-                        break;
-
-                    case HOLD:
-                        // calculate the desired temperature from the reflow profile, based on the elapsed time and the temp from the profile
-                        targetTemp = reflowTemp + ((elapsedHeatingTime - reflowTime) / (coolingTime - reflowTime)) * (coolingTemp - reflowTemp);
-
-                        printTargetTemperature();
-                        updateStatus(DGREEN, WHITE, "Holding");
-                        if (TCCelsius < targetTemp) {
-                            Output = 50;  // reduce the power to maintain the temperature
-                        } else {
-                            Output = 0;
-                        }
-                        analogWrite(SSR_pin, Output);
-
-                        if (TCCelsius > coolingTemp && elapsedHeatingTime > coolingTime)
-                        // when we have reached the coolingTime limit, we can move to the cooling phase
-
-                        // in case the time runs out and we don't reach the cooling phase, you can use this:
-                        // if (elapsedHeatingTime > coolingTime)
-                        {
-                            currentPhase = COOLING;
-                        }
-                        break;
-
-                    case COOLING:
-                        // turn of the heater, turn on the fans and allow them to cool the plate down to 40 degrees
-                        targetTemp = 40;
-                        Output = 0;
-                        analogWrite(SSR_pin, Output);            // stop heating
-                        updateStatus(DGREEN, WHITE, "Cooling");  // start cooling
-                        heatingEnabled = false;                  // Disable heating
-                        coolingFanEnabled = true;                // Enable cooling
-                        if (TCCelsius > targetTemp) {
-                            digitalWrite(Fan_pin, HIGH);  // Turn on the fan(s)
-                            Fan = "ON";                   // so we can show the status with printFan()
-                        } else {
-                            digitalWrite(Fan_pin, LOW);  // Turn on the fan(s)
-                            Fan = "OFF";
-                        }
-                        break;
-                }
-                if (heatingEnabled == true) {
-                    // show the PWM output on the screen
-                    printPWM();
-                } else {
-                    // show the Fan status on the screen
-                    printFan();
-                }
-                // *** when simulating: set interval to 100.0 (10x faster)
-                elapsedHeatingTime += (SSRInterval / 1000.0);  // SSRInterval is in ms, so it has to be divided by 1000
-                SSRTimer = millis();
+        case COOLING:
+            // the heater is off, the fans cool the plate down to the cooling target
+            updateStatus(runStatusColor(), WHITE, "Cooling");  // start cooling
+            heatingEnabled = false;                  // Disable heating
+            coolingFanEnabled = true;                // Enable cooling
+            if (reflowControl.fan) {
+                setFan(true);  // Turn on the fan(s)
+                Fan = "ON";                   // so we can show the status with printFan()
+            } else {
+                setFan(false);  // Turn off the fan(s)
+                Fan = "OFF";
             }
-        }
+            break;
+    }
+    if (heatingEnabled == true) {
+        // show the PWM output on the screen
+        printPWM();
+    } else {
+        // show the Fan status on the screen
+        printFan();
     }
+    // add the power and dT/dt to the strip charts
+    appendStripCharts();
+    updateProgress();  // the progress bar and the time to the release
+    // and add the sample to the run log
+    appendRunLog();
+    recordProbe();
+    // *** when simulating: set interval to 100.0 (10x faster)
+    elapsedHeatingTime += (SSRInterval / 1000.0);  // SSRInterval is in ms, so it has to be divided by 1000
 }
 
-// run the free heating mode
+// one step of the free heating mode, freeHeatingTask() runs it every 250ms
 void freeHeating() {
-    if (enableFreeHeating == true) {
-        unsigned long timeNow = millis();
-        static bool slowdown = false;
-        static bool rampup = true;
+    // Draw a pixel for the temperature measurement - Calculate the position
+    measuredTemp_px = (int)(yGraph - ((TCCelsius / tempPixelFactor)));  // 220 -> 200 offset is 3
+    measuredTime_px = (int)(xGraph + (elapsedHeatingTime / timePixelFactor));
 
-        if (timeNow - SSRTimer > SSRInterval)  // update frequency = 250 ms - should be less frequent than the temperature readings
-        {
-            // Draw a pixel for the temperature measurement - Calculate the position
-            measuredTemp_px = (int)(yGraph - ((TCCelsius / tempPixelFactor)));  // 220 -> 200 offset is 3
-            measuredTime_px = (int)(xGraph + (elapsedHeatingTime / timePixelFactor));
-
-            printElapsedTime();        // Print the elapsed time in seconds
-            printTargetTemperature();  // Print the actual target temperature
+    printElapsedTime();        // Print the elapsed time in seconds
+    printTargetTemperature();  // Print the actual target temperature
 
-            // Draw the pixel (time vs. temperature) on the chart
-            tft.drawPixel(measuredTime_px, measuredTemp_px, CYAN);
-            tft.drawPixel(measuredTime_px, measuredTemp_px + 1, CYAN);  // putting another pixel next (on Y) the original, "fake a thick line"
+    // Draw the pixel (time vs. temperature) on the chart
+    tft.drawPixel(measuredTime_px, measuredTemp_px, CYAN);
+    tft.drawPixel(measuredTime_px, measuredTemp_px + 1, CYAN);  // putting another pixel next (on Y) the original, "fake a thick line"
 
-            targetTemp = freeHeatingTemp;
+    // ramp up at full power, slow down when we are getting close to the target and
+    // use conservative parameters to regulate the temperature to avoid overshooting
+    targetTemp = freeHeatingTemp;
+    heatingControl.target = freeHeatingTemp;
+    showHeatingStage(heatingStep(heatingControl, TCCelsius));
+    Output = heatingControl.output;
+    setHeater(Output);
 
-            // If we are almost there and just below the targetTemp,
-            // we can use conservative parameters to reduce overshooting
+    // show the PWM output on the screen
+    printPWM();
+    appendStripCharts();
 
-            double gap = abs(targetTemp - TCCelsius);
-
-            // initial rampup
-            if (slowdown == false && rampup == true) {
-                Output = 255;
-                analogWrite(SSR_pin, int(Output));
-                tft.fillRoundRect(130, 80, 80, 20, RectRadius, BLACK);
-                tft.setTextColor(WHITE);
-                tft.drawString("rampup", 132, 80, 1);
-            }
+    updateStatus(DGREEN, WHITE, "Heating");
 
-            // when we are ramping up and close to the target, but still below it, slow down
-            if (gap < 25 && TCCelsius < freeHeatingTemp && rampup == true) {
-                // slow down based on the targetTemp so we will get there
-                if (freeHeatingTemp < 100) {
-                    Output = 10;
-                } else if (freeHeatingTemp < 200) {
-                    Output = 20;
-                } else {
-                    Output = 30;
-                }
+    elapsedHeatingTime += (SSRInterval / 1000.0);  // SSRInterval is in ms, so it has to be divided by 1000
+}
 
-                analogWrite(SSR_pin, Output);  // let it still creep up
-                tft.fillRoundRect(130, 80, 80, 20, RectRadius, BLACK);
-                tft.setTextColor(WHITE);
-                tft.drawString("slow down", 132, 80, 1);
-                slowdown = true;
-            }
+// one step of the free cooling mode, freeCoolingTask() runs it every 250ms
+void freeCooling() {
+    // Calculate the x-y pixel position for the temperature measurement over time
+    measuredTemp_px = (int)(yGraph - ((TCCelsius / tempPixelFactor)));
+    measuredTime_px = (int)(xGraph + (elapsedHeatingTime / timePixelFactor));
 
-            // if we are now above the target, return to normal regulation
-            if (TCCelsius >= freeHeatingTemp && slowdown == true && rampup == true) {
-                // back to normal regulation
-                slowdown = false;
-                rampup = false;
-            }
+    // Draw the pixel (time vs. temperature) on the chart
+    tft.drawPixel(measuredTime_px, measuredTemp_px, BLUE);
+    tft.drawPixel(measuredTime_px, measuredTemp_px + 1, BLUE);
+    // putting another pixel next (on Y) the original, to fake a "thick line"
+    // tft.drawLine(measuredTime_px, measuredTemp_px, measuredTime_px-50, measuredTime_px+50, WHITE);
 
-            // normal regulation
-            if (slowdown == false && rampup == false) {
-                if (TCCelsius < freeHeatingTemp) {
-                    Output = 40;  // curb the power to make the regulation smoother
-                    analogWrite(SSR_pin, int(Output));
-                } else {
-                    Output = 0;
-                    analogWrite(SSR_pin, int(Output));
-                }
-                tft.fillRoundRect(130, 80, 80, 20, RectRadius, BLACK);
-                tft.setTextColor(WHITE);
-                tft.drawString("regulate", 132, 80, 1);
-            }
+    // Also print the elapsed time in second
+    printElapsedTime();
 
-            // show the PWM output on the screen
-            printPWM();
+    targetTemp = freeCoolingTemp;
+    printTargetTemperature();  // Print the target temperature that we calculated above
 
-            updateStatus(DGREEN, WHITE, "Heating");
+    if (TCCelsius > freeCoolingTemp)  // Turn the fans ON or OFF depending on the flag
+    {
+        setFan(true);
+        Fan = "ON";
+    } else {
+        setFan(false);
+        Fan = "OFF";
+    }
 
-            elapsedHeatingTime += (SSRInterval / 1000.0);  // SSRInterval is in ms, so it has to be divided by 1000
+    updateStatus(DGREEN, WHITE, "Cooling");
+    // Print the Fan status on the TFT
+    printFan();
+    appendStripCharts();
 
-            SSRTimer = millis();
-        }
-    }
+    elapsedHeatingTime += (SSRInterval / 1000.0);  // SSRInterval is in ms, so it has to be divided by 1000
 }
 
-// run the free cooling mode
-void freeCooling() {
-    if (enableFreeCooling == true)  // If heating was enabled somewhere in the code, we can enter the code below
-    {
-        unsigned long timeNow = millis();
-
-        if (timeNow - SSRTimer > SSRInterval)  // update frequency = 250 ms - should be less frequent than the temperature readings
-        {
-            // Calculate the x-y pixel position for the temperature measurement over time
-            measuredTemp_px = (int)(yGraph - ((TCCelsius / tempPixelFactor)));
-            measuredTime_px = (int)(xGraph + (elapsedHeatingTime / timePixelFactor));
+// One step of the warmup mode, a more gentile warmup for lower temperatures than free heating.
+// warmupTask() runs it every 250ms
+void runWarmup() {
+    // Calculate the position of the coordinates for the pixel so we can plot it on the chart
+    measuredTemp_px = (int)(yGraph - ((TCCelsius / tempPixelFactor)));         // 220 -> 200 offset is 13
+    measuredTime_px = (int)(xGraph + (elapsedHeatingTime / timePixelFactor));  // 18px from the left
+
+    // Draw the calculated pixel position (time vs. temperature) on the chart
+    tft.drawPixel(measuredTime_px, measuredTemp_px, CYAN);
+    tft.drawPixel(measuredTime_px, measuredTemp_px + 1, CYAN);  // putting another pixel next (on Y) the original, "fake a thick line"
+
+    // Also print the elapsed time in second
+    printElapsedTime();
+    printTargetTemperature();
+
+    // ramp up at half power, then creep up to the target and regulate with a reduced power
+    targetTemp = warmupTemp;
+    heatingControl.target = warmupTemp;
+    showHeatingStage(heatingStep(heatingControl, TCCelsius));
+    Output = heatingControl.output;
+    setHeater(Output);
+
+    // show the PWM output on the screen
+    printPWM();
+    appendStripCharts();
+
+    if (autoRunState == AUTO_COUNTDOWN) {
+        unsigned long left = (autoCountdown - (millis() - autoCountdownStart) + 999) / 1000;
+        updateStatus(ORANGE, BLACK, ("Start " + String(left) + "s").c_str());
+    } else {
+        updateStatus(DGREEN, WHITE, "Warmup");
+    }
 
-            // Draw the pixel (time vs. temperature) on the chart
-            tft.drawPixel(measuredTime_px, measuredTemp_px, BLUE);
-            tft.drawPixel(measuredTime_px, measuredTemp_px + 1, BLUE);
-            // putting another pixel next (on Y) the original, to fake a "thick line"
-            // tft.drawLine(measuredTime_px, measuredTemp_px, measuredTime_px-50, measuredTime_px+50, WHITE);
+    elapsedHeatingTime += (SSRInterval / 1000.0);  // SSRInterval is in ms, so it has to be divided by 1000
+}
 
-            // Also print the elapsed time in second
-            printElapsedTime();
+/*
+  The tasks of the modes (see include/protothread.h).
+  A task is started by the button of the mode and stopped again by the same button, the stop
+  code in processRotaryButton() turns the heater and the fans off. A task only runs when its
+  wait is over, the main loop no longer checks every mode.
+*/
 
-            targetTemp = freeCoolingTemp;
-            printTargetTemperature();  // Print the target temperature that we calculated above
+// the reflow run: a step every 250ms until the end of the time scale, then the run log is closed and the
+// fans cool the plate down until the run is stopped, with the button or by the removal of the board
+bool reflowTask(Task& t) {
+    TASK_BEGIN(t);
+    while (elapsedHeatingTime < 340 && !runAborted) {
+        runReflow();
+        TASK_DELAY(t, SSRInterval);  // Update frequency = 250 ms - should be less frequent than the temperature readings
+    }
+    endRunLog();  // we're at the end of the time scale, the run log is complete
+    finishCharacterization();
+    reportReflowTiming();
+    heaterOff();
+    while (true) {
+        setFan(TCCelsius > reflowControl.coolingTarget);
+        updateStatus(runStatusColor(), WHITE, TCCelsius > autoReleaseTemp ? "Cooling" : "Lift off");
+        printElapsedTime();
+        updateProgress();
+        TASK_DELAY(t, SSRInterval);
+        elapsedHeatingTime += (SSRInterval / 1000.0);
+    }
+    TASK_END(t);
+}
 
-            if (TCCelsius > freeCoolingTemp)  // Turn the fans ON or OFF depending on the flag
-            {
-                digitalWrite(Fan_pin, HIGH);
-            } else {
-                digitalWrite(Fan_pin, LOW);
-            }
+// free heating, warmup and free cooling run until they are stopped
+bool freeHeatingTask(Task& t) {
+    TASK_BEGIN(t);
+    while (true) {
+        freeHeating();
+        TASK_DELAY(t, SSRInterval);
+    }
+    TASK_END(t);
+}
 
-            updateStatus(DGREEN, WHITE, "Cooling");
-            // Print the Fan status on the TFT
-            printFan();
+bool warmupTask(Task& t) {
+    TASK_BEGIN(t);
+    while (true) {
+        runWarmup();
+        TASK_DELAY(t, SSRInterval);
+    }
+    TASK_END(t);
+}
 
-            elapsedHeatingTime += (SSRInterval / 1000.0);  // SSRInterval is in ms, so it has to be divided by 1000
+bool freeCoolingTask(Task& t) {
+    TASK_BEGIN(t);
+    while (true) {
+        freeCooling();
+        TASK_DELAY(t, SSRInterval);
+    }
+    TASK_END(t);
+}
 
-            SSRTimer = millis();
-        }
+// the automatic runs: a step at every reading
+bool autoRunTask(Task& t) {
+    TASK_BEGIN(t);
+    while (true) {
+        TASK_WAIT_EVENT(t, TASK_EVENT_TEMPERATURE);
+        autoRunStep();
     }
+    TASK_END(t);
 }
 
-// Run warmup mode, a more gentile warmup for lower temperatures than free heating
-void runWarmup() {
-    static bool slowdown = false;
-    static bool rampup = true;
+/*
+  Start a run when a board is placed on the plate in the warmup mode, and finish it when the
+  board is taken off after the run. The detector only runs while the plate is where it looks
+  for a board: at the warmup temperature, or below autoReleaseTemp at the end of the run.
+*/
+void autoRunStep() {
+    double dt = (millis() - autoTimer) / 1000.0;
+    autoTimer = millis();
+    double expected = plateRateLag(autoPlate, autoRateLag, plateRate(autoPlate, heaterPower, fanOn, TCCelsius),
+                                   SSRInterval / 1000.0 * (1 - TCRateFilter) / TCRateFilter, dt);
+    if (fanOn != autoFan) boardDetectReset(boardDetect);  // the step of the fans is not a board
+    autoFan = fanOn;
+
+    switch (autoRunState) {
+        case AUTO_WATCH:
+            // the element of a plate that just came up from cold still gives off the heat of the ramp up, the
+            // detector would take the end of it for a board: it waits until the warmup regulated for a while
+            if (!autoRunEnabled || !taskRunning(warmupRun) || fabs(TCCelsius - warmupTemp) > autoStandbyBand ||
+                heatingControl.rampup || heatingControl.slowdown) {
+                autoStandbyStart = millis();
+                boardDetectReset(boardDetect);
+                break;
+            }
+            if (millis() - autoStandbyStart < autoStandbySettle) {
+                boardDetectReset(boardDetect);
+                break;
+            }
+            if (boardDetectStep(boardDetect, boardPlaceSettings, TCRate, expected, dt) == BOARD_DIP) {
+                autoRunState = AUTO_COUNTDOWN;
+                autoCountdownStart = millis();
+                LOG("Board placed at %.1fC, the run starts in %lus", TCCelsius, autoCountdown / 1000);
+            }
+            break;
 
-    if (enableWarmup == true) {
-        unsigned long timeNow = millis();
+        case AUTO_COUNTDOWN:
+            if (!taskRunning(warmupRun)) {  // the warmup was stopped
+                cancelAutoStart();
+            } else if (millis() - autoCountdownStart >= autoCountdown) {
+                stopWarmup();
+                itemCounter = 10;  // the reflow button
+                drawActionButtons();
+                startReflowRun();
+                autoRunState = AUTO_RUN;
+                boardDetectReset(boardDetect);
+                LOG("Automatic run started");
+            }
+            break;
 
-        if (timeNow - SSRTimer > SSRInterval)  // update frequency = 250 ms - should be less frequent than the temperature readings
-        {
-            // Calculate the position of the coordinates for the pixel so we can plot it on the chart
-            measuredTemp_px = (int)(yGraph - ((TCCelsius / tempPixelFactor)));         // 220 -> 200 offset is 13
-            measuredTime_px = (int)(xGraph + (elapsedHeatingTime / timePixelFactor));  // 18px from the left
-
-            // Draw the calculated pixel position (time vs. temperature) on the chart
-            tft.drawPixel(measuredTime_px, measuredTemp_px, CYAN);
-            tft.drawPixel(measuredTime_px, measuredTemp_px + 1, CYAN);  // putting another pixel next (on Y) the original, "fake a thick line"
-
-            // Also print the elapsed time in second
-            printElapsedTime();
-            printTargetTemperature();
-
-            targetTemp = warmupTemp;
-            double gap = abs(targetTemp - TCCelsius);  // to stop the rampup mode early
-
-            // initial rampup
-            if (slowdown == false && rampup == true) {
-                Output = 125;  // curb the output in this mode to half power
-                analogWrite(SSR_pin, int(Output));
-                tft.fillRoundRect(130, 80, 80, 20, RectRadius, BLACK);
-                tft.setTextColor(WHITE);
-                tft.drawString("rampup", 132, 80, 1);
+        case AUTO_RUN:
+            if (!taskRunning(reflowRun)) {  // stopped with the button
+                autoRunState = AUTO_WATCH;
+                break;
             }
-
-            // when we are ramping up and close to the target, but still below it, slow down
-            if (gap < 10 && TCCelsius < warmupTemp && rampup == true) {
-                Output = 4;  // slow down and let it creep up
-                analogWrite(SSR_pin, Output);
-                tft.fillRoundRect(130, 80, 80, 20, RectRadius, BLACK);
-                tft.setTextColor(WHITE);
-                tft.drawString("slow down", 132, 80, 1);
-                slowdown = true;
+            // the board comes off when the heating is over and the solder is solid, below autoReleaseTemp
+            if ((reflowControl.phase != COOLING && elapsedHeatingTime < 340) || TCCelsius > autoReleaseTemp) {
+                boardDetectReset(boardDetect);
+                break;
             }
-
-            // if we are now above the target, return to normal regulation
-            if (TCCelsius >= warmupTemp && slowdown == true && rampup == true) {
-                // back to normal regulation
-                slowdown = false;
-                rampup = false;
+            if (boardDetectStep(boardDetect, boardRemoveSettings, TCRate, expected, dt) != BOARD_STEADY) {
+                LOG("Board removed at %.1fC, the run is finished", TCCelsius);
+                stopReflowRun();  // the run log is closed
+                itemCounter = 9;  // back to the standby for the next board
+                drawActionButtons();
+                startWarmup();
+                autoRunState = AUTO_WATCH;
+                boardDetectReset(boardDetect);
             }
+            break;
+    }
+}
 
-            // normal regulation
-            if (slowdown == false && rampup == false) {
-                if (TCCelsius < warmupTemp) {
-                    Output = 40;  // reduce the power even more
-                    analogWrite(SSR_pin, int(Output));
-                } else {
-                    Output = 0;
-                    analogWrite(SSR_pin, int(Output));
-                }
-                tft.fillRoundRect(130, 80, 80, 20, RectRadius, BLACK);
-                tft.setTextColor(WHITE);
-                tft.drawString("regulate", 132, 80, 1);
-            }
+// the countdown of an automatic run was cancelled, the board has to be placed again
+void cancelAutoStart() {
+    autoRunState = AUTO_WATCH;
+    boardDetectReset(boardDetect);
+    LOG("Automatic run cancelled");
+}
+
+/*
+  Calculate the positions of the fields for the size of the panel (after the rotation is set)
+  and scale the chart: the 250°C and 360s of the chart fill the chart area of any panel.
+*/
+void setupLayout() {
+    tftX = tft.width();
+    tftY = tft.height();
+    int outside = layoutScreen(uiSpec, UI_FIELDS, tftX, tftY, ui);
+    if (outside > 0) {
+        LOG("%d fields are not on the screen, the panel is too small", outside);
+    }
 
-            // show the PWM output on the screen
-            printPWM();
+    const LayoutBox& chart = ui[UI_CHART];
+    xGraph = chart.x;
+    yGraph = chart.bottom();
+    tempPixelFactor = 250.0 / chart.h;
+    timePixelFactor = 360.0 / chart.w;
+    powerStripY = yGraph - 12;
+    rateStripY = yGraph - 7;
+    progressBarY = yGraph - 16;
+
+    LOG("screen %dx%d", tftX, tftY);
+    LOG("tempPixelFactor = %.3f", tempPixelFactor);
+    LOG("timePixelFactor = %.3f", timePixelFactor);
+}
 
-            updateStatus(DGREEN, WHITE, "Warmup");
+// the background of a field, with rounded corners
+void fillField(const LayoutBox& field, uint16_t color) {
+    tft.fillRoundRect(field.x, field.y, field.w, field.h, RectRadius, color);
+}
 
-            elapsedHeatingTime += (SSRInterval / 1000.0);  // SSRInterval is in ms, so it has to be divided by 1000
+// the text of a field, at its text position
+void drawFieldText(const LayoutBox& field, const String& text, uint8_t font) {
+    tft.drawString(text, field.textX, field.textY, font);
+}
 
-            SSRTimer = millis();
-        }
+// show the stage of the free heating or warmup controller
+void showHeatingStage(HeatingStage stage) {
+    fillField(ui[UI_STAGE], BLACK);
+    tft.setTextColor(WHITE);
+    if (stage == RAMPUP) {
+        drawFieldText(ui[UI_STAGE], "rampup", 1);
+    } else if (stage == SLOWDOWN) {
+        drawFieldText(ui[UI_STAGE], "slow down", 1);
+    } else {
+        drawFieldText(ui[UI_STAGE], "regulate", 1);
     }
 }
 
-// Draw the chart axes, tickmarks and values
+// Draw the chart axes, tickmarks and values, relative to the bottom left corner of the chart
 void drawAxis() {
-    // Y-axis line (vertical - temperature): total 320px
-    tft.drawLine(xGraph, ((int)238 - (250 / tempPixelFactor)) - 12, xGraph, 238 - 13, RED);  // X0, Y0, X1, Y1, Color
+    // Y-axis line (vertical - temperature)
+    tft.drawLine(xGraph, (int)(yGraph - (250 / tempPixelFactor)) - 1, xGraph, yGraph - 2, RED);  // X0, Y0, X1, Y1, Color
 
-    // Horizontal lines (ticks) at every 50C (a line from from 13 left to 22 right)
-    tft.drawLine(13, (int)yGraph - (50 / tempPixelFactor), 22, (int)yGraph - (50 / tempPixelFactor), RED);    // 50C
-    tft.drawLine(13, (int)yGraph - (100 / tempPixelFactor), 22, (int)yGraph - (100 / tempPixelFactor), RED);  // 100C
-    tft.drawLine(13, (int)yGraph - (150 / tempPixelFactor), 22, (int)yGraph - (150 / tempPixelFactor), RED);  // 150C
-    tft.drawLine(13, (int)yGraph - (200 / tempPixelFactor), 22, (int)yGraph - (200 / tempPixelFactor), RED);  // 200C
-    tft.drawLine(13, (int)yGraph - (250 / tempPixelFactor), 22, (int)yGraph - (250 / tempPixelFactor), RED);  // 250C
+    // Horizontal lines (ticks) at every 50C (a line from from 5 left to 4 right of the axis)
+    for (int t = 50; t <= 250; t += 50) {
+        int y = (int)(yGraph - (t / tempPixelFactor));
+        tft.drawLine(xGraph - 5, y, xGraph + 4, y, RED);
+    }
 
     // Y-axis is Temperature in Celsius
-    tft.drawString("`c", 4, (int)tftY - 35, 2);
+    tft.drawString("`c", xGraph - 14, yGraph - 22, 2);
 
     // tick values
-    tft.drawString("50", 5, (int)tftY - 17 - (50 / tempPixelFactor), 1);  // text, x, y color
-    tft.drawString("100", 0, (int)tftY - 17 - (100 / tempPixelFactor), 1);
-    tft.drawString("150", 0, (int)tftY - 17 - (150 / tempPixelFactor), 1);
-    tft.drawString("200", 0, (int)tftY - 17 - (200 / tempPixelFactor), 1);
-    tft.drawString("250", 0, (int)tftY - 17 - (250 / tempPixelFactor), 1);
+    tft.drawString("50", xGraph - 13, (int)(yGraph - 4 - (50 / tempPixelFactor)), 1);  // text, x, y color
+    for (int t = 100; t <= 250; t += 50) {
+        tft.drawString(String(t), xGraph - 18, (int)(yGraph - 4 - (t / tempPixelFactor)), 1);
+    }
 
-    // X-axis line (horizontal - time) : total 240px
-    tft.drawLine(xGraph, yGraph, ((int)360 / timePixelFactor), yGraph, WHITE);  // X0, Y0, X1, Y1, Color
+    // X-axis line (horizontal - time)
+    tft.drawLine(xGraph, yGraph, ui[UI_CHART].right() - 1, yGraph, WHITE);  // X0, Y0, X1, Y1, Color
 
     // Vertical lines (ticks) at every 30s; generate small (4px) and larger ticks (6px) at every 60s
-    tft.drawLine(xGraph + (int)30 / timePixelFactor, 226, xGraph + (int)30 / timePixelFactor, 222, WHITE);    // 30S
-    tft.drawLine(xGraph + (int)60 / timePixelFactor, 226, xGraph + (int)60 / timePixelFactor, 220, WHITE);    // 60S
-    tft.drawLine(xGraph + (int)90 / timePixelFactor, 226, xGraph + (int)90 / timePixelFactor, 222, WHITE);    // 90S
-    tft.drawLine(xGraph + (int)120 / timePixelFactor, 226, xGraph + (int)120 / timePixelFactor, 220, WHITE);  // 120S
-    tft.drawLine(xGraph + (int)150 / timePixelFactor, 226, xGraph + (int)150 / timePixelFactor, 222, WHITE);  // 150S
-    tft.drawLine(xGraph + (int)180 / timePixelFactor, 226, xGraph + (int)180 / timePixelFactor, 220, WHITE);  // 180S
-    tft.drawLine(xGraph + (int)210 / timePixelFactor, 226, xGraph + (int)210 / timePixelFactor, 222, WHITE);  // 210S
-    tft.drawLine(xGraph + (int)240 / timePixelFactor, 226, xGraph + (int)240 / timePixelFactor, 220, WHITE);  // 240S
-    tft.drawLine(xGraph + (int)270 / timePixelFactor, 226, xGraph + (int)270 / timePixelFactor, 222, WHITE);  // 270S
-    tft.drawLine(xGraph + (int)300 / timePixelFactor, 226, xGraph + (int)300 / timePixelFactor, 220, WHITE);  // 300S
-    tft.drawLine(xGraph + (int)330 / timePixelFactor, 226, xGraph + (int)330 / timePixelFactor, 222, WHITE);  // 330S
+    for (int t = 30; t <= 330; t += 30) {
+        int x = xGraph + (int)(t / timePixelFactor);
+        tft.drawLine(x, yGraph - 1, x, (t % 60 == 0) ? yGraph - 7 : yGraph - 5, WHITE);
+    }
 
     // X-axis is Time in seconds
-    tft.drawString("seconds", 15, (int)tftY - 10, 1);
+    tft.drawString("seconds", xGraph - 3, yGraph + 3, 1);
 
     // tick values with justified numbers
-    tft.drawString("60", (xGraph + (int)60 / timePixelFactor) - 5, 230, 1);
-    tft.drawString("120", (xGraph + (int)120 / timePixelFactor) - 8, 230, 1);
-    tft.drawString("180", (xGraph + (int)180 / timePixelFactor) - 8, 230, 1);
-    tft.drawString("240", (xGraph + (int)240 / timePixelFactor) - 8, 230, 1);
-    tft.drawString("300", (xGraph + (int)300 / timePixelFactor) - 8, 230, 1);
+    tft.drawString("60", (xGraph + (int)(60 / timePixelFactor)) - 5, yGraph + 3, 1);
+    for (int t = 120; t <= 300; t += 60) {
+        tft.drawString(String(t), (xGraph + (int)(t / timePixelFactor)) - 8, yGraph + 3, 1);
+    }
 }
 
 /*
@@ -2080,6 +2768,9 @@ void drawCurve() {
     tft.drawLine(soakingTime_px, soakingTemp_px, reflowTime_px, reflowTemp_px, RED);
     tft.drawLine(reflowTime_px, reflowTemp_px, coolingTime_px, coolingTemp_px, RED);
     tft.drawLine(coolingTime_px, coolingTemp_px, coolingTime_px + 40, coolingTemp_px + 20, BLUE);  // fake a downward cooling curve
+
+    // show the planned plate setpoints, when the plan is of this profile (the job may still be busy)
+    if (boardPlanEnabled && planned && samePlan(plannedFor, profileInput())) drawPlan();
 }
 
 // =================================================================================================
@@ -2140,14 +2831,12 @@ void drawCurve_new() {
   plot their curves.
 */
 void drawFreeCurve() {
-    // first update the hotplate temperature reading
-    tft.fillRoundRect(4, 10, 156, 115, RectRadius, BLACK);  // Erase previous content
-    tft.fillScreen(BLACK);                                  // Repaint with black
+    tft.fillScreen(BLACK);  // Repaint with black
     //-------------------------------------
 
     // Print the name of the default paste
     tft.setTextColor(WHITE);
-    tft.drawString(pasteName, pasteNamePosX, pasteNamePosY, 2);
+    drawFieldText(ui[UI_PASTE_NAME], pasteName, 2);
 
     drawAxis();
 }
@@ -2166,13 +2855,11 @@ void drawFreeCurve() {
 */
 void drawReflowCurve() {
     if (redrawCurve == true) {
-        // first update the hotplate temperature reading
-        tft.fillRoundRect(4, 10, 156, 115, RectRadius, BLACK);  // Erase previous content
-        tft.fillScreen(BLACK);                                  // Repaint with black
+        tft.fillScreen(BLACK);  // Repaint with black
 
         // Print the name of the paste
         tft.setTextColor(WHITE);
-        tft.drawString(pasteName, pasteNamePosX, pasteNamePosY, 2);
+        drawFieldText(ui[UI_PASTE_NAME], pasteName, 2);
 
         // Calculate the portions of the curve to be plotted
         // Temperature and time values converted into pixel values
@@ -2189,6 +2876,9 @@ void drawReflowCurve() {
         coolingTemp_px = (int)(yGraph - (double)coolingTemp / tempPixelFactor);
         coolingTime_px = (int)(xGraph + (double)coolingTime / timePixelFactor);
 
+        // the profile may have changed, so plan the plate setpoints again, in the background
+        submitPlan();
+
         // Draw the reflow curve
         drawCurve();
 
@@ -2246,76 +2936,191 @@ void drawReflowCurve() {
 */
 void drawActionButtons() {
     // place the warmup button
-    tft.fillRoundRect(260, 0, 60, 15, RectRadius, DGREEN);  // X,Y, W,H, Color
+    fillField(ui[UI_WARMUP_BUTTON], DGREEN);
     tft.setTextColor(WHITE);
-    tft.drawString("WARMUP", 265, 0, 2);
+    drawFieldText(ui[UI_WARMUP_BUTTON], "WARMUP", 2);
 
     // Free warmup value
-    tft.fillRoundRect(220, 2, 32, 12, RectRadius, BLACK);  // X,Y, W,H, Color
+    fillField(ui[UI_WARMUP_VALUE], BLACK);
     tft.setTextColor(RED);
-    tft.drawString(String(warmupTemp) + "C", 228, 4, 1);
+    drawFieldText(ui[UI_WARMUP_VALUE], String(warmupTemp) + "C", 1);
 
     // Place the reflow/stop button
-    tft.fillRoundRect(260, 20, 60, 15, RectRadius, ORANGE);  // X,Y, W,H, Color
+    fillField(ui[UI_REFLOW_BUTTON], ORANGE);
     tft.setTextColor(WHITE);
-    tft.drawString("REFLOW", 265, 20, 2);
+    drawFieldText(ui[UI_REFLOW_BUTTON], "REFLOW", 2);
 
     // Place the Heating/stop button
-    tft.fillRoundRect(260, 40, 60, 15, RectRadius, RED);  // X,Y, W,H, Color
+    fillField(ui[UI_HEATING_BUTTON], RED);
     tft.setTextColor(WHITE);
-    tft.drawString("HEATING", 265, 40, 2);
+    drawFieldText(ui[UI_HEATING_BUTTON], "HEATING", 2);
 
     // Free maximum Heating value
-    tft.fillRoundRect(220, 42, 32, 12, RectRadius, BLACK);  // X,Y, W,H, Color
+    fillField(ui[UI_HEATING_VALUE], BLACK);
     tft.setTextColor(RED);
-    tft.drawString(String(freeHeatingTemp) + "C", 228, 44, 1);
+    drawFieldText(ui[UI_HEATING_VALUE], String(freeHeatingTemp) + "C", 1);
 
     // Place the Free Cooling/stop button
-    tft.fillRoundRect(260, 60, 60, 15, RectRadius, BLUE);  // X,Y, W,H, Color
+    fillField(ui[UI_COOLING_BUTTON], BLUE);
     tft.setTextColor(WHITE);
-    tft.drawString("COOLING", 265, 60, 2);
+    drawFieldText(ui[UI_COOLING_BUTTON], "COOLING", 2);
 
     // Free minimum Cooling value
-    tft.fillRoundRect(220, 62, 32, 12, RectRadius, BLACK);  // X,Y, W,H, Color
+    fillField(ui[UI_COOLING_VALUE], BLACK);
     tft.setTextColor(BLUE);
-    tft.drawString(String(freeCoolingTemp) + "C", 228, 64, 1);
+    drawFieldText(ui[UI_COOLING_VALUE], String(freeCoolingTemp) + "C", 1);
+
+    // Place the noise analysis button
+    fillField(ui[UI_NOISE_BUTTON], MAGENTA);
+    tft.setTextColor(WHITE);
+    drawFieldText(ui[UI_NOISE_BUTTON], "NOISE", 2);
 }
 
 /*
  Obtain the hot plate temperature using a thermocouple and the MAX6675
  Do regular readings and update the display every 0.25s (could be slower)
-
+ The reads are queued on the SPI host of the thermocouples, the reading is processed in a
+ later pass of the loop, when the transactions are done.
 */
 void measureTemperature() {
+    // the next conversions start when the edges of this slot have settled
+    if (conversionHeld && millis() - temperatureTimer >= switchGuard) releaseConversions();
+    // without the quiet sampling the slots run on their own clock, the edges fall anywhere in a conversion
+    if (!quietSampling && millis() - slotTimer >= SSRInterval) {
+        slotTimer = millis();
+        heaterSlot();
+    }
+
     // Relevant YouTube video for this part: https://www.youtube.com/watch?v=PdS6-TccgK4
-    if (millis() - temperatureTimer > 250)  // update frequency = 0.25s - faster than checking the heating (2s)
-    {
-        int status = thermoCouple.read();  // Do one read to make sure we get the valid temp reading
-
-        /*
-          If there is an issue, we'll show the status on the serial monitor.
-          The errors can be:
-            0 for status OK
-            4 for Thermocouple short to VCC
-            128 no read done yet
-            129 no cummunication
-        */
-        if (status != 0) {
-            Serial.print("Max status: ");
-            Serial.print(status);
-            Serial.print("\t");
+    // start the reads, the SPI host clocks them in while the loop goes on
+    if (!readingRequested && millis() - temperatureTimer > 250) {  // update frequency = 0.25s - faster than checking the heating (2s)
+        probeRequested = characterizing;  // the board temperature during a characterization run
+        readingRequested = true;
+    }
+
+    // the reading, once the transactions of the chips are done. The chips share SO, one is read at a time:
+    // the board probe first and without hold, then the plate, the only chip select that stays low
+    if (!readingRequested) return;
+    if (probeRequested && !probeDone) {
+        if (!boardProbe.request() || !boardProbe.ready()) return;
+        probeDone = true;
+    }
+    if (!plateRequested) {
+        if (!thermoCouple.request(quietSampling)) return;
+        plateRequested = true;
+    }
+    if (!thermoCouple.ready()) return;
+    readingRequested = plateRequested = probeDone = false;
+    int status = thermoCouple.getStatus();
+
+    /*
+      If there is an issue, we'll show the status on the serial monitor.
+      The errors can be:
+        0 for status OK
+        4 for Thermocouple short to VCC
+        128 no read done yet
+        129 no cummunication
+    */
+    if (status != 0) {
+        LOG("Max status: %d", status);
+    }
+
+    double reading = thermoCouple.getTemperature();
+
+    // a conversion that saw an edge of the SSR or the fans is left out once, the next one is always used
+    bool flagged = conversionDisturbed;
+    conversionDisturbed = false;
+    if (flagged) flaggedReadings++;
+    bool skip = quietSampling && flagged && !lastFlagged && status == STATUS_OK;
+    lastFlagged = flagged;
+
+    // record the raw readings for the noise analysis
+    if (enableNoiseAnalysis && noiseCount < NOISE_SAMPLES) {
+        if (noiseCount == 0) noiseStart = millis();
+        noiseSamples[noiseCount++] = reading;
+        if (flagged) noiseFlagged++;
+    }
+
+    if (!skip) {
+        // the notch filter removes the interference found by the noise analysis, not the error values
+        if (notchEnabled && reading < 500) {
+            TCCelsius = notchFilter(reading);
+        } else {
+            TCCelsius = reading;
         }
 
-        TCCelsius = thermoCouple.getTemperature();
+        // filtered dT/dt for the strip chart, based on the real time between the readings
+        double interval = (millis() - rateTimer) / 1000.0;
+        if (rateTimer > 0 && TCCelsius < 500 && prevTCCelsius < 500) {  // skip the first and error readings
+            TCRate = TCRate + TCRateFilter * (((TCCelsius - prevTCCelsius) / interval) - TCRate);
+        }
+        prevTCCelsius = TCCelsius;
+        rateTimer = millis();
+    }
+
+    LOG("Temp: %.2f", TCCelsius);  // the converted reading, formatted by tools/dlog
 
-        Serial.print("Temp: ");
-        Serial.println(TCCelsius);  // print converted data on the serial terminal
+    if (probeRequested) probeCelsius = boardProbe.getTemperature();
 
-        // Update the text on the TFT display whenever a reading is finished
-        printTemp();
+    // Update the text on the TFT display whenever a reading is finished
+    printTemp();
+    signalTasks(tasks, TASK_EVENT_TEMPERATURE);
 
-        temperatureTimer = millis();  // reset timer
+    // the SSR and fan edges of the next slot, while the chip select of the plate is low
+    if (quietSampling) {
+        conversionHeld = true;
+        heaterSlot();
     }
+    temperatureTimer = millis();  // reset timer
+}
+
+// the average power of the heater, 0-255: the slots from the next one on
+void setHeater(int power) {
+    heaterPower = constrain(power, OFF, ON);
+    if (heaterPower == OFF) heaterSum = 0;
+}
+
+// the heater off right away, for a stop
+void heaterOff() {
+    heaterPower = OFF;
+    heaterSum = 0;
+    switchHeater(false);
+}
+
+// the fans from the next slot on
+void setFan(bool on) {
+    fanRequest = on;
+}
+
+// switch the SSR, an edge during a conversion flags its reading
+void switchHeater(bool on) {
+    if (on == heaterOn) return;
+    OutputPin<Board::ssr>::write(on);
+    heaterOn = on;
+    if (!conversionHeld) conversionDisturbed = true;
+}
+
+void switchFan(bool on) {
+    if (on == fanOn) return;
+    OutputPin<Board::fan>::write(on);
+    fanOn = on;
+    if (!conversionHeld) conversionDisturbed = true;
+}
+
+// a slot: the SSR on when the sigma-delta sum of the power reaches full power, and the requested fans
+void heaterSlot() {
+    heaterSum += heaterPower;
+    bool on = heaterSum >= ON;
+    if (on) heaterSum -= ON;
+    switchHeater(on);
+    switchFan(fanRequest);
+}
+
+// start the conversions of the chips that were read
+void releaseConversions() {
+    thermoCouple.release();
+    boardProbe.release();
+    conversionHeld = false;
 }
 
 /*
@@ -2337,17 +3142,21 @@ void removeFieldsFromDisplay() {
     tft.fillRoundRect(coolingTime_px + 20, coolingTemp_px + 20, 24, 9, RectRadius, BLACK);
 
     // Also remove the free warmup, cooling and heating buttons and values
-    tft.fillRoundRect(220, 0, 100, 15, RectRadius, BLACK);   // Warmup
-    tft.fillRoundRect(220, 40, 100, 15, RectRadius, BLACK);  // Free Heating
-    tft.fillRoundRect(220, 60, 100, 15, RectRadius, BLACK);  // Free cooling
+    // from the value fields to the right side of the buttons
+    int left = ui[UI_WARMUP_VALUE].x;
+    int width = ui[UI_WARMUP_BUTTON].right() - left;
+    tft.fillRoundRect(left, ui[UI_WARMUP_BUTTON].y, width, ui[UI_WARMUP_BUTTON].h, RectRadius, BLACK);    // Warmup
+    tft.fillRoundRect(left, ui[UI_HEATING_BUTTON].y, width, ui[UI_HEATING_BUTTON].h, RectRadius, BLACK);  // Free Heating
+    tft.fillRoundRect(left, ui[UI_COOLING_BUTTON].y, width, ui[UI_COOLING_BUTTON].h, RectRadius, BLACK);  // Free cooling
+    tft.fillRoundRect(left, ui[UI_NOISE_BUTTON].y, width, ui[UI_NOISE_BUTTON].h, RectRadius, BLACK);      // Noise analysis
 }
 
 // show and update the status field on the display
 void updateStatus(int fieldColor, int textColor, const char* text) {
     // Erase the previously printed text
-    tft.fillRoundRect(160, 190, 70, 18, RectRadius, fieldColor);
+    fillField(ui[UI_STATUS], fieldColor);
     tft.setTextColor(textColor);
-    tft.drawString(text, 170, 190, 2);
+    drawFieldText(ui[UI_STATUS], text, 2);
 }
 
 // show and update the actual temperature to the TFT
@@ -2356,16 +3165,16 @@ void printTemp() {
         // >500 must be an incorrect value, could be a grounding issue?
         // if the "temperature" is 1024 "degrees", there is a short circuit to VCC
         // or the thermocouple is not connected properly. The error code will be 4
-        tft.fillRoundRect(30, 40, 90, 16, RectRadius, RED);  // X,Y, W,H, Color
+        fillField(ui[UI_TEMP], RED);
         tft.setTextColor(WHITE);
         // this is an error code not a temperature
-        tft.drawString("Temp " + String(int(TCCelsius)), 32, 40, 2);
+        drawFieldText(ui[UI_TEMP], "Temp " + String(int(TCCelsius)), 2);
 
     } else {
-        tft.fillRoundRect(30, 40, 90, 16, RectRadius, DGREEN);  // X,Y, W,H, Color
+        fillField(ui[UI_TEMP], DGREEN);
         tft.setTextColor(WHITE);
         // can only print "°C" with font 2
-        tft.drawString("Temp " + String(int(TCCelsius)) + "`C", 32, 40, 2);
+        drawFieldText(ui[UI_TEMP], "Temp " + String(int(TCCelsius)) + "`C", 2);
     }
 }
 
@@ -2374,30 +3183,1270 @@ void printTemp() {
  and the reflow curve shown on the TFT
 */
 void printTargetTemperature() {
-    tft.fillRoundRect(30, 60, 80, 16, RectRadius, DGREEN);
+    fillField(ui[UI_TARGET], DGREEN);
     tft.setTextColor(WHITE);
-    tft.drawString("Targt " + String(int(targetTemp)) + "`C", 32, 60, 2);  // can only print "°C" with font 2
+    drawFieldText(ui[UI_TARGET], "Targt " + String(int(targetTemp)) + "`C", 2);  // can only print "°C" with font 2
 }
 
 // function to print the elapsed time on the TFT when one of the modes is active
 void printElapsedTime() {
-    tft.fillRoundRect(120, 40, 80, 16, RectRadius, DGREEN);
+    fillField(ui[UI_TIME], DGREEN);
     tft.setTextColor(WHITE);
-    tft.drawString("Time " + String(int(elapsedHeatingTime)) + "s", 122, 40, 2);
+    drawFieldText(ui[UI_TIME], "Time " + String(int(elapsedHeatingTime)) + "s", 2);
 }
 
 // Print the PWM information to the TFT
 void printPWM() {
-    tft.fillRoundRect(120, 60, 80, 16, RectRadius, DGREEN);
+    fillField(ui[UI_POWER], DGREEN);
     tft.setTextColor(WHITE);
-    tft.drawString("PID : " + String(int(Output)), 122, 60, 2);
+    drawFieldText(ui[UI_POWER], "PID : " + String(int(Output)), 2);
 }
 
 // Print the fan information to the TFT
 void printFan() {
-    tft.fillRoundRect(120, 60, 80, 16, RectRadius, DGREEN);
+    fillField(ui[UI_POWER], DGREEN);
     tft.setTextColor(WHITE);
-    tft.drawString("FAN : " + Fan, 122, 60, 2);
+    drawFieldText(ui[UI_POWER], "FAN : " + Fan, 2);
+}
+
+/*
+  Add the heater power and the temperature rise (dT/dt) to the strip charts below the curve.
+
+  This is called every 250ms from the active mode. There are several samples per pixel column
+  (timePixelFactor is 1.2s per pixel), so we average the PWM value of the samples in a column and
+  only write the column to the display when the time axis moves to the next pixel.
+  Each strip column is a single small SPI write: a fast vertical line for the power and a
+  7 pixel image for the dT/dt bar.
+*/
+void appendStripCharts() {
+    if (measuredTime_px < stripColumn) {
+        resetStripCharts();  // a new run started at the left of the chart
+    }
+    if (measuredTime_px != stripColumn && stripSamples > 0) {
+        // power strip: the average PWM value of the column, or cyan when the fan is cooling the plate
+        int power = stripPowerSum / stripSamples;
+        uint16_t color = powerColor(power);
+        if (power == 0 && Fan == "ON") color = CYAN;
+        tft.drawFastVLine(stripColumn, powerStripY, powerStripH, color);
+
+        // dT/dt strip: a bar up or down from the zero line, 1px per half of the ramp limit
+        uint16_t column[rateStripH];
+        int zero = rateStripH / 2;
+        int bar = (int)round(TCRate / (rampRateLimit / 2));
+        bar = constrain(bar, -zero, zero);
+        double rate = fabs(TCRate);
+        uint16_t barColor = (rate <= rampRateLimit) ? GREEN : (rate <= 1.5 * rampRateLimit) ? ORANGE : RED;
+        for (int i = 0; i < rateStripH; i++) {
+            int level = zero - i;  // positive above the zero line
+            if ((bar > 0 && level > 0 && level <= bar) || (bar < 0 && level < 0 && level >= bar)) {
+                column[i] = barColor;
+            } else if (level == 0) {
+                column[i] = DGREY;  // zero line
+            } else {
+                column[i] = BLACK;
+            }
+        }
+        tft.pushImage(stripColumn, rateStripY, 1, rateStripH, column);
+
+        stripSamples = 0;
+        stripPowerSum = 0;
+    }
+    stripColumn = measuredTime_px;
+    stripPowerSum += (long)Output;
+    stripSamples++;
+}
+
+// start collecting at the left of the chart again
+// the strips of a previous run are already gone, every mode starts with a fresh chart
+void resetStripCharts() {
+    stripColumn = -1;
+    stripSamples = 0;
+    stripPowerSum = 0;
+}
+
+// map the PWM value (0-255) to a color from blue (low power) to red (full power), black is off
+uint16_t powerColor(int pwm) {
+    if (pwm <= 0) return BLACK;
+    pwm = constrain(pwm, 0, 255);
+    return tft.color565(pwm, 0, 255 - pwm);
+}
+
+/*
+  Find the run logs on the file system, so we know the id for the next run and
+  which one is the oldest to remove when we run out of space.
+*/
+void findRunLogs() {
+    if (!LittleFS.exists("/runs")) {
+        LittleFS.mkdir("/runs");
+    }
+    File dir = LittleFS.open("/runs");
+    bool found = false;
+    File file = dir.openNextFile();
+    while (file) {
+        uint32_t id = strtoul(file.name(), NULL, 10);  // the name is "<id>.rlg"
+        if (!found || id < runLogOldest) runLogOldest = id;
+        if (!found || id >= runLogId) runLogId = id + 1;
+        found = true;
+        file = dir.openNextFile();
+    }
+    LOG("Run logs: next run id %u", runLogId);
+}
+
+/*
+  Open the log file for a new reflow run and write the header with the profile.
+  We make room first by removing the oldest logs when the file system is getting full.
+*/
+void startRunLog() {
+    if (!runLogReady) return;
+    endRunLog();  // just in case the previous one was not closed
+
+    while (LittleFS.totalBytes() - LittleFS.usedBytes() < runLogReserve && runLogOldest < runLogId) {
+        LittleFS.remove("/runs/" + String(runLogOldest) + ".rlg");
+        runLogOldest++;
+    }
+
+    String path = "/runs/" + String(runLogId) + ".rlg";
+    runLogFile = LittleFS.open(path, FILE_WRITE);
+    if (!runLogFile) {
+        LOG("Cannot create %s", path.c_str());
+        return;
+    }
+
+    RunLogHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = RUNLOG_MAGIC;
+    header.version = RUNLOG_VERSION;
+    header.blockSamples = RUNLOG_BLOCK_SAMPLES;
+    header.runId = runLogId;
+    header.sampleInterval = SSRInterval;
+    strncpy(header.pasteName, pasteName.c_str(), sizeof(header.pasteName) - 1);
+    header.profile[0] = preheatTemp;
+    header.profile[1] = preheatTime;
+    header.profile[2] = soakingTemp;
+    header.profile[3] = soakingTime;
+    header.profile[4] = reflowTemp;
+    header.profile[5] = reflowTime;
+    header.profile[6] = coolingTemp;
+    header.profile[7] = coolingTime;
+    runLogFile.write((const uint8_t*)&header, sizeof(header));
+    runLogCount = 0;
+
+    LOG("Run log: %s", path.c_str());
+}
+
+// add the current sample of the reflow run to the log, a full block is written to the file
+void appendRunLog() {
+    if (!runLogFile) return;
+
+    runLogSamples.time[runLogCount] = (uint32_t)(elapsedHeatingTime * 1000);
+    runLogSamples.temperature[runLogCount] = (int16_t)constrain(round(TCCelsius * 10), -32768.0, 32767.0);
+    runLogSamples.setpoint[runLogCount] = (int16_t)constrain(round(targetTemp * 10), -32768.0, 32767.0);
+    runLogSamples.power[runLogCount] = (uint8_t)constrain((int)Output, 0, 255);
+    runLogSamples.phase[runLogCount] = (uint8_t)reflowControl.phase;
+    runLogCount++;
+
+    if (runLogCount == RUNLOG_BLOCK_SAMPLES) {
+        writeRunLogBlock();
+    }
+}
+
+// encode the collected samples and write them as a block to the log file
+void writeRunLogBlock() {
+    if (runLogCount == 0) return;
+
+    RunLogBlockHeader block;
+    block.count = runLogCount;
+    block.encoding = RUNLOG_ENCODING_DELTA;
+    block.reserved = 0;
+    block.payloadSize = runLogEncodeDelta(runLogSamples, runLogCount, runLogPayload);
+    block.crc = runLogCrc32(runLogPayload, block.payloadSize);
+    runLogFile.write((const uint8_t*)&block, sizeof(block));
+    runLogFile.write(runLogPayload, block.payloadSize);
+    const uint8_t padding[3] = {0, 0, 0};
+    runLogFile.write(padding, (4 - block.payloadSize % 4) % 4);  // the next block starts at a multiple of 4
+    runLogFile.flush();  // so the block can be synchronized while the run continues
+    runLogCount = 0;
+}
+
+// write the remaining samples and close the log of the run
+void endRunLog() {
+    if (!runLogFile) return;
+
+    writeRunLogBlock();
+    runLogFile.close();
+    runLogId++;
+}
+
+/*
+  Send the LOG() records to the serial port, as many whole records as fit in the transmit buffer,
+  so the loop never waits for the UART. The records that did not fit in the buffer are counted.
+*/
+void flushLog() {
+    if (dlog.dropped > 0) {
+        uint32_t dropped = dlog.dropped;
+        dlog.dropped = 0;
+        LOG("%u log records dropped", dropped);
+    }
+    int room = Serial.availableForWrite();
+    size_t n = dlogTake(dlog, dlogOut, room > 0 ? room : 0);
+    if (n > 0) Serial.write(dlogOut, n);
+}
+
+#ifdef DLOG_TEXT
+void dlogTextOut(const char* text) {
+    Serial.print(text);
+}
+#endif
+
+/*
+  Read the commands of the host on the serial port, a line at a time.
+  SYNC <runId> <block> starts sending the run logs from that point, see include/logsync.h.
+  A new SYNC restarts the transfer, that is how the host resumes after an error.
+  STATUS, PASTES and PROFILE <n> are the telemetry of include/station_status.h.
+  ANOMALY off|warn|abort sets what an anomaly of a reflow run does, see include/run_anomaly.h.
+*/
+void readSerialCommand() {
+    while (Serial.available() > 0) {
+        char c = Serial.read();
+        if (c != '\n' && c != '\r') {
+            if (serialLineLength < (int)sizeof(serialLine) - 1) serialLine[serialLineLength++] = c;
+            continue;
+        }
+        if (serialLineLength == 0) continue;
+        serialLine[serialLineLength] = 0;
+        serialLineLength = 0;
+
+        unsigned long runId, block;
+        int paste;
+        if (sscanf(serialLine, "SYNC %lu %lu", &runId, &block) == 2 && runLogReady) {
+            syncFile.close();
+            syncRunId = runId;
+            syncBlock = block;
+            startTask(syncRun);
+        } else if (strcmp(serialLine, "QUIET on") == 0 || strcmp(serialLine, "QUIET off") == 0) {
+            quietSampling = strcmp(serialLine, "QUIET on") == 0;
+            if (!quietSampling) releaseConversions();
+            slotTimer = millis();
+            LOG("Quiet sampling %s", quietSampling ? "on" : "off");
+        } else if (strcmp(serialLine, "JOBS") == 0) {
+            reportComputeStats();
+        } else if (strcmp(serialLine, "AUTO on") == 0 || strcmp(serialLine, "AUTO off") == 0) {
+            autoRunEnabled = strcmp(serialLine, "AUTO on") == 0;
+            if (!autoRunEnabled && autoRunState == AUTO_COUNTDOWN) cancelAutoStart();
+            LOG("Automatic runs %s", autoRunEnabled ? "on" : "off");
+        } else if (strcmp(serialLine, "STATUS") == 0) {
+            statusRequested = true;
+            startTask(telemetryRun);
+        } else if (strcmp(serialLine, "PASTES") == 0) {
+            pasteRequested = 0;
+            startTask(telemetryRun);
+        } else if (sscanf(serialLine, "PROFILE %d", &paste) == 1) {
+            selectProfileCommand(paste);
+        } else if (strcmp(serialLine, "ANOMALY off") == 0 || strcmp(serialLine, "ANOMALY warn") == 0 ||
+                   strcmp(serialLine, "ANOMALY abort") == 0) {
+            anomalyAction = serialLine[8] == 'o' ? ANOMALY_OFF : serialLine[8] == 'w' ? ANOMALY_WARN : ANOMALY_ABORT;
+            LOG("Anomaly detection %s", serialLine + 8);
+        } else {
+            LOG("Unknown command: %s", serialLine);
+        }
+    }
+}
+
+/*
+  Send the run logs to the host, a frame per pass of the main loop, and only when the whole
+  frame fits in the transmit buffer of the serial port. The UART sends it in the background,
+  so the transfer does not hold up the reflow control, it only gets slower while the debug
+  prints also need the port. At 115200 baud a run of 4kB takes less than half a second.
+*/
+bool syncTask(Task& t) {
+    TASK_BEGIN(t);
+    // the host only takes the frames after the start of the transfer it asked for
+    syncFrameLength = logSyncSeal(syncFrame, LOGSYNC_START, syncRunId, syncBlock, 0);
+    TASK_WAIT_UNTIL(t, Serial.availableForWrite() >= (int)syncFrameLength + serialTxReserve);
+    Serial.write(syncFrame, syncFrameLength);
+    while (nextSyncFrame()) {
+        TASK_WAIT_UNTIL(t, Serial.availableForWrite() >= (int)syncFrameLength + serialTxReserve);
+        Serial.write(syncFrame, syncFrameLength);
+        TASK_YIELD(t);
+    }
+    // tell the host where it is now, it continues from there the next time
+    syncFrameLength = logSyncSeal(syncFrame, LOGSYNC_END, syncRunId, syncBlock, 0);
+    TASK_WAIT_UNTIL(t, Serial.availableForWrite() >= (int)syncFrameLength + serialTxReserve);
+    Serial.write(syncFrame, syncFrameLength);
+    LOG("Sync: next run %u block %u", syncRunId, syncBlock);
+    TASK_END(t);
+}
+
+/*
+  Read the next frame to send into syncFrame and advance the mark: a header, a block, or the
+  closed frame at the end of a finished run. Returns false when everything up to the end of the
+  logs (or what is written of the active run) was sent. A block larger than syncMaxBlock is the
+  end of its log, syncTask() could never write its frame.
+*/
+bool nextSyncFrame() {
+    uint32_t endId = runLogFile ? runLogId + 1 : runLogId;  // the ids after the last stored run
+    if (syncRunId < runLogOldest) {  // removed to make room, continue with the oldest one
+        syncRunId = runLogOldest;
+        syncBlock = 0;
+        syncFile.close();
+    }
+    uint8_t* data = syncFrame + sizeof(LogSyncFrame);
+    while (syncRunId < endId) {
+        bool found = true;
+        if (!syncFile) {
+            syncFile = LittleFS.open("/runs/" + String(syncRunId) + ".rlg", FILE_READ);
+            if (!syncFile) {  // a run without a log, the file system was not mounted
+                syncRunId++;
+                syncBlock = 0;
+                continue;
+            }
+            found = seekSyncBlock();
+        }
+        if (found && syncBlock == 0) {
+            if (syncFile.read(data, sizeof(RunLogHeader)) == sizeof(RunLogHeader)) {
+                syncFrameLength = logSyncSeal(syncFrame, LOGSYNC_HEADER, syncRunId, 0, sizeof(RunLogHeader));
+                syncBlock = 1;
+                return true;
+            }
+        } else if (found) {
+            RunLogBlockHeader block;
+            if (syncFile.read((uint8_t*)&block, sizeof(block)) == sizeof(block) && block.payloadSize <= RUNLOG_MAX_PAYLOAD) {
+                uint32_t size = logSyncBlockSize(block);
+                memcpy(data, &block, sizeof(block));
+                if (size > syncMaxBlock) {
+                    LOG("Sync: block %u of run %u is too large for the serial buffer, the log ends there", syncBlock,
+                        syncRunId);
+                } else if (syncFile.read(data + sizeof(block), size - sizeof(block)) == size - sizeof(block)) {
+                    syncFrameLength = logSyncSeal(syncFrame, LOGSYNC_BLOCK, syncRunId, syncBlock, size);
+                    syncBlock++;
+                    return true;
+                }
+            }
+        }
+        // the end of this log: the active run continues later, a finished one is closed
+        syncFile.close();
+        if (runLogFile && syncRunId == runLogId) return false;
+        syncFrameLength = logSyncSeal(syncFrame, LOGSYNC_CLOSED, syncRunId, syncBlock, 0);
+        syncRunId++;
+        syncBlock = 0;
+        return true;
+    }
+    return false;
+}
+
+// move the position in syncFile to the start of block syncBlock, false when the file is shorter
+bool seekSyncBlock() {
+    if (syncBlock == 0) return true;
+    uint32_t position = sizeof(RunLogHeader);
+    for (uint32_t i = 1; i < syncBlock; i++) {
+        RunLogBlockHeader block;
+        syncFile.seek(position);
+        if (syncFile.read((uint8_t*)&block, sizeof(block)) != sizeof(block)) return false;
+        position += logSyncBlockSize(block);
+    }
+    return syncFile.seek(position) && syncFile.available() > 0;
+}
+
+/*
+  Send the answers to STATUS and PASTES, a frame at a time when it fits in the transmit buffer,
+  like the frames of the log synchronization. A new request restarts the task.
+*/
+bool telemetryTask(Task& t) {
+    TASK_BEGIN(t);
+    while (statusRequested || pasteRequested >= 0) {
+        if (statusRequested) {
+            statusRequested = false;
+            telemetryFrameLength = sealStationStatus();
+        } else {
+            telemetryFrameLength = sealStationPaste(pasteRequested);
+            pasteRequested = pasteRequested + 1 < numSolderpastes ? pasteRequested + 1 : -1;
+        }
+        TASK_WAIT_UNTIL(t, Serial.availableForWrite() >= (int)telemetryFrameLength + serialTxReserve);
+        Serial.write(telemetryFrame, telemetryFrameLength);
+    }
+    TASK_END(t);
+}
+
+// what the station is doing, for the host
+uint8_t stationMode() {
+    if (taskRunning(reflowRun)) return STATION_REFLOW;
+    if (autoRunState == AUTO_COUNTDOWN) return STATION_COUNTDOWN;
+    if (taskRunning(warmupRun)) return STATION_WARMUP;
+    if (taskRunning(freeHeatingRun) || taskRunning(freeCoolingRun) || taskRunning(noiseRun)) return STATION_BUSY;
+    return STATION_IDLE;
+}
+
+// the status of the station in telemetryFrame, returns the size of the frame
+size_t sealStationStatus() {
+    StationStatus status = {};
+    status.mode = stationMode();
+    status.phase = reflowControl.phase;
+    status.paste = solderPasteSelected;
+    status.flags = (autoRunEnabled ? STATION_AUTO : 0) | (released ? STATION_RELEASED : 0) |
+                   (solderpasteFieldSelected || editingProfile() ? STATION_EDITING : 0) |
+                   (status.mode == STATION_REFLOW && anomalyFound != ANOMALY_NONE ? STATION_ANOMALY : 0);
+    status.temperature = TCCelsius;
+    status.standby = warmupTemp;
+    if (status.mode == STATION_REFLOW) {
+        status.elapsed = elapsedHeatingTime;
+        status.readyIn = released ? 0 : max(0.0, phaseEnds[COOLING] - elapsedHeatingTime);
+    }
+    status.runs = runLogId;
+    const int profile[8] = {preheatTemp, preheatTime, soakingTemp, soakingTime, reflowTemp, reflowTime, coolingTemp, coolingTime};
+    for (int i = 0; i < 8; i++) status.profile[i] = profile[i];
+    memcpy(telemetryFrame + sizeof(LogSyncFrame), &status, sizeof(status));
+    return logSyncSeal(telemetryFrame, LOGSYNC_STATUS, 0, 0, sizeof(status));
+}
+
+// a paste of the table in telemetryFrame, returns the size of the frame
+size_t sealStationPaste(int index) {
+    const solderpaste& p = solderpastes[index];
+    StationPaste paste = {};
+    strncpy(paste.name, p.pasteName, sizeof(paste.name) - 1);
+    paste.cascade = p.cascadeControl;
+    const int profile[8] = {p.preheatTemp, p.preheatTime, p.soakingTemp, p.soakingTime, p.reflowTemp, p.reflowTime, p.coolingTemp, p.coolingTime};
+    for (int i = 0; i < 8; i++) paste.profile[i] = profile[i];
+    paste.rampRateLimit = p.rampRateLimit;
+    memcpy(telemetryFrame + sizeof(LogSyncFrame), &paste, sizeof(paste));
+    return logSyncSeal(telemetryFrame, LOGSYNC_PASTE, numSolderpastes, index, sizeof(paste));
+}
+
+/*
+  PROFILE <n>: the host selects paste n for the next board. Not while a board is on the plate
+  or the profile is edited on the station. In the standby the curve is drawn again when the
+  run starts, the plan of the plate setpoints is made in the background right away.
+*/
+void selectProfileCommand(int index) {
+    uint8_t mode = stationMode();
+    if (index < 0 || index >= numSolderpastes) {
+        LOG("Unknown paste %d", index);
+    } else if (mode == STATION_COUNTDOWN || mode == STATION_REFLOW) {
+        LOG("Profile not changed, a board is on the plate");
+    } else if (solderpasteFieldSelected || editingProfile()) {
+        LOG("Profile not changed, it is being edited");
+    } else {
+        selectSolderPaste(index);
+        if (mode == STATION_IDLE) {
+            redrawCurve = true;
+            drawReflowCurve();  // also plans the plate setpoints
+            menuChanged = true;
+            updateHighlighting();
+        } else {
+            submitPlan();
+        }
+        LOG("Profile %s selected by the host", solderpastes[index].pasteName);
+    }
+}
+
+/*
+  Calculate the plate setpoints that make the board follow the profile, right now.
+  When the profile is (re)drawn the background job does this (submitPlan()), this is for a run
+  that starts before its result is there and for a board model that was just fitted.
+*/
+void planBoardProfile() {
+    plannedFor = profileInput();
+    planned = true;
+    double distortion = planPlateSetpoints(plannedFor.profile, plannedFor.model, plateLimits, plateSetpoints, PLAN_SECONDS);
+    if (boardPlanEnabled) {
+        LOG("Board plan: max deviation caused by the heater limits %.1f", distortion);
+    }
+}
+
+// the inputs of the jobs for the current profile and settings
+ComputeInput profileInput() {
+    ComputeInput input;
+    ReflowProfile profile = {preheatTemp, preheatTime, soakingTemp, soakingTime,
+                             reflowTemp, reflowTime, coolingTemp, coolingTime};
+    input.profile = profile;
+    input.model = boardModel;
+    input.plan = boardPlanEnabled;
+    input.warp = timeWarpEnabled;
+    input.start = TCCelsius;
+    return input;
+}
+
+// the same plate setpoints: the same profile and board model
+bool samePlan(const ComputeInput& a, const ComputeInput& b) {
+    return memcmp(&a.profile, &b.profile, sizeof(a.profile)) == 0 && a.model.tau == b.model.tau &&
+           a.model.loss == b.model.loss && a.model.ambient == b.model.ambient;
+}
+
+// plan the plate setpoints in the background when the profile or the board model changed
+void submitPlan() {
+    ComputeInput input = profileInput();
+    if (planned && samePlan(input, plannedFor)) return;
+    computeLock();
+    computeInputs[JOB_PLAN] = input;
+    computeSubmit(computeJobs, JOB_PLAN, 1, millis());
+    computeUnlock();
+#ifndef COMPUTE_INLINE
+    xTaskNotifyGive(computeWorker);
+#endif
+}
+
+// predict a run of the edited profile, this supersedes the prediction of the previous detent
+void submitPrediction() {
+    computeLock();
+    computeInputs[JOB_PREDICT] = profileInput();
+    computeSubmit(computeJobs, JOB_PREDICT, 2, millis());  // before a plan, the user is watching
+    computeUnlock();
+    predicting = true;
+#ifndef COMPUTE_INLINE
+    xTaskNotifyGive(computeWorker);
+#endif
+}
+
+// a value of the reflow profile is in the edit mode
+bool editingProfile() {
+    return preheatTempSelected || preheatTimeSelected || soakingTempSelected || soakingTimeSelected ||
+           reflowTempSelected || reflowTimeSelected || coolingTempSelected || coolingTimeSelected;
+}
+
+/*
+  The lock of the job queue and the result buffers, a spinlock because the worker runs on the
+  other core. It is only held to copy the inputs and the results, never during a job.
+  The scenario runner of tools/scenario has no worker: the main loop runs the jobs.
+*/
+void computeLock() {
+#ifndef COMPUTE_INLINE
+    portENTER_CRITICAL(&computeMux);
+#endif
+}
+
+void computeUnlock() {
+#ifndef COMPUTE_INLINE
+    portEXIT_CRITICAL(&computeMux);
+#endif
+}
+
+// run the next job of the queue, false when there is none
+bool runComputeJob() {
+    static int16_t plan[PLAN_SECONDS];        // the work buffers of the worker
+    static int16_t trajectory[PLAN_SECONDS];
+    static double ends[5];
+    ComputeJob job;
+    ComputeInput input;
+    computeLock();
+    bool found = computeTake(computeJobs, &job, millis());
+    if (found) input = computeInputs[job.kind];
+    computeUnlock();
+    if (!found) return false;
+
+    bool completed = true;
+    double distortion = 0;
+    if (job.kind == JOB_PLAN) {
+        distortion = planPlateSetpoints(input.profile, input.model, plateLimits, plan, PLAN_SECONDS);
+    } else if (job.kind == JOB_PREDICT) {
+        completed = predictReflow(input, job, plan, trajectory);
+    } else {
+        completed = predictRemaining(input, job, ends);
+    }
+
+    computeLock();
+    if (completed && !computeCancelled(computeJobs, job)) {
+        computeDone[job.kind] = input;
+        if (job.kind == JOB_PLAN) {
+            memcpy(planResult, plan, sizeof(planResult));
+            planDistortion = distortion;
+        } else if (job.kind == JOB_PREDICT) {
+            memcpy(predictResult, trajectory, sizeof(predictResult));
+        } else {
+            memcpy(etaResult, ends, sizeof(etaResult));
+        }
+    }
+    computeFinished(computeJobs, job, completed, millis());
+    computeUnlock();
+    return true;
+}
+
+#ifndef COMPUTE_INLINE
+// the worker on core 0: it sleeps until a job is submitted, at a lower priority than the system tasks
+void computeTask(void*) {
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        while (runComputeJob()) {
+        }
+    }
+}
+#endif
+
+/*
+  Predict the plate temperature of a run of the profile: the controller of the reflow mode
+  (reflowStep(), with the board plan and the time warp as set) on the plate model of
+  include/plate_model.h, from the plate temperature at the submission. The model is the
+  default plate, so it shows the shape of the run, not the last degree.
+  About 7000 model steps. Every simulated second it checks if another detent superseded the
+  job, it returns false then.
+*/
+bool predictReflow(const ComputeInput& input, const ComputeJob& job, int16_t* plan, int16_t* trajectory) {
+    if (input.plan) planPlateSetpoints(input.profile, input.model, plateLimits, plan, PLAN_SECONDS);
+    ReflowControl control;
+    control.profile = input.profile;
+    control.plan = input.plan ? plan : NULL;
+    control.coolingTarget = 40;
+    control.warp = input.warp ? &defaultTimeWarp : NULL;
+    reflowStart(control);
+
+    PlateParams params = defaultPlateParams();
+    PlateState plate = plateAtRest(params, 1);
+    plate.element = plate.plate = plate.sensor = input.start;
+    const double interval = SSRInterval / 1000.0;  // the control step of the reflow mode
+    const int substeps = 4;                        // the model wants steps of 0.1s or less
+    double t = 0;
+    for (int second = 0; second < PLAN_SECONDS; second++) {
+        if (computeCancelled(computeJobs, job)) return false;
+        trajectory[second] = (int16_t)round(plate.sensor * 10);
+        while (t < second + 1) {
+            reflowStep(control, t, plate.sensor);
+            for (int i = 0; i < substeps; i++) {
+                plateStep(params, plate, control.output, control.fan, interval / substeps);
+            }
+            t += interval;
+        }
+    }
+    return true;
+}
+
+/*
+  Predict the rest of a reflow run: the controller from its state at the submission on the plate
+  model, from the plate temperature. A run on the policy table is predicted with the table, the
+  others with reflowStep() (a cascade run too, the model has no probe).
+  ends[] gets the time of the run at which every phase ends that did not end yet, ends[COOLING]
+  when the plate is below autoReleaseTemp. At most etaHorizon ahead, a phase that does not
+  end within that ends at the horizon. Every simulated second it checks if it was superseded.
+*/
+bool predictRemaining(const ComputeInput& input, const ComputeJob& job, double* ends) {
+    ReflowControl control = input.run;
+    PlateParams params = defaultPlateParams();
+    PlateState plate = plateAtRest(params, 1);
+    plate.element = plate.plate = plate.sensor = input.start;
+    for (int phase = PREHEAT; phase <= COOLING; phase++) ends[phase] = -1;
+    const double interval = SSRInterval / 1000.0;
+    const int substeps = 4;
+    double t = input.time;
+    double rate = input.rate;
+    for (int second = 0; second < etaHorizon && ends[COOLING] < 0; second++) {
+        if (computeCancelled(computeJobs, job)) return false;
+        while (t < input.time + second + 1) {
+            ReflowPhase phase = control.phase;
+            if (t >= 340 && phase != COOLING) control.phase = COOLING;  // the end of the time scale, see reflowTask()
+            if (input.policy && control.phase != COOLING) {
+                reflowPolicyStep(control, policyTable, t, plate.sensor, rate);
+            } else {
+                reflowStep(control, t, plate.sensor);
+            }
+            if (control.phase != phase) ends[phase] = t;
+            if (control.phase == COOLING && plate.sensor <= autoReleaseTemp) {
+                ends[COOLING] = t;
+                break;
+            }
+            double before = plate.sensor;
+            for (int i = 0; i < substeps; i++) {
+                plateStep(params, plate, control.output, control.fan, interval / substeps);
+            }
+            rate += TCRateFilter * ((plate.sensor - before) / interval - rate);
+            t += interval;
+        }
+    }
+    for (int phase = PREHEAT; phase <= COOLING; phase++) {
+        if (ends[phase] < 0) ends[phase] = t;
+    }
+    return true;
+}
+
+/*
+  Take the results of the background jobs, in the main loop. The plan replaces the plate
+  setpoints, except during a reflow run which keeps the plan it started with. The prediction
+  is drawn on the chart while the value of the profile is edited, it goes away after that.
+*/
+void deliverComputeResults() {
+#ifdef COMPUTE_INLINE
+    while (runComputeJob()) {
+    }
+#endif
+    if (predicting && !editingProfile()) {
+        computeLock();
+        computeCancel(computeJobs, JOB_PREDICT);
+        computeUnlock();
+        predicting = false;
+    }
+    if (predictionShown && !editingProfile()) clearPrediction();
+
+    bool newPlan = false, newPrediction = false;
+    ComputeResult result;
+    computeLock();
+    while (computeResult(computeJobs, &result, millis())) {
+        if (result.kind == JOB_PLAN && !taskRunning(reflowRun)) {
+            memcpy(plateSetpoints, planResult, sizeof(plateSetpoints));
+            plannedFor = computeDone[JOB_PLAN];
+            planned = true;
+            newPlan = true;
+        } else if (result.kind == JOB_PREDICT) {
+            memcpy(prediction, predictResult, sizeof(prediction));
+            newPrediction = true;
+        } else if (result.kind == JOB_ETA && taskRunning(reflowRun)) {
+            memcpy(phaseEnds, etaResult, sizeof(phaseEnds));
+            if (etaFirst < 0) etaFirst = phaseEnds[COOLING];
+        }
+    }
+    double distortion = planDistortion;
+    computeUnlock();
+
+    bool chartIdle = !taskRunning(reflowRun) && !taskRunning(freeHeatingRun) && !taskRunning(warmupRun) &&
+                     !taskRunning(freeCoolingRun) && !taskRunning(noiseRun);
+    if (newPlan && boardPlanEnabled) {
+        LOG("Board plan: max deviation caused by the heater limits %.1f", distortion);
+        if (chartIdle) drawPlan();
+    }
+    if (newPrediction && editingProfile()) {
+        if (predictionShown) clearPrediction();
+        drawPrediction(CYAN);
+        predictionShown = true;
+    }
+}
+
+// the planned plate setpoints as a dotted line, every other second
+void drawPlan() {
+    for (int t = 0; t < PLAN_SECONDS; t += 2) {
+        tft.drawPixel(xGraph + t / timePixelFactor, yGraph - (plateSetpoints[t] / 10.0) / tempPixelFactor, DGREY);
+    }
+}
+
+// the predicted plate temperature as a dotted line, on the seconds between the dots of the plan
+void drawPrediction(uint16_t color) {
+    for (int t = 1; t < PLAN_SECONDS; t += 2) {
+        tft.drawPixel(xGraph + t / timePixelFactor, yGraph - (prediction[t] / 10.0) / tempPixelFactor, color);
+    }
+}
+
+// remove the prediction from the chart and repair the curve under it
+void clearPrediction() {
+    drawPrediction(BLACK);
+    drawCurve();
+    predictionShown = false;
+}
+
+// predict the end of the phases from the state of the run now
+void submitEta() {
+    ComputeInput input = profileInput();
+    input.run = reflowControl;
+    if (elapsedHeatingTime >= 340) input.run.phase = COOLING;  // the end of the time scale, the heater is off
+    input.time = elapsedHeatingTime;
+    input.policy = policyRunning;
+    input.rate = TCRate;
+    computeLock();
+    computeInputs[JOB_ETA] = input;
+    computeSubmit(computeJobs, JOB_ETA, 1, millis());
+    computeUnlock();
+    etaSubmitted = elapsedHeatingTime;
+#ifndef COMPUTE_INLINE
+    xTaskNotifyGive(computeWorker);
+#endif
+}
+
+// the segment of a phase on the progress bar: the phase of the profile on the time axis of the chart
+void progressSegment(int phase, int* x0, int* x1) {
+    const ReflowProfile& p = reflowControl.profile;
+    int start = phase == PREHEAT ? 0 : reflowPhaseEndTime(p, (ReflowPhase)(phase - 1));
+    int end = phase == COOLING ? 340 : reflowPhaseEndTime(p, (ReflowPhase)phase);
+    *x0 = xGraph + (int)(start / timePixelFactor);
+    *x1 = xGraph + (int)(end / timePixelFactor) - 1;  // a pixel between the segments
+}
+
+// the empty progress bar and the profile times as the first guess, at the start of a run
+void startProgress() {
+    for (int phase = PREHEAT; phase <= COOLING; phase++) {
+        int x0, x1;
+        progressSegment(phase, &x0, &x1);
+        tft.fillRect(x0, progressBarY, x1 - x0, progressBarH, DGREY);
+        progressFilled[phase] = x0;
+        phaseEnds[phase] = phase == COOLING ? 340 : reflowPhaseEndTime(reflowControl.profile, (ReflowPhase)phase);
+    }
+    progressShown = -1;
+    etaSubmitted = -1;
+    etaFirst = -1;
+    released = false;
+}
+
+/*
+  A step of the progress of the run: the phase that runs fills its segment by the time since
+  its start over its predicted duration, short of the end until the phase is over, the phases
+  before it are full. Only the new pixels are drawn, the bar never goes back.
+*/
+void updateProgress() {
+    double t = elapsedHeatingTime;
+    if (etaSubmitted < 0 || t - etaSubmitted >= etaInterval) submitEta();
+    ReflowPhase current = elapsedHeatingTime >= 340 ? COOLING : reflowControl.phase;
+    if (current == COOLING && !released && TCCelsius <= autoReleaseTemp) {
+        released = true;
+        LOG("Release temperature at %.0fs, predicted %.0fs at the start of the run", t, etaFirst);
+    }
+
+    for (int phase = PREHEAT; phase <= COOLING; phase++) {
+        double fraction = 0;
+        if (phase < current || (phase == COOLING && released)) {
+            fraction = 1;
+        } else if (phase == current) {
+            double start = reflowControl.phaseStart[phase] >= 0 ? reflowControl.phaseStart[phase] : t;
+            double duration = phaseEnds[phase] - start;
+            fraction = duration > 0 ? (t - start) / duration : 0;
+            fraction = constrain(fraction, 0.0, 0.95);
+        }
+        int x0, x1;
+        progressSegment(phase, &x0, &x1);
+        int x = x0 + (int)(fraction * (x1 - x0));
+        if (x > progressFilled[phase]) {
+            tft.fillRect(progressFilled[phase], progressBarY, x - progressFilled[phase], progressBarH, GREEN);
+            progressFilled[phase] = x;
+        }
+    }
+
+    // the time until the board can be taken off, in minutes and seconds
+    int left = released ? 0 : max(0, (int)ceil(phaseEnds[COOLING] - t));
+    if (left != progressShown) {
+        fillField(ui[UI_STAGE], BLACK);
+        tft.setTextColor(WHITE);
+        String seconds = (left % 60 < 10 ? "0" : "") + String(left % 60);
+        drawFieldText(ui[UI_STAGE], left > 0 ? "ready in " + String(left / 60) + ":" + seconds : "ready", 1);
+        progressShown = left;
+    }
+}
+
+// print the statistics of the background jobs (the serial command JOBS)
+void reportComputeStats() {
+    const char* names[] = {"plan", "predict", "eta"};
+    ComputeStats stats[COMPUTE_KINDS];
+    computeLock();
+    memcpy(stats, computeJobs.stats, sizeof(stats));
+    computeUnlock();
+    for (int kind = JOB_PLAN; kind <= JOB_ETA; kind++) {
+        const ComputeStats& s = stats[kind];
+        LOG("Jobs %s: done %u, cancelled %u, latency avg %ums max %ums, run max %ums", names[kind], s.done,
+            s.cancelled, s.done ? s.latencyTotal / s.done : 0, s.latencyMax, s.runMax);
+    }
+}
+
+// set up the reflow controller for a new run with the current profile and the board plan setting
+void startReflowControl() {
+    ReflowProfile profile = {preheatTemp, preheatTime, soakingTemp, soakingTime,
+                             reflowTemp, reflowTime, coolingTemp, coolingTime};
+    if (boardPlanEnabled && !(planned && samePlan(plannedFor, profileInput()))) planBoardProfile();
+    reflowControl.profile = profile;
+    reflowControl.plan = boardPlanEnabled ? plateSetpoints : NULL;
+    reflowControl.coolingTarget = 40;  // let the fans cool the plate down to 40 degrees
+    reflowControl.warp = timeWarpEnabled ? &defaultTimeWarp : NULL;
+    reflowStart(reflowControl);
+
+    // with the board probe connected, a profile can follow the board temperature instead of the plate
+    cascadeRunning = cascadeEnabled && characterizing;
+    if (cascadeRunning) {
+        cascade = cascadeControl(boardModel);
+        cascadeStart(cascade, TCCelsius);
+        LOG("Cascade control on the board probe");
+    }
+    // the policy table follows the profile with the plate, not the board plan
+    policyRunning = policyControl && !cascadeRunning && !boardPlanEnabled && policyMatches(policyTable, profile);
+    if (policyRunning) LOG("Policy table control");
+
+    runAnomalyReset(runAnomaly, anomalyPlate, TCCelsius);
+    anomalyFound = ANOMALY_NONE;
+    runAborted = false;
+}
+
+// print the planned and the actual duration of the phases of the last run
+void reportReflowTiming() {
+    const char* names[] = {"Preheat", "Soak", "Reflow", "Hold"};
+    LOG("Phase timing, profile time %.1fs at %.1fs", reflowControl.profileTime, reflowControl.lastTime);
+    for (int phase = PREHEAT; phase <= HOLD; phase++) {
+        int planned = reflowPlannedDuration(reflowControl.profile, (ReflowPhase)phase);
+        double actual = reflowActualDuration(reflowControl, (ReflowPhase)phase);
+        if (actual < 0) {
+            LOG("%s: planned %ds, actual -", names[phase], planned);
+        } else {
+            LOG("%s: planned %ds, actual %.1fs", names[phase], planned, actual);
+        }
+    }
+}
+
+/*
+  A step of the anomaly detector while the run heats, before the controller: the model is heated with
+  the power and the fans of the step before. The open thermocouple and the other error readings are
+  left to the controller. The first anomaly of the run is reported, with ANOMALY abort the heater goes
+  off right away and the run continues with the cooling phase.
+*/
+void checkRunAnomaly() {
+    if (reflowControl.phase == COOLING || TCCelsius >= 500) return;
+    RunAnomalyKind kind = runAnomalyStep(runAnomaly, anomalyPlate, runAnomalySettings, TCCelsius, heaterPower, fanOn,
+                                         SSRInterval / 1000.0);
+    if (kind == ANOMALY_NONE || anomalyFound != ANOMALY_NONE || anomalyAction == ANOMALY_OFF) return;
+    anomalyFound = kind;
+    LOG("Anomaly at %.0fs: the plate reads %.1fC %s the model (heater %.0fW, board %.0fJ/C)", elapsedHeatingTime,
+        fabs(runAnomaly.residual), kind == ANOMALY_LOW ? "below" : "above", runAnomaly.heater, runAnomaly.board);
+    if (anomalyAction != ANOMALY_ABORT) return;
+    heaterOff();
+    runAborted = true;
+    reflowControl.phase = COOLING;
+    reflowControl.phaseStart[COOLING] = elapsedHeatingTime;
+    LOG("Run aborted, the plate cools down");
+}
+
+// the background of the status field during a run: red after an anomaly
+uint16_t runStatusColor() {
+    return anomalyFound != ANOMALY_NONE ? RED : DGREEN;
+}
+
+// check for a thermocouple on the board: the probe chip answers and the thermocouple is not open
+bool probeConnected() {
+    // the bus to the probe: the read of the plate finishes (measureTemperature() still takes it) and its
+    // chip select goes high
+    thermoCouple.wait();
+    releaseConversions();
+    int status = boardProbe.read();
+    if (status != STATUS_OK) return false;
+    probeCelsius = boardProbe.getTemperature();
+    if (probeCelsius < 0 || probeCelsius > 100) return false;  // a board at the start of a run is cold
+    LOG("Board probe found, characterization run. Board temp: %.2f", probeCelsius);
+    return true;
+}
+
+// record the plate and board temperature every second of a characterization run and show the board curve
+void recordProbe() {
+    if (!characterizing) return;
+    tft.drawPixel(measuredTime_px, (int)(yGraph - (probeCelsius / tempPixelFactor)), MAGENTA);
+    if (probeCount < PLAN_SECONDS && elapsedHeatingTime >= probeCount) {
+        probePlate[probeCount] = (int16_t)round(TCCelsius * 10);
+        probeBoard[probeCount] = (int16_t)round(probeCelsius * 10);
+        probeCount++;
+    }
+}
+
+/*
+  The end of a characterization run: fit the board model and store it with the profile.
+  From now on, the reflow runs of this product follow the board-side plan.
+*/
+void finishCharacterization() {
+    if (!characterizing) return;
+    characterizing = false;
+    if (probeCount < probeMinSamples) {
+        LOG("Characterization: the run was too short for a fit");
+        return;
+    }
+    BoardModel fitted;
+    double error = fitBoardModel(probePlate, probeBoard, probeCount, &fitted);
+    if (error < 0) {
+        LOG("Characterization: no plausible board model, is the probe on the board?");
+        updateStatus(RED, WHITE, "No fit");
+        return;
+    }
+    boardModel = fitted;
+    boardModels.putBytes(boardModelKey(solderPasteSelected).c_str(), &boardModel, sizeof(boardModel));
+    boardPlanEnabled = true;
+    planBoardProfile();
+
+    LOG("Characterization: tau = %.1fs, loss = %.3f, ambient = %.1f, rms error = %.3f C/s", fitted.tau, fitted.loss,
+        fitted.ambient, error);
+    updateStatus(DGREEN, WHITE, "Learned");
+}
+
+// use the stored board model of the selected profile, or the default model without the board plan
+void loadBoardModel() {
+    String key = boardModelKey(solderPasteSelected);
+    BoardModel stored;
+    if (boardModels.getBytesLength(key.c_str()) == sizeof(stored) &&
+        boardModels.getBytes(key.c_str(), &stored, sizeof(stored)) == sizeof(stored)) {
+        boardModel = stored;
+        boardPlanEnabled = true;
+    } else {
+        boardModel = defaultBoardModel;
+        boardPlanEnabled = false;
+    }
+}
+
+// the NVS key for a profile: from its name, so it stays the same when the list of pastes changes (max 15 chars)
+String boardModelKey(int paste) {
+    const char* name = solderpastes[paste].pasteName;
+    uint32_t crc = runLogCrc32((const uint8_t*)name, strlen(name));
+    char key[12];
+    snprintf(key, sizeof(key), "b%08lx", (unsigned long)crc);
+    return String(key);
+}
+
+/*
+  Show the list of solder pastes on top of the chart, with the selected paste highlighted.
+  The list is scrolled so the selected paste is in the first row, unless that is near the end.
+*/
+void openPasteList() {
+    pasteListTop = solderPasteSelected;
+    if (pasteListTop > numSolderpastes - pasteListRows) pasteListTop = numSolderpastes - pasteListRows;
+    if (pasteListTop < 0) pasteListTop = 0;
+
+    const LayoutBox& list = ui[UI_PASTE_LIST];
+    tft.fillRect(list.x, list.y, list.w, list.h, BLACK);
+    tft.drawRect(list.x, list.y, list.w, list.h, WHITE);
+    for (int row = 0; row < pasteListRows && pasteListTop + row < numSolderpastes; row++) {
+        drawPasteListRow(pasteListTop + row, pasteListTop + row == solderPasteSelected);
+    }
+    drawPasteListScrollBar();
+    pasteListShown = solderPasteSelected;
+}
+
+/*
+  Follow the selection of the encoder in the list.
+  When the selected paste is visible, only the previous and the new row are redrawn.
+  Otherwise the list scrolls just enough to show it (or jumps when we wrapped around)
+  and only then all the visible rows are redrawn.
+*/
+void updatePasteList() {
+    int selected = solderPasteSelected;
+    if (selected == pasteListShown) return;
+
+    if (selected >= pasteListTop && selected < pasteListTop + pasteListRows) {
+        drawPasteListRow(pasteListShown, false);
+        drawPasteListRow(selected, true);
+    } else {
+        if (selected < pasteListTop) {
+            pasteListTop = selected;
+        } else {
+            pasteListTop = selected - pasteListRows + 1;
+        }
+        for (int row = 0; row < pasteListRows && pasteListTop + row < numSolderpastes; row++) {
+            drawPasteListRow(pasteListTop + row, pasteListTop + row == selected);
+        }
+        drawPasteListScrollBar();
+    }
+    pasteListShown = selected;
+}
+
+// the list is closed, the caller has to redraw the chart
+void closePasteList() {
+    pasteListShown = -1;
+}
+
+// draw a single row of the list, the name is read from flash only now
+void drawPasteListRow(int index, bool selected) {
+    const LayoutBox& list = ui[UI_PASTE_LIST];
+    int y = list.y + 2 + (index - pasteListTop) * pasteListRowH;
+    tft.fillRect(list.x + 2, y, list.w - 8, pasteListRowH, selected ? GREEN : BLACK);
+    tft.setTextColor(selected ? RED : WHITE);
+    tft.drawString(solderpastes[index].pasteName, list.x + 4, y, 2);
+}
+
+// a scroll bar on the right side of the list to show where we are in the list
+void drawPasteListScrollBar() {
+    const LayoutBox& list = ui[UI_PASTE_LIST];
+    int trackY = list.y + 2;
+    int trackH = pasteListRows * pasteListRowH;
+    int x = list.right() - 5;
+    tft.fillRect(x, trackY, 3, trackH, DGREY);
+    if (numSolderpastes > pasteListRows) {
+        int thumbH = max(4, trackH * pasteListRows / numSolderpastes);
+        int thumbY = trackY + (trackH - thumbH) * pasteListTop / (numSolderpastes - pasteListRows);
+        tft.fillRect(x, thumbY, 3, thumbH, WHITE);
+    } else {
+        tft.fillRect(x, trackY, 3, trackH, WHITE);
+    }
+}
+
+/*
+  The noise analysis task.
+  The readings are collected by measureTemperature(), here we wait for each of them to
+  show the progress and run the analysis when we have all of them. The result stays on
+  the display until the user stops the mode with the button.
+*/
+bool noiseTask(Task& t) {
+    TASK_BEGIN(t);
+    while (noiseCount < NOISE_SAMPLES) {
+        // show the progress in the PWM field
+        fillField(ui[UI_POWER], DGREEN);
+        tft.setTextColor(WHITE);
+        drawFieldText(ui[UI_POWER], "Rec " + String(noiseCount) + "/" + String(NOISE_SAMPLES), 2);
+        if (TCCelsius >= 100 && Output > 0) {  // don't let the plate get hot during the recording
+            Output = 0;
+            heaterOff();
+        }
+        TASK_WAIT_EVENT(t, TASK_EVENT_TEMPERATURE);
+    }
+    Output = 0;
+    heaterOff();  // done recording, the heater is no longer needed
+    analyzeNoise();
+    TASK_END(t);
+}
+
+/*
+  Analyze the recorded readings and show the result.
+
+  First the trend (the plate is heating or cooling) is removed with a straight line fit,
+  so only the noise is left. A Hann window reduces the leakage between the FFT bins.
+  The samples are converted to Q15 with 1/1024°C per count, the FFT scales down by 2 in
+  each stage, so a bin holds X/N. The dominant frequency is the largest bin above the
+  lowest two, these are what is left of the trend.
+  The notch filter is then tested on the recorded readings to see how much it helps.
+*/
+void analyzeNoise() {
+    static int16_t re[NOISE_SAMPLES];
+    static int16_t im[NOISE_SAMPLES];
+    static double residual[NOISE_SAMPLES];
+    static double filtered[NOISE_SAMPLES];
+    const int settle = 16;  // skip the start-up of the filter when comparing the noise levels
+
+    double sampleRate = (NOISE_SAMPLES - 1) * 1000.0 / (temperatureTimer - noiseStart);
+
+    // remove the trend: least squares straight line
+    double sumX = 0, sumY = 0, sumXY = 0, sumXX = 0;
+    for (int i = 0; i < NOISE_SAMPLES; i++) {
+        sumX += i;
+        sumY += noiseSamples[i];
+        sumXY += i * noiseSamples[i];
+        sumXX += (double)i * i;
+    }
+    double slope = (NOISE_SAMPLES * sumXY - sumX * sumY) / (NOISE_SAMPLES * sumXX - sumX * sumX);
+    double offset = (sumY - slope * sumX) / NOISE_SAMPLES;
+    for (int i = 0; i < NOISE_SAMPLES; i++) {
+        residual[i] = noiseSamples[i] - (offset + slope * i);
+    }
+
+    // windowed fixed-point FFT of the noise
+    for (int i = 0; i < NOISE_SAMPLES; i++) {
+        double hann = 0.5 - 0.5 * cos(2 * PI * i / (NOISE_SAMPLES - 1));
+        re[i] = (int16_t)constrain(residual[i] * hann * 1024, -32767.0, 32767.0);
+        im[i] = 0;
+    }
+    fixedFFT(re, im, NOISE_SAMPLES);
+
+    // amplitude per bin in °C: 2 * |X/N| for a one-sided spectrum, / 0.5 for the Hann window
+    double amplitude[NOISE_SAMPLES / 2];
+    double largest = 0;
+    int peakBin = 2;
+    for (int k = 0; k < NOISE_SAMPLES / 2; k++) {
+        amplitude[k] = 4.0 * sqrt((double)re[k] * re[k] + (double)im[k] * im[k]) / 1024;
+        if (k >= 2 && amplitude[k] > amplitude[peakBin]) peakBin = k;
+        if (k >= 2 && amplitude[k] > largest) largest = amplitude[k];
+    }
+    double peakFrequency = peakBin * sampleRate / NOISE_SAMPLES;
+
+    // try the notch on the recording
+    double before = noiseRMS(residual, settle, NOISE_SAMPLES);
+    setupNotch(peakFrequency, sampleRate);
+    for (int i = 0; i < NOISE_SAMPLES; i++) {
+        filtered[i] = notchFilter(residual[i]);
+    }
+    double after = noiseRMS(filtered, settle, NOISE_SAMPLES);
+    double reduction = (after > 0) ? 20 * log10(before / after) : 0;
+
+    // use the notch in the acquisition when it helps, with the state set to the current temperature
+    notchEnabled = reduction > 1.0;
+    notchX1 = notchX2 = notchY1 = notchY2 = TCCelsius;
+
+    // draw the spectrum in the chart area: 4px per bin, scaled to the largest bin
+    int barWidth = (ui[UI_CHART].w - 18) / (NOISE_SAMPLES / 2);
+    int maxHeight = yGraph - 110;
+    for (int k = 1; k < NOISE_SAMPLES / 2; k++) {
+        int height = (largest > 0) ? (int)(amplitude[k] / largest * maxHeight) : 0;
+        height = constrain(height, 0, maxHeight);
+        uint16_t color = (k == peakBin) ? RED : (k < 2) ? DGREY : YELLOW;
+        tft.fillRect(xGraph + 2 + k * barWidth, yGraph - height, barWidth - 1, height, color);
+    }
+    tft.setTextColor(WHITE);
+    tft.drawString("0Hz", xGraph + 2, yGraph + 3, 1);
+    tft.drawString(String(sampleRate / 2, 2) + "Hz", ui[UI_CHART].right() - 38, yGraph + 3, 1);
+
+    // and the numbers
+    const LayoutBox& result = ui[UI_NOISE_RESULT];
+    tft.fillRect(result.x, result.y, result.w, result.h, BLACK);
+    tft.drawString("Noise " + String(before, 2) + "`C rms", result.textX, result.textY, 2);
+    tft.drawString("Peak " + String(peakFrequency, 2) + "Hz " + String(amplitude[peakBin], 2) + "`C", result.textX, result.textY + 16, 2);
+    tft.drawString("Notch " + String(after, 2) + "`C " + String(-reduction, 1) + "dB " + (notchEnabled ? "on" : "off"), result.textX, result.textY + 32, 2);
+    updateStatus(DGREEN, WHITE, "Done");
+
+    LOG("Noise analysis: sample rate %.3fHz, noise %.3fC rms, peak at %.3fHz, after the notch %.3fC rms (%.1fdB), %s",
+        sampleRate, before, peakFrequency, after, -reduction, notchEnabled ? "notch enabled" : "notch not used");
+    LOG("Noise analysis: %d of %d conversions saw a switching edge, quiet sampling %s", noiseFlagged, NOISE_SAMPLES,
+        quietSampling ? "on" : "off");
+}
+
+/*
+  In-place radix-2 FFT on Q15 numbers.
+  Every stage divides by 2 to avoid an overflow, so the result is X/N.
+*/
+void fixedFFT(int16_t* re, int16_t* im, int n) {
+    if (twiddleCos[0] == 0) {  // calculate the coefficients the first time
+        for (int k = 0; k < NOISE_SAMPLES / 2; k++) {
+            twiddleCos[k] = (int16_t)round(32767 * cos(2 * PI * k / NOISE_SAMPLES));
+            twiddleSin[k] = (int16_t)round(32767 * sin(2 * PI * k / NOISE_SAMPLES));
+        }
+    }
+
+    // bit reversed order
+    for (int i = 1, j = 0; i < n; i++) {
+        int bit = n >> 1;
+        for (; j & bit; bit >>= 1) j ^= bit;
+        j ^= bit;
+        if (i < j) {
+            int16_t t = re[i];
+            re[i] = re[j];
+            re[j] = t;
+            t = im[i];
+            im[i] = im[j];
+            im[j] = t;
+        }
+    }
+
+    // the butterflies
+    for (int length = 2; length <= n; length <<= 1) {
+        int step = NOISE_SAMPLES / length;
+        for (int i = 0; i < n; i += length) {
+            for (int k = 0; k < length / 2; k++) {
+                int32_t wr = twiddleCos[k * step];
+                int32_t wi = -twiddleSin[k * step];
+                int a = i + k;
+                int b = a + length / 2;
+                int32_t tr = (wr * re[b] - wi * im[b]) >> 15;
+                int32_t ti = (wr * im[b] + wi * re[b]) >> 15;
+                re[b] = (re[a] - tr) >> 1;
+                im[b] = (im[a] - ti) >> 1;
+                re[a] = (re[a] + tr) >> 1;
+                im[a] = (im[a] + ti) >> 1;
+            }
+        }
+    }
+}
+
+/*
+  Calculate the notch filter for a frequency (Hz) at the sample rate (Hz).
+  The zeros are on the unit circle at the frequency, the poles just inside it (r = 0.9)
+  so the notch is narrow, about 0.13Hz at 4Hz. The gain is 1 at DC, so the temperature
+  itself is not changed.
+*/
+void setupNotch(double frequency, double sampleRate) {
+    const double r = 0.9;
+    double w = 2 * PI * frequency / sampleRate;
+    notchFrequency = frequency;
+    notchB1 = -2 * cos(w);
+    notchA1 = -2 * r * cos(w);
+    notchA2 = r * r;
+    notchGain = (1 + notchA1 + notchA2) / (2 + notchB1);
+    notchX1 = notchX2 = notchY1 = notchY2 = 0;
+}
+
+// filter one reading
+double notchFilter(double x) {
+    double y = notchGain * (x + notchB1 * notchX1 + notchX2) - notchA1 * notchY1 - notchA2 * notchY2;
+    notchX2 = notchX1;
+    notchX1 = x;
+    notchY2 = notchY1;
+    notchY1 = y;
+    return y;
+}
+
+// the RMS value of the samples from..to-1
+double noiseRMS(const double* samples, int from, int to) {
+    double sum = 0, sumSquares = 0;
+    for (int i = from; i < to; i++) {
+        sum += samples[i];
+        sumSquares += samples[i] * samples[i];
+    }
+    double mean = sum / (to - from);
+    return sqrt(sumSquares / (to - from) - mean * mean);
 }
 
 // ============== End of code
\ No newline at end of file
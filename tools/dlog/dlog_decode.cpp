@@ -0,0 +1,229 @@
+/*
+  dlog_decode: print the LOG() records of the controller as text
+
+  Usage: dlog_decode [--baud n] [--no-time] <firmware.elf> [serial port or capture file]
+
+  The format strings of LOG() are not in the flash, they are in the .dlog section of the ELF file
+  of the build (.pio/build/esp32doit-devkit-v1/firmware.elf), see include/dlog.h. The records on
+  the serial port have the offset of the format in that section, the time and the raw values of
+  the arguments. Use the ELF file of the firmware that is running, another build has other ids.
+
+  Without a port or file the input is stdin. The text that is not a record (the messages of the
+  boot loader) is passed on, the frames of the run log synchronization are skipped.
+
+  POSIX only (Linux, macOS), the ELF file can be 32 (ESP32) or 64 bits.
+*/
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "dlog.h"
+#include "logsync.h"
+
+namespace {
+
+struct Formats {
+    std::vector<char> strings;  // the .dlog section
+    uint16_t base = 0;          // the low 16 bits of the address of the section
+};
+
+template <class T>
+T field(const std::vector<uint8_t>& elf, size_t offset) {
+    T value = 0;
+    if (offset + sizeof(T) <= elf.size()) memcpy(&value, &elf[offset], sizeof(T));
+    return value;
+}
+
+// read the .dlog section from the section headers of a little-endian ELF file
+bool loadFormats(const char* path, Formats& formats) {
+    std::ifstream in(path, std::ios::binary);
+    std::vector<uint8_t> elf((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    if (elf.size() < 64 || memcmp(elf.data(), "\x7f" "ELF", 4) != 0 || elf[5] != 1) return false;
+    bool wide = elf[4] == 2;  // ELF64
+
+    uint64_t shoff = wide ? field<uint64_t>(elf, 0x28) : field<uint32_t>(elf, 0x20);
+    uint16_t shentsize = field<uint16_t>(elf, wide ? 0x3A : 0x2E);
+    uint16_t shnum = field<uint16_t>(elf, wide ? 0x3C : 0x30);
+    uint16_t shstrndx = field<uint16_t>(elf, wide ? 0x3E : 0x32);
+
+    auto section = [&](int i, uint32_t* name, uint64_t* addr, uint64_t* offset, uint64_t* size) {
+        size_t h = shoff + (size_t)i * shentsize;
+        *name = field<uint32_t>(elf, h);
+        *addr = wide ? field<uint64_t>(elf, h + 0x10) : field<uint32_t>(elf, h + 0x0C);
+        *offset = wide ? field<uint64_t>(elf, h + 0x18) : field<uint32_t>(elf, h + 0x10);
+        *size = wide ? field<uint64_t>(elf, h + 0x20) : field<uint32_t>(elf, h + 0x14);
+    };
+
+    uint32_t name;
+    uint64_t addr, offset, size, names;
+    section(shstrndx, &name, &addr, &names, &size);
+    for (int i = 0; i < shnum; i++) {
+        section(i, &name, &addr, &offset, &size);
+        if (names + name + 6 > elf.size() || memcmp(&elf[names + name], ".dlog", 6) != 0) continue;
+        if (offset + size > elf.size()) return false;
+        formats.strings.assign(elf.begin() + offset, elf.begin() + offset + size);
+        formats.strings.push_back(0);
+        formats.base = (uint16_t)addr;
+        return true;
+    }
+    return false;
+}
+
+/*
+  Format the arguments of a record with its format string, the way the device would have done.
+  Returns false when the arguments do not match the format: not a record after all.
+*/
+bool format(const char* f, const uint8_t* args, size_t length, std::string& text) {
+    size_t used = 0;
+    char piece[256];
+    while (*f) {
+        if (*f != '%') {
+            text += *f++;
+            continue;
+        }
+        std::string spec = "%";
+        f++;
+        while (*f && strchr("-+ #0123456789.", *f)) spec += *f++;
+        while (*f && strchr("hlLqjzt", *f)) f++;  // the values are 32 bits or a float anyway
+        char conversion = *f ? *f++ : 0;
+        spec += conversion;
+        if (conversion == '%') {
+            text += '%';
+            continue;
+        }
+        if (conversion == 's') {
+            if (used + 1 > length || used + 1 + args[used] > length) return false;
+            std::string s((const char*)args + used + 1, args[used]);
+            used += 1 + args[used];
+            snprintf(piece, sizeof(piece), spec.c_str(), s.c_str());
+        } else if (strchr("diuxXoc", conversion) && conversion) {
+            if (used + 4 > length) return false;
+            int32_t v;
+            memcpy(&v, args + used, 4);
+            used += 4;
+            snprintf(piece, sizeof(piece), spec.c_str(), v);
+        } else if (strchr("fFeEgGaA", conversion) && conversion) {
+            if (used + 4 > length) return false;
+            float v;
+            memcpy(&v, args + used, 4);
+            used += 4;
+            snprintf(piece, sizeof(piece), spec.c_str(), (double)v);
+        } else {
+            return false;
+        }
+        text += piece;
+    }
+    return used == length;
+}
+
+int openInput(const char* path, int baud) {
+    if (!path || strcmp(path, "-") == 0) return STDIN_FILENO;
+    int fd = open(path, O_RDONLY | O_NOCTTY);
+    if (fd < 0 || !isatty(fd)) return fd;
+    termios tio;
+    if (tcgetattr(fd, &tio) == 0) {
+        cfmakeraw(&tio);
+        tio.c_cflag |= CLOCAL | CREAD;
+        tio.c_cflag &= ~HUPCL;  // don't reset the controller when we close the port
+        speed_t speed = baud == 9600 ? B9600 : baud == 57600 ? B57600 : baud == 230400 ? B230400 : B115200;
+        cfsetispeed(&tio, speed);
+        cfsetospeed(&tio, speed);
+        tcsetattr(fd, TCSANOW, &tio);
+    }
+    return fd;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    int baud = 115200;
+    bool time = true;
+    const char* elf = nullptr;
+    const char* input = nullptr;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--baud") == 0 && i + 1 < argc) {
+            baud = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--no-time") == 0) {
+            time = false;
+        } else if (!elf) {
+            elf = argv[i];
+        } else {
+            input = argv[i];
+        }
+    }
+    if (!elf) {
+        fprintf(stderr, "Usage: dlog_decode [--baud n] [--no-time] <firmware.elf> [serial port or capture file]\n");
+        return 2;
+    }
+
+    Formats formats;
+    if (!loadFormats(elf, formats)) {
+        fprintf(stderr, "no .dlog section in %s\n", elf);
+        return 1;
+    }
+    int fd = openInput(input, baud);
+    if (fd < 0) {
+        perror(input);
+        return 1;
+    }
+
+    std::vector<uint8_t> buffer;
+    uint8_t bytes[4096];
+    ssize_t n;
+    while ((n = read(fd, bytes, sizeof(bytes))) > 0) {
+        buffer.insert(buffer.end(), bytes, bytes + n);
+
+        size_t used = 0;
+        while (used < buffer.size()) {
+            const uint8_t* p = buffer.data() + used;
+            size_t available = buffer.size() - used;
+
+            LogSyncFrame frame;
+            int size = logSyncCheck(p, available, &frame);
+            if (size > 0) {
+                used += size;
+                continue;
+            }
+            if (size == 0) break;  // maybe a frame, wait for the rest
+            if (p[0] != DLOG_START) {
+                putchar(p[0]);
+                used++;
+                continue;
+            }
+            if (available < 2 || available < (size_t)p[1] + 3) break;
+
+            // a record when the sum, the id and the arguments all check out
+            size_t length = p[1];
+            uint8_t sum = 0;
+            for (size_t i = 2; i < length + 2; i++) sum += p[i];
+            uint16_t id;
+            uint32_t ms;
+            memcpy(&id, p + 2, sizeof(id));
+            memcpy(&ms, p + 4, sizeof(ms));
+            uint16_t offset = (uint16_t)(id - formats.base);
+            std::string text;
+            if (length >= DLOG_HEADER - 2 && sum == p[length + 2] && offset < formats.strings.size() &&
+                format(&formats.strings[offset], p + DLOG_HEADER, length + 2 - DLOG_HEADER, text)) {
+                if (time) printf("[%10.3f] ", ms / 1000.0);
+                printf("%s\n", text.c_str());
+                used += length + 3;
+            } else {
+                putchar(p[0]);
+                used++;
+            }
+        }
+        buffer.erase(buffer.begin(), buffer.begin() + used);
+        fflush(stdout);
+    }
+    fwrite(buffer.data(), 1, buffer.size(), stdout);  // the end of a capture file
+    return 0;
+}
@@ -0,0 +1,404 @@
+#include "plate2d.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+namespace {
+
+const double controlInterval = 0.25;  // s, the SSRInterval of the firmware
+
+// the workers meet here after every time step
+class Barrier {
+public:
+    explicit Barrier(int count) : count(count) {}
+
+    void wait() {
+        int generation = this->generation.load(std::memory_order_acquire);
+        if (waiting.fetch_add(1, std::memory_order_acq_rel) + 1 == count) {
+            waiting.store(0, std::memory_order_relaxed);
+            this->generation.fetch_add(1, std::memory_order_acq_rel);
+            return;
+        }
+        for (int spin = 0; this->generation.load(std::memory_order_acquire) == generation; spin++) {
+            if (spin > 1000) std::this_thread::yield();  // more workers than cores
+        }
+    }
+
+private:
+    const int count;
+    std::atomic<int> waiting{0};
+    std::atomic<int> generation{0};
+};
+
+}  // namespace
+
+Plate2DConfig Plate2DConfig::load(const std::string& path) {
+    std::ifstream file(path);
+    if (!file) throw std::runtime_error("cannot open " + path);
+    Plate2DConfig c;
+    std::string line;
+    int number = 0;
+    while (std::getline(file, line)) {
+        number++;
+        line = line.substr(0, line.find('#'));
+        std::istringstream in(line);
+        std::string key;
+        if (!(in >> key)) continue;
+        bool ok = true;
+        if (key == "plate") {
+            ok = static_cast<bool>(in >> c.width >> c.height >> c.thickness);
+        } else if (key == "grid") {
+            ok = static_cast<bool>(in >> c.cell);
+        } else if (key == "ambient") {
+            ok = static_cast<bool>(in >> c.ambient);
+        } else if (key == "convection") {
+            ok = static_cast<bool>(in >> c.convection >> c.fanConvection);
+        } else if (key == "element") {
+            Element2D e;
+            std::string shape;
+            ok = static_cast<bool>(in >> e.name >> e.power >> shape >> e.x0 >> e.y0 >> e.x1 >> e.y1);
+            e.width = 0;
+            if (ok && shape == "ring") {
+                ok = static_cast<bool>(in >> e.width);
+            } else if (shape != "rect") {
+                ok = false;
+            }
+            if (ok) c.elements.push_back(e);
+        } else if (key == "element_tau") {
+            ok = static_cast<bool>(in >> c.elementTau);
+        } else if (key == "board") {
+            Board2D b;
+            ok = static_cast<bool>(in >> b.x >> b.y >> b.width >> b.height >> b.thickness);
+            if (ok) c.boards.push_back(b);
+        } else if (key == "contact") {
+            ok = static_cast<bool>(in >> c.boardContact);
+        } else if (key == "sensor") {
+            ok = static_cast<bool>(in >> c.sensorX >> c.sensorY);
+        } else if (key == "sensor_tau") {
+            ok = static_cast<bool>(in >> c.sensorTau);
+        } else {
+            ok = false;
+        }
+        if (!ok) throw std::runtime_error(path + ":" + std::to_string(number) + ": cannot read \"" + line + "\"");
+    }
+    if (c.elements.empty()) throw std::runtime_error(path + ": no heating elements");
+    return c;
+}
+
+Plate2D::Plate2D(const Plate2DConfig& c) : config(c) {
+    nx = (int)std::lround(c.width / c.cell);
+    ny = (int)std::lround(c.height / c.cell);
+    stride = nx + 2;
+    size_t cells = (size_t)stride * (ny + 2);
+
+    // the explicit scheme is stable for alpha dt / dx2 <= 1/4, keep some margin and fit a whole number of steps in 250ms
+    double dx = c.cell / 1000;
+    double alpha = c.conductivity / (c.density * c.heatCapacity);
+    double maxStep = 0.9 * dx * dx / (4 * alpha);
+    stepsPerInterval = (int)std::ceil(controlInterval / maxStep);
+    dt = controlInterval / stepsPerInterval;
+    diffusion = (float)(alpha * dt / (dx * dx));
+
+    plate.assign(cells, (float)c.ambient);
+    next.assign(cells, (float)c.ambient);
+    board.assign(cells, (float)c.ambient);
+    heat.assign(cells, 0);
+    loss.assign(cells, 0);
+    fanLoss.assign(cells, 0);
+    toBoard.assign(cells, 0);
+    fromPlate.assign(cells, 0);
+    boardLoss.assign(cells, 0);
+    boardIndex.assign(cells, -1);
+    peak.assign(cells, (float)c.ambient);
+    above.assign(cells, 0);
+
+    double plateCapacity = c.density * c.heatCapacity * c.thickness / 1000;  // J/(m2 K)
+    auto cellCenter = [&](int x, int y, double& mmX, double& mmY) {
+        mmX = (x + 0.5) * c.cell;
+        mmY = (y + 0.5) * c.cell;
+    };
+
+    // the elements: their power is spread evenly over the cells they cover
+    for (const Element2D& e : c.elements) {
+        std::vector<int> covered;
+        for (int y = 0; y < ny; y++) {
+            for (int x = 0; x < nx; x++) {
+                double mx, my;
+                cellCenter(x, y, mx, my);
+                bool inside = mx >= e.x0 && mx < e.x1 && my >= e.y0 && my < e.y1;
+                if (inside && e.width > 0) {
+                    inside = mx < e.x0 + e.width || mx >= e.x1 - e.width || my < e.y0 + e.width || my >= e.y1 - e.width;
+                }
+                if (inside) covered.push_back((y + 1) * stride + x + 1);
+            }
+        }
+        if (covered.empty()) throw std::runtime_error("element " + e.name + " is not on the plate");
+        double density = e.power / (covered.size() * dx * dx);  // W/m2
+        for (int i : covered) heat[i] += (float)(density / plateCapacity);
+    }
+
+    // the boards
+    for (size_t b = 0; b < c.boards.size(); b++) {
+        const Board2D& board = c.boards[b];
+        double capacity = c.boardDensity * c.boardHeatCapacity * board.thickness / 1000;
+        for (int y = 0; y < ny; y++) {
+            for (int x = 0; x < nx; x++) {
+                double mx, my;
+                cellCenter(x, y, mx, my);
+                if (mx >= board.x && mx < board.x + board.width && my >= board.y && my < board.y + board.height) {
+                    int i = (y + 1) * stride + x + 1;
+                    boardIndex[i] = (int)b;
+                    toBoard[i] = (float)(c.boardContact / plateCapacity);
+                    fromPlate[i] = (float)(c.boardContact / capacity);
+                    boardLoss[i] = (float)(c.convection / capacity);
+                }
+            }
+        }
+    }
+
+    // the air: the top of the plate where there is no board, and the edges
+    for (int y = 0; y < ny; y++) {
+        for (int x = 0; x < nx; x++) {
+            int i = (y + 1) * stride + x + 1;
+            double area = boardIndex[i] < 0 ? 1.0 : 0.0;  // relative to the cell area
+            int edges = (x == 0) + (x == nx - 1) + (y == 0) + (y == ny - 1);
+            area += edges * c.thickness / c.cell;
+            loss[i] = (float)(area * c.convection / plateCapacity);
+            fanLoss[i] = (float)(area * c.fanConvection / plateCapacity);
+        }
+    }
+
+    int sx = std::min(nx - 1, std::max(0, (int)(c.sensorX / c.cell)));
+    int sy = std::min(ny - 1, std::max(0, (int)(c.sensorY / c.cell)));
+    sensorCell = (sy + 1) * stride + sx + 1;
+    sensor = c.ambient;
+    power = 0;
+    fan = false;
+    elementPower = 0;
+    threads = 1;
+}
+
+/*
+  One time step for the rows first..last-1 from the plate temperatures in from to those in to.
+  The board layer is updated in place, it only depends on its own cell. The ghost cells of
+  these rows are set for the next step.
+*/
+void Plate2D::stepRows(int first, int last, const float* from, float* to, float p, bool fanOn) {
+    const float ambient = (float)config.ambient;
+    const float step = (float)dt;
+    const float r = diffusion;
+    const float fanFactor = fanOn ? 1.0f : 0.0f;
+    const float boardAir = fanOn ? (float)((config.convection + config.fanConvection) / config.convection) : 1.0f;
+
+    for (int y = first; y < last; y++) {
+        size_t row = (size_t)(y + 1) * stride + 1;
+        const float* __restrict t = from + row;
+        const float* __restrict up = t - stride;
+        const float* __restrict down = t + stride;
+        float* __restrict out = to + row;
+        float* __restrict b = board.data() + row;
+        const float* __restrict q = heat.data() + row;
+        const float* __restrict l = loss.data() + row;
+        const float* __restrict fl = fanLoss.data() + row;
+        const float* __restrict tb = toBoard.data() + row;
+        const float* __restrict fp = fromPlate.data() + row;
+        const float* __restrict bl = boardLoss.data() + row;
+
+        for (int x = 0; x < nx; x++) {
+            float contact = t[x] - b[x];
+            float laplace = t[x - 1] + t[x + 1] + up[x] + down[x] - 4 * t[x];
+            out[x] = t[x] + r * laplace + step * (p * q[x] - (l[x] + fanFactor * fl[x]) * (t[x] - ambient) - tb[x] * contact);
+            b[x] = b[x] + step * (fp[x] * contact - boardAir * bl[x] * (b[x] - ambient));
+        }
+        // insulated edges: the ghost cells mirror the edge cells
+        out[-1] = out[0];
+        out[nx] = out[nx - 1];
+    }
+    if (first == 0) std::copy(to + stride, to + 2 * stride, to);
+    if (last == ny) std::copy(to + (size_t)ny * stride, to + (size_t)(ny + 1) * stride, to + (size_t)(ny + 1) * stride);
+}
+
+// the peak temperatures and the time above liquidus, at the end of every controller interval
+void Plate2D::updateStatistics(int first, int last, float interval) {
+    for (int y = first; y < last; y++) {
+        size_t row = (size_t)(y + 1) * stride + 1;
+        for (int x = 0; x < nx; x++) {
+            size_t i = row + x;
+            float t = boardIndex[i] >= 0 ? board[i] : plate[i];
+            peak[i] = std::max(peak[i], t);
+            if (t >= liquidus) above[i] += interval;
+        }
+    }
+}
+
+Plate2DSample Plate2D::sampleState(double time) const {
+    Plate2DSample s;
+    s.time = time;
+    s.reading = sensor;
+    s.setpoint = 0;
+    s.power = power;
+    s.phase = 0;
+    s.fan = fan;
+    s.plateMin = 1e9;
+    s.plateMax = -1e9;
+    size_t boards = config.boards.size();
+    std::vector<double> sum(boards, 0);
+    std::vector<int> count(boards, 0);
+    s.boardMin.assign(boards, 1e9);
+    s.boardMax.assign(boards, -1e9);
+    for (int y = 0; y < ny; y++) {
+        for (int x = 0; x < nx; x++) {
+            size_t i = (size_t)(y + 1) * stride + x + 1;
+            s.plateMin = std::min<double>(s.plateMin, plate[i]);
+            s.plateMax = std::max<double>(s.plateMax, plate[i]);
+            int b = boardIndex[i];
+            if (b >= 0) {
+                sum[b] += board[i];
+                count[b]++;
+                s.boardMin[b] = std::min<double>(s.boardMin[b], board[i]);
+                s.boardMax[b] = std::max<double>(s.boardMax[b], board[i]);
+            }
+        }
+    }
+    s.boardMean.resize(boards);
+    for (size_t b = 0; b < boards; b++) s.boardMean[b] = count[b] ? sum[b] / count[b] : 0;
+    return s;
+}
+
+void Plate2D::run(double duration, unsigned workers,
+                  const std::function<void(double, double, Plate2DControl&)>& controller,
+                  const std::function<void(const Plate2DSample&)>& sample) {
+    std::fill(plate.begin(), plate.end(), (float)config.ambient);
+    std::fill(next.begin(), next.end(), (float)config.ambient);
+    std::fill(board.begin(), board.end(), (float)config.ambient);
+    std::fill(peak.begin(), peak.end(), (float)config.ambient);
+    std::fill(above.begin(), above.end(), 0.0f);
+    sensor = config.ambient;
+    elementPower = 0;
+
+    if (workers == 0) workers = std::max(1u, std::thread::hardware_concurrency());
+    threads = (int)std::min<unsigned>(workers, (unsigned)ny);
+    int intervals = (int)std::ceil(duration / controlInterval);
+    double decay = std::exp(-dt / config.elementTau);           // the element lag per step
+    double sensorDecay = std::exp(-controlInterval / config.sensorTau);
+    Barrier barrier(threads);
+    Plate2DControl control = {0, false};
+
+    // worker w does the rows [w * ny / threads, (w + 1) * ny / threads)
+    auto worker = [&](int w) {
+        int first = w * ny / threads;
+        int last = (w + 1) * ny / threads;
+        for (int k = 0; k < intervals; k++) {
+            if (w == 0) {
+                // the controller sees the thermocouple, with its lag and resolution
+                double reading = std::floor(sensor / config.sensorResolution) * config.sensorResolution;
+                controller(k * controlInterval, reading, control);
+                power = std::min(255, std::max(0, control.power));
+                fan = control.fan;
+            }
+            barrier.wait();
+            // all workers calculate the same lagged element power
+            double target = power / 255.0;
+            double element = elementPower;
+            bool fanOn = fan;
+            float* from = plate.data();
+            float* to = next.data();
+            for (int s = 0; s < stepsPerInterval; s++) {
+                element = target + (element - target) * decay;
+                stepRows(first, last, from, to, (float)element, fanOn);
+                std::swap(from, to);
+                barrier.wait();
+            }
+            if (w == 0 && from != plate.data()) plate.swap(next);
+            barrier.wait();
+            updateStatistics(first, last, (float)controlInterval);
+            barrier.wait();
+            if (w == 0) {
+                elementPower = element;
+                sensor = plate[sensorCell] + (sensor - plate[sensorCell]) * sensorDecay;
+                sample(sampleState((k + 1) * controlInterval));
+            }
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (int w = 1; w < threads; w++) pool.emplace_back(worker, w);
+    worker(0);
+    for (std::thread& t : pool) t.join();
+}
+
+void Plate2D::runReflow(const ReflowProfile& profile, const int16_t* plan, double duration, unsigned workers,
+                        const std::function<void(const Plate2DSample&)>& sample) {
+    ReflowControl control;
+    control.profile = profile;
+    control.plan = plan;
+    control.coolingTarget = 40;
+    control.warp = nullptr;
+    reflowStart(control);
+    double setpoint = 0;
+    int phase = PREHEAT;
+
+    run(
+        duration, workers,
+        [&](double time, double reading, Plate2DControl& c) {
+            phase = control.phase;
+            reflowStep(control, time, reading);
+            setpoint = control.target;
+            c.power = control.output;
+            c.fan = control.fan;
+        },
+        [&](const Plate2DSample& s) {
+            Plate2DSample copy = s;
+            copy.setpoint = setpoint;
+            copy.phase = phase;
+            sample(copy);
+        });
+}
+
+void Plate2D::runHeating(double target, bool warmup, double duration, unsigned workers,
+                         const std::function<void(const Plate2DSample&)>& sample) {
+    HeatingControl control = warmup ? warmupControl(target) : freeHeatingControl(target);
+    int stage = RAMPUP;
+
+    run(
+        duration, workers,
+        [&](double, double reading, Plate2DControl& c) {
+            stage = heatingStep(control, reading);
+            c.power = control.output;
+            c.fan = false;
+        },
+        [&](const Plate2DSample& s) {
+            Plate2DSample copy = s;
+            copy.setpoint = target;
+            copy.phase = stage;
+            sample(copy);
+        });
+}
+
+std::vector<Board2DResult> Plate2D::boardResults() const {
+    std::vector<Board2DResult> results(config.boards.size(), Board2DResult{1e9, -1e9, 1e9, -1e9});
+    for (size_t i = 0; i < boardIndex.size(); i++) {
+        int b = boardIndex[i];
+        if (b < 0) continue;
+        Board2DResult& r = results[b];
+        r.peakMin = std::min<double>(r.peakMin, peak[i]);
+        r.peakMax = std::max<double>(r.peakMax, peak[i]);
+        r.aboveMin = std::min<double>(r.aboveMin, above[i]);
+        r.aboveMax = std::max<double>(r.aboveMax, above[i]);
+    }
+    return results;
+}
+
+std::vector<float> Plate2D::peakMap() const {
+    std::vector<float> map((size_t)nx * ny);
+    for (int y = 0; y < ny; y++) {
+        std::copy(peak.begin() + (size_t)(y + 1) * stride + 1, peak.begin() + (size_t)(y + 1) * stride + 1 + nx,
+                  map.begin() + (size_t)y * nx);
+    }
+    return map;
+}
@@ -0,0 +1,163 @@
+/*
+  2D thermal model of the hotplate
+
+  The plate is a grid of square cells (1mm by default) with the heat equation solved by an
+  explicit finite difference scheme. The heating elements, the boards on the plate and the
+  sensor position are described in a small text file (see uyue946c.cfg):
+
+    plate 200 200 3            width and height (mm), thickness (mm), aluminium
+    grid 1                     cell size in mm
+    element main 400 ring 15 15 185 185 10     name, power (W), ring x0 y0 x1 y1 width (mm)
+    element extra 300 rect 50 50 150 150       name, power (W), rect x0 y0 x1 y1 (mm)
+    board 60 70 80 60 1.6      x y width height (mm), thickness (mm), FR4
+    sensor 100 100             the thermocouple position (mm)
+
+  Every cell has the plate temperature, the cells under a board also have a board temperature
+  (a board layer without lateral conduction, coupled to the plate by the contact conductance).
+  The plate loses heat to the air on the top and at the edges, more with the fans on, the bottom
+  is insulated. Both elements are switched by the one SSR.
+
+  The solver works on contiguous rows with a ghost border, the inner loop has no branches so the
+  compiler vectorizes it. The rows are divided over a worker per core, the workers meet at a
+  barrier after every time step. Every 250ms the controller of the firmware (reflow_control.h)
+  gets the sensor reading and sets the power, like runReflow() does.
+*/
+#ifndef PLATE2D_H
+#define PLATE2D_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "reflow_control.h"
+
+struct Element2D {
+    std::string name;
+    double power;              // W at full PWM
+    double x0, y0, x1, y1;     // mm, the outline
+    double width;              // mm, the width of the trace of a ring, 0 for a filled rectangle
+};
+
+struct Board2D {
+    double x, y, width, height;  // mm
+    double thickness;            // mm
+};
+
+struct Plate2DConfig {
+    double width = 200, height = 200;   // mm
+    double thickness = 3;               // mm
+    double cell = 1;                    // mm
+    // aluminium
+    double conductivity = 167;          // W/(m K)
+    double density = 2700;              // kg/m3
+    double heatCapacity = 900;          // J/(kg K)
+    // air
+    double ambient = 20;                // °C
+    double convection = 12;             // W/(m2 K), top and edges, including radiation (linearized)
+    double fanConvection = 30;          // W/(m2 K) extra with the fans on
+    // the heating elements
+    std::vector<Element2D> elements;
+    double elementTau = 8;              // s, the lag of the elements
+    // the boards, FR4
+    std::vector<Board2D> boards;
+    double boardDensity = 1850;         // kg/m3
+    double boardHeatCapacity = 1100;    // J/(kg K)
+    double boardContact = 200;          // W/(m2 K), plate to board
+    // the thermocouple
+    double sensorX = 100, sensorY = 100;  // mm
+    double sensorTau = 2;               // s
+    double sensorResolution = 0.25;     // °C
+
+    // read a configuration file, the defaults stay for what is not in the file; throws on errors
+    static Plate2DConfig load(const std::string& path);
+};
+
+// The state at a controller step
+struct Plate2DSample {
+    double time;           // s
+    double reading;        // °C, the sensor
+    double setpoint;       // °C
+    int power;             // PWM
+    int phase;             // ReflowPhase
+    bool fan;
+    double plateMin, plateMax;   // °C
+    std::vector<double> boardMean, boardMin, boardMax;  // °C, per board
+};
+
+// Per board results of a run
+struct Board2DResult {
+    double peakMin, peakMax;    // °C, the lowest and highest peak temperature on the board
+    double aboveMin, aboveMax;  // s, the shortest and longest time above the liquidus temperature
+};
+
+// What a controller sets for the next 250ms
+struct Plate2DControl {
+    int power;    // PWM 0..255
+    bool fan;
+};
+
+class Plate2D {
+public:
+    explicit Plate2D(const Plate2DConfig& config);
+
+    int columns() const { return nx; }
+    int rows() const { return ny; }
+    double timeStep() const { return dt; }
+    void setLiquidus(double celsius) { liquidus = (float)celsius; }
+
+    /*
+      Run from the ambient temperature for duration seconds. Every 250ms the controller gets the
+      time and the sensor reading and sets the power and the fans, then sample() gets the state.
+    */
+    void run(double duration, unsigned threads,
+             const std::function<void(double time, double reading, Plate2DControl& control)>& controller,
+             const std::function<void(const Plate2DSample&)>& sample);
+
+    // The reflow controller of the firmware, with the profile and the optional board-side plan
+    void runReflow(const ReflowProfile& profile, const int16_t* plan, double duration, unsigned threads,
+                   const std::function<void(const Plate2DSample&)>& sample);
+
+    // The free heating or warmup controller of the firmware
+    void runHeating(double target, bool warmup, double duration, unsigned threads,
+                    const std::function<void(const Plate2DSample&)>& sample);
+
+    // The results per board of the last run
+    std::vector<Board2DResult> boardResults() const;
+
+    // The peak temperature of every cell of the last run, the board temperature under the boards (ny rows of nx)
+    std::vector<float> peakMap() const;
+
+private:
+    void stepRows(int first, int last, const float* from, float* to, float power, bool fan);
+    void updateStatistics(int first, int last, float interval);
+    Plate2DSample sampleState(double time) const;
+
+    Plate2DConfig config;
+    int nx, ny, stride;       // cells, the stride includes the ghost border
+    double dt;                // s
+    int stepsPerInterval;
+    float diffusion;          // alpha dt / dx2
+    // per cell, with a ghost border
+    std::vector<float> plate, next, board;  // next is the other buffer of the plate during a step
+    std::vector<float> heat;          // K/s at full power
+    std::vector<float> loss;          // 1/s to the ambient air
+    std::vector<float> fanLoss;       // 1/s extra with the fans on
+    std::vector<float> toBoard;       // 1/s, plate side of the contact with a board
+    std::vector<float> fromPlate;     // 1/s, board side of the contact
+    std::vector<float> boardLoss;     // 1/s, board to the air
+    std::vector<int> boardIndex;      // the board on a cell, -1 for none
+    std::vector<float> peak;          // °C
+    std::vector<float> above;         // s above the liquidus
+    float liquidus = 183;
+    int sensorCell;
+    double sensor;                    // °C, the lagged sensor temperature
+    // what the controller set and what the elements do with it
+    int power;
+    bool fan;
+    double elementPower;              // 0..1, the lagged power of the elements
+    // the current run
+    int threads;
+};
+
+#endif  // PLATE2D_H
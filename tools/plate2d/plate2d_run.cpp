@@ -0,0 +1,96 @@
+/*
+  plate2d_run: a reflow run on the 2D model of the plate, printed as CSV
+
+  Usage: plate2d_run [--threads n] [--peak file.csv] [--liquidus C] config.cfg
+                     [preheatTemp preheatTime soakingTemp soakingTime reflowTemp reflowTime coolingTemp coolingTime]
+
+  Prints a line per second with the sensor reading, the setpoint, the power, the lowest and
+  highest plate temperature and the mean temperature of every board. The peak temperature and
+  the time above liquidus of every board go to stderr, --peak writes the peak temperature of
+  every cell as a grid (rows of the plate) for a heat map.
+*/
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#include "plate2d.h"
+
+int main(int argc, char** argv) {
+    ReflowProfile profile = {90, 90, 130, 180, 165, 240, 165, 250};  // Sn42/Bi57.6/Ag0.4
+    double liquidus = 138;
+    unsigned threads = 0;
+    const char* peakFile = nullptr;
+    const char* configFile = nullptr;
+    std::vector<int> values;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threads = strtoul(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--peak") == 0 && i + 1 < argc) {
+            peakFile = argv[++i];
+        } else if (strcmp(argv[i], "--liquidus") == 0 && i + 1 < argc) {
+            liquidus = atof(argv[++i]);
+        } else if (!configFile) {
+            configFile = argv[i];
+        } else {
+            values.push_back(atoi(argv[i]));
+        }
+    }
+    if (values.size() == 8) {
+        profile = {values[0], values[1], values[2], values[3], values[4], values[5], values[6], values[7]};
+    } else if (!configFile || !values.empty()) {
+        fprintf(stderr, "usage: %s [--threads n] [--peak file.csv] [--liquidus C] config.cfg [8 profile values]\n", argv[0]);
+        return 2;
+    }
+
+    Plate2DConfig config;
+    try {
+        config = Plate2DConfig::load(configFile);
+    } catch (const std::exception& e) {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    Plate2D model(config);
+    model.setLiquidus(liquidus);
+    fprintf(stderr, "%d x %d cells, time step %.2fms\n", model.columns(), model.rows(), model.timeStep() * 1000);
+
+    printf("time_s,reading_C,setpoint_C,power,phase,fan,plate_min_C,plate_max_C");
+    for (size_t b = 0; b < config.boards.size(); b++) printf(",board%zu_C", b + 1);
+    printf("\n");
+
+    auto start = std::chrono::steady_clock::now();
+    model.runReflow(profile, nullptr, 340, threads, [&](const Plate2DSample& s) {
+        if (std::lround(s.time * 4) % 4 != 0) return;  // a line per second
+        printf("%.0f,%.2f,%.1f,%d,%d,%d,%.1f,%.1f", s.time, s.reading, s.setpoint, s.power, s.phase, s.fan, s.plateMin,
+               s.plateMax);
+        for (double t : s.boardMean) printf(",%.1f", t);
+        printf("\n");
+    });
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    fprintf(stderr, "340s simulated in %.1fs\n", seconds);
+
+    std::vector<Board2DResult> results = model.boardResults();
+    for (size_t b = 0; b < results.size(); b++) {
+        const Board2DResult& r = results[b];
+        fprintf(stderr, "board %zu: peak %.1f..%.1f°C, %.0f..%.0fs above %.0f°C\n", b + 1, r.peakMin, r.peakMax,
+                r.aboveMin, r.aboveMax, liquidus);
+    }
+
+    if (peakFile) {
+        FILE* f = fopen(peakFile, "w");
+        if (!f) {
+            fprintf(stderr, "cannot write %s\n", peakFile);
+            return 1;
+        }
+        std::vector<float> map = model.peakMap();
+        for (int y = 0; y < model.rows(); y++) {
+            for (int x = 0; x < model.columns(); x++) fprintf(f, x ? ",%.1f" : "%.1f", map[(size_t)y * model.columns() + x]);
+            fprintf(f, "\n");
+        }
+        fclose(f);
+    }
+    return 0;
+}
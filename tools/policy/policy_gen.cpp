@@ -0,0 +1,402 @@
+/*
+  policy_gen: solve the reflow control policy offline and write it as a header for the firmware
+
+  Usage: policy_gen [--out policy_table.h] [--threads n] [--seeds n]
+                    [preheatTemp preheatTime soakingTemp soakingTime reflowTemp reflowTime coolingTemp coolingTime]
+
+  The plate is the lumped model of include/plate_model.h, reduced to the element and the plate:
+  with the plate temperature and its rate known, the element temperature follows from the
+  coupling, so (setpoint, error, rate) is the complete state. The setpoint moves along the
+  profile, with the slope of the profile at that temperature.
+
+  Value iteration on a fine grid gives the cost of every state: the squared error, with the
+  overshoot weighted much heavier than the lag, and a little bit for the power. The policy is
+  then the best PWM value (in steps of 8) on the coarse grid of the table, with a look ahead of
+  one step on the fine cost. The accuracy of the table is reported as the difference to the
+  best PWM value on the fine grid and as the cost of that difference, and with closed loop runs
+  on the full plate model (sensor lag, noise and the dT/dt filter of the firmware) against the
+  reflowStep() controller.
+*/
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <thread>
+#include <vector>
+
+#include "plate_model.h"
+#include "policy.h"
+#include "reflow_control.h"
+
+namespace {
+
+struct Grid {
+    double first, step;
+    int count;
+
+    double value(int i) const { return first + i * step; }
+};
+
+// the fine grid of the value iteration and the coarse grid of the table
+const Grid fineSetpoint = {20, 5, 49};       // 20..260°C
+const Grid fineError = {-40, 0.5, 121};      // -40..20°C
+const Grid fineRate = {-1.5, 0.1, 46};       // -1.5..3°C/s
+const Grid tableSetpoint = {20, 20, 13};     // 20..260°C
+const Grid tableError = {-20, 1, 31};        // -20..10°C
+const Grid tableRate = {-1, 0.25, 17};       // -1..3°C/s
+
+const double controlInterval = 0.25;  // s, the SSRInterval of the firmware
+const double modelStep = 0.05;        // s
+const double overshootWeight = 20;    // an error above the setpoint costs this much more than below
+const double powerWeight = 0.05;      // cost of full power for a step, relative to 1°C error
+const double discount = 0.99;         // per step, a horizon of about 25s
+const int solveActions = 9;           // PWM 0, 32, .. 255 in the value iteration
+const int tableActions = 33;          // PWM 0, 8, .. 255 for the table
+const double rateFilter = 0.2;        // TCRateFilter of the firmware
+
+double actionPwm(int a, int actions) {
+    return std::min(255.0, a * 256.0 / (actions - 1));
+}
+
+class Solver {
+public:
+    Solver(const PlateParams& plate, const ReflowProfile& profile) : p(plate), profile(profile) {
+        // the highest temperature of the heating part of the profile, the setpoint stops there
+        peak = std::max(std::max(profile.preheatTemp, profile.soakingTemp), std::max(profile.reflowTemp, profile.coolingTemp));
+        n = fineSetpoint.count * fineError.count * fineRate.count;
+        value.assign(n, 0.0);
+    }
+
+    // the slope of the profile where it passes the temperature, 0 from the peak on
+    double slope(double setpoint) const {
+        const double times[] = {0, (double)profile.preheatTime, (double)profile.soakingTime, (double)profile.reflowTime,
+                                (double)profile.coolingTime};
+        const double temps[] = {p.ambient, (double)profile.preheatTemp, (double)profile.soakingTemp,
+                                (double)profile.reflowTemp, (double)profile.coolingTemp};
+        if (setpoint >= peak) return 0;
+        for (int i = 0; i < 4; i++) {
+            if (temps[i + 1] > temps[i] && setpoint < temps[i + 1] && times[i + 1] > times[i]) {
+                return (temps[i + 1] - temps[i]) / (times[i + 1] - times[i]);
+            }
+        }
+        return 0;
+    }
+
+    // one control interval of the reduced model with the PWM value, the state is updated
+    void advance(double& setpoint, double& error, double& rate, double pwm) const {
+        double h = p.plateLoss, k = p.elementCoupling;
+        double plate = setpoint + error;
+        double element = plate + (p.plateCapacity * rate + h * (plate - p.ambient)) / k;
+        double heat = p.heaterPower * pwm / 255.0;
+        for (double t = 0; t < controlInterval - 1e-9; t += modelStep) {
+            double toPlate = k * (element - plate);
+            element += modelStep * (heat - toPlate) / p.elementCapacity;
+            plate += modelStep * (toPlate - h * (plate - p.ambient)) / p.plateCapacity;
+        }
+        rate = (k * (element - plate) - h * (plate - p.ambient)) / p.plateCapacity;
+        setpoint = std::min(setpoint + slope(setpoint) * controlInterval, std::max(setpoint, (double)peak));
+        error = plate - setpoint;
+    }
+
+    double cost(double error, double pwm) const {
+        double c = error > 0 ? overshootWeight * error * error : error * error;
+        double u = pwm / 255.0;
+        return c + powerWeight * u * u;
+    }
+
+    // the cost of a state from the fine grid, interpolated
+    double interpolate(const std::vector<double>& v, double setpoint, double error, double rate) const {
+        double fs, fe, fr;
+        int s = index(fineSetpoint, setpoint, &fs);
+        int e = index(fineError, error, &fe);
+        int r = index(fineRate, rate, &fr);
+        double result = 0;
+        for (int ds = 0; ds < 2; ds++) {
+            for (int de = 0; de < 2; de++) {
+                const double* row = &v[((s + ds) * fineError.count + e + de) * fineRate.count + r];
+                result += (ds ? fs : 1 - fs) * (de ? fe : 1 - fe) * ((1 - fr) * row[0] + fr * row[1]);
+            }
+        }
+        return result;
+    }
+
+    // the cost of taking the PWM value in the state and the best policy after that
+    double q(double setpoint, double error, double rate, double pwm) const {
+        double c = cost(error, pwm);
+        advance(setpoint, error, rate, pwm);
+        return c + discount * interpolate(value, setpoint, error, rate);
+    }
+
+    // the best PWM value for the state, in steps of 8
+    double best(double setpoint, double error, double rate, double* bestCost) const {
+        double bestPwm = 0;
+        *bestCost = 1e300;
+        for (int a = 0; a < tableActions; a++) {
+            double pwm = actionPwm(a, tableActions);
+            double c = q(setpoint, error, rate, pwm);
+            if (c < *bestCost) {
+                *bestCost = c;
+                bestPwm = pwm;
+            }
+        }
+        return bestPwm;
+    }
+
+    // value iteration until the costs change less than tolerance, returns the number of sweeps
+    int solve(unsigned threads, double tolerance, int maxSweeps) {
+        // the transitions do not change, so calculate them once: the grid cell and the fractions
+        struct Transition {
+            int32_t base;
+            float fs, fe, fr;
+            float cost;
+        };
+        std::vector<Transition> transitions((size_t)n * solveActions);
+        std::vector<std::thread> workers;
+        auto forStates = [&](const std::function<void(int first, int last, unsigned worker)>& work) {
+            workers.clear();
+            int chunk = (n + threads - 1) / threads;
+            for (unsigned w = 0; w < threads; w++) {
+                int first = w * chunk, last = std::min(n, first + chunk);
+                if (first < last) workers.emplace_back(work, first, last, w);
+            }
+            for (auto& worker : workers) worker.join();
+        };
+        forStates([&](int first, int last, unsigned) {
+            for (int i = first; i < last; i++) {
+                int r = i % fineRate.count, e = (i / fineRate.count) % fineError.count, s = i / (fineRate.count * fineError.count);
+                for (int a = 0; a < solveActions; a++) {
+                    double setpoint = fineSetpoint.value(s), error = fineError.value(e), rate = fineRate.value(r);
+                    double pwm = actionPwm(a, solveActions);
+                    Transition& t = transitions[(size_t)i * solveActions + a];
+                    t.cost = (float)cost(error, pwm);
+                    advance(setpoint, error, rate, pwm);
+                    double fs, fe, fr;
+                    int si = index(fineSetpoint, setpoint, &fs);
+                    int ei = index(fineError, error, &fe);
+                    int ri = index(fineRate, rate, &fr);
+                    t.base = (si * fineError.count + ei) * fineRate.count + ri;
+                    t.fs = (float)fs;
+                    t.fe = (float)fe;
+                    t.fr = (float)fr;
+                }
+            }
+        });
+
+        std::vector<double> next(n);
+        std::vector<double> change(threads);
+        const int planeS = fineError.count * fineRate.count, planeE = fineRate.count;
+        for (int sweep = 1; sweep <= maxSweeps; sweep++) {
+            forStates([&](int first, int last, unsigned worker) {
+                double largest = 0;
+                for (int i = first; i < last; i++) {
+                    double bestCost = 1e300;
+                    for (int a = 0; a < solveActions; a++) {
+                        const Transition& t = transitions[(size_t)i * solveActions + a];
+                        const double* v = &value[t.base];
+                        double low = (1 - t.fe) * ((1 - t.fr) * v[0] + t.fr * v[1]) +
+                                     t.fe * ((1 - t.fr) * v[planeE] + t.fr * v[planeE + 1]);
+                        v += planeS;
+                        double high = (1 - t.fe) * ((1 - t.fr) * v[0] + t.fr * v[1]) +
+                                      t.fe * ((1 - t.fr) * v[planeE] + t.fr * v[planeE + 1]);
+                        double c = t.cost + discount * ((1 - t.fs) * low + t.fs * high);
+                        if (c < bestCost) bestCost = c;
+                    }
+                    next[i] = bestCost;
+                    largest = std::max(largest, std::fabs(bestCost - value[i]));
+                }
+                change[worker] = largest;
+            });
+            value.swap(next);
+            if (*std::max_element(change.begin(), change.end()) < tolerance) return sweep;
+        }
+        return maxSweeps;
+    }
+
+    const PlateParams& plate() const { return p; }
+
+private:
+    static int index(const Grid& g, double v, double* fraction) {
+        PolicyAxis axis = {(float)g.first, (float)g.step, (uint8_t)g.count};
+        return policyIndex(axis, v, fraction);
+    }
+
+    PlateParams p;
+    ReflowProfile profile;
+    int peak;
+    int n;
+    std::vector<double> value;
+};
+
+struct ClosedLoop {
+    double overshoot;  // °C, the highest plate temperature above the target
+    double rmsError;   // °C, until the cooling time
+    double peak;       // °C, the highest plate temperature
+};
+
+// a run on the full plate model, with the policy table or with reflowStep()
+ClosedLoop closedLoop(const PlateParams& p, const ReflowProfile& profile, const PolicyTable* table, uint32_t seed) {
+    PlateState state = plateAtRest(p, seed);
+    ReflowControl control;
+    control.profile = profile;
+    control.plan = nullptr;
+    control.coolingTarget = 40;
+    control.warp = nullptr;
+    reflowStart(control);
+    double rate = 0, previous = p.ambient;
+    ClosedLoop result = {-1e9, 0, 0};
+    int samples = 0;
+    for (double t = 0; t < profile.coolingTime; t += controlInterval) {
+        double reading = plateReading(p, state);
+        if (t > 0) rate += rateFilter * ((reading - previous) / controlInterval - rate);
+        previous = reading;
+        if (table) {
+            reflowPolicyStep(control, *table, t, reading, rate);
+        } else {
+            reflowStep(control, t, reading);
+        }
+        for (double s = 0; s < controlInterval - 1e-9; s += modelStep) {
+            plateStep(p, state, control.output, control.fan, modelStep);
+        }
+        double target = profileTemperature(profile, t + controlInterval, 20, 0);
+        double error = state.plate - target;
+        result.overshoot = std::max(result.overshoot, error);
+        result.peak = std::max(result.peak, state.plate);
+        result.rmsError += error * error;
+        samples++;
+    }
+    result.rmsError = std::sqrt(result.rmsError / samples);
+    return result;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    ReflowProfile profile = {90, 90, 130, 180, 165, 240, 165, 250};  // Sn42/Bi57.6/Ag0.4
+    const char* out = "policy_table.h";
+    unsigned threads = std::thread::hardware_concurrency();
+    int seeds = 20;
+    std::vector<int> values;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+            out = argv[++i];
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threads = strtoul(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--seeds") == 0 && i + 1 < argc) {
+            seeds = atoi(argv[++i]);
+        } else {
+            values.push_back(atoi(argv[i]));
+        }
+    }
+    if (values.size() == 8) {
+        profile = {values[0], values[1], values[2], values[3], values[4], values[5], values[6], values[7]};
+    } else if (!values.empty()) {
+        fprintf(stderr, "usage: %s [--out file.h] [--threads n] [--seeds n] [8 profile values]\n", argv[0]);
+        return 2;
+    }
+    if (threads == 0) threads = 1;
+
+    PlateParams plate = defaultPlateParams();
+    Solver solver(plate, profile);
+    auto start = std::chrono::steady_clock::now();
+    int sweeps = solver.solve(threads, 1e-3, 5000);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    fprintf(stderr, "value iteration: %d states, %d sweeps, %.1fs\n",
+            fineSetpoint.count * fineError.count * fineRate.count, sweeps, seconds);
+
+    // the table: the best PWM value on the coarse grid
+    std::vector<uint8_t> pwm(tableSetpoint.count * tableError.count * tableRate.count);
+    for (int s = 0; s < tableSetpoint.count; s++) {
+        for (int e = 0; e < tableError.count; e++) {
+            for (int r = 0; r < tableRate.count; r++) {
+                double c;
+                double best = solver.best(tableSetpoint.value(s), tableError.value(e), tableRate.value(r), &c);
+                pwm[(s * tableError.count + e) * tableRate.count + r] = (uint8_t)std::lround(best);
+            }
+        }
+    }
+    PolicyTable table = {profile,
+                         {(float)tableSetpoint.first, (float)tableSetpoint.step, (uint8_t)tableSetpoint.count},
+                         {(float)tableError.first, (float)tableError.step, (uint8_t)tableError.count},
+                         {(float)tableRate.first, (float)tableRate.step, (uint8_t)tableRate.count},
+                         pwm.data()};
+
+    // the accuracy of the table on the states of the fine grid within the table
+    double sumDifference = 0, maxDifference = 0, sumExtra = 0;
+    int compared = 0;
+    for (int s = 0; s < fineSetpoint.count; s++) {
+        for (int e = 0; e < fineError.count; e++) {
+            for (int r = 0; r < fineRate.count; r++) {
+                double setpoint = fineSetpoint.value(s), error = fineError.value(e), rate = fineRate.value(r);
+                if (error < tableError.first || error > tableError.value(tableError.count - 1) ||
+                    rate < tableRate.first || rate > tableRate.value(tableRate.count - 1)) {
+                    continue;
+                }
+                double bestCost;
+                double best = solver.best(setpoint, error, rate, &bestCost);
+                double output = policyOutput(table, setpoint, setpoint + error, rate);
+                double difference = std::fabs(output - best);
+                sumDifference += difference;
+                maxDifference = std::max(maxDifference, difference);
+                sumExtra += (solver.q(setpoint, error, rate, output) - bestCost) / bestCost;
+                compared++;
+            }
+        }
+    }
+
+    // closed loop on the full model
+    ClosedLoop policyRuns = {0, 0, 0}, stepRuns = {0, 0, 0};
+    for (int seed = 1; seed <= seeds; seed++) {
+        ClosedLoop a = closedLoop(plate, profile, &table, seed);
+        ClosedLoop b = closedLoop(plate, profile, nullptr, seed);
+        policyRuns.overshoot = std::max(policyRuns.overshoot, a.overshoot);
+        policyRuns.rmsError += a.rmsError / seeds;
+        policyRuns.peak = std::max(policyRuns.peak, a.peak);
+        stepRuns.overshoot = std::max(stepRuns.overshoot, b.overshoot);
+        stepRuns.rmsError += b.rmsError / seeds;
+        stepRuns.peak = std::max(stepRuns.peak, b.peak);
+    }
+
+    char summary[5][160];
+    snprintf(summary[0], sizeof(summary[0]), "%d x %d x %d = %zu bytes", tableSetpoint.count, tableError.count,
+             tableRate.count, pwm.size());
+    snprintf(summary[1], sizeof(summary[1]), "interpolation: %.1f mean, %.0f max PWM difference to the fine policy, %.2f%% extra cost",
+             sumDifference / compared, maxDifference, 100 * sumExtra / compared);
+    snprintf(summary[2], sizeof(summary[2]), "closed loop, %d runs on the plate model:", seeds);
+    snprintf(summary[3], sizeof(summary[3]), "  policy:     %.1fC rms error, %.1fC max overshoot, %.1fC peak",
+             policyRuns.rmsError, policyRuns.overshoot, policyRuns.peak);
+    snprintf(summary[4], sizeof(summary[4]), "  reflowStep: %.1fC rms error, %.1fC max overshoot, %.1fC peak",
+             stepRuns.rmsError, stepRuns.overshoot, stepRuns.peak);
+    for (auto& line : summary) fprintf(stderr, "%s\n", line);
+
+    FILE* f = fopen(out, "w");
+    if (!f) {
+        perror(out);
+        return 1;
+    }
+    fprintf(f, "/*\n  Lookup table control policy, generated by tools/policy/policy_gen, do not edit\n\n");
+    fprintf(f, "  Profile %d %d %d %d %d %d %d %d, default plate model (%.0fW)\n", profile.preheatTemp,
+            profile.preheatTime, profile.soakingTemp, profile.soakingTime, profile.reflowTemp, profile.reflowTime,
+            profile.coolingTemp, profile.coolingTime, plate.heaterPower);
+    for (auto& line : summary) fprintf(f, "  %s\n", line);
+    fprintf(f, "*/\n#ifndef POLICY_TABLE_H\n#define POLICY_TABLE_H\n\n#include \"policy.h\"\n\n");
+    fprintf(f, "// [setpoint][error][rate]\nconst uint8_t policyPwm[%zu] = {\n", pwm.size());
+    for (size_t i = 0; i < pwm.size(); i += tableRate.count) {
+        fprintf(f, "   ");
+        for (int r = 0; r < tableRate.count; r++) fprintf(f, " %3u,", pwm[i + r]);
+        fprintf(f, "\n");
+    }
+    fprintf(f, "};\n\n");
+    fprintf(f, "const PolicyTable policyTable = {\n    {%d, %d, %d, %d, %d, %d, %d, %d},\n", profile.preheatTemp,
+            profile.preheatTime, profile.soakingTemp, profile.soakingTime, profile.reflowTemp, profile.reflowTime,
+            profile.coolingTemp, profile.coolingTime);
+    fprintf(f, "    {%g, %g, %d},  // setpoint\n", tableSetpoint.first, tableSetpoint.step, tableSetpoint.count);
+    fprintf(f, "    {%g, %g, %d},  // error\n", tableError.first, tableError.step, tableError.count);
+    fprintf(f, "    {%g, %g, %d},  // rate\n", tableRate.first, tableRate.step, tableRate.count);
+    fprintf(f, "    policyPwm};\n\n#endif  // POLICY_TABLE_H\n");
+    fclose(f);
+    return 0;
+}
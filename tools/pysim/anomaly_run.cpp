@@ -0,0 +1,188 @@
+/*
+  anomaly_run: the false alarms and the faults found by the anomaly detector of a reflow run
+
+  Usage: anomaly_run [--runs n] [--seed n] [--noise C]
+
+  Runs the reflow controller of the firmware (reflowStep(), or the policy table for the profile it
+  was solved for, with the time warp) on stations that differ from the plate model of the detector
+  (include/run_anomaly.h): the heater 360-440W, the losses and the fans +/-20%, the thermocouple lag
+  1.5-3s, the ambient 15-30°C, a board of 15-60J/°C on the plate in 70% of the runs, half of the
+  runs from the ambient and half from a standby of 38-80°C, one of the four pastes. The detector
+  runs while the run heats, like checkRunAnomaly() does.
+
+  First the healthy runs: how many raised an alarm and the highest CUSUM of a healthy run (the
+  margin to the threshold). Then every fault in a quarter as many runs, at a random time between
+  30s and 230s: how many were found after the fault and how long it took. --noise sets the noise
+  of the readings (0.2°C).
+*/
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "plate_model.h"
+#include "policy_table.h"
+#include "reflow_control.h"
+#include "run_anomaly.h"
+
+namespace {
+
+enum FaultKind {
+    FAULT_NONE,
+    FAULT_LIFT,   // the thermocouple reads size of the way to the ambient
+    FAULT_SLIDE,  // the same, in 30s
+    FAULT_HEATER, // the heater has size of its power
+    FAULT_BOARD,  // the board slips off the plate
+    FAULT_SSR     // the SSR is stuck on
+};
+
+struct Fault {
+    FaultKind kind;
+    double size;
+    const char* name;
+};
+
+struct Outcome {
+    double alarm;  // s of the run, -1 without one
+    double low;    // the highest CUSUMs of the run
+    double high;
+};
+
+// the pastes of the firmware
+const ReflowProfile pastes[] = {
+    {90, 90, 130, 180, 165, 240, 165, 250},   // Sn42/Bi57.6/Ag0.4
+    {90, 90, 130, 180, 165, 240, 165, 250},   // Sn42/Bi57/Ag1
+    {100, 30, 150, 120, 235, 210, 235, 220},  // Sn63/Pb37
+    {100, 60, 150, 120, 235, 210, 235, 220},  // Sn63/Pb37 Mod
+};
+
+double sensorNoise = 0.2;
+
+Outcome simulate(std::mt19937& random, const Fault& fault, double faultTime) {
+    std::uniform_real_distribution<double> uniform(0, 1);
+    PlateParams station = defaultPlateParams();
+    station.heaterPower = 360 + 80 * uniform(random);
+    station.plateLoss *= 0.8 + 0.4 * uniform(random);
+    station.fanLoss *= 0.8 + 0.4 * uniform(random);
+    station.sensorTau = 1.5 + 1.5 * uniform(random);
+    station.sensorNoise = sensorNoise;
+    station.ambient = 15 + 15 * uniform(random);
+    double board = uniform(random) < 0.7 ? 15 + 45 * uniform(random) : 0;  // J/°C
+    double start = uniform(random) < 0.5 ? station.ambient : 38 + 42 * uniform(random);
+    const ReflowProfile& profile = pastes[random() % 4];
+
+    PlateState plate = plateAtRest(station, random());
+    plate.element = plate.plate = plate.sensor = start;
+    ReflowControl control;
+    control.profile = profile;
+    control.plan = nullptr;
+    control.coolingTarget = 40;
+    control.warp = &defaultTimeWarp;
+    reflowStart(control);
+    bool policy = policyMatches(policyTable, profile);
+
+    const PlateParams model = defaultPlateParams();
+    RunAnomaly anomaly;
+    runAnomalyReset(anomaly, model, plateReading(station, plate));
+    Outcome outcome = {-1, 0, 0};
+    const double interval = 0.25, step = 0.05;
+    double heater = station.heaterPower;
+    double previous = start, rate = 0;
+    for (double t = 0; t < 340; t += interval) {
+        bool faulty = fault.kind != FAULT_NONE && t >= faultTime;
+        double lift = 0;
+        if (faulty && fault.kind == FAULT_LIFT) lift = fault.size;
+        if (faulty && fault.kind == FAULT_SLIDE) lift = std::min(1.0, (t - faultTime) / 30) * fault.size;
+        if (faulty && fault.kind == FAULT_HEATER) station.heaterPower = heater * fault.size;
+        if (faulty && fault.kind == FAULT_BOARD) board = 0;
+
+        double reading = plateReading(station, plate);
+        reading -= lift * (reading - station.ambient);
+        rate += 0.2 * ((reading - previous) / interval - rate);  // TCRateFilter
+        previous = reading;
+
+        if (control.phase != COOLING) {
+            RunAnomalyKind kind =
+                runAnomalyStep(anomaly, model, runAnomalySettings, reading, control.output, control.fan, interval);
+            outcome.low = std::max(outcome.low, -anomaly.low);
+            outcome.high = std::max(outcome.high, anomaly.high);
+            if (kind != ANOMALY_NONE && outcome.alarm < 0) outcome.alarm = t;
+        }
+        if (policy) {
+            reflowPolicyStep(control, policyTable, t, reading, rate);
+        } else {
+            reflowStep(control, t, reading);
+        }
+
+        int power = faulty && fault.kind == FAULT_SSR ? 255 : control.output;
+        for (double s = 0; s < interval - 1e-9; s += step) {
+            plateStep(station, plate, power, control.fan, step);
+            // the board takes heat from the plate, like the board the scenario runner places
+            plate.plate -= step * board * (plate.plate - plate.board) / station.boardTau / station.plateCapacity;
+        }
+    }
+    return outcome;
+}
+
+double percentile(std::vector<double> values, double p) {
+    if (values.empty()) return -1;
+    std::sort(values.begin(), values.end());
+    return values[std::min(values.size() - 1, (size_t)(p * values.size()))];
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    int runs = 2000;
+    uint32_t seed = 1;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--runs") == 0 && i + 1 < argc) {
+            runs = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = strtoul(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--noise") == 0 && i + 1 < argc) {
+            sensorNoise = atof(argv[++i]);
+        } else {
+            fprintf(stderr, "usage: %s [--runs n] [--seed n] [--noise C]\n", argv[0]);
+            return 2;
+        }
+    }
+    std::mt19937 random(seed);
+
+    int alarms = 0;
+    std::vector<double> low, high;
+    for (int i = 0; i < runs; i++) {
+        Outcome o = simulate(random, {FAULT_NONE, 0, ""}, 0);
+        if (o.alarm >= 0) alarms++;
+        low.push_back(o.low);
+        high.push_back(o.high);
+    }
+    printf("healthy: %d alarms in %d runs, the highest sum below %.1f above %.1f, threshold %.1f\n", alarms, runs,
+           percentile(low, 1), percentile(high, 1), runAnomalySettings.threshold);
+
+    const Fault faults[] = {
+        {FAULT_LIFT, 0.05, "thermocouple lifts 5%"},  {FAULT_LIFT, 0.1, "thermocouple lifts 10%"},
+        {FAULT_LIFT, 0.2, "thermocouple lifts 20%"},  {FAULT_SLIDE, 0.2, "slides 20% in 30s"},
+        {FAULT_HEATER, 0.8, "heater at 80%"},         {FAULT_HEATER, 0.6, "heater at 60%"},
+        {FAULT_HEATER, 0.5, "heater at 50%"},         {FAULT_HEATER, 0, "heater open"},
+        {FAULT_BOARD, 0, "board slips off"},          {FAULT_SSR, 0, "SSR stuck on"},
+    };
+    std::uniform_real_distribution<double> when(30, 230);
+    for (const Fault& fault : faults) {
+        int found = 0, n = std::max(1, runs / 4);
+        std::vector<double> delays;
+        for (int i = 0; i < n; i++) {
+            double t = when(random);
+            Outcome o = simulate(random, fault, t);
+            if (o.alarm >= t) {
+                found++;
+                delays.push_back(o.alarm - t);
+            }
+        }
+        printf("%-24s found %4d of %4d, after %5.1fs (median) %5.1fs (90%%)\n", fault.name, found, n,
+               percentile(delays, 0.5), percentile(delays, 0.9));
+    }
+    return 0;
+}
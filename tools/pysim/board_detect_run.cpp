@@ -0,0 +1,265 @@
+/*
+  board_detect_run: the false starts and the boards found by the board detection of the automatic runs
+
+  Usage: board_detect_run [--runs n] [--seed n] [--noise C] [--board J]
+
+  Runs the detector of include/board_detect.h the way autoRunStep() in the firmware does, on stations
+  that differ from the plate model of the detector: the heater 360-440W, the losses and the fans +/-20%,
+  the thermocouple lag 1.5-3s, the ambient 15-30°C.
+
+  The placements: the warmup controller of the firmware (warmupControl()) holds a standby of 38-60°C,
+  half of the runs from the ambient and half from a plate at the standby. A healthy standby lasts 30
+  minutes without a board, a start is a false start. Then a board of --board J/°C (30, a 100x100mm FR4
+  board, 0 for 15-60) is placed between 2 and 10 minutes after the start of the warmup: how many were
+  found in 30s and how long it took, by the standby temperature.
+
+  The removals: a reflow run with the board (reflowStep(), one of the four pastes) from the standby,
+  the board is taken off at a random time in the 2 minutes after the plate has come down to the release
+  temperature. A change before that is a false finish, a change in 30s after it a removal found.
+  --noise sets the noise of the readings (0.2°C).
+*/
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "board_detect.h"
+#include "plate_model.h"
+#include "reflow_control.h"
+
+namespace {
+
+// the automatic runs of the firmware (main.cpp)
+const double interval = 0.25;          // s between the readings
+const double rateFilter = 0.2;         // TCRateFilter
+const double standbyBand = 5;          // autoStandbyBand
+const double standbySettle = 30;       // autoStandbySettle
+const double releaseTemp = 100;        // autoReleaseTemp
+
+// the pastes of the firmware
+const ReflowProfile pastes[] = {
+    {90, 90, 130, 180, 165, 240, 165, 250},   // Sn42/Bi57.6/Ag0.4
+    {90, 90, 130, 180, 165, 240, 165, 250},   // Sn42/Bi57/Ag1
+    {100, 30, 150, 120, 235, 210, 235, 220},  // Sn63/Pb37
+    {100, 60, 150, 120, 235, 210, 235, 220},  // Sn63/Pb37 Mod
+};
+
+double sensorNoise = 0.2;
+double boardSize = 30;  // J/°C, 0 for a random board
+
+struct Station {
+    PlateParams params;
+    PlateState plate;
+    double board;     // J/°C on the plate, 0 without a board
+    double previous;  // the previous reading
+    double rate;      // TCRate
+};
+
+struct Outcome {
+    double change;  // s of the run when the detector reported a change, -1 without one
+    double sum;     // the highest CUSUM of the detector before the board was placed or taken off
+};
+
+Station makeStation(std::mt19937& random, double start) {
+    std::uniform_real_distribution<double> uniform(0, 1);
+    Station s;
+    s.params = defaultPlateParams();
+    s.params.heaterPower = 360 + 80 * uniform(random);
+    s.params.plateLoss *= 0.8 + 0.4 * uniform(random);
+    s.params.fanLoss *= 0.8 + 0.4 * uniform(random);
+    s.params.sensorTau = 1.5 + 1.5 * uniform(random);
+    s.params.sensorNoise = sensorNoise;
+    s.params.ambient = 15 + 15 * uniform(random);
+    s.plate = plateAtRest(s.params, random());
+    if (start > 0) s.plate.element = s.plate.plate = s.plate.board = s.plate.sensor = start;
+    s.board = 0;
+    s.previous = plateReading(s.params, s.plate);
+    s.rate = 0;
+    return s;
+}
+
+// a reading with the filtered dT/dt of the firmware
+double readPlate(Station& s) {
+    double reading = plateReading(s.params, s.plate);
+    s.rate += rateFilter * ((reading - s.previous) / interval - s.rate);
+    s.previous = reading;
+    return reading;
+}
+
+// the plate for one interval, the board on the plate takes heat from it like the board of the scenario runner
+void heatPlate(Station& s, int power, bool fan) {
+    const double step = 0.05;
+    for (double t = 0; t < interval - 1e-9; t += step) {
+        plateStep(s.params, s.plate, power, fan, step);
+        s.plate.plate -= step * s.board * (s.plate.plate - s.plate.board) / s.params.boardTau / s.params.plateCapacity;
+    }
+}
+
+double randomBoard(std::mt19937& random) {
+    return boardSize > 0 ? boardSize : std::uniform_real_distribution<double>(15, 60)(random);
+}
+
+// a standby of the warmup mode, a board is placed at the time place (never when it is negative)
+Outcome standby(std::mt19937& random, double temperature, double place, double length) {
+    std::uniform_real_distribution<double> uniform(0, 1);
+    Station s = makeStation(random, uniform(random) < 0.5 ? 0 : temperature);
+    double board = randomBoard(random);
+    const PlateParams model = defaultPlateParams();
+    HeatingControl control = warmupControl(temperature);
+    BoardDetect detect;
+    boardDetectReset(detect);
+    PlateRateLag lag = {0, 0, 0};
+    const double filter = interval * (1 - rateFilter) / rateFilter;
+    double settled = 0;
+    Outcome outcome = {-1, 0};
+
+    for (double t = 0; t < length; t += interval) {
+        if (place >= 0 && t >= place && s.board == 0) {
+            s.board = board;
+            s.plate.board = s.params.ambient;
+        }
+        double reading = readPlate(s);
+        double expected = plateRateLag(model, lag, plateRate(model, control.output, false, reading), filter, interval);
+        if (fabs(reading - temperature) > standbyBand || control.rampup || control.slowdown) settled = t;
+        if (t - settled < standbySettle) {
+            boardDetectReset(detect);
+        } else if (boardDetectStep(detect, boardPlaceSettings, s.rate, expected, interval) == BOARD_DIP) {
+            outcome.change = t;
+            break;
+        }
+        if (s.board == 0) outcome.sum = std::max(outcome.sum, -detect.low);
+        heatingStep(control, reading);
+        heatPlate(s, control.output, false);
+    }
+    return outcome;
+}
+
+// a reflow run with a board from the standby, the board is taken off remove seconds after the plate
+// came down to the release temperature
+Outcome removal(std::mt19937& random, double temperature, double remove) {
+    Station s = makeStation(random, temperature);
+    s.board = randomBoard(random);
+    s.plate.board = s.params.ambient;
+    const PlateParams model = defaultPlateParams();
+    ReflowControl control;
+    control.profile = pastes[random() % 4];
+    control.plan = nullptr;
+    control.coolingTarget = 40;
+    control.warp = &defaultTimeWarp;
+    reflowStart(control);
+    BoardDetect detect;
+    boardDetectReset(detect);
+    PlateRateLag lag = {0, 0, 0};
+    const double filter = interval * (1 - rateFilter) / rateFilter;
+    int power = 0;
+    bool fan = false, previousFan = false;
+    double released = -1;
+    Outcome outcome = {-1, 0};
+
+    for (double t = 0; t < 1200; t += interval) {
+        double reading = readPlate(s);
+        if (released >= 0 && t >= released + remove) s.board = 0;
+        double expected = plateRateLag(model, lag, plateRate(model, power, fan, reading), filter, interval);
+        if (fan != previousFan) boardDetectReset(detect);
+        previousFan = fan;
+        bool cooling = control.phase == COOLING || t >= 340;
+        if (cooling && released < 0 && reading <= releaseTemp) released = t;
+        if (!cooling || reading > releaseTemp) {
+            boardDetectReset(detect);
+        } else if (boardDetectStep(detect, boardRemoveSettings, s.rate, expected, interval) != BOARD_STEADY) {
+            outcome.change = t - released;  // from the release
+            break;
+        }
+        if (s.board > 0) outcome.sum = std::max(outcome.sum, std::max(-detect.low, detect.high));
+
+        if (t < 340) {
+            reflowStep(control, t, reading);
+            power = control.output;
+            fan = control.fan;
+        } else {
+            power = 0;
+            fan = reading > control.coolingTarget;
+        }
+        heatPlate(s, power, fan);
+    }
+    return outcome;
+}
+
+double percentile(std::vector<double> values, double p) {
+    if (values.empty()) return -1;
+    std::sort(values.begin(), values.end());
+    return values[std::min(values.size() - 1, (size_t)(p * values.size()))];
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    int runs = 1000;
+    uint32_t seed = 1;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--runs") == 0 && i + 1 < argc) {
+            runs = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = strtoul(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--noise") == 0 && i + 1 < argc) {
+            sensorNoise = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--board") == 0 && i + 1 < argc) {
+            boardSize = atof(argv[++i]);
+        } else {
+            fprintf(stderr, "usage: %s [--runs n] [--seed n] [--noise C] [--board J]\n", argv[0]);
+            return 2;
+        }
+    }
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<double> standbyTemp(38, 60);
+
+    int starts = 0;
+    std::vector<double> sums;
+    for (int i = 0; i < runs; i++) {
+        Outcome o = standby(random, standbyTemp(random), -1, 1800);
+        if (o.change >= 0) starts++;
+        sums.push_back(o.sum);
+    }
+    printf("standby: %d false starts in %.0f hours, the highest sum %.2f, threshold %.2f\n", starts, runs * 0.5,
+           percentile(sums, 1), boardPlaceSettings.threshold);
+
+    const double bands[][2] = {{38, 45}, {45, 50}, {50, 55}, {55, 60}};
+    for (const auto& band : bands) {
+        int found = 0, early = 0;
+        std::vector<double> delays;
+        std::uniform_real_distribution<double> temp(band[0], band[1]), when(120, 600);
+        for (int i = 0; i < runs; i++) {
+            double place = when(random);
+            Outcome o = standby(random, temp(random), place, place + 30);
+            if (o.change >= 0 && o.change < place) {
+                early++;
+            } else if (o.change >= 0) {
+                found++;
+                delays.push_back(o.change - place);
+            }
+        }
+        printf("placed at %2.0f-%2.0f°C: found %4d of %4d, after %4.1fs (median) %4.1fs (90%%), %d false starts\n",
+               band[0], band[1], found, runs, percentile(delays, 0.5), percentile(delays, 0.9), early);
+    }
+
+    int found = 0, early = 0;
+    std::vector<double> delays, finishSums;
+    std::uniform_real_distribution<double> when(0, 120);
+    for (int i = 0; i < runs; i++) {
+        double remove = when(random);
+        Outcome o = removal(random, standbyTemp(random), remove);
+        finishSums.push_back(o.sum);
+        if (o.change >= 0 && o.change < remove) {
+            early++;
+        } else if (o.change >= 0 && o.change < remove + 30) {
+            found++;
+            delays.push_back(o.change - remove);
+        }
+    }
+    printf("removed: found %d of %d, after %.1fs (median) %.1fs (90%%), %d false finishes, the highest sum %.2f\n",
+           found, runs, percentile(delays, 0.5), percentile(delays, 0.9), early, percentile(finishSums, 1));
+    return 0;
+}
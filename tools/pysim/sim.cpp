@@ -0,0 +1,130 @@
+#include "sim.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <thread>
+
+namespace {
+
+// store the values of step i in the trace (row offset already applied)
+void record(const SimTrace& trace, size_t i, double time, double reading, const PlateState& state, double setpoint,
+            int power, int phase, bool fan) {
+    if (trace.time) trace.time[i] = time;
+    if (trace.reading) trace.reading[i] = reading;
+    if (trace.plate) trace.plate[i] = state.plate;
+    if (trace.board) trace.board[i] = state.board;
+    if (trace.setpoint) trace.setpoint[i] = setpoint;
+    if (trace.power) trace.power[i] = (uint8_t)power;
+    if (trace.phase) trace.phase[i] = (uint8_t)phase;
+    if (trace.fan) trace.fan[i] = fan ? 1 : 0;
+}
+
+// the trace of row r in a batch of rows with steps values each
+SimTrace row(const SimTrace& trace, size_t r, size_t steps) {
+    size_t offset = r * steps;
+    SimTrace t;
+    t.time = trace.time ? trace.time + offset : nullptr;
+    t.reading = trace.reading ? trace.reading + offset : nullptr;
+    t.plate = trace.plate ? trace.plate + offset : nullptr;
+    t.board = trace.board ? trace.board + offset : nullptr;
+    t.setpoint = trace.setpoint ? trace.setpoint + offset : nullptr;
+    t.power = trace.power ? trace.power + offset : nullptr;
+    t.phase = trace.phase ? trace.phase + offset : nullptr;
+    t.fan = trace.fan ? trace.fan + offset : nullptr;
+    return t;
+}
+
+// run the plate model for one controller interval
+void advance(const PlateParams& plate, PlateState& state, int power, bool fan) {
+    for (double t = 0; t < SIM_CONTROL_INTERVAL - 1e-9; t += SIM_MODEL_STEP) {
+        plateStep(plate, state, power, fan, SIM_MODEL_STEP);
+    }
+}
+
+}  // namespace
+
+size_t simSteps(double duration) {
+    return (size_t)std::ceil(duration / SIM_CONTROL_INTERVAL);
+}
+
+size_t simulateReflow(const SimRun& run, const SimTrace& trace, size_t steps) {
+    PlateState state = plateAtRest(run.plate, run.seed);
+    state.element = state.plate = state.board = state.sensor = run.startTemp;
+
+    ReflowControl control;
+    control.profile = run.profile;
+    control.plan = run.plan;
+    control.coolingTarget = 40;
+    control.warp = run.warp ? &defaultTimeWarp : nullptr;
+    reflowStart(control);
+    BoardModel model = {run.plate.boardTau, run.plate.boardLoss, run.plate.ambient};
+    CascadeControl cascade = cascadeControl(model);
+    cascadeStart(cascade, run.startTemp);
+
+    for (size_t i = 0; i < steps; i++) {
+        double time = i * SIM_CONTROL_INTERVAL;
+        double reading = plateReading(run.plate, state);
+        int phase = control.phase;  // the phase of this step, like the firmware shows and logs it
+        if (run.cascade) {
+            // the board thermocouple has the resolution of the MAX6675, without the lag of the plate sensor
+            double board = std::floor(state.board / 0.25) * 0.25;
+            reflowCascadeStep(control, cascade, time, SIM_CONTROL_INTERVAL, reading, board);
+        } else {
+            reflowStep(control, time, reading);
+        }
+        record(trace, i, time, reading, state, control.target, control.output, phase, control.fan);
+        advance(run.plate, state, control.output, control.fan);
+    }
+    return steps;
+}
+
+size_t simulateHeating(double target, bool warmup, const PlateParams& plate, uint32_t seed, const SimTrace& trace,
+                       size_t steps) {
+    PlateState state = plateAtRest(plate, seed);
+    HeatingControl control = warmup ? warmupControl(target) : freeHeatingControl(target);
+
+    for (size_t i = 0; i < steps; i++) {
+        double time = i * SIM_CONTROL_INTERVAL;
+        double reading = plateReading(plate, state);
+        int stage = heatingStep(control, reading);
+        record(trace, i, time, reading, state, target, control.output, stage, false);
+        advance(plate, state, control.output, false);
+    }
+    return steps;
+}
+
+void simulateReflowBatch(const std::vector<SimRun>& runs, const SimTrace& trace, size_t steps, unsigned threads) {
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    threads = std::min<size_t>(threads, std::max<size_t>(1, runs.size()));
+
+    // the workers take the next run from a shared counter, the same as the run log scanner
+    std::atomic<size_t> next{0};
+    auto worker = [&]() {
+        for (size_t i = next++; i < runs.size(); i = next++) {
+            simulateReflow(runs[i], row(trace, i, steps), steps);
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (unsigned t = 1; t < threads; t++) pool.emplace_back(worker);
+    worker();
+    for (std::thread& thread : pool) thread.join();
+}
+
+void replayReflow(const ReflowProfile& profile, const int16_t* plan, const double* time, const double* temperature,
+                  size_t n, double* setpoint, uint8_t* power, uint8_t* phase) {
+    ReflowControl control;
+    control.profile = profile;
+    control.plan = plan;
+    control.coolingTarget = 40;
+    control.warp = nullptr;
+    reflowStart(control);
+
+    for (size_t i = 0; i < n; i++) {
+        phase[i] = (uint8_t)control.phase;
+        reflowStep(control, time[i], temperature[i]);
+        setpoint[i] = control.target;
+        power[i] = (uint8_t)control.output;
+    }
+}
@@ -0,0 +1,72 @@
+/*
+  Closed loop simulation of the reflow controller on the plate model
+
+  The controller is the firmware code (include/reflow_control.h), the plate is the model
+  from include/plate_model.h. The controller runs every 250ms on the last reading of the
+  thermocouple, like runReflow() does, the model runs in steps of 50ms in between.
+
+  All results are written to arrays that the caller owns, nothing is copied. The batch
+  functions run a worker per core.
+*/
+#ifndef PYSIM_SIM_H
+#define PYSIM_SIM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "plate_model.h"
+#include "profile_plan.h"
+#include "reflow_control.h"
+
+// The settings of a simulated reflow run
+struct SimRun {
+    ReflowProfile profile;
+    PlateParams plate;
+    const int16_t* plan;   // planned plate setpoints (PLAN_SECONDS) for a board-side profile, or nullptr
+    uint32_t seed;         // for the sensor noise
+    double startTemp;      // the plate (and board) temperature at the start
+    bool cascade;          // cascade control on a board thermocouple (reflow_control.h) instead of the plate
+    bool warp;             // the time warp of the profile (defaultTimeWarp) for reflowStep()
+};
+
+// The columns of a simulated run, one value per controller step, the caller provides the arrays.
+// A column can be left nullptr when it is not needed.
+struct SimTrace {
+    double* time;      // s
+    double* reading;   // °C, what the controller saw
+    double* plate;     // °C
+    double* board;     // °C
+    double* setpoint;  // °C, the target of the controller
+    uint8_t* power;    // PWM value
+    uint8_t* phase;    // ReflowPhase
+    uint8_t* fan;      // 1 when the fans are running
+};
+
+const double SIM_CONTROL_INTERVAL = 0.25;  // s, the SSRInterval of the firmware
+const double SIM_MODEL_STEP = 0.05;        // s
+const double SIM_DURATION = 340;           // s, the end of the time scale
+
+// The number of controller steps in a run of the given duration
+size_t simSteps(double duration);
+
+// Run the reflow controller on the plate model and fill the trace, returns the number of steps
+size_t simulateReflow(const SimRun& run, const SimTrace& trace, size_t steps);
+
+// Run the free heating (warmup == false) or warmup controller on the plate model.
+// The trace has no phase and the setpoint is the target.
+size_t simulateHeating(double target, bool warmup, const PlateParams& plate, uint32_t seed, const SimTrace& trace,
+                       size_t steps);
+
+// Simulate many runs, the traces are rows of steps values in the arrays of the trace
+void simulateReflowBatch(const std::vector<SimRun>& runs, const SimTrace& trace, size_t steps, unsigned threads);
+
+/*
+  Run the reflow controller open loop on a logged (or otherwise measured) temperature series,
+  to see what a modified profile or plan would have done with the same plate readings.
+  Fills setpoint, power and phase for every sample.
+*/
+void replayReflow(const ReflowProfile& profile, const int16_t* plan, const double* time, const double* temperature,
+                  size_t n, double* setpoint, uint8_t* power, uint8_t* phase);
+
+#endif  // PYSIM_SIM_H
@@ -0,0 +1,90 @@
+/*
+  sim_run: simulate a reflow run on the plate model and print it as CSV
+
+  Usage: sim_run [--board | --cascade] [--warp] [--seed n] [preheatTemp preheatTime soakingTemp soakingTime reflowTemp reflowTime coolingTemp coolingTime]
+
+  Without a profile the first solder paste of the firmware is used. With --board the controller
+  follows the board-side plan (profile_plan.h) instead of the profile, with --cascade the cascade
+  controller regulates on the board temperature. --warp turns on the time warp of the profile.
+  The planned and the actual duration of the phases go to stderr.
+*/
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "sim.h"
+
+int main(int argc, char** argv) {
+    ReflowProfile profile = {90, 90, 130, 180, 165, 240, 165, 250};  // Sn42/Bi57.6/Ag0.4
+    bool board = false;
+    bool cascade = false;
+    bool warp = false;
+    uint32_t seed = 1;
+    std::vector<int> values;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--board") == 0) {
+            board = true;
+        } else if (strcmp(argv[i], "--cascade") == 0) {
+            cascade = true;
+        } else if (strcmp(argv[i], "--warp") == 0) {
+            warp = true;
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = strtoul(argv[++i], nullptr, 10);
+        } else {
+            values.push_back(atoi(argv[i]));
+        }
+    }
+    if (values.size() == 8) {
+        profile = {values[0], values[1], values[2], values[3], values[4], values[5], values[6], values[7]};
+    } else if (!values.empty()) {
+        fprintf(stderr, "usage: %s [--board | --cascade] [--warp] [--seed n] [8 profile values]\n", argv[0]);
+        return 2;
+    }
+
+    SimRun run;
+    run.profile = profile;
+    run.plate = defaultPlateParams();
+    run.seed = seed;
+    run.startTemp = run.plate.ambient;
+    run.cascade = cascade;
+    run.warp = warp;
+    int16_t plan[PLAN_SECONDS];
+    run.plan = nullptr;
+    if (board) {
+        BoardModel model = {run.plate.boardTau, run.plate.boardLoss, run.plate.ambient};
+        PlateLimits limits = {260.0, 1.5, 0.7};
+        planPlateSetpoints(profile, model, limits, plan, PLAN_SECONDS);
+        run.plan = plan;
+    }
+
+    size_t steps = simSteps(SIM_DURATION);
+    std::vector<double> time(steps), reading(steps), plate(steps), boardTemp(steps), setpoint(steps);
+    std::vector<uint8_t> power(steps), phase(steps), fan(steps);
+    SimTrace trace = {time.data(), reading.data(), plate.data(), boardTemp.data(), setpoint.data(),
+                      power.data(), phase.data(), fan.data()};
+    simulateReflow(run, trace, steps);
+
+    // the planned and the actual duration of the phases, from the phase column
+    const char* names[] = {"preheat", "soak", "reflow", "hold"};
+    double start[5] = {0, -1, -1, -1, -1};
+    for (size_t i = 1; i < steps; i++) {
+        if (phase[i] != phase[i - 1] && phase[i] <= COOLING) start[phase[i]] = time[i];
+    }
+    for (int k = PREHEAT; k <= HOLD; k++) {
+        int planned = reflowPlannedDuration(profile, (ReflowPhase)k);
+        if (start[k] >= 0 && start[k + 1] >= 0) {
+            fprintf(stderr, "%-8s planned %3ds, actual %5.1fs\n", names[k], planned, start[k + 1] - start[k]);
+        } else {
+            fprintf(stderr, "%-8s planned %3ds, did not end\n", names[k], planned);
+        }
+    }
+
+    printf("time_s,reading_C,plate_C,board_C,setpoint_C,power,phase,fan\n");
+    for (size_t i = 0; i < steps; i++) {
+        printf("%.2f,%.2f,%.2f,%.2f,%.1f,%u,%u,%u\n", time[i], reading[i], plate[i], boardTemp[i], setpoint[i], power[i],
+               phase[i], fan[i]);
+    }
+    return 0;
+}
@@ -0,0 +1,230 @@
+/*
+  Host-side reader for the binary run logs, see runlog_reader.h
+*/
+#include "runlog_reader.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+#include <thread>
+
+RunLog::RunLog(const std::string& path) : path_(path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw std::runtime_error(path + ": cannot open");
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        close(fd);
+        throw std::runtime_error(path + ": cannot stat");
+    }
+    mapSize_ = info.st_size;
+    if (mapSize_ < sizeof(RunLogHeader)) {
+        close(fd);
+        throw std::runtime_error(path + ": too short for a run log");
+    }
+    map_ = mmap(nullptr, mapSize_, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);  // the mapping keeps the file open
+    if (map_ == MAP_FAILED) {
+        map_ = nullptr;
+        throw std::runtime_error(path + ": mmap failed");
+    }
+
+    const uint8_t* base = static_cast<const uint8_t*>(map_);
+    header_ = reinterpret_cast<const RunLogHeader*>(base);
+    if (header_->magic != RUNLOG_MAGIC || header_->version != RUNLOG_VERSION ||
+        header_->blockSamples != RUNLOG_BLOCK_SAMPLES) {
+        unmap();
+        throw std::runtime_error(path + ": not a run log or an unsupported version");
+    }
+
+    // index the blocks, this only touches the block headers
+    size_t offset = sizeof(RunLogHeader);
+    while (offset + sizeof(RunLogBlockHeader) <= mapSize_) {
+        const RunLogBlockHeader* block = reinterpret_cast<const RunLogBlockHeader*>(base + offset);
+        offset += sizeof(RunLogBlockHeader);
+        bool sizeOk = block->count <= RUNLOG_BLOCK_SAMPLES && offset + block->payloadSize <= mapSize_;
+        bool encodingOk = block->encoding == RUNLOG_ENCODING_DELTA ||
+                          (block->encoding == RUNLOG_ENCODING_RAW && block->payloadSize == sizeof(RunLogSamples));
+        if (!sizeOk || !encodingOk) break;  // a log that was cut off while writing, keep what we have
+        blocks_.push_back(Block{block, base + offset, nullptr});
+        samples_ += block->count;
+        offset += block->payloadSize;
+        offset = (offset + 3) & ~size_t(3);  // skip the padding, blocks start at a multiple of 4
+    }
+}
+
+RunLog::~RunLog() { unmap(); }
+
+RunLog::RunLog(RunLog&& other) noexcept { *this = std::move(other); }
+
+RunLog& RunLog::operator=(RunLog&& other) noexcept {
+    if (this != &other) {
+        unmap();
+        path_ = std::move(other.path_);
+        map_ = other.map_;
+        mapSize_ = other.mapSize_;
+        header_ = other.header_;
+        blocks_ = std::move(other.blocks_);
+        samples_ = other.samples_;
+        other.map_ = nullptr;
+        other.mapSize_ = 0;
+        other.header_ = nullptr;
+        other.samples_ = 0;
+    }
+    return *this;
+}
+
+void RunLog::unmap() {
+    if (map_) munmap(map_, mapSize_);
+    map_ = nullptr;
+    blocks_.clear();
+}
+
+const RunLogSamples& RunLog::samples(size_t index) const {
+    const Block& block = blocks_.at(index);
+    if (block.header->encoding == RUNLOG_ENCODING_RAW) {
+        return *reinterpret_cast<const RunLogSamples*>(block.payload);
+    }
+    if (!block.decoded) {
+        std::unique_ptr<RunLogSamples> decoded(new RunLogSamples());
+        if (!runLogDecodeDelta(block.payload, block.header->payloadSize, block.header->count, *decoded)) {
+            throw std::runtime_error(path_ + ": block " + std::to_string(index) + " cannot be decoded");
+        }
+        block.decoded = std::move(decoded);
+    }
+    return *block.decoded;
+}
+
+bool RunLog::isMapped(size_t block) const {
+    return blocks_.at(block).header->encoding == RUNLOG_ENCODING_RAW || blocks_[block].decoded != nullptr;
+}
+
+Span<uint32_t> RunLog::time(size_t block) const { return {samples(block).time, blocks_[block].header->count}; }
+Span<int16_t> RunLog::temperature(size_t block) const { return {samples(block).temperature, blocks_[block].header->count}; }
+Span<int16_t> RunLog::setpoint(size_t block) const { return {samples(block).setpoint, blocks_[block].header->count}; }
+Span<uint8_t> RunLog::power(size_t block) const { return {samples(block).power, blocks_[block].header->count}; }
+Span<uint8_t> RunLog::phase(size_t block) const { return {samples(block).phase, blocks_[block].header->count}; }
+
+size_t RunLog::verify() const {
+    size_t bad = 0;
+    for (const Block& block : blocks_) {
+        if (runLogCrc32(block.payload, block.header->payloadSize) != block.header->crc) bad++;
+    }
+    return bad;
+}
+
+std::vector<double> RunLog::timeSeconds() const {
+    std::vector<double> column;
+    column.reserve(samples_);
+    for (size_t b = 0; b < blocks_.size(); b++) {
+        for (uint32_t ms : time(b)) column.push_back(ms / 1000.0);
+    }
+    return column;
+}
+
+std::vector<double> RunLog::temperatureCelsius() const {
+    std::vector<double> column;
+    column.reserve(samples_);
+    for (size_t b = 0; b < blocks_.size(); b++) {
+        for (int16_t t : temperature(b)) column.push_back(t / 10.0);
+    }
+    return column;
+}
+
+std::vector<double> RunLog::setpointCelsius() const {
+    std::vector<double> column;
+    column.reserve(samples_);
+    for (size_t b = 0; b < blocks_.size(); b++) {
+        for (int16_t t : setpoint(b)) column.push_back(t / 10.0);
+    }
+    return column;
+}
+
+RunSummary summarizeRunLog(const RunLog& log) {
+    RunSummary summary;
+    summary.path = log.path();
+    summary.runId = log.header().runId;
+    summary.pasteName = std::string(log.header().pasteName, strnlen(log.header().pasteName, sizeof(log.header().pasteName)));
+
+    const double interval = log.header().sampleInterval / 1000.0;
+    const int liquidus = (log.header().profile[4] - 20) * 10;  // reflow temperature - 20°C, in 0.1°C
+    int peak = INT16_MIN;
+    int overshoot = 0;
+    uint64_t above = 0;
+    uint64_t duty = 0;
+
+    for (size_t b = 0; b < log.blockCount(); b++) {
+        Span<uint32_t> time = log.time(b);
+        Span<int16_t> temperature = log.temperature(b);
+        Span<int16_t> setpoint = log.setpoint(b);
+        Span<uint8_t> power = log.power(b);
+        for (size_t i = 0; i < temperature.size; i++) {
+            if (temperature[i] > peak) {
+                peak = temperature[i];
+                summary.peakTime = time[i] / 1000.0;
+            }
+            overshoot = std::max(overshoot, temperature[i] - setpoint[i]);
+            if (temperature[i] >= liquidus) above++;
+            duty += power[i];
+        }
+        if (!time.empty()) summary.duration = time[time.size - 1] / 1000.0;
+    }
+
+    summary.valid = log.sampleCount() > 0;
+    summary.peakTemperature = summary.valid ? peak / 10.0 : 0;
+    summary.maxOvershoot = overshoot / 10.0;
+    summary.timeAbove = above * interval;
+    summary.energy = duty / 255.0 * interval;
+    return summary;
+}
+
+void forEachRunLog(const std::vector<std::string>& paths, const std::function<void(size_t, const RunLog&)>& work,
+                   const std::function<void(size_t, const std::string&)>& failed, unsigned threads) {
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    threads = std::min<size_t>(threads, std::max<size_t>(1, paths.size()));
+
+    // the workers take the next file from a shared counter, so a slow (large) file does not hold up a whole range
+    std::atomic<size_t> next{0};
+    auto worker = [&]() {
+        for (size_t i = next++; i < paths.size(); i = next++) {
+            try {
+                RunLog log(paths[i]);
+                work(i, log);
+            } catch (const std::exception& e) {
+                failed(i, e.what());
+            }
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (unsigned t = 1; t < threads; t++) pool.emplace_back(worker);
+    worker();
+    for (std::thread& thread : pool) thread.join();
+}
+
+std::vector<RunSummary> scanRunLogs(const std::vector<std::string>& paths, unsigned threads) {
+    std::vector<RunSummary> summaries(paths.size());
+    forEachRunLog(
+        paths, [&](size_t i, const RunLog& log) { summaries[i] = summarizeRunLog(log); },
+        [&](size_t i, const std::string& error) {
+            summaries[i].path = paths[i];
+            summaries[i].error = error;
+        },
+        threads);
+    return summaries;
+}
+
+std::vector<std::string> findRunLogFiles(const std::string& directory) {
+    std::vector<std::string> files;
+    for (const auto& entry : std::filesystem::recursive_directory_iterator(directory)) {
+        if (entry.is_regular_file() && entry.path().extension() == ".rlg") files.push_back(entry.path().string());
+    }
+    std::sort(files.begin(), files.end());
+    return files;
+}
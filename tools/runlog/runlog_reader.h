@@ -0,0 +1,120 @@
+/*
+  Host-side reader for the binary run logs of the reflow controller
+
+  A RunLog memory maps a log file and gives access to the columns (time, temperature,
+  setpoint, power and phase) per block. Raw blocks are returned as spans straight into
+  the mapped file, delta encoded blocks are decoded the first time they are accessed
+  and then kept in a per-block cache, so a scan that only needs the temperatures of a
+  few runs never decodes the rest.
+
+  A RunLog object is not thread safe (the cache is filled lazily), but different RunLog
+  objects can be used from different threads. scanRunLogs() does exactly that to process
+  a directory of logs in parallel.
+
+  The file format is described in include/runlog.h of the firmware.
+*/
+#ifndef RUNLOG_READER_H
+#define RUNLOG_READER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../../include/runlog.h"
+
+// A read-only view on a contiguous array, like the C++20 std::span
+template <class T>
+struct Span {
+    const T* data = nullptr;
+    size_t size = 0;
+
+    const T* begin() const { return data; }
+    const T* end() const { return data + size; }
+    const T& operator[](size_t i) const { return data[i]; }
+    bool empty() const { return size == 0; }
+};
+
+class RunLog {
+   public:
+    // Map the file and index its blocks, throws std::runtime_error when it is not a valid run log
+    explicit RunLog(const std::string& path);
+    ~RunLog();
+
+    RunLog(const RunLog&) = delete;
+    RunLog& operator=(const RunLog&) = delete;
+    RunLog(RunLog&& other) noexcept;
+    RunLog& operator=(RunLog&& other) noexcept;
+
+    const std::string& path() const { return path_; }
+    const RunLogHeader& header() const { return *header_; }
+    size_t blockCount() const { return blocks_.size(); }
+    size_t sampleCount() const { return samples_; }
+
+    // The columns of a block; the spans stay valid as long as the RunLog exists
+    Span<uint32_t> time(size_t block) const;
+    Span<int16_t> temperature(size_t block) const;
+    Span<int16_t> setpoint(size_t block) const;
+    Span<uint8_t> power(size_t block) const;
+    Span<uint8_t> phase(size_t block) const;
+
+    // True when the block can be used without decoding (a raw block or an already decoded one)
+    bool isMapped(size_t block) const;
+
+    // Check the CRC of every block, returns the number of bad blocks
+    size_t verify() const;
+
+    // Convenience copies of a complete column in physical units (s, °C, °C)
+    std::vector<double> timeSeconds() const;
+    std::vector<double> temperatureCelsius() const;
+    std::vector<double> setpointCelsius() const;
+
+   private:
+    struct Block {
+        const RunLogBlockHeader* header;
+        const uint8_t* payload;
+        mutable std::unique_ptr<RunLogSamples> decoded;  // only for delta encoded blocks
+    };
+
+    const RunLogSamples& samples(size_t block) const;
+    void unmap();
+
+    std::string path_;
+    void* map_ = nullptr;
+    size_t mapSize_ = 0;
+    const RunLogHeader* header_ = nullptr;
+    std::vector<Block> blocks_;
+    size_t samples_ = 0;
+};
+
+// Summary of a run, the result of the standard scan
+struct RunSummary {
+    std::string path;
+    uint32_t runId = 0;
+    std::string pasteName;
+    double duration = 0;         // s
+    double peakTemperature = 0;  // °C
+    double peakTime = 0;         // s, the time of the peak
+    double timeAbove = 0;        // s above the liquidus (the reflow temperature of the profile minus 20°C)
+    double maxOvershoot = 0;     // °C above the setpoint
+    double energy = 0;           // heater duty in full-power seconds
+    bool valid = false;
+    std::string error;
+};
+
+// Summarize one run log
+RunSummary summarizeRunLog(const RunLog& log);
+
+// Run a function on every file with a worker per hardware thread (0 = all cores)
+void forEachRunLog(const std::vector<std::string>& paths, const std::function<void(size_t, const RunLog&)>& work,
+                   const std::function<void(size_t, const std::string&)>& failed, unsigned threads = 0);
+
+// Summarize all the files in parallel, the result is in the order of the paths
+std::vector<RunSummary> scanRunLogs(const std::vector<std::string>& paths, unsigned threads = 0);
+
+// All *.rlg files in a directory and its subdirectories, sorted by name
+std::vector<std::string> findRunLogFiles(const std::string& directory);
+
+#endif  // RUNLOG_READER_H
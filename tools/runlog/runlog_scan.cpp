@@ -0,0 +1,68 @@
+/*
+  runlog_scan: summarize a collection of run logs
+
+  Usage: runlog_scan [-j threads] [--verify] <file or directory>...
+
+  Prints a CSV line per run with the peak temperature, the time above liquidus, the largest
+  overshoot and the heater energy. The files are memory mapped and processed in parallel,
+  only the blocks that are needed are decoded.
+*/
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "runlog_reader.h"
+
+int main(int argc, char** argv) {
+    unsigned threads = 0;
+    bool verify = false;
+    std::vector<std::string> paths;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--verify") == 0) {
+            verify = true;
+        } else if (std::filesystem::is_directory(argv[i])) {
+            std::vector<std::string> found = findRunLogFiles(argv[i]);
+            paths.insert(paths.end(), found.begin(), found.end());
+        } else {
+            paths.push_back(argv[i]);
+        }
+    }
+    if (paths.empty()) {
+        fprintf(stderr, "usage: %s [-j threads] [--verify] <file or directory>...\n", argv[0]);
+        return 2;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<RunSummary> summaries = scanRunLogs(paths, threads);
+    std::vector<size_t> badBlocks(paths.size(), 0);
+    if (verify) {
+        forEachRunLog(
+            paths, [&](size_t i, const RunLog& log) { badBlocks[i] = log.verify(); }, [](size_t, const std::string&) {},
+            threads);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    printf("run,paste,duration_s,peak_C,peak_time_s,above_liquidus_s,overshoot_C,energy_s%s,file\n", verify ? ",bad_blocks" : "");
+    int errors = 0;
+    for (size_t i = 0; i < summaries.size(); i++) {
+        const RunSummary& s = summaries[i];
+        if (!s.error.empty()) {
+            fprintf(stderr, "%s\n", s.error.c_str());
+            errors++;
+            continue;
+        }
+        printf("%u,\"%s\",%.2f,%.1f,%.2f,%.2f,%.1f,%.1f", s.runId, s.pasteName.c_str(), s.duration, s.peakTemperature,
+               s.peakTime, s.timeAbove, s.maxOvershoot, s.energy);
+        if (verify) printf(",%zu", badBlocks[i]);
+        printf(",%s\n", s.path.c_str());
+    }
+    fprintf(stderr, "%zu run logs in %.3f s, %d errors\n", paths.size(), seconds, errors);
+    return errors ? 1 : 0;
+}
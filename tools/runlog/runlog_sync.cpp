@@ -0,0 +1,286 @@
+/*
+  runlog_sync: collect the new run logs of a controller over its serial port
+
+  Usage: runlog_sync [--baud n] [--timeout s] [--retries n] [-v] <serial port> <directory>
+
+  The logs are stored as <directory>/<runId>.rlg, byte for byte the files of the controller,
+  so runlog_scan can read the directory. <directory>/sync.state holds the high-water mark: the
+  run and the block that are needed next and the size of the verified part of that file. Only
+  what is new since the last time is transferred (include/logsync.h). A block is appended to its
+  file and the mark is saved after the CRCs were checked, so after an interruption (a damaged
+  frame, a time-out, a reset or an unplugged cable, or a kill of this program) the next SYNC
+  resumes at the last verified block. Use a directory per station.
+
+  The debug prints of the firmware are dropped, -v shows them on stderr.
+
+  POSIX only (Linux, macOS).
+*/
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "logsync.h"
+
+namespace {
+
+struct Mark {
+    uint32_t runId = 0;
+    uint32_t block = 0;  // 0: the header of the run is needed next
+    uint64_t size = 0;   // verified bytes of <runId>.rlg
+};
+
+std::string directory;
+bool verbose = false;
+
+std::string logPath(uint32_t runId) {
+    return directory + "/" + std::to_string(runId) + ".rlg";
+}
+
+bool loadMark(Mark& mark) {
+    FILE* f = fopen((directory + "/sync.state").c_str(), "r");
+    if (!f) return errno == ENOENT;  // the first time: start at the beginning
+    unsigned long runId, block;
+    unsigned long long size;
+    bool ok = fscanf(f, "%lu %lu %llu", &runId, &block, &size) == 3;
+    fclose(f);
+    mark.runId = (uint32_t)runId;
+    mark.block = (uint32_t)block;
+    mark.size = size;
+    return ok;
+}
+
+// write the mark to a new file and rename it, so a kill never leaves half a state
+bool saveMark(const Mark& mark) {
+    std::string path = directory + "/sync.state";
+    FILE* f = fopen((path + ".new").c_str(), "w");
+    if (!f) return false;
+    fprintf(f, "%lu %lu %llu\n", (unsigned long)mark.runId, (unsigned long)mark.block, (unsigned long long)mark.size);
+    bool ok = fflush(f) == 0 && fsync(fileno(f)) == 0;
+    fclose(f);
+    return ok && rename((path + ".new").c_str(), path.c_str()) == 0;
+}
+
+// check the data of a header or block frame, the frames without data have nothing to check
+bool valid(const LogSyncFrame& frame, const uint8_t* data) {
+    if (frame.type == LOGSYNC_HEADER) {
+        RunLogHeader header;
+        if (frame.block != 0 || frame.length != sizeof(header)) return false;
+        memcpy(&header, data, sizeof(header));
+        return header.magic == RUNLOG_MAGIC && header.runId == frame.runId;
+    }
+    if (frame.type == LOGSYNC_BLOCK) {
+        RunLogBlockHeader block;
+        if (frame.block == 0 || frame.length < sizeof(block)) return false;
+        memcpy(&block, data, sizeof(block));
+        return logSyncBlockSize(block) == frame.length && block.crc == runLogCrc32(data + sizeof(block), block.payloadSize);
+    }
+    return frame.length == 0 && (frame.type == LOGSYNC_CLOSED || frame.type == LOGSYNC_END);
+}
+
+/*
+  Store a header or a block that continues at the mark and save the new mark. The file is cut at
+  the verified size first, that drops a block that was written before a kill but not in the mark.
+*/
+bool store(Mark& mark, const LogSyncFrame& frame, const uint8_t* data) {
+    int fd = open(logPath(frame.runId).c_str(), O_WRONLY | O_CREAT, 0644);
+    if (fd < 0) return false;
+    uint64_t offset = frame.type == LOGSYNC_HEADER ? 0 : mark.size;
+    bool ok = ftruncate(fd, (off_t)offset) == 0 && pwrite(fd, data, frame.length, (off_t)offset) == frame.length &&
+              fsync(fd) == 0;
+    close(fd);
+    if (!ok) return false;
+
+    mark.runId = frame.runId;
+    mark.block = frame.block + 1;
+    mark.size = offset + frame.length;
+    return saveMark(mark);
+}
+
+int openPort(const char* port, int baud) {
+    int fd = open(port, O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (fd < 0) return -1;
+    termios tio;
+    if (tcgetattr(fd, &tio) != 0) {
+        close(fd);
+        return -1;
+    }
+    cfmakeraw(&tio);
+    tio.c_cflag |= CLOCAL | CREAD;
+    tio.c_cflag &= ~HUPCL;  // don't reset the controller when we close the port
+    speed_t speed = baud == 9600 ? B9600 : baud == 57600 ? B57600 : baud == 230400 ? B230400 : B115200;
+    cfsetispeed(&tio, speed);
+    cfsetospeed(&tio, speed);
+    if (tcsetattr(fd, TCSANOW, &tio) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+bool sendSync(int fd, const Mark& mark) {
+    char line[64];
+    int n = snprintf(line, sizeof(line), "SYNC %lu %lu\n", (unsigned long)mark.runId, (unsigned long)mark.block);
+    return write(fd, line, n) == n;
+}
+
+// show the bytes that are not part of a frame, the debug prints of the firmware
+void dropped(const uint8_t* bytes, size_t n) {
+    if (verbose) fwrite(bytes, 1, n, stderr);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    int baud = 115200;
+    double timeout = 5;  // s without a verified frame before we send the mark again
+    int retries = 10;    // resends in a row without progress before we give up
+    const char* port = nullptr;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--baud") == 0 && i + 1 < argc) {
+            baud = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--timeout") == 0 && i + 1 < argc) {
+            timeout = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--retries") == 0 && i + 1 < argc) {
+            retries = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-v") == 0) {
+            verbose = true;
+        } else if (!port) {
+            port = argv[i];
+        } else {
+            directory = argv[i];
+        }
+    }
+    if (!port || directory.empty()) {
+        fprintf(stderr, "Usage: runlog_sync [--baud n] [--timeout s] [--retries n] [-v] <serial port> <directory>\n");
+        return 2;
+    }
+
+    Mark mark;
+    if (!loadMark(mark)) {
+        fprintf(stderr, "cannot read %s/sync.state\n", directory.c_str());
+        return 1;
+    }
+
+    typedef std::chrono::steady_clock Clock;
+    int fd = -1;
+    int attempts = 0;
+    unsigned blocks = 0, runs = 0, damaged = 0;
+    std::vector<uint8_t> buffer;
+    bool started = false;  // the frames of the last SYNC are coming in
+    bool first = false;    // the next frame is the first one after the start
+    Clock::time_point deadline = Clock::now();
+
+    while (true) {
+        // (re)send the mark when nothing came in time, reopen the port when it went away
+        if (Clock::now() >= deadline) {
+            if (attempts++ > retries) {
+                fprintf(stderr, "no response, stopped at run %lu block %lu\n", (unsigned long)mark.runId,
+                        (unsigned long)mark.block);
+                return 1;
+            }
+            if (fd < 0) fd = openPort(port, baud);
+            if (fd < 0 || !sendSync(fd, mark)) {
+                if (fd >= 0) close(fd);
+                fd = -1;
+            }
+            buffer.clear();
+            started = false;
+            deadline = Clock::now() + std::chrono::milliseconds((long)(timeout * 1000));
+            continue;
+        }
+
+        uint8_t bytes[4096];
+        ssize_t n = 0;
+        if (fd >= 0) {
+            pollfd p = {fd, POLLIN, 0};
+            if (poll(&p, 1, 100) > 0) {
+                n = read(fd, bytes, sizeof(bytes));
+                if (n <= 0 || (p.revents & (POLLERR | POLLHUP))) {  // unplugged, try again later
+                    close(fd);
+                    fd = -1;
+                    n = 0;
+                }
+            }
+        } else {
+            usleep(100000);
+        }
+        buffer.insert(buffer.end(), bytes, bytes + n);
+
+        // take the frames out of the buffer, what is not a frame is debug output
+        size_t used = 0;
+        bool resend = false;
+        while (used < buffer.size()) {
+            LogSyncFrame frame;
+            int size = logSyncCheck(buffer.data() + used, buffer.size() - used, &frame);
+            if (size == 0) break;
+            if (size < 0) {
+                const uint32_t magic = LOGSYNC_MAGIC;
+                if (buffer.size() - used >= sizeof(magic) && memcmp(&buffer[used], &magic, sizeof(magic)) == 0) damaged++;
+                dropped(&buffer[used], 1);
+                used++;
+                continue;
+            }
+            const uint8_t* data = buffer.data() + used + sizeof(LogSyncFrame);
+            used += size;
+
+            if (frame.type == LOGSYNC_STATUS || frame.type == LOGSYNC_PASTE) continue;  // for tools/scheduler
+            if (frame.type == LOGSYNC_START) {
+                // the transfer we asked for, what came before it was still on its way
+                started = frame.runId == mark.runId && frame.block == mark.block;
+                first = true;
+                continue;
+            }
+            if (!started) continue;
+
+            // a frame continues at the mark, a later run only after a closed run or at the start
+            bool atMark = frame.runId == mark.runId && frame.block == mark.block;
+            bool later = frame.runId > mark.runId && frame.block == 0 && (mark.block == 0 || first);
+            first = false;
+            if ((!atMark && !later) || !valid(frame, data)) {  // we missed a frame
+                started = false;
+                resend = true;
+                continue;
+            }
+
+            if (frame.type == LOGSYNC_END) {
+                mark.runId = frame.runId;
+                if (later && !saveMark(mark)) return 1;  // the runs we needed were removed
+                printf("%u runs, %u blocks, now at run %lu block %lu", runs, blocks, (unsigned long)mark.runId,
+                       (unsigned long)mark.block);
+                if (damaged > 0) printf(", %u damaged frames", damaged);
+                printf("\n");
+                return 0;
+            }
+            if (frame.type == LOGSYNC_CLOSED) {
+                mark.runId = frame.runId + 1;
+                mark.block = 0;
+                mark.size = 0;
+                if (!saveMark(mark)) return 1;
+            } else if (store(mark, frame, data)) {
+                if (frame.type == LOGSYNC_HEADER) {
+                    runs++;
+                } else {
+                    blocks++;
+                }
+            } else {
+                fprintf(stderr, "cannot store run %lu block %lu\n", (unsigned long)frame.runId,
+                        (unsigned long)frame.block);
+                return 1;
+            }
+            attempts = 0;
+            deadline = Clock::now() + std::chrono::milliseconds((long)(timeout * 1000));
+        }
+        buffer.erase(buffer.begin(), buffer.begin() + used);
+        if (resend) deadline = Clock::now();
+    }
+}
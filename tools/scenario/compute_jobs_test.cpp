@@ -0,0 +1,137 @@
+/*
+  compute_jobs_test: the cancellation of the background jobs of include/compute_jobs.h
+
+  Usage: compute_jobs_test
+
+  The scenarios run the jobs inline (COMPUTE_INLINE), a job always finishes before the next
+  submission, so the supersession of a running job and of a result that waits for the main loop
+  is checked here, on the queue itself. Prints the checks that failed, returns 1 when one did.
+*/
+#include <cstdio>
+#include <cstring>
+
+#include "compute_jobs.h"
+
+namespace {
+
+int checks = 0, failures = 0;
+
+void check(bool ok, const char* what, int line) {
+    checks++;
+    if (ok) return;
+    failures++;
+    printf("compute_jobs_test.cpp:%d: %s\n", line, what);
+}
+
+#define CHECK(condition) check(condition, #condition, __LINE__)
+
+const uint8_t JOB_A = 0, JOB_B = 1;
+
+void freshQueue(ComputeQueue& q) {
+    memset(&q, 0, sizeof(q));
+}
+
+// a job runs to the end and its result reaches the main loop
+void delivered() {
+    ComputeQueue q;
+    freshQueue(q);
+    uint32_t generation = computeSubmit(q, JOB_A, 1, 100);
+    ComputeJob job;
+    CHECK(computeTake(q, &job, 110));
+    CHECK(job.generation == generation);
+    CHECK(!computeCancelled(q, job));
+    computeFinished(q, job, true, 150);
+    ComputeResult result;
+    CHECK(computeResult(q, &result, 160));
+    CHECK(result.kind == JOB_A && result.generation == generation);
+    CHECK(q.stats[JOB_A].done == 1 && q.stats[JOB_A].cancelled == 0);
+    CHECK(q.stats[JOB_A].latencyMax == 60 && q.stats[JOB_A].runMax == 40);
+    CHECK(!computeResult(q, &result, 170));
+}
+
+// a submission while the job runs: the worker sees it and the job counts as cancelled
+void supersededWhileRunning() {
+    ComputeQueue q;
+    freshQueue(q);
+    computeSubmit(q, JOB_A, 1, 100);
+    ComputeJob job;
+    CHECK(computeTake(q, &job, 110));
+    uint32_t newer = computeSubmit(q, JOB_A, 1, 120);
+    CHECK(computeCancelled(q, job));
+
+    // it completes anyway: no result, one cancelled
+    computeFinished(q, job, true, 150);
+    ComputeResult result;
+    CHECK(!computeResult(q, &result, 160));
+    CHECK(q.stats[JOB_A].cancelled == 1 && q.stats[JOB_A].done == 0);
+
+    // the newer one is still queued and delivers
+    ComputeJob next;
+    CHECK(computeTake(q, &next, 170));
+    CHECK(next.generation == newer && !computeCancelled(q, next));
+    computeFinished(q, next, true, 200);
+    CHECK(computeResult(q, &result, 210));
+    CHECK(result.generation == newer);
+    CHECK(q.stats[JOB_A].done == 1 && q.stats[JOB_A].cancelled == 1);
+}
+
+// a worker that gives up at a checkpoint counts the job as cancelled
+void givenUp() {
+    ComputeQueue q;
+    freshQueue(q);
+    computeSubmit(q, JOB_A, 1, 100);
+    ComputeJob job;
+    CHECK(computeTake(q, &job, 110));
+    computeCancel(q, JOB_A);
+    CHECK(computeCancelled(q, job));
+    computeFinished(q, job, false, 120);
+    ComputeResult result;
+    CHECK(!computeResult(q, &result, 130));
+    CHECK(q.stats[JOB_A].cancelled == 1 && q.stats[JOB_A].done == 0);
+}
+
+// a result that waits for the main loop when the kind is submitted again is dropped
+void staleResult() {
+    ComputeQueue q;
+    freshQueue(q);
+    computeSubmit(q, JOB_A, 1, 100);
+    computeSubmit(q, JOB_B, 1, 100);
+    ComputeJob a, b;
+    CHECK(computeTake(q, &a, 110));
+    CHECK(computeTake(q, &b, 110));
+    computeFinished(q, a, true, 120);
+    computeFinished(q, b, true, 120);
+    computeSubmit(q, JOB_A, 1, 130);  // the result of a is stale now
+
+    ComputeResult result;
+    CHECK(computeResult(q, &result, 140));
+    CHECK(result.kind == JOB_B);  // the event of a was dropped on the way
+    CHECK(!computeResult(q, &result, 140));
+    CHECK(q.stats[JOB_A].cancelled == 1 && q.stats[JOB_A].done == 0);
+    CHECK(q.stats[JOB_B].done == 1);
+}
+
+// a queued job that is submitted again runs once, with the newest inputs
+void supersededWhileQueued() {
+    ComputeQueue q;
+    freshQueue(q);
+    computeSubmit(q, JOB_A, 1, 100);
+    uint32_t newer = computeSubmit(q, JOB_A, 1, 110);
+    CHECK(q.stats[JOB_A].cancelled == 1);
+    ComputeJob job;
+    CHECK(computeTake(q, &job, 120));
+    CHECK(job.generation == newer && job.submitted == 110);
+    CHECK(!computeTake(q, &job, 120));
+}
+
+}  // namespace
+
+int main() {
+    delivered();
+    supersededWhileRunning();
+    givenUp();
+    staleResult();
+    supersededWhileQueued();
+    printf("%d checks, %d failed\n", checks, failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,110 @@
+/*
+  Mock of the Arduino core for the scenario runner: the virtual clock, the pins, String and Serial
+*/
+#ifndef Arduino_h
+#define Arduino_h
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+
+#include "host.h"
+
+using std::max;
+using std::min;
+
+#define IRAM_ATTR
+#define PI 3.1415926535897932384626433832795
+#define HIGH 1
+#define LOW 0
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define INPUT_PULLUP 0x05
+#define CHANGE 0x03
+#define portTICK_PERIOD_MS 1
+
+typedef uint8_t byte;
+
+inline unsigned long millis() { return (unsigned long)host.now; }
+inline unsigned long micros() { return (unsigned long)(host.now * 1000); }
+inline void delay(unsigned long ms) { host.advance(ms); }
+inline void vTaskDelay(unsigned long ticks) { host.advance(ticks); }
+inline void pinMode(int, int) {}
+inline void digitalWrite(int pin, int level) { host.writePin(pin, level ? 1 : 0); }
+inline int digitalRead(int pin) { return host.pins[pin]; }
+inline int digitalPinToInterrupt(int pin) { return pin; }
+inline void attachInterrupt(int, void (*)(), int) {}
+
+template <class T>
+T constrain(T value, T low, T high) {
+    return value < low ? low : (value > high ? high : value);
+}
+
+class String : public std::string {
+public:
+    String() {}
+    String(const char* s) : std::string(s ? s : "") {}
+    String(const std::string& s) : std::string(s) {}
+    String(char c) : std::string(1, c) {}
+    String(int v) : std::string(std::to_string(v)) {}
+    String(unsigned v) : std::string(std::to_string(v)) {}
+    String(long v) : std::string(std::to_string(v)) {}
+    String(unsigned long v) : std::string(std::to_string(v)) {}
+    String(double v, int decimals = 2) {
+        char buffer[40];
+        snprintf(buffer, sizeof(buffer), "%.*f", decimals, v);
+        assign(buffer);
+    }
+
+    String operator+(const String& o) const { return String(std::string(*this) + std::string(o)); }
+    String operator+(const char* o) const { return String(std::string(*this) + o); }
+    friend String operator+(const char* a, const String& b) { return String(std::string(a) + std::string(b)); }
+    int toInt() const { return atoi(c_str()); }
+};
+
+// The print functions of the Arduino Print class, the derived class writes the characters
+class Print {
+public:
+    virtual ~Print() {}
+    virtual size_t write(const char* text, size_t length) = 0;
+
+    size_t write(uint8_t c) { return write((const char*)&c, 1); }
+    size_t write(const uint8_t* data, size_t length) { return write((const char*)data, length); }
+    size_t print(const char* s) { return write(s, strlen(s)); }
+    size_t print(const String& s) { return write(s.c_str(), s.size()); }
+    size_t print(char c) { return write(&c, 1); }
+    size_t print(int v) { return print(String(v)); }
+    size_t print(unsigned v) { return print(String(v)); }
+    size_t print(long v) { return print(String(v)); }
+    size_t print(unsigned long v) { return print(String(v)); }
+    size_t print(double v, int decimals = 2) { return print(String(v, decimals)); }
+    size_t println() { return print("\r\n"); }
+    template <class T>
+    size_t println(T v) { return print(v) + println(); }
+    size_t println(double v, int decimals) { return print(v, decimals) + println(); }
+};
+
+class HardwareSerial : public Print {
+public:
+    void begin(unsigned long) {}
+    void setTxBufferSize(size_t) {}
+    operator bool() const { return true; }
+    int available() { return (int)(host.serialInput.size() - host.serialRead); }
+    int read() { return host.serialRead < host.serialInput.size() ? (uint8_t)host.serialInput[host.serialRead++] : -1; }
+    int availableForWrite() { return 2048; }  // the output is taken at once
+    void flush() {}
+    using Print::write;
+    size_t write(const char* text, size_t length) override {
+        host.serial.append(text, length);
+        return length;
+    }
+};
+
+inline HardwareSerial Serial;
+
+#endif  // Arduino_h
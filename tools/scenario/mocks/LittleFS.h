@@ -0,0 +1,126 @@
+/*
+  Mock of LittleFS for the scenario runner: the files are kept in memory for one scenario
+*/
+#ifndef _LITTLEFS_H_
+#define _LITTLEFS_H_
+
+#include <Arduino.h>
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#define FILE_READ "r"
+#define FILE_WRITE "w"
+#define FILE_APPEND "a"
+
+namespace fs {
+
+struct MockFiles {
+    std::map<std::string, std::vector<uint8_t>> files;
+    std::set<std::string> directories = {"/"};
+};
+
+inline MockFiles mockFiles;
+
+class File {
+public:
+    File() {}
+    File(const std::string& path, bool directory) : path(path), directory(directory), open(true) {}
+
+    operator bool() const { return open; }
+    bool isDirectory() const { return directory; }
+    const char* name() const {
+        size_t slash = path.rfind('/');
+        return path.c_str() + (slash == std::string::npos ? 0 : slash + 1);
+    }
+    const char* getPath() const { return path.c_str(); }
+
+    size_t write(const uint8_t* data, size_t length) {
+        if (!open || directory) return 0;
+        std::vector<uint8_t>& file = mockFiles.files[path];
+        if (position + length > file.size()) file.resize(position + length);
+        std::copy(data, data + length, file.begin() + position);
+        position += length;
+        return length;
+    }
+    size_t write(uint8_t c) { return write(&c, 1); }
+    size_t read(uint8_t* buffer, size_t length) {
+        if (!open || directory) return 0;
+        const std::vector<uint8_t>& file = mockFiles.files[path];
+        size_t n = std::min(length, file.size() - std::min(position, file.size()));
+        std::copy(file.begin() + position, file.begin() + position + n, buffer);
+        position += n;
+        return n;
+    }
+    int read() {
+        uint8_t c;
+        return read(&c, 1) == 1 ? c : -1;
+    }
+    bool seek(uint32_t to) {
+        position = to;
+        return true;
+    }
+    size_t size() const { return open && !directory ? mockFiles.files[path].size() : 0; }
+    int available() const { return (int)(size() - std::min(position, size())); }
+    void flush() {}
+    void close() { open = false; }
+
+    // the next file in a directory, in the order of their names
+    File openNextFile() {
+        if (!open || !directory) return File();
+        std::string prefix = path == "/" ? "/" : path + "/";
+        auto it = mockFiles.files.upper_bound(last.empty() ? prefix : last);
+        for (; it != mockFiles.files.end() && it->first.compare(0, prefix.size(), prefix) == 0; ++it) {
+            if (it->first.find('/', prefix.size()) == std::string::npos) {
+                last = it->first;
+                return File(it->first, false);
+            }
+        }
+        return File();
+    }
+
+private:
+    std::string path;
+    bool directory = false;
+    bool open = false;
+    size_t position = 0;
+    std::string last;  // the last file given by openNextFile()
+};
+
+class LittleFSFS {
+public:
+    bool begin(bool = false) { return true; }
+    File open(const String& path, const char* mode = FILE_READ, bool = false) { return open(path.c_str(), mode); }
+    File open(const char* path, const char* mode = FILE_READ, bool = false) {
+        std::string p(path);
+        if (mockFiles.directories.count(p)) return File(p, true);
+        if (mode[0] == 'w') {
+            mockFiles.files[p].clear();
+        } else if (mode[0] == 'r' && !mockFiles.files.count(p)) {
+            return File();
+        }
+        File file(p, false);
+        if (mode[0] == 'a') file.seek(mockFiles.files[p].size());
+        return file;
+    }
+    bool exists(const String& path) { return exists(path.c_str()); }
+    bool exists(const char* path) { return mockFiles.files.count(path) || mockFiles.directories.count(path); }
+    bool remove(const String& path) { return remove(path.c_str()); }
+    bool remove(const char* path) { return mockFiles.files.erase(path) != 0; }
+    bool mkdir(const char* path) { return mockFiles.directories.insert(path).second; }
+    size_t totalBytes() { return 1441792; }  // the spiffs partition of the default 4MB layout
+    size_t usedBytes() {
+        size_t used = 0;
+        for (auto& file : mockFiles.files) used += (file.second.size() + 4095) / 4096 * 4096;
+        return used;
+    }
+};
+
+}  // namespace fs
+
+using fs::File;
+inline fs::LittleFSFS LittleFS;
+
+#endif  // _LITTLEFS_H_
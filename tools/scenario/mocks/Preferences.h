@@ -0,0 +1,48 @@
+/*
+  Mock of the ESP32 Preferences (NVS) for the scenario runner, kept in memory for one scenario
+*/
+#ifndef _PREFERENCES_H_
+#define _PREFERENCES_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+class Preferences {
+public:
+    bool begin(const char* name, bool = false, const char* = nullptr) {
+        space = name;
+        return true;
+    }
+    void end() {}
+    size_t putBytes(const char* key, const void* value, size_t length) {
+        const uint8_t* bytes = (const uint8_t*)value;
+        store()[space + "/" + key].assign(bytes, bytes + length);
+        return length;
+    }
+    size_t getBytesLength(const char* key) {
+        auto found = store().find(space + "/" + key);
+        return found == store().end() ? 0 : found->second.size();
+    }
+    size_t getBytes(const char* key, void* buffer, size_t length) {
+        auto found = store().find(space + "/" + key);
+        if (found == store().end() || found->second.size() > length) return 0;
+        memcpy(buffer, found->second.data(), found->second.size());
+        return found->second.size();
+    }
+    bool isKey(const char* key) { return store().count(space + "/" + key) != 0; }
+    bool remove(const char* key) { return store().erase(space + "/" + key) != 0; }
+
+private:
+    static std::map<std::string, std::vector<uint8_t>>& store() {
+        static std::map<std::string, std::vector<uint8_t>> values;
+        return values;
+    }
+    std::string space;
+};
+
+#endif  // _PREFERENCES_H_
@@ -0,0 +1,14 @@
+/*
+  Mock of the Arduino SPI class for the scenario runner, the thermocouple chips are bit-banged
+*/
+#ifndef _SPI_H_INCLUDED
+#define _SPI_H_INCLUDED
+
+class SPIClass {
+public:
+    void begin() {}
+};
+
+inline SPIClass SPI;
+
+#endif  // _SPI_H_INCLUDED
@@ -0,0 +1,230 @@
+/*
+  Mock of TFT_eSPI for the scenario runner: a 16-bit framebuffer and a list of the texts on it
+
+  The shapes are drawn into the framebuffer (rounded corners are square), the texts are not
+  rendered but kept as a list with their position and color. A text disappears from the list
+  when something is drawn over its position, so the list is what a user would read on the
+  screen. writeSnapshot() saves both, as a PPM image and a text file.
+*/
+#ifndef TFT_ESPI_H
+#define TFT_ESPI_H
+
+#include <Arduino.h>
+
+#include <vector>
+
+#define TFT_BLACK 0x0000
+#define TFT_NAVY 0x000F
+#define TFT_DARKGREEN 0x03E0
+#define TFT_DARKCYAN 0x03EF
+#define TFT_MAROON 0x7800
+#define TFT_PURPLE 0x780F
+#define TFT_OLIVE 0x7BE0
+#define TFT_LIGHTGREY 0xD69A
+#define TFT_DARKGREY 0x7BEF
+#define TFT_BLUE 0x001F
+#define TFT_GREEN 0x07E0
+#define TFT_CYAN 0x07FF
+#define TFT_RED 0xF800
+#define TFT_MAGENTA 0xF81F
+#define TFT_YELLOW 0xFFE0
+#define TFT_WHITE 0xFFFF
+#define TFT_ORANGE 0xFDA0
+#define TFT_GREENYELLOW 0xB7E0
+#define TFT_PINK 0xFE19
+#define TFT_BROWN 0x9A60
+#define TFT_GOLD 0xFEA0
+#define TFT_SILVER 0xC618
+#define TFT_SKYBLUE 0x867D
+#define TFT_VIOLET 0x915C
+
+#define TL_DATUM 0
+#define TC_DATUM 1
+#define TR_DATUM 2
+#define ML_DATUM 3
+#define MC_DATUM 4
+#define MR_DATUM 5
+#define BL_DATUM 6
+#define BC_DATUM 7
+#define BR_DATUM 8
+
+// the panel size the firmware finds, the runner can change it before setup()
+inline int16_t mockPanelWidth = 240;
+inline int16_t mockPanelHeight = 320;
+
+struct ScreenText {
+    int16_t x, y, w, h;
+    uint16_t color;
+    std::string text;
+};
+
+class TFT_eSPI : public Print {
+public:
+    TFT_eSPI(int16_t w = mockPanelWidth, int16_t h = mockPanelHeight) : panelW(w), panelH(h), w(w), h(h) {}
+
+    void init() { pixels.assign((size_t)w * h, 0); }
+    void setRotation(uint8_t r) {
+        w = (r & 1) ? panelH : panelW;
+        h = (r & 1) ? panelW : panelH;
+        pixels.assign((size_t)w * h, 0);
+        texts.clear();
+    }
+    int16_t width() const { return w; }
+    int16_t height() const { return h; }
+    void setSwapBytes(bool) {}
+    void startWrite() {}
+    void endWrite() {}
+
+    void setTextColor(uint16_t c) { textColor = c; }
+    void setTextColor(uint16_t c, uint16_t) { textColor = c; }
+    void setTextDatum(uint8_t d) { datum = d; }
+    void setTextSize(uint8_t s) { textSize = s ? s : 1; }
+    void setTextFont(uint8_t f) { textFont = f; }
+    void setCursor(int16_t x, int16_t y) {
+        cursorX = x;
+        cursorY = y;
+    }
+
+    uint16_t color565(uint8_t r, uint8_t g, uint8_t b) { return ((r & 0xF8) << 8) | ((g & 0xFC) << 3) | (b >> 3); }
+    int16_t fontHeight(uint8_t font) const { return font == 1 ? 8 * textSize : 16 * textSize; }
+    int16_t textWidth(const char* s, uint8_t font) const { return (int16_t)(strlen(s) * (font == 1 ? 6 : 8) * textSize); }
+    int16_t textWidth(const String& s, uint8_t font) const { return textWidth(s.c_str(), font); }
+
+    void fillScreen(uint32_t color) { fillRect(0, 0, w, h, color); }
+    void fillRect(int32_t x, int32_t y, int32_t rw, int32_t rh, uint32_t color) {
+        for (int32_t j = std::max(0, (int)y); j < std::min((int32_t)h, y + rh); j++) {
+            for (int32_t i = std::max(0, (int)x); i < std::min((int32_t)w, x + rw); i++) pixels[(size_t)j * w + i] = color;
+        }
+        cover(x, y, rw, rh);
+    }
+    void fillRoundRect(int32_t x, int32_t y, int32_t rw, int32_t rh, int32_t, uint32_t color) { fillRect(x, y, rw, rh, color); }
+    void drawRect(int32_t x, int32_t y, int32_t rw, int32_t rh, uint32_t color) {
+        drawFastHLine(x, y, rw, color);
+        drawFastHLine(x, y + rh - 1, rw, color);
+        drawFastVLine(x, y, rh, color);
+        drawFastVLine(x + rw - 1, y, rh, color);
+    }
+    void drawRoundRect(int32_t x, int32_t y, int32_t rw, int32_t rh, int32_t, uint32_t color) { drawRect(x, y, rw, rh, color); }
+    void drawFastHLine(int32_t x, int32_t y, int32_t length, uint32_t color) {
+        for (int32_t i = 0; i < length; i++) drawPixel(x + i, y, color);
+    }
+    void drawFastVLine(int32_t x, int32_t y, int32_t length, uint32_t color) {
+        for (int32_t j = 0; j < length; j++) drawPixel(x, y + j, color);
+    }
+    void drawPixel(int32_t x, int32_t y, uint32_t color) {
+        if (x >= 0 && y >= 0 && x < w && y < h) pixels[(size_t)y * w + x] = color;
+    }
+    void drawLine(int32_t x0, int32_t y0, int32_t x1, int32_t y1, uint32_t color) {
+        int32_t dx = abs(x1 - x0), dy = -abs(y1 - y0);
+        int32_t sx = x0 < x1 ? 1 : -1, sy = y0 < y1 ? 1 : -1, error = dx + dy;
+        while (true) {
+            drawPixel(x0, y0, color);
+            if (x0 == x1 && y0 == y1) break;
+            int32_t e2 = 2 * error;
+            if (e2 >= dy) {
+                error += dy;
+                x0 += sx;
+            }
+            if (e2 <= dx) {
+                error += dx;
+                y0 += sy;
+            }
+        }
+    }
+    void fillCircle(int32_t cx, int32_t cy, int32_t r, uint32_t color) {
+        for (int32_t j = -r; j <= r; j++) {
+            for (int32_t i = -r; i <= r; i++) {
+                if (i * i + j * j <= r * r) drawPixel(cx + i, cy + j, color);
+            }
+        }
+    }
+    void pushImage(int32_t x, int32_t y, int32_t iw, int32_t ih, const uint16_t* data) {
+        for (int32_t j = 0; j < ih; j++) {
+            for (int32_t i = 0; i < iw; i++) drawPixel(x + i, y + j, data[j * iw + i]);
+        }
+        cover(x, y, iw, ih);
+    }
+    void pushImage(int32_t x, int32_t y, int32_t iw, int32_t ih, uint16_t* data) {
+        pushImage(x, y, iw, ih, (const uint16_t*)data);
+    }
+
+    int16_t drawString(const String& s, int32_t x, int32_t y, uint8_t font) { return drawString(s.c_str(), x, y, font); }
+    int16_t drawString(const char* s, int32_t x, int32_t y, uint8_t font) {
+        int16_t tw = textWidth(s, font), th = fontHeight(font);
+        if (datum % 3 == 1) x -= tw / 2;
+        if (datum % 3 == 2) x -= tw;
+        if (datum / 3 == 1) y -= th / 2;
+        if (datum / 3 == 2) y -= th;
+        addText(x, y, tw, th, s);
+        return tw;
+    }
+
+    using Print::write;
+    size_t write(const char* text, size_t length) override {
+        std::string s(text, length);
+        int16_t tw = (int16_t)(length * 6 * textSize);
+        // consecutive prints on a line are one text
+        if (!texts.empty() && texts.back().y == cursorY && texts.back().x + texts.back().w == cursorX) {
+            texts.back().text += s;
+            texts.back().w += tw;
+        } else {
+            addText(cursorX, cursorY, tw, 8 * textSize, s);
+        }
+        cursorX += tw;
+        return length;
+    }
+
+    // the framebuffer as a binary PPM and the visible texts, from the top left
+    bool writeSnapshot(const std::string& image, const std::string& text) const {
+        FILE* f = fopen(image.c_str(), "wb");
+        if (!f) return false;
+        fprintf(f, "P6\n%d %d\n255\n", w, h);
+        for (uint16_t c : pixels) {
+            uint8_t rgb[3] = {(uint8_t)((c >> 8) & 0xF8), (uint8_t)((c >> 3) & 0xFC), (uint8_t)((c << 3) & 0xF8)};
+            fwrite(rgb, 1, 3, f);
+        }
+        fclose(f);
+        f = fopen(text.c_str(), "w");
+        if (!f) return false;
+        std::vector<ScreenText> sorted = texts;
+        std::stable_sort(sorted.begin(), sorted.end(), [](const ScreenText& a, const ScreenText& b) {
+            return a.y != b.y ? a.y < b.y : a.x < b.x;
+        });
+        for (const ScreenText& t : sorted) fprintf(f, "%4d %4d  #%04X  %s\n", t.x, t.y, t.color, t.text.c_str());
+        fclose(f);
+        return true;
+    }
+
+    // the visible texts, for the expectations of the runner
+    const std::vector<ScreenText>& screenTexts() const { return texts; }
+
+private:
+    void addText(int32_t x, int32_t y, int32_t tw, int32_t th, const std::string& s) {
+        // a new text replaces the one that starts at the same position
+        for (size_t i = 0; i < texts.size(); i++) {
+            if (texts[i].x == x && texts[i].y == y) {
+                texts.erase(texts.begin() + i);
+                break;
+            }
+        }
+        texts.push_back({(int16_t)x, (int16_t)y, (int16_t)tw, (int16_t)th, textColor, s});
+    }
+
+    // remove the texts that start inside the area
+    void cover(int32_t x, int32_t y, int32_t rw, int32_t rh) {
+        texts.erase(std::remove_if(texts.begin(), texts.end(),
+                                   [&](const ScreenText& t) {
+                                       return t.x >= x && t.x < x + rw && t.y >= y && t.y < y + rh;
+                                   }),
+                     texts.end());
+    }
+
+    int16_t panelW, panelH, w, h;
+    std::vector<uint16_t> pixels;
+    std::vector<ScreenText> texts;
+    uint16_t textColor = TFT_WHITE;
+    uint8_t datum = TL_DATUM, textSize = 1, textFont = 1;
+    int16_t cursorX = 0, cursorY = 0;
+};
+
+#endif  // TFT_ESPI_H
@@ -0,0 +1,53 @@
+/*
+  Mock of the ESP-IDF pulse counter driver for the scenario runner, the count is Host::encoder
+*/
+#ifndef _DRIVER_PCNT_H_
+#define _DRIVER_PCNT_H_
+
+#include <stdint.h>
+
+#include "host.h"
+
+typedef int esp_err_t;
+#define ESP_OK 0
+
+typedef enum { PCNT_UNIT_0, PCNT_UNIT_1, PCNT_UNIT_2, PCNT_UNIT_3 } pcnt_unit_t;
+typedef enum { PCNT_CHANNEL_0, PCNT_CHANNEL_1 } pcnt_channel_t;
+typedef enum { PCNT_COUNT_DIS, PCNT_COUNT_INC, PCNT_COUNT_DEC } pcnt_count_mode_t;
+typedef enum { PCNT_MODE_KEEP, PCNT_MODE_REVERSE, PCNT_MODE_DISABLE } pcnt_ctrl_mode_t;
+
+typedef struct {
+    int pulse_gpio_num;
+    int ctrl_gpio_num;
+    pcnt_ctrl_mode_t lctrl_mode;
+    pcnt_ctrl_mode_t hctrl_mode;
+    pcnt_count_mode_t pos_mode;
+    pcnt_count_mode_t neg_mode;
+    int16_t counter_h_lim;
+    int16_t counter_l_lim;
+    pcnt_unit_t unit;
+    pcnt_channel_t channel;
+} pcnt_config_t;
+
+inline int16_t mockEncoderLimit = 0;
+
+inline esp_err_t pcnt_unit_config(const pcnt_config_t* config) {
+    mockEncoderLimit = config->counter_h_lim;
+    return ESP_OK;
+}
+inline esp_err_t pcnt_set_filter_value(pcnt_unit_t, uint16_t) { return ESP_OK; }
+inline esp_err_t pcnt_filter_enable(pcnt_unit_t) { return ESP_OK; }
+inline esp_err_t pcnt_counter_pause(pcnt_unit_t) { return ESP_OK; }
+inline esp_err_t pcnt_counter_resume(pcnt_unit_t) { return ESP_OK; }
+inline esp_err_t pcnt_counter_clear(pcnt_unit_t) {
+    host.encoder = 0;
+    return ESP_OK;
+}
+// the hardware restarts at 0 when the count reaches a limit
+inline esp_err_t pcnt_get_counter_value(pcnt_unit_t, int16_t* count) {
+    if (mockEncoderLimit > 0) host.encoder %= mockEncoderLimit;
+    *count = host.encoder;
+    return ESP_OK;
+}
+
+#endif  // _DRIVER_PCNT_H_
@@ -0,0 +1,29 @@
+/*
+  Mock of ezButton for the scenario runner: a press is a high to low edge of the pin, seen by loop()
+*/
+#ifndef ezButton_h
+#define ezButton_h
+
+#include <Arduino.h>
+
+class ezButton {
+public:
+    explicit ezButton(int pin) : pin(pin) {}
+    void setDebounceTime(unsigned long) {}
+    void loop() {
+        int now = digitalRead(pin);
+        pressed = previous == HIGH && now == LOW;
+        released = previous == LOW && now == HIGH;
+        previous = now;
+    }
+    bool isPressed() { return pressed; }
+    bool isReleased() { return released; }
+    int getState() { return previous; }
+
+private:
+    int pin;
+    int previous = HIGH;
+    bool pressed = false, released = false;
+};
+
+#endif  // ezButton_h
@@ -0,0 +1,188 @@
+/*
+  The simulated hardware behind the mock Arduino headers of the scenario runner
+
+  One Host object holds everything the firmware can see or touch: the virtual clock, the
+  pin levels, the pulse counter of the encoder, the two thermocouples, the serial input and
+  output and the plate model of include/plate_model.h. Time only moves when
+  the runner (or a delay() in the firmware) advances it, the plate model then runs in steps of
+  50ms with the levels of the SSR and the fan pins.
+
+  The board of the model follows the plate without taking heat from it. A board that the runner
+  placed on the plate does take heat: boardCapacity over the lag of the board, from the plate,
+  so the plate dips when a cold board is placed.
+
+  The faults of a station: an open thermocouple, one that lost its contact with the plate and
+  reads closer to the ambient, an SSR that is stuck on.
+
+  The switching of the SSR and the fans can disturb the thermocouple chips: with switchNoise
+  set, a conversion that ran while one of those pins changed reads that many °C off.
+
+  The two chips share SO. When both chip selects are low, both drive it and a chip that drives a
+  zero wins, so the bits of both readings are mixed; clashes counts how often that happened.
+
+  Header only, C++17: the runner compiles src/main.cpp and these mocks as one translation unit.
+*/
+#ifndef SCENARIO_HOST_H
+#define SCENARIO_HOST_H
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <string>
+
+#include "plate_model.h"
+
+struct Host {
+    uint64_t now = 0;  // ms, the virtual clock
+    int pins[64];      // the levels set by digitalWrite() or by the runner (inputs)
+    int16_t encoder = 0;  // the pulse counter, 4 counts per detent
+    std::string serial;   // everything printed on Serial
+    std::string serialInput;  // what the runner sent to Serial
+    size_t serialRead = 0;    // the part of it the firmware has read
+
+    // the hardware the firmware is wired to, set by the runner from the pin definitions
+    int ssrPin = -1, fanPin = -1, plateCs = -1, probeCs = -1, busSo = -1, busClk = -1;
+    uint16_t shift[64];  // the shift register of a chip while its select is low, the MSB is on SO
+    int clashes = 0;     // the times a chip was selected while the other one was, both drive SO
+
+    // the plate and the thermocouples
+    PlateParams plate = defaultPlateParams();
+    PlateState state = plateAtRest(defaultPlateParams(), 1);
+    bool plateOpen = false;       // the plate thermocouple is detached (open)
+    double plateLift = 0;         // the plate thermocouple lost its contact: it reads this part of the way to the ambient
+    bool ssrStuck = false;        // the SSR conducts whatever its pin says
+    bool probePresent = false;    // the board probe chip is on the board
+    bool probeOpen = false;       // and its thermocouple is detached
+    double probeOffset = 0;       // °C, added to the board temperature of the model
+    bool boardPlaced = false;     // a board with heat capacity is on the plate
+    double boardCapacity = 30;    // J/°C, a 100x100mm FR4 board
+    double remainder = 0;         // ms, not yet simulated
+    double switchNoise = 0;       // °C, the error of a conversion that saw a switching edge
+    uint64_t lastSwitch = 0;      // ms, the last edge of the SSR or the fan pin
+    uint64_t converting[64];      // ms, when the chip select of a chip went high
+
+    Host() {
+        for (int i = 0; i < 64; i++) {
+            pins[i] = 1;  // inputs have a pull up
+            converting[i] = 0;
+            shift[i] = 0xFFFF;
+        }
+    }
+
+    void setAmbient(double celsius) {
+        plate.ambient = celsius;
+    }
+
+    void setPlate(double celsius) {
+        state.element = state.plate = state.board = state.sensor = celsius;
+    }
+
+    // a board at the ambient temperature is put on the plate, or taken off
+    void placeBoard(bool placed) {
+        if (placed && !boardPlaced) state.board = plate.ambient;
+        boardPlaced = placed;
+    }
+
+    void seed(uint32_t value) {
+        state.random = value ? value : 1;
+    }
+
+    // run the plate model for ms milliseconds of virtual time
+    void advance(uint64_t ms) {
+        now += ms;
+        remainder += ms;
+        const double step = 50;
+        while (remainder >= step) {
+            int power = ssr();
+            bool fan = fanPin >= 0 && pins[fanPin] != 0;
+            plateStep(plate, state, power, fan, step / 1000);
+            if (boardPlaced) {
+                double toBoard = boardCapacity * (state.plate - state.board) / plate.boardTau;
+                state.plate -= step / 1000 * toBoard / plate.plateCapacity;
+            }
+            remainder -= step;
+        }
+    }
+
+    /*
+      A conversion of the MAX6675 with this chip select: the status and the temperature. An open
+      thermocouple sets the error bit and reads as the highest value, a missing chip gives all
+      ones on the bus (no communication) and does not change the temperature.
+    */
+    uint8_t readThermocouple(int cs, float* temperature) {
+        if (cs == plateCs) {
+            if (plateOpen) {
+                *temperature = 1023.75f;
+                return 0x04;
+            }
+            double reading = plateReading(plate, state);
+            reading -= plateLift * (reading - plate.ambient);
+            *temperature = (float)(reading + disturbance(cs));
+            return 0x00;
+        }
+        if (cs == probeCs && probePresent) {
+            if (probeOpen) {
+                *temperature = 1023.75f;
+                return 0x04;
+            }
+            double board = state.board + probeOffset + disturbance(cs);
+            *temperature = (float)(floor(board / 0.25) * 0.25);
+            return 0x00;
+        }
+        return 0x81;
+    }
+
+    // the error of the conversion of this chip: switchNoise up or down when an edge came after its start
+    double disturbance(int cs) {
+        if (switchNoise <= 0 || lastSwitch <= converting[cs]) return 0;
+        return plateRandom(state) < 0.5 ? -switchNoise : switchNoise;
+    }
+
+    /*
+      A pin written by the firmware. The thermocouple chips are emulated on the bus the way
+      include/thermocouple.h reads them, as a MAX6675: the conversion is latched when the chip
+      select goes low and a bit is shifted out at every falling clock edge. SO has a pull-up, so
+      a chip that is not there reads as all ones, and a zero of either chip pulls it low.
+    */
+    void writePin(int pin, int level) {
+        int previous = pins[pin];
+        pins[pin] = level;
+        if ((pin == ssrPin || pin == fanPin) && level != previous) lastSwitch = now;
+        if (pin == plateCs || pin == probeCs) {
+            if (level == 0 && previous != 0) {
+                shift[pin] = conversion(pin);
+                if (selected(plateCs) && selected(probeCs)) clashes++;
+            } else if (level != 0 && previous == 0) {
+                converting[pin] = now;
+            }
+        } else if (pin == busClk && level == 0 && previous != 0) {
+            if (selected(plateCs)) shift[plateCs] <<= 1;
+            if (selected(probeCs)) shift[probeCs] <<= 1;
+        }
+        if (busSo >= 0) pins[busSo] = bit(plateCs) & bit(probeCs);
+    }
+
+    bool selected(int cs) const { return cs >= 0 && pins[cs] == 0; }
+
+    // the level a chip drives on SO, 1 (the pull-up) when it is not selected or not there
+    int bit(int cs) const {
+        if (!selected(cs) || (cs == probeCs && !probePresent)) return 1;
+        return (shift[cs] >> 15) & 1;
+    }
+
+    // the 16 bits of a MAX6675: the temperature in 0.25°C in bits 3-14, the open bit 2
+    uint16_t conversion(int cs) {
+        float temperature;
+        uint8_t status = readThermocouple(cs, &temperature);
+        if (status & 0x80) return 0xFFFF;
+        int counts = std::min(std::max((int)(temperature * 4), 0), 4095);
+        return (uint16_t)((counts << 3) | (status & 0x04));
+    }
+
+    int ssr() const { return ssrStuck || (ssrPin >= 0 && pins[ssrPin] != 0) ? 255 : 0; }
+    bool fan() const { return fanPin >= 0 && pins[fanPin] != 0; }
+};
+
+inline Host host;
+
+#endif  // SCENARIO_HOST_H
@@ -0,0 +1,509 @@
+/*
+  scenario: behavioral tests of the firmware on the host
+
+  Usage: scenario [--jobs n] [--out dir] [--panel WxH] [--tick ms] file.scn ...
+
+  The runner compiles src/main.cpp with the mock Arduino headers of mocks/ (the display is a
+  framebuffer, the thermocouples read the plate model of include/plate_model.h) and runs the
+  scenarios of the files in virtual time: a 340s reflow run takes a fraction of a second. Every
+  scenario runs in its own forked process, so it starts from the power-up state of the firmware,
+  and the scenarios run in parallel. A failing scenario leaves a snapshot of the screen, the
+  trace and the serial output in the output directory.
+
+  A scenario file is a list of commands, one per line, # starts a comment:
+
+    scenario <name>              start a new scenario, a file can have many
+    seed <n>                     the seed of the thermocouple noise
+    ambient <C>                  the ambient temperature of the plate model
+    plate <C>                    set the plate (and board) temperature
+    heater <W>                   the power of the heater
+    switching <C>                the error of a conversion that saw the SSR or the fans switch
+    detach [plate|probe]         open thermocouple
+    attach [plate|probe]
+    lift <fraction>              the plate thermocouple loses its contact: it reads that part of the way to the
+                                 ambient, 0 puts it back
+    ssr stuck|ok                 the SSR conducts whatever its pin says, or follows it again
+    probe on|off                 the board probe chip is connected
+    place, remove                a cold board is put on the plate, or taken off
+    rotate <n>                   turn the encoder n detents, negative is counter clockwise
+    press                        press and release the rotary button
+    select <field>               turn the encoder to a field: preheatTemp .. coolingTime, warmupTemp, warmup,
+                                 reflow, heatingTemp, heating, coolingTarget, cooling, paste, noise
+    wait <s>                     run for s seconds
+    expect <value> <op> <x> [within <s>]
+                                 value: phase, ssr, fan, temp, plate, board, target, mode, field, paste,
+                                 noise (°C rms of the last noise analysis), probe (the reading of the board
+                                 probe), clashes (the times both thermocouple chips were selected at once)
+                                 op: == != < > <= >=, without an operator it is ==
+                                 within: keep running until it is true, fail after s seconds
+    expect screen contains|lacks <text> [within <s>]
+    expect serial contains|lacks <text> [within <s>]
+                                 the texts printed on the serial port since the power-up
+    send <text>                  send a line to the serial port of the firmware
+    snapshot <name>              save the screen, the trace and the serial output
+
+  The commands before the first one that needs the firmware (rotate, press, select, wait, expect,
+  send, snapshot) set up the plate before the power-up, setup() runs at that point.
+*/
+#define DLOG_TEXT 1       // the diagnostics as text on the serial output, see include/dlog.h
+#define COMPUTE_INLINE 1  // no worker task, the main loop runs the background jobs
+#include "../../src/main.cpp"
+
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cctype>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+namespace scenario {
+
+struct Step {
+    int line;
+    std::vector<std::string> words;
+};
+
+struct Scenario {
+    std::string name;
+    std::string file;
+    int line;
+    std::vector<Step> steps;
+};
+
+struct Sample {
+    double time;
+    double reading, plate, board, target;
+    int ssr;
+    bool fan;
+    int phase, mode, field;
+};
+
+struct Options {
+    int jobs = 0;
+    std::string out = "scenario-out";
+    int panelWidth = 240, panelHeight = 320;
+    int tick = 5;  // ms of virtual time per loop()
+};
+
+const char* phaseNames[] = {"preheat", "soak", "reflow", "hold", "cooling"};
+const char* modeNames[] = {"idle", "reflow", "heating", "warmup", "cooling", "noise"};
+const char* fieldNames[] = {"preheattemp", "preheattime", "soakingtemp", "soakingtime", "reflowtemp", "reflowtime",
+                            "coolingtemp", "coolingtime", "warmuptemp", "warmup", "reflow", "heatingtemp",
+                            "heating", "coolingtarget", "cooling", "paste", "noise"};
+
+std::string lower(std::string s) {
+    for (char& c : s) c = (char)tolower((unsigned char)c);
+    return s;
+}
+
+int lookup(const char* const* names, int count, const std::string& word) {
+    for (int i = 0; i < count; i++) {
+        if (lower(word) == names[i]) return i;
+    }
+    return -1;
+}
+
+std::vector<Scenario> parse(const std::string& path, std::string* error) {
+    std::vector<Scenario> scenarios;
+    std::ifstream in(path);
+    if (!in) {
+        *error = path + ": cannot open";
+        return scenarios;
+    }
+    std::string text;
+    int line = 0;
+    while (std::getline(in, text)) {
+        line++;
+        size_t hash = text.find('#');
+        if (hash != std::string::npos) text.erase(hash);
+        std::istringstream words(text);
+        Step step = {line, {}};
+        std::string word;
+        while (words >> word) step.words.push_back(word);
+        if (step.words.empty()) continue;
+        if (lower(step.words[0]) == "scenario") {
+            std::string name;
+            for (size_t i = 1; i < step.words.size(); i++) name += (i > 1 ? " " : "") + step.words[i];
+            scenarios.push_back({name.empty() ? path + ":" + std::to_string(line) : name, path, line, {}});
+        } else if (scenarios.empty()) {
+            *error = path + ":" + std::to_string(line) + ": a command before the first scenario";
+            return scenarios;
+        } else {
+            scenarios.back().steps.push_back(step);
+        }
+    }
+    return scenarios;
+}
+
+// runs one scenario, in the forked process
+class Runner {
+public:
+    Runner(const Scenario& s, const Options& o) : scenario(s), options(o) {}
+
+    // returns true when all expectations are met
+    bool run() {
+        host.ssrPin = Board::ssr;
+        host.fanPin = Board::fan;
+        host.plateCs = Board::maxCs;
+        host.probeCs = Board::probeCs;
+        host.busSo = Board::maxSo;
+        host.busClk = Board::maxClk;
+        host.setPlate(host.plate.ambient);
+        mockPanelWidth = options.panelWidth;
+        mockPanelHeight = options.panelHeight;
+        tft = TFT_eSPI();
+
+        for (const Step& step : scenario.steps) {
+            current = &step;
+            if (!execute(step)) {
+                save(safeName(scenario.name));
+                return false;
+            }
+        }
+        return true;
+    }
+
+private:
+    bool execute(const Step& step) {
+        const std::vector<std::string>& w = step.words;
+        std::string command = lower(w[0]);
+        if (command == "seed" && w.size() == 2) {
+            host.seed((uint32_t)strtoul(w[1].c_str(), nullptr, 10));
+        } else if (command == "ambient" && w.size() == 2) {
+            host.setAmbient(atof(w[1].c_str()));
+            if (!booted) host.setPlate(host.plate.ambient);
+        } else if (command == "plate" && w.size() == 2) {
+            host.setPlate(atof(w[1].c_str()));
+        } else if (command == "heater" && w.size() == 2) {
+            host.plate.heaterPower = atof(w[1].c_str());
+        } else if (command == "switching" && w.size() == 2) {
+            host.switchNoise = atof(w[1].c_str());
+        } else if ((command == "detach" || command == "attach") && w.size() <= 2) {
+            bool open = command == "detach";
+            if (w.size() == 2 && lower(w[1]) == "probe") {
+                host.probeOpen = open;
+            } else {
+                host.plateOpen = open;
+            }
+        } else if (command == "lift" && w.size() == 2) {
+            host.plateLift = atof(w[1].c_str());
+        } else if (command == "ssr" && w.size() == 2) {
+            host.ssrStuck = lower(w[1]) == "stuck";
+        } else if ((command == "place" || command == "remove") && w.size() == 1) {
+            host.placeBoard(command == "place");
+        } else if (command == "probe" && w.size() == 2) {
+            host.probePresent = lower(w[1]) == "on";
+        } else if (command == "rotate" && w.size() == 2) {
+            boot();
+            rotate(atoi(w[1].c_str()));
+        } else if (command == "press" && w.size() == 1) {
+            boot();
+            press();
+        } else if (command == "select" && w.size() == 2) {
+            boot();
+            return select(w[1]);
+        } else if (command == "wait" && w.size() == 2) {
+            boot();
+            runFor(atof(w[1].c_str()));
+        } else if (command == "expect" && w.size() >= 2) {
+            boot();
+            return expect(w);
+        } else if (command == "send" && w.size() >= 2) {
+            boot();
+            std::string line = join(w);
+            host.serialInput += line.substr(line.find(' ') + 1) + "\n";
+        } else if (command == "snapshot" && w.size() == 2) {
+            boot();
+            save(safeName(scenario.name) + "-" + safeName(w[1]));
+        } else {
+            return fail("unknown command or wrong number of arguments: " + join(w));
+        }
+        return true;
+    }
+
+    void boot() {
+        if (booted) return;
+        booted = true;
+        setup();
+    }
+
+    // run the firmware for seconds of virtual time, or until the condition is true
+    template <class Condition>
+    bool runUntil(double seconds, Condition condition) {
+        uint64_t end = host.now + (uint64_t)(seconds * 1000);
+        while (true) {
+            if (condition()) return true;
+            if (host.now >= end) return false;
+            loop();
+            host.advance(options.tick);
+            if (host.now >= nextSample) {
+                record();
+                nextSample += 250;
+            }
+        }
+    }
+
+    void runFor(double seconds) {
+        runUntil(seconds, [] { return false; });
+    }
+
+    void rotate(int detents) {
+        for (int i = 0; i < abs(detents); i++) {
+            host.encoder += detents > 0 ? encoderCountsPerStep : -encoderCountsPerStep;
+            runFor(0.02);
+        }
+    }
+
+    void press() {
+        host.pins[Board::rotarySw] = LOW;
+        runFor(0.05);
+        host.pins[Board::rotarySw] = HIGH;
+        runFor(0.05);
+    }
+
+    bool select(const std::string& name) {
+        int field = lookup(fieldNames, sizeof(fieldNames) / sizeof(fieldNames[0]), name);
+        if (field < 0) return fail("unknown field " + name);
+        if (editMode) return fail("cannot select a field in the edit mode");
+        for (int i = 0; i <= lastMenuItem + 1 && itemCounter != field; i++) rotate(1);
+        if (itemCounter != field) return fail("could not select " + name);
+        return true;
+    }
+
+    int mode() const {
+        if (taskRunning(reflowRun)) return 1;
+        if (taskRunning(freeHeatingRun)) return 2;
+        if (taskRunning(warmupRun)) return 3;
+        if (taskRunning(freeCoolingRun)) return 4;
+        if (taskRunning(noiseRun)) return 5;
+        return 0;
+    }
+
+    // the value of a quantity, false when it is unknown
+    bool value(const std::string& name, double* v) const {
+        if (name == "phase") *v = reflowControl.phase;
+        else if (name == "ssr") *v = host.ssr();
+        else if (name == "fan") *v = host.fan();
+        else if (name == "temp") *v = TCCelsius;
+        else if (name == "plate") *v = host.state.plate;
+        else if (name == "board") *v = host.state.board;
+        else if (name == "target") *v = targetTemp;
+        else if (name == "mode") *v = mode();
+        else if (name == "field") *v = itemCounter;
+        else if (name == "paste") *v = solderPasteSelected;
+        else if (name == "noise") return lastNoise(v);
+        else if (name == "probe") *v = probeCelsius;
+        else if (name == "clashes") *v = host.clashes;
+        else return false;
+        return true;
+    }
+
+    // the noise of the last noise analysis on the serial port, °C rms
+    bool lastNoise(double* v) const {
+        size_t at = host.serial.rfind(", noise ");
+        if (at == std::string::npos) return false;
+        *v = atof(host.serial.c_str() + at + 8);
+        return true;
+    }
+
+    // the number for the expected value: a number, on/off, a phase, mode or field name
+    bool operand(const std::string& name, const std::string& word, double* v) const {
+        std::string x = lower(word);
+        char* end;
+        *v = strtod(x.c_str(), &end);
+        if (*end == 0 && !x.empty()) return true;
+        if (x == "on") return *v = 1, true;
+        if (x == "off") return *v = 0, true;
+        int i = -1;
+        if (name == "phase") i = lookup(phaseNames, 5, x);
+        if (name == "mode") i = lookup(modeNames, 6, x);
+        if (name == "field") i = lookup(fieldNames, sizeof(fieldNames) / sizeof(fieldNames[0]), x);
+        *v = i;
+        return i >= 0;
+    }
+
+    static bool compare(double a, const std::string& op, double b) {
+        if (op == "==") return a == b;
+        if (op == "!=") return a != b;
+        if (op == "<") return a < b;
+        if (op == ">") return a > b;
+        if (op == "<=") return a <= b;
+        if (op == ">=") return a >= b;
+        return false;
+    }
+
+    bool onScreen(const std::string& text) const {
+        for (const ScreenText& t : tft.screenTexts()) {
+            if (t.text.find(text) != std::string::npos) return true;
+        }
+        return false;
+    }
+
+    bool expect(std::vector<std::string> w) {
+        double within = 0;
+        if (w.size() >= 4 && lower(w[w.size() - 2]) == "within") {
+            within = atof(w.back().c_str());
+            w.resize(w.size() - 2);
+        }
+        std::string name = lower(w[1]);
+
+        if (name == "screen" || name == "serial") {
+            if (w.size() < 4 || (lower(w[2]) != "contains" && lower(w[2]) != "lacks")) {
+                return fail("expect " + name + " contains|lacks <text>");
+            }
+            bool contains = lower(w[2]) == "contains";
+            std::string text = w[3];
+            for (size_t i = 4; i < w.size(); i++) text += " " + w[i];
+            if (text.size() >= 2 && text.front() == '"' && text.back() == '"') text = text.substr(1, text.size() - 2);
+            auto found = [&] {
+                return name == "screen" ? onScreen(text) : host.serial.find(text) != std::string::npos;
+            };
+            if (runUntil(within, [&] { return found() == contains; })) return true;
+            return fail("the " + name + " " + std::string(contains ? "does not show" : "shows") + " \"" + text + "\"");
+        }
+
+        std::string op = "==";
+        std::string expected;
+        if (w.size() == 3) {
+            expected = w[2];
+        } else if (w.size() == 4) {
+            op = w[2];
+            expected = w[3];
+        } else {
+            return fail("expect <value> <op> <x> [within <s>]");
+        }
+        double actual, x;
+        if (!value(name, &actual)) return fail("unknown value " + w[1]);
+        if (!operand(name, expected, &x)) return fail("unknown " + name + " " + expected);
+        if (name == "ssr" && (lower(expected) == "on")) {
+            // on is any PWM value above 0
+            op = op == "==" ? ">" : "<=";
+            x = 0;
+        }
+        if (runUntil(within, [&] { return value(name, &actual) && compare(actual, op, x); })) return true;
+        value(name, &actual);
+        char got[64];
+        snprintf(got, sizeof(got), "%g", actual);
+        return fail(join(w) + (within > 0 ? " within " + std::to_string(within) + "s" : "") + ", got " + got);
+    }
+
+    void record() {
+        trace.push_back({host.now / 1000.0, TCCelsius, host.state.plate, host.state.board, targetTemp, host.ssr(),
+                         host.fan(), (int)reflowControl.phase, mode(), itemCounter});
+    }
+
+    bool fail(const std::string& message) {
+        char line[1024];
+        int n = snprintf(line, sizeof(line), "%s:%d: %s: %s (at %.2fs)\n", scenario.file.c_str(),
+                         current ? current->line : scenario.line, scenario.name.c_str(), message.c_str(),
+                         host.now / 1000.0);
+        if (write(STDOUT_FILENO, line, n) < 0) return false;
+        return false;
+    }
+
+    // the screen, the trace and the serial output
+    void save(const std::string& base) const {
+        mkdir(options.out.c_str(), 0755);
+        std::string path = options.out + "/" + base;
+        tft.writeSnapshot(path + ".ppm", path + ".txt");
+        FILE* f = fopen((path + ".trace.csv").c_str(), "w");
+        if (f) {
+            fprintf(f, "time_s,reading_C,plate_C,board_C,target_C,ssr,fan,phase,mode,field\n");
+            for (const Sample& s : trace) {
+                fprintf(f, "%.2f,%.2f,%.2f,%.2f,%.1f,%d,%d,%s,%s,%d\n", s.time, s.reading, s.plate, s.board,
+                        s.target, s.ssr, s.fan, phaseNames[s.phase], modeNames[s.mode], s.field);
+            }
+            fclose(f);
+        }
+        f = fopen((path + ".serial.log").c_str(), "w");
+        if (f) {
+            fwrite(host.serial.data(), 1, host.serial.size(), f);
+            fclose(f);
+        }
+    }
+
+    static std::string safeName(const std::string& name) {
+        std::string s;
+        for (char c : name) s += isalnum((unsigned char)c) || c == '-' || c == '_' ? c : '_';
+        return s;
+    }
+
+    static std::string join(const std::vector<std::string>& w) {
+        std::string s;
+        for (size_t i = 0; i < w.size(); i++) s += (i ? " " : "") + w[i];
+        return s;
+    }
+
+    const Scenario& scenario;
+    const Options& options;
+    const Step* current = nullptr;
+    bool booted = false;
+    uint64_t nextSample = 0;
+    std::vector<Sample> trace;
+};
+
+}  // namespace scenario
+
+int main(int argc, char** argv) {
+    using namespace scenario;
+    Options options;
+    std::vector<Scenario> scenarios;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--jobs" && i + 1 < argc) {
+            options.jobs = atoi(argv[++i]);
+        } else if (arg == "--out" && i + 1 < argc) {
+            options.out = argv[++i];
+        } else if (arg == "--panel" && i + 1 < argc) {
+            if (sscanf(argv[++i], "%dx%d", &options.panelWidth, &options.panelHeight) != 2) {
+                fprintf(stderr, "--panel WxH, e.g. 320x480\n");
+                return 2;
+            }
+        } else if (arg == "--tick" && i + 1 < argc) {
+            options.tick = std::max(1, atoi(argv[++i]));
+        } else {
+            std::string error;
+            std::vector<Scenario> found = parse(arg, &error);
+            if (!error.empty()) {
+                fprintf(stderr, "%s\n", error.c_str());
+                return 2;
+            }
+            scenarios.insert(scenarios.end(), found.begin(), found.end());
+        }
+    }
+    if (scenarios.empty()) {
+        fprintf(stderr, "usage: %s [--jobs n] [--out dir] [--panel WxH] [--tick ms] file.scn ...\n", argv[0]);
+        return 2;
+    }
+    if (options.jobs <= 0) options.jobs = std::max(1L, sysconf(_SC_NPROCESSORS_ONLN));
+    fflush(stdout);
+
+    // a process per scenario, at most jobs at a time
+    int failed = 0, running = 0;
+    size_t next = 0;
+    while (next < scenarios.size() || running > 0) {
+        if (next < scenarios.size() && running < options.jobs) {
+            pid_t pid = fork();
+            if (pid == 0) {
+                Runner runner(scenarios[next], options);
+                _exit(runner.run() ? 0 : 1);
+            }
+            if (pid < 0) {
+                perror("fork");
+                return 1;
+            }
+            next++;
+            running++;
+            continue;
+        }
+        int status;
+        if (wait(&status) > 0) {
+            running--;
+            if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) failed++;
+        }
+    }
+    printf("%zu scenarios, %zu passed, %d failed\n", scenarios.size(), scenarios.size() - failed, failed);
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,349 @@
+#include "bench.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "policy_table.h"
+
+namespace {
+
+const double controlInterval = 0.25;  // s, the SSRInterval of the firmware
+const int modelSteps = 5;             // steps of the plate model in a control interval
+const double runHorizon = 900;        // s, how far a run is simulated at most
+const double standbyHorizon = 3600;   // s, a standby that is not reached in this time
+const double rateFilter = 0.2;        // TCRateFilter of the firmware
+const double epsilon = 0.01;          // s, smaller improvements of a plan do not count
+const int searchPasses = 200;         // improvements of a plan at most
+
+// run the plate model for one control interval
+void advance(const PlateParams& params, PlateState& plate, double output, bool fan) {
+    for (int i = 0; i < modelSteps; i++) plateStep(params, plate, output, fan, controlInterval / modelSteps);
+}
+
+// the boards of a station with their releases
+struct Sequence {
+    std::vector<int> boards;
+    std::vector<double> ends;
+    double last = -1;  // s, the last release, with the committed board
+    double total = 0;  // s, the sum of the releases of the boards
+    int switches = 0;
+};
+
+void evaluate(BenchModel& model, const BenchStation& station, const std::vector<BenchBoard>& boards, Sequence& s) {
+    BenchState state = station.state;
+    s.ends.clear();
+    s.last = station.committedEnd;
+    s.total = 0;
+    s.switches = 0;
+    for (int b : s.boards) {
+        if (boards[b].paste != state.paste) s.switches++;
+        model.next(state, boards[b].paste);
+        s.ends.push_back(state.time);
+        s.total += state.time;
+        s.last = std::max(s.last, state.time);
+    }
+}
+
+struct Cost {
+    double makespan;
+    double total;
+};
+
+bool better(const Cost& a, const Cost& b) {
+    return a.makespan < b.makespan - epsilon || (a.makespan < b.makespan + epsilon && a.total < b.total - epsilon);
+}
+
+// the cost of the plan with the sequences of stations a and b replaced (b may be a or -1)
+Cost cost(const std::vector<Sequence>& plan, int a, const Sequence* sa, int b, const Sequence* sb) {
+    Cost c = {0, 0};
+    for (size_t i = 0; i < plan.size(); i++) {
+        const Sequence& s = (int)i == a ? *sa : (int)i == b ? *sb : plan[i];
+        c.makespan = std::max(c.makespan, s.last);
+        c.total += s.total;
+    }
+    return c;
+}
+
+// every station gets the board that finishes first, as long as there are boards
+void greedy(BenchModel& model, const std::vector<BenchStation>& stations, const std::vector<BenchBoard>& boards,
+            std::vector<Sequence>& plan) {
+    std::vector<BenchState> states;
+    for (const BenchStation& s : stations) states.push_back(s.state);
+    std::vector<bool> planned(boards.size(), false);
+    for (size_t n = 0; n < boards.size(); n++) {
+        int bestBoard = -1, bestStation = -1;
+        double bestEnd = 0;
+        bool bestSwitch = false;
+        std::vector<bool> tried(model.pasteCount(), false);
+        for (size_t b = 0; b < boards.size(); b++) {
+            if (planned[b] || tried[boards[b].paste]) continue;  // the boards of a paste are all the same
+            tried[boards[b].paste] = true;
+            for (size_t i = 0; i < stations.size(); i++) {
+                if (!stations[i].usable) continue;
+                BenchState state = states[i];
+                bool switching = boards[b].paste != state.paste;
+                model.next(state, boards[b].paste);
+                if (bestBoard < 0 || state.time < bestEnd - epsilon ||
+                    (state.time < bestEnd + epsilon && bestSwitch && !switching)) {
+                    bestBoard = (int)b;
+                    bestStation = (int)i;
+                    bestEnd = state.time;
+                    bestSwitch = switching;
+                }
+            }
+        }
+        if (bestBoard < 0) return;  // no station to plan on
+        model.next(states[bestStation], boards[bestBoard].paste);
+        plan[bestStation].boards.push_back(bestBoard);
+        planned[bestBoard] = true;
+    }
+}
+
+// move a board to another place, the first move that makes the plan better
+bool relocate(BenchModel& model, const std::vector<BenchStation>& stations, const std::vector<BenchBoard>& boards,
+              std::vector<Sequence>& plan) {
+    Cost now = cost(plan, -1, nullptr, -1, nullptr);
+    for (size_t a = 0; a < plan.size(); a++) {
+        for (size_t i = 0; i < plan[a].boards.size(); i++) {
+            int board = plan[a].boards[i];
+            // a board after one of the same paste would only give the same plans again
+            if (i > 0 && boards[plan[a].boards[i - 1]].paste == boards[board].paste) continue;
+            Sequence from = plan[a];
+            from.boards.erase(from.boards.begin() + i);
+            evaluate(model, stations[a], boards, from);
+            for (size_t b = 0; b < plan.size(); b++) {
+                if (!stations[b].usable) continue;
+                const Sequence& target = b == a ? from : plan[b];
+                for (size_t k = 0; k <= target.boards.size(); k++) {
+                    if (b == a && k == i) continue;  // where it was
+                    Sequence to = target;
+                    to.boards.insert(to.boards.begin() + k, board);
+                    evaluate(model, stations[b], boards, to);
+                    Cost c = b == a ? cost(plan, (int)a, &to, -1, nullptr) : cost(plan, (int)a, &from, (int)b, &to);
+                    if (!better(c, now)) continue;
+                    if (b != a) plan[a] = from;
+                    plan[b] = to;
+                    return true;
+                }
+            }
+        }
+    }
+    return false;
+}
+
+// swap two boards of different pastes, the first swap that makes the plan better
+bool swap(BenchModel& model, const std::vector<BenchStation>& stations, const std::vector<BenchBoard>& boards,
+          std::vector<Sequence>& plan) {
+    Cost now = cost(plan, -1, nullptr, -1, nullptr);
+    for (size_t a = 0; a < plan.size(); a++) {
+        for (size_t b = a + 1; b < plan.size(); b++) {
+            for (size_t i = 0; i < plan[a].boards.size(); i++) {
+                for (size_t k = 0; k < plan[b].boards.size(); k++) {
+                    if (boards[plan[a].boards[i]].paste == boards[plan[b].boards[k]].paste) continue;
+                    Sequence sa = plan[a], sb = plan[b];
+                    std::swap(sa.boards[i], sb.boards[k]);
+                    evaluate(model, stations[a], boards, sa);
+                    evaluate(model, stations[b], boards, sb);
+                    if (!better(cost(plan, (int)a, &sa, (int)b, &sb), now)) continue;
+                    plan[a] = sa;
+                    plan[b] = sb;
+                    return true;
+                }
+            }
+        }
+    }
+    return false;
+}
+
+}  // namespace
+
+BenchModel::BenchModel(const BenchSettings& settings, const std::vector<ReflowProfile>& pastes)
+    : settings_(settings), pastes_(pastes) {}
+
+double BenchModel::runTime(int paste, double standby) {
+    std::pair<int, int> key(paste, (int)lround(standby));
+    auto found = runTimes_.find(key);
+    if (found != runTimes_.end()) return found->second;
+    double time = benchRelease(settings_, benchControl(settings_, pastes_[paste]), 0, key.second, 0);
+    runTimes_[key] = time;
+    return time;
+}
+
+double BenchModel::standbyTime(double temperature, double standby) {
+    if (fabs(temperature - standby) <= settings_.band) return 0;
+    std::pair<int, int> key((int)lround(temperature * 2), (int)lround(standby));
+    auto found = standbyTimes_.find(key);
+    if (found != standbyTimes_.end()) return found->second;
+
+    HeatingControl control = warmupControl(key.second);
+    PlateState plate = plateAtRest(settings_.plate, 1);
+    plate.element = plate.plate = plate.board = plate.sensor = key.first / 2.0;
+    double t = 0, settled = 0;
+    while (t < standbyHorizon && t - settled < settings_.settle) {
+        if (fabs(plate.sensor - key.second) > settings_.band || control.rampup || control.slowdown) settled = t;
+        heatingStep(control, plate.sensor);
+        advance(settings_.plate, plate, control.output, false);
+        t += controlInterval;
+    }
+    standbyTimes_[key] = t;
+    return t;
+}
+
+double BenchModel::next(BenchState& state, int paste) {
+    bool switching = paste != state.paste;
+    double ready = state.operatorDone >= 0 ? state.operatorDone
+                                           : state.time + settings_.handling + (switching ? settings_.switchTime : 0);
+    double placed = std::max(state.time + standbyTime(state.temperature, state.standby), ready);
+    state.time = placed + settings_.countdown + runTime(paste, state.standby);
+    state.temperature = settings_.release;
+    state.paste = paste;
+    state.operatorDone = -1;
+    return placed;
+}
+
+ReflowControl benchControl(const BenchSettings& settings, const ReflowProfile& profile) {
+    ReflowControl control;
+    control.profile = profile;
+    control.plan = nullptr;
+    control.coolingTarget = 40;
+    control.warp = settings.warp ? &defaultTimeWarp : nullptr;
+    reflowStart(control);
+    return control;
+}
+
+double benchRelease(const BenchSettings& settings, ReflowControl control, double t, double temperature, double rate) {
+    bool policy = settings.policy && policyMatches(policyTable, control.profile);
+    PlateState plate = plateAtRest(settings.plate, 1);
+    plate.element = plate.plate = plate.board = plate.sensor = temperature;
+    for (double end = t + runHorizon; t < end; t += controlInterval) {
+        if (t >= 340 && control.phase != COOLING) control.phase = COOLING;  // the end of the time scale
+        if (policy && control.phase != COOLING) {
+            reflowPolicyStep(control, policyTable, t, plate.sensor, rate);
+        } else {
+            reflowStep(control, t, plate.sensor);
+        }
+        if (control.phase == COOLING && plate.sensor <= settings.release) return t;
+        double before = plate.sensor;
+        advance(settings.plate, plate, control.output, control.fan);
+        rate += rateFilter * ((plate.sensor - before) / controlInterval - rate);
+    }
+    return t;
+}
+
+BenchPlan planBench(BenchModel& model, const std::vector<BenchStation>& stations, const std::vector<BenchBoard>& boards) {
+    std::vector<Sequence> plan(stations.size());
+    greedy(model, stations, boards, plan);
+    for (size_t i = 0; i < plan.size(); i++) evaluate(model, stations[i], boards, plan[i]);
+    for (int pass = 0; pass < searchPasses; pass++) {
+        if (!relocate(model, stations, boards, plan) && !swap(model, stations, boards, plan)) break;
+    }
+
+    BenchPlan result;
+    for (const Sequence& s : plan) {
+        result.sequence.push_back(s.boards);
+        result.ends.push_back(s.ends);
+        result.makespan = std::max(result.makespan, s.last);
+        result.total += s.total;
+        result.switches += s.switches;
+    }
+    return result;
+}
+
+BenchStation BenchDispatcher::planStation(const StationStatus& status, bool online, Committed& committed, double now) {
+    const BenchSettings& settings = model_.settings();
+    BenchStation s;
+    s.usable = online && (status.flags & STATION_AUTO) &&
+               (status.mode == STATION_WARMUP || status.mode == STATION_COUNTDOWN || status.mode == STATION_REFLOW);
+    s.state = {now, status.temperature, status.standby, status.paste, -1};
+    s.committedEnd = -1;
+    if (!online) return s;
+
+    bool ours = committed.board.id >= 0;
+    if (status.mode == STATION_COUNTDOWN) {
+        s.state.time = now + settings.countdown + model_.runTime(status.paste, status.standby);
+        s.state.temperature = settings.release;
+        if (ours) s.committedEnd = s.state.time;
+    } else if (status.mode == STATION_REFLOW) {
+        if (!(status.flags & STATION_RELEASED)) {
+            s.state.time = now + status.readyIn;
+            s.state.temperature = settings.release;
+        }
+        if (ours) s.committedEnd = s.state.time;
+    } else if (status.mode == STATION_WARMUP && ours) {
+        // the operator is on the way with the board, and changes the paste first
+        s.state.operatorDone =
+            committed.since + settings.handling + (committed.switching ? settings.switchTime : 0);
+        s.state.paste = committed.board.paste;
+        model_.next(s.state, committed.board.paste);
+        s.committedEnd = s.state.time;
+    }
+    return s;
+}
+
+std::vector<BenchAction> BenchDispatcher::step(const std::vector<StationStatus>& status, const std::vector<bool>& online,
+                                               double now) {
+    std::vector<BenchAction> actions;
+    committed_.resize(status.size());
+
+    // follow the committed boards: placed, released, or back to the queue
+    for (size_t i = 0; i < status.size(); i++) {
+        Committed& c = committed_[i];
+        if (c.board.id < 0 || !online[i]) continue;
+        uint8_t mode = status[i].mode;
+        if (!c.placed && (mode == STATION_COUNTDOWN || mode == STATION_REFLOW)) {
+            c.placed = true;
+            c.placedAt = now;
+        } else if (c.placed && (mode == STATION_WARMUP || mode == STATION_IDLE)) {
+            finished_.push_back({c.board, (int)i, c.placedAt, now});
+            c = Committed();
+        } else if (!c.placed && mode != STATION_WARMUP) {  // the station left the standby
+            queue_.insert(queue_.begin(), c.board);
+            c = Committed();
+        } else if (!c.placed && status[i].paste != c.board.paste && !(status[i].flags & STATION_EDITING)) {
+            actions.push_back({(int)i, c.board, false, true});  // PROFILE was lost or refused, again
+        }
+    }
+
+    // plan the queue when a station is free, and commit the first board of its plan
+    bool free = false;
+    for (size_t i = 0; i < status.size(); i++) {
+        free = free || (online[i] && status[i].mode == STATION_WARMUP && committed_[i].board.id < 0);
+    }
+    if (!free || queue_.empty()) return actions;
+    std::vector<BenchStation> stations;
+    for (size_t i = 0; i < status.size(); i++) stations.push_back(planStation(status[i], online[i], committed_[i], now));
+    plan_ = planBench(model_, stations, queue_);
+    std::vector<bool> taken(queue_.size(), false);
+    for (size_t i = 0; i < status.size(); i++) {
+        Committed& c = committed_[i];
+        if (!stations[i].usable || status[i].mode != STATION_WARMUP || c.board.id >= 0 || plan_.sequence[i].empty()) {
+            continue;
+        }
+        int b = plan_.sequence[i][0];
+        c.board = queue_[b];
+        c.since = now;
+        c.switching = status[i].paste != c.board.paste;
+        actions.push_back({(int)i, c.board, true, c.switching});
+        taken[b] = true;
+    }
+    if (std::find(taken.begin(), taken.end(), true) == taken.end()) return actions;
+
+    // the plan of what is left
+    std::vector<BenchBoard> left;
+    for (size_t b = 0; b < queue_.size(); b++) {
+        if (!taken[b]) left.push_back(queue_[b]);
+    }
+    queue_ = left;
+    stations.clear();
+    for (size_t i = 0; i < status.size(); i++) stations.push_back(planStation(status[i], online[i], committed_[i], now));
+    plan_ = planBench(model_, stations, queue_);
+    return actions;
+}
+
+bool BenchDispatcher::done() const {
+    if (!queue_.empty()) return false;
+    for (const Committed& c : committed_) {
+        if (c.board.id >= 0) return false;
+    }
+    return true;
+}
@@ -0,0 +1,182 @@
+/*
+  Bench scheduler: which board goes on which station next, so the queue is done the soonest
+
+  The stations of a bench are in the automatic runs of the firmware: the warmup mode is the
+  standby, a board placed on the plate starts a run after a countdown, and the removal of the
+  board after the run brings the station back to the standby. Every station reports its state
+  with the telemetry of include/station_status.h: the mode, the plate temperature, the loaded
+  paste and, during a run, the predicted time until the board can be taken off.
+
+  BenchModel estimates the times of a station with the controllers of the firmware
+  (include/reflow_control.h and the policy table) on the plate model (include/plate_model.h):
+
+    - a run, from the placement of a board to its release (the plate below the release
+      temperature), per paste and standby temperature
+    - the standby: the warmup controller from a plate temperature until a board is seen. A plate
+      that comes from a run has to cool down first, with the heater off (the warm start), a cold
+      one heats up
+    - a paste switch: the time the operator needs to change a station to another paste, on top of
+      the PROFILE command, while the plate goes to the standby
+
+  planBench() plans the whole queue: a sequence of boards per station. It starts with the greedy
+  choice of the board and the station that finish first, then moves boards to other places and
+  swaps boards of different pastes while the makespan (the release of the last board) gets
+  shorter, or the sum of the releases with the same makespan. Boards of the same paste end up
+  together on a station when the switch time is worth it.
+
+  BenchDispatcher runs it online: at every round of the telemetry it plans again with what is
+  known now and commits the first board of the plan of every station that is free (in the
+  standby without a board). The station gets the profile of the board (PROFILE <n>) and the
+  operator the instruction to place it there. A committed board stays with its station, the rest
+  of the queue is planned again at the next round, so a station that is faster or slower than
+  predicted only moves the boards that still wait.
+
+  C++17, without the Arduino or POSIX dependencies: tools/scheduler/bench_sim.cpp runs it on
+  simulated stations, bench_run.cpp on the stations of a bench.
+*/
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "plate_model.h"
+#include "profile_plan.h"
+#include "reflow_control.h"
+#include "station_status.h"
+
+struct BenchSettings {
+    PlateParams plate = defaultPlateParams();  // the model of the stations
+    double release = 100;    // °C, the board can be taken off (autoReleaseTemp of the firmware)
+    double band = 5;         // °C around the standby where a placed board is seen (autoStandbyBand)
+    double settle = 50;      // s of regulation at the standby before then (autoStandbySettle and the detector)
+    double countdown = 5;    // s from the placement to the start of the run (autoCountdown)
+    double handling = 10;    // s for the operator to get a board to a station
+    double switchTime = 30;  // s to change a station to another paste, on top of the PROFILE command
+    bool warp = true;        // the time warp of the ramps (timeWarpEnabled)
+    bool policy = true;      // the policy table for the profile it was solved for (policyControl)
+};
+
+// A station at a point in time, as far as the plan is concerned
+struct BenchState {
+    double time;          // s
+    double temperature;   // °C of the plate
+    double standby;       // °C, the warmup temperature
+    int paste;            // the loaded paste
+    double operatorDone;  // s, the operator has the committed board at the station, -1 without one
+};
+
+class BenchModel {
+   public:
+    BenchModel(const BenchSettings& settings, const std::vector<ReflowProfile>& pastes);
+
+    const BenchSettings& settings() const { return settings_; }
+    size_t pasteCount() const { return pastes_.size(); }
+    const ReflowProfile& profile(int paste) const { return pastes_[paste]; }
+
+    // s from the placement of a board to its release, on a plate at the standby
+    double runTime(int paste, double standby);
+
+    // s of the warmup controller from a plate temperature until a placed board is seen
+    double standbyTime(double temperature, double standby);
+
+    // the next board on a station: the state moves on to its release, returns the placement.
+    // The board is placed when the plate is at the standby and the operator is there with it,
+    // after the handling and a paste switch from the time the station is free.
+    double next(BenchState& state, int paste);
+
+   private:
+    BenchSettings settings_;
+    std::vector<ReflowProfile> pastes_;
+    std::map<std::pair<int, int>, double> runTimes_;      // paste, standby
+    std::map<std::pair<int, int>, double> standbyTimes_;  // 0.5°C steps of the temperature, standby
+};
+
+/*
+  The rest of a run on the plate model, from the state of its controller at time t of the run:
+  returns the time of the run at which the plate is below the release temperature. This is what
+  the firmware predicts for the progress of a run (predictRemaining()).
+*/
+double benchRelease(const BenchSettings& settings, ReflowControl control, double t, double temperature, double rate);
+
+// The controller of a run of the firmware for a profile, ready to start
+ReflowControl benchControl(const BenchSettings& settings, const ReflowProfile& profile);
+
+struct BenchBoard {
+    int id;     // of the caller
+    int paste;  // the index of its paste
+};
+
+// A station for the plan
+struct BenchStation {
+    bool usable;          // online and in the automatic runs
+    BenchState state;     // when it can start with the boards of the plan
+    double committedEnd;  // s, the release of the board it has now, -1 for none
+};
+
+struct BenchPlan {
+    std::vector<std::vector<int>> sequence;  // per station, the boards (indexes into the queue) in order
+    std::vector<std::vector<double>> ends;   // s, the release of every board of the sequence
+    double makespan = 0;                     // s, the last release, of the plan and the committed boards
+    double total = 0;                        // s, the sum of the releases
+    int switches = 0;                        // paste switches in the plan
+};
+
+// Plan the queue on the stations
+BenchPlan planBench(BenchModel& model, const std::vector<BenchStation>& stations, const std::vector<BenchBoard>& boards);
+
+// What a round of the dispatcher asks for
+struct BenchAction {
+    int station;
+    BenchBoard board;
+    bool assign;  // a new board for the station: tell the operator
+    bool push;    // send PROFILE <board.paste> to the station
+};
+
+// A board that was released and taken off
+struct BenchDone {
+    BenchBoard board;
+    int station;
+    double placed;    // s, when the station started the countdown
+    double released;  // s, when the station was back in the standby
+};
+
+class BenchDispatcher {
+   public:
+    explicit BenchDispatcher(BenchModel& model) : model_(model) {}
+
+    void add(const BenchBoard& board) { queue_.push_back(board); }
+
+    // A round with the telemetry of the stations, online[i] is false when station i did not
+    // answer in time. Returns what the stations and the operator have to do.
+    std::vector<BenchAction> step(const std::vector<StationStatus>& status, const std::vector<bool>& online,
+                                  double now);
+
+    // the queue is empty and all boards were released
+    bool done() const;
+
+    // the plan of the last round that had a free station
+    const BenchPlan& plan() const { return plan_; }
+    const std::vector<BenchBoard>& queue() const { return queue_; }
+    const std::vector<BenchDone>& finished() const { return finished_; }
+
+   private:
+    struct Committed {
+        BenchBoard board = {-1, 0};
+        bool placed = false;  // the station saw the board
+        double since = 0;     // s, the commitment
+        double placedAt = 0;  // s
+        bool switching = false;
+    };
+
+    BenchStation planStation(const StationStatus& status, bool online, Committed& committed, double now);
+
+    BenchModel& model_;
+    std::vector<BenchBoard> queue_;       // the boards that wait
+    std::vector<Committed> committed_;    // per station
+    std::vector<BenchDone> finished_;
+    BenchPlan plan_;
+};
+
+#endif  // BENCH_H
@@ -0,0 +1,295 @@
+/*
+  bench_run: schedule a queue of boards on the stations of a bench
+
+  Usage: bench_run [--baud n] [--switch s] [--handling s] [-v] <queue file> <serial port> [<serial port> ...]
+
+  The queue file has a line per board: a name and the paste, the index or the name of a paste
+  of the table of the firmware (the first station sends it, PASTES). Empty lines and lines that
+  start with # are skipped:
+
+    # board    paste
+    ctrl-01    Sn63/Pb37
+    ctrl-02    2
+    sensor-01  Sn42/Bi57.6/Ag0.4
+
+  Every second the stations are asked for their STATUS (include/station_status.h), the
+  dispatcher of bench.h plans the queue on the stations in the automatic runs, and when a station
+  is free it gets the profile of its next board (PROFILE <n>) and the operator the instruction to
+  place that board there. The automatic runs do the rest: the run starts when the board is
+  placed on the plate at the standby, and the removal of the board after the run frees the
+  station again. A station that does not answer for 3s is left out of the plan until it is back.
+  An anomaly of a run (include/run_anomaly.h) is reported to the operator. The stations get AUTO on at
+  the start.
+  It stops when every board of the queue was released.
+
+  The debug prints of the firmware are dropped, -v shows them on stderr.
+
+  POSIX only (Linux, macOS).
+*/
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "bench.h"
+#include "logsync.h"
+
+namespace {
+
+const double telemetryInterval = 1;  // s between the rounds of STATUS
+const double telemetryTimeout = 3;   // s without a status before a station is offline
+const double pastesTimeout = 3;      // s to wait for the paste table
+
+struct Port {
+    std::string path;
+    int fd = -1;
+    std::vector<uint8_t> buffer;
+    StationStatus status = {};
+    double seen = -1;  // s, the last status
+    bool anomaly = false;  // the run of the station reported an anomaly
+};
+
+bool verbose = false;
+std::vector<StationPaste> pasteTable;
+
+int openPort(const char* port, int baud) {
+    int fd = open(port, O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (fd < 0) return -1;
+    termios tio;
+    if (tcgetattr(fd, &tio) != 0) {
+        close(fd);
+        return -1;
+    }
+    cfmakeraw(&tio);
+    tio.c_cflag |= CLOCAL | CREAD;
+    tio.c_cflag &= ~HUPCL;  // don't reset the controller when we close the port
+    speed_t speed = baud == 9600 ? B9600 : baud == 57600 ? B57600 : baud == 230400 ? B230400 : B115200;
+    cfsetispeed(&tio, speed);
+    cfsetospeed(&tio, speed);
+    if (tcsetattr(fd, TCSANOW, &tio) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+void send(Port& port, const std::string& line) {
+    std::string text = line + "\n";
+    if (port.fd >= 0 && write(port.fd, text.data(), text.size()) != (ssize_t)text.size()) {
+        close(port.fd);
+        port.fd = -1;  // opened again at the next round
+    }
+}
+
+// take the telemetry frames out of the received bytes, what is not a frame is debug output
+void receive(Port& port, double now) {
+    uint8_t bytes[4096];
+    ssize_t n;
+    while (port.fd >= 0 && (n = read(port.fd, bytes, sizeof(bytes))) > 0) port.buffer.insert(port.buffer.end(), bytes, bytes + n);
+
+    size_t used = 0;
+    while (used < port.buffer.size()) {
+        LogSyncFrame frame;
+        int size = logSyncCheck(port.buffer.data() + used, port.buffer.size() - used, &frame);
+        if (size == 0) break;
+        if (size < 0) {
+            if (verbose) fputc(port.buffer[used], stderr);
+            used++;
+            continue;
+        }
+        const uint8_t* data = port.buffer.data() + used + sizeof(LogSyncFrame);
+        used += size;
+        if (frame.type == LOGSYNC_STATUS && frame.length == sizeof(StationStatus)) {
+            memcpy(&port.status, data, sizeof(StationStatus));
+            port.seen = now;
+        } else if (frame.type == LOGSYNC_PASTE && frame.length == sizeof(StationPaste)) {
+            if (pasteTable.size() != frame.runId) pasteTable.assign(frame.runId, StationPaste());
+            if (frame.block < pasteTable.size()) memcpy(&pasteTable[frame.block], data, sizeof(StationPaste));
+        }
+    }
+    port.buffer.erase(port.buffer.begin(), port.buffer.begin() + used);
+}
+
+// wait for the bytes of the stations, at most 100ms
+void waitForPorts(std::vector<Port>& ports) {
+    std::vector<pollfd> fds;
+    for (const Port& p : ports) {
+        if (p.fd >= 0) fds.push_back({p.fd, POLLIN, 0});
+    }
+    if (fds.empty()) {
+        usleep(100000);
+    } else {
+        poll(fds.data(), fds.size(), 100);
+    }
+}
+
+// the paste of the queue file: an index or a name of the table
+int findPaste(const std::string& text) {
+    char* end;
+    long index = strtol(text.c_str(), &end, 10);
+    if (*end == 0 && index >= 0 && index < (long)pasteTable.size()) return (int)index;
+    for (size_t i = 0; i < pasteTable.size(); i++) {
+        if (text == pasteTable[i].name) return (int)i;
+    }
+    return -1;
+}
+
+// a line per board: the name and the paste, the rest of the line is the paste (the names have spaces)
+bool readQueue(const char* path, std::vector<std::string>& names, std::vector<BenchBoard>& boards) {
+    std::ifstream in(path);
+    if (!in) return false;
+    std::string line;
+    int number = 0;
+    while (std::getline(in, line)) {
+        number++;
+        std::istringstream words(line);
+        std::string name, paste;
+        if (!(words >> name) || name[0] == '#') continue;
+        std::getline(words >> std::ws, paste);
+        while (!paste.empty() && (paste.back() == ' ' || paste.back() == '\t' || paste.back() == '\r')) paste.pop_back();
+        int index = findPaste(paste);
+        if (index < 0) {
+            fprintf(stderr, "%s:%d: unknown paste \"%s\"\n", path, number, paste.c_str());
+            return false;
+        }
+        boards.push_back({(int)names.size(), index});
+        names.push_back(name);
+    }
+    return true;
+}
+
+void printTime(double s) {
+    printf("[%3d:%02d] ", (int)s / 60, (int)s % 60);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    int baud = 115200;
+    BenchSettings settings;
+    const char* queueFile = nullptr;
+    std::vector<Port> ports;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--baud") == 0 && i + 1 < argc) {
+            baud = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--switch") == 0 && i + 1 < argc) {
+            settings.switchTime = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--handling") == 0 && i + 1 < argc) {
+            settings.handling = atof(argv[++i]);
+        } else if (strcmp(argv[i], "-v") == 0) {
+            verbose = true;
+        } else if (!queueFile) {
+            queueFile = argv[i];
+        } else {
+            ports.emplace_back();
+            ports.back().path = argv[i];
+        }
+    }
+    if (!queueFile || ports.empty()) {
+        fprintf(stderr, "Usage: bench_run [--baud n] [--switch s] [--handling s] [-v] <queue file> <serial port> [...]\n");
+        return 2;
+    }
+
+    typedef std::chrono::steady_clock Clock;
+    Clock::time_point start = Clock::now();
+    auto seconds = [&]() { return std::chrono::duration<double>(Clock::now() - start).count(); };
+
+    for (Port& p : ports) {
+        p.fd = openPort(p.path.c_str(), baud);
+        if (p.fd < 0) fprintf(stderr, "cannot open %s, trying again later\n", p.path.c_str());
+    }
+
+    // the automatic runs are off after the power-up of a station
+    for (Port& p : ports) send(p, "AUTO on");
+
+    // the paste table of the firmware, from the first station that answers
+    while (seconds() < pastesTimeout && (pasteTable.empty() || pasteTable.back().name[0] == 0)) {
+        for (Port& p : ports) {
+            if (pasteTable.empty()) send(p, "PASTES");
+        }
+        waitForPorts(ports);
+        for (Port& p : ports) receive(p, seconds());
+    }
+    if (pasteTable.empty() || pasteTable.back().name[0] == 0) {
+        fprintf(stderr, "no paste table from the stations\n");
+        return 1;
+    }
+
+    std::vector<std::string> names;
+    std::vector<BenchBoard> boards;
+    if (!readQueue(queueFile, names, boards)) {
+        fprintf(stderr, "cannot read the queue %s\n", queueFile);
+        return 1;
+    }
+
+    std::vector<ReflowProfile> profiles;
+    for (const StationPaste& p : pasteTable) {
+        const int16_t* v = p.profile;
+        profiles.push_back({v[0], v[1], v[2], v[3], v[4], v[5], v[6], v[7]});
+    }
+    BenchModel model(settings, profiles);
+    BenchDispatcher dispatcher(model);
+    for (const BenchBoard& b : boards) dispatcher.add(b);
+    printf("%zu boards on %zu stations\n", boards.size(), ports.size());
+
+    size_t finished = 0;
+    double nextRound = 0;
+    while (!dispatcher.done()) {
+        double now = seconds();
+        if (now >= nextRound) {
+            nextRound = now + telemetryInterval;
+            std::vector<StationStatus> status;
+            std::vector<bool> online;
+            for (Port& p : ports) {
+                if (p.fd < 0) p.fd = openPort(p.path.c_str(), baud);
+                bool answered = p.seen >= 0 && now - p.seen < telemetryTimeout;
+                status.push_back(p.status);
+                online.push_back(answered);
+                send(p, "STATUS");
+                bool anomaly = answered && (p.status.flags & STATION_ANOMALY);
+                if (anomaly && !p.anomaly) {
+                    printTime(now);
+                    printf("station %d (%s): the run reads away from the plate model, check the station\n",
+                           (int)(&p - &ports[0]), p.path.c_str());
+                }
+                p.anomaly = anomaly;
+            }
+
+            for (const BenchAction& a : dispatcher.step(status, online, now)) {
+                Port& p = ports[a.station];
+                if (a.push) send(p, "PROFILE " + std::to_string(a.board.paste));
+                if (!a.assign) continue;
+                printTime(now);
+                printf("station %d (%s): place %s, %s%s\n", a.station, p.path.c_str(), names[a.board.id].c_str(),
+                       pasteTable[a.board.paste].name, a.push ? ", the profile was switched" : "");
+                const BenchPlan& plan = dispatcher.plan();
+                if (!dispatcher.queue().empty()) {
+                    printf("          %zu boards wait, the last one is done in %.0f min\n", dispatcher.queue().size(),
+                           (plan.makespan - now) / 60);
+                }
+            }
+            for (; finished < dispatcher.finished().size(); finished++) {
+                const BenchDone& d = dispatcher.finished()[finished];
+                printTime(now);
+                printf("station %d (%s): %s is done, %.0fs on the plate\n", d.station, ports[d.station].path.c_str(),
+                       names[d.board.id].c_str(), d.released - d.placed);
+            }
+            fflush(stdout);
+        }
+        waitForPorts(ports);
+        for (Port& p : ports) receive(p, seconds());
+    }
+    printTime(seconds());
+    printf("all %zu boards are done\n", boards.size());
+    return 0;
+}
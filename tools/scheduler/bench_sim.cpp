@@ -0,0 +1,333 @@
+/*
+  bench_sim: the bench scheduler on simulated stations
+
+  Usage: bench_sim [--stations n] [--boards n] [--switch s] [--handling s] [--standby C] [--seed n]
+                   [--runs n] [--fifo] [-v]
+
+  Every station is a plate of include/plate_model.h with its own heater power and losses (up to
+  10 and 20% off the model of the scheduler), the noise of the thermocouple, and the automatic
+  runs of the firmware: the warmup controller in the standby, the countdown when a board was
+  placed, the reflow controller (the policy table or reflowStep() with the time warp) and the
+  release. It answers a round of the telemetry with a StationStatus like the firmware does, the
+  time to the release is predicted on the default plate model every 5s. A simulated operator
+  takes a board to a station when it is told to, changes the paste when the profile was switched,
+  places it when the plate is at the standby and takes it off at the release.
+
+  The stations start in the standby with a random paste and a random plate temperature, from
+  cold to just after a run. The queue has boards of random pastes of the table of the firmware.
+  The same bench and queue run with the scheduler and with the first-free rule (the next board
+  of the queue goes to the first station that is free, what an operator would do), the output
+  is the time until the last board is released, the paste switches and the mean release. -v
+  prints the events of the scheduled runs. --fifo shows those of the first-free rule instead.
+
+  Runs in virtual time, a bench of an hour takes a fraction of a second.
+*/
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "bench.h"
+#include "policy_table.h"
+
+namespace {
+
+// the solder pastes of the firmware, as PASTES reports them
+struct Paste {
+    const char* name;
+    ReflowProfile profile;
+};
+
+const Paste pastes[] = {
+    {"Sn42/Bi57.6/Ag0.4", {90, 90, 130, 180, 165, 240, 165, 250}},
+    {"Sn42/Bi57/Ag1", {90, 90, 130, 180, 165, 240, 165, 250}},
+    {"Sn63/Pb37", {100, 30, 150, 120, 235, 210, 235, 220}},
+    {"Sn63/Pb37 Mod", {100, 60, 150, 120, 235, 210, 235, 220}},
+};
+const int pasteCount = sizeof(pastes) / sizeof(pastes[0]);
+
+const double controlInterval = 0.25;  // s, the SSRInterval of the firmware
+const double telemetryInterval = 1;   // s between the rounds of the telemetry
+const double etaInterval = 5;         // s between the predictions of the release
+const double simHorizon = 36000;      // s, a bench that is not done by then is stuck
+
+struct Options {
+    int stations = 4;
+    int boards = 24;
+    double standby = 50;
+    uint32_t seed = 1;
+    int runs = 1;
+    bool fifo = false;
+    bool verbose = false;
+    BenchSettings settings;
+};
+
+// a station of the bench and the operator at it
+struct Station {
+    PlateParams params;
+    PlateState plate;
+    StationStatus status;
+    HeatingControl warmup;
+    ReflowControl control;
+    bool policy = false;
+    double reading = 0;
+    double rate = 0;
+    double modeStart = 0;   // s, the start of the countdown or the run
+    double settled = 0;     // s, since then the warmup regulates at the standby
+    double etaAt = -1;      // s of the run of the last prediction
+    double releaseAt = 0;   // s of the run, the prediction
+    int board = -1;         // the board the operator was told to place here
+    int boardPaste = 0;
+    double operatorDone = 0;  // s, the operator is there with the board
+};
+
+struct Result {
+    double makespan = 0;  // s, the release of the last board
+    double predicted = 0; // s, the makespan of the first plan
+    double total = 0;     // s, the sum of the releases
+    int switches = 0;
+};
+
+void printTime(double s) {
+    printf("%3d:%02d", (int)s / 60, (int)s % 60);
+}
+
+void event(const Options& o, double now, int station, const char* text, int board, int paste) {
+    if (!o.verbose) return;
+    printf("[");
+    printTime(now);
+    printf("] station %d: board %d (%s) %s\n", station, board, pastes[paste].name, text);
+}
+
+// the bench at the start: the plates, their temperatures and pastes
+std::vector<Station> makeBench(const Options& o, std::mt19937& random) {
+    std::uniform_real_distribution<double> unit(0, 1);
+    std::vector<Station> bench(o.stations);
+    for (Station& s : bench) {
+        s.params = o.settings.plate;
+        s.params.heaterPower *= 0.9 + 0.2 * unit(random);
+        s.params.plateLoss *= 0.8 + 0.4 * unit(random);
+        s.params.fanLoss *= 0.8 + 0.4 * unit(random);
+        s.plate = plateAtRest(s.params, random());
+        double temperature = o.standby + (200 - o.standby) * unit(random);
+        s.plate.element = s.plate.plate = s.plate.board = s.plate.sensor = temperature;
+        s.status = StationStatus();
+        s.status.mode = STATION_WARMUP;
+        s.status.flags = STATION_AUTO;
+        s.status.paste = (uint8_t)(random() % pasteCount);
+        s.status.temperature = (float)temperature;
+        s.status.standby = (float)o.standby;
+        s.warmup = warmupControl(o.standby);
+    }
+    return bench;
+}
+
+// a control step of a station: the automatic runs of the firmware and the operator
+void stepStation(const Options& o, Station& s, int index, double now, Result& result) {
+    const BenchSettings& settings = o.settings;
+    s.reading = plateReading(s.params, s.plate);
+    s.rate += 0.2 * ((s.reading - s.status.temperature) / controlInterval - s.rate);
+    s.status.temperature = (float)s.reading;
+    double output = 0;
+    bool fan = false;
+
+    switch (s.status.mode) {
+        case STATION_WARMUP:
+            if (fabs(s.reading - o.standby) > settings.band || s.warmup.rampup || s.warmup.slowdown) s.settled = now;
+            heatingStep(s.warmup, s.reading);
+            output = s.warmup.output;
+            if (s.board >= 0 && now >= s.operatorDone && now - s.settled >= settings.settle &&
+                s.status.paste == s.boardPaste) {
+                s.status.mode = STATION_COUNTDOWN;
+                s.modeStart = now;
+                event(o, now, index, "placed", s.board, s.boardPaste);
+            }
+            break;
+
+        case STATION_COUNTDOWN:
+            heatingStep(s.warmup, s.reading);
+            output = s.warmup.output;
+            if (now - s.modeStart >= settings.countdown) {
+                s.status.mode = STATION_REFLOW;
+                s.control = benchControl(settings, pastes[s.status.paste].profile);
+                s.policy = settings.policy && policyMatches(policyTable, s.control.profile);
+                s.modeStart = now;
+                s.etaAt = -1;
+            }
+            break;
+
+        case STATION_REFLOW: {
+            double t = now - s.modeStart;
+            if (t >= 340 && s.control.phase != COOLING) s.control.phase = COOLING;
+            if (s.policy && s.control.phase != COOLING) {
+                reflowPolicyStep(s.control, policyTable, t, s.reading, s.rate);
+            } else {
+                reflowStep(s.control, t, s.reading);
+            }
+            output = s.control.output;
+            fan = s.control.fan;
+            // the firmware predicts on the default plate model, not on this plate
+            if (s.etaAt < 0 || t - s.etaAt >= etaInterval) {
+                s.releaseAt = benchRelease(settings, s.control, t, s.reading, s.rate);
+                s.etaAt = t;
+            }
+            s.status.elapsed = (float)t;
+            s.status.phase = s.control.phase;
+            s.status.readyIn = (float)std::max(0.0, s.releaseAt - t);
+            if (s.control.phase == COOLING && s.reading <= settings.release) {
+                // the operator takes the board off, the station goes back to the standby
+                event(o, now, index, "released", s.board, s.status.paste);
+                result.makespan = std::max(result.makespan, now);
+                result.total += now;
+                s.board = -1;
+                s.status.mode = STATION_WARMUP;
+                s.status.readyIn = 0;
+                s.status.runs++;
+                s.warmup = warmupControl(o.standby);
+            }
+            break;
+        }
+    }
+    for (int i = 0; i < 5; i++) plateStep(s.params, s.plate, output, fan, controlInterval / 5);
+}
+
+// what the operator does with an action of the scheduler
+void apply(const Options& o, Station& s, int index, const BenchAction& action, double now, Result& result) {
+    if (action.push && s.status.mode == STATION_WARMUP) {
+        s.status.paste = (uint8_t)action.board.paste;  // PROFILE <n>
+        if (action.assign) result.switches++;
+    }
+    if (action.assign) {
+        s.board = action.board.id;
+        s.boardPaste = action.board.paste;
+        s.operatorDone = now + o.settings.handling + (action.push ? o.settings.switchTime : 0);
+        event(o, now, index, action.push ? "assigned, profile pushed" : "assigned", s.board, s.boardPaste);
+    }
+}
+
+// the bench with the scheduler (or the first-free rule): the result
+Result runBench(const Options& o, bool scheduled, uint32_t seed) {
+    std::mt19937 random(seed);
+    std::vector<Station> bench = makeBench(o, random);
+    std::vector<BenchBoard> boards;
+    for (int i = 0; i < o.boards; i++) boards.push_back({i, (int)(random() % pasteCount)});
+
+    std::vector<ReflowProfile> profiles;
+    for (const Paste& p : pastes) profiles.push_back(p.profile);
+    BenchModel model(o.settings, profiles);
+    BenchDispatcher dispatcher(model);
+    for (const BenchBoard& b : boards) dispatcher.add(b);
+    size_t next = 0;  // the first-free rule: the next board of the queue
+
+    Result result;
+    std::vector<bool> online(bench.size(), true);
+    double nextRound = 0;
+    bool first = true;
+    for (double now = 0; now < simHorizon; now += controlInterval) {
+        for (size_t i = 0; i < bench.size(); i++) stepStation(o, bench[i], (int)i, now, result);
+        if (now < nextRound) continue;
+        nextRound += telemetryInterval;
+
+        std::vector<StationStatus> status;
+        for (const Station& s : bench) status.push_back(s.status);
+        if (scheduled) {
+            std::vector<BenchAction> actions = dispatcher.step(status, online, now);
+            if (first) result.predicted = dispatcher.plan().makespan;
+            first = false;
+            for (const BenchAction& a : actions) apply(o, bench[a.station], a.station, a, now, result);
+            if (dispatcher.done()) break;
+        } else {
+            bool busy = next < boards.size();
+            for (size_t i = 0; i < bench.size(); i++) {
+                Station& s = bench[i];
+                if (s.board >= 0 || s.status.mode == STATION_REFLOW || s.status.mode == STATION_COUNTDOWN) busy = true;
+                if (next >= boards.size() || s.status.mode != STATION_WARMUP || s.board >= 0) continue;
+                const BenchBoard& b = boards[next++];
+                apply(o, s, (int)i, {(int)i, b, true, s.status.paste != b.paste}, now, result);
+            }
+            if (!busy) break;
+        }
+    }
+    return result;
+}
+
+void usage() {
+    fprintf(stderr,
+            "Usage: bench_sim [--stations n] [--boards n] [--switch s] [--handling s] [--standby C] [--seed n]\n"
+            "                 [--runs n] [--fifo] [-v]\n");
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    Options o;
+    for (int i = 1; i < argc; i++) {
+        bool value = i + 1 < argc;
+        if (strcmp(argv[i], "--stations") == 0 && value) {
+            o.stations = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--boards") == 0 && value) {
+            o.boards = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--switch") == 0 && value) {
+            o.settings.switchTime = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--handling") == 0 && value) {
+            o.settings.handling = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--standby") == 0 && value) {
+            o.standby = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--seed") == 0 && value) {
+            o.seed = (uint32_t)atol(argv[++i]);
+        } else if (strcmp(argv[i], "--runs") == 0 && value) {
+            o.runs = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--fifo") == 0) {
+            o.fifo = true;
+        } else if (strcmp(argv[i], "-v") == 0) {
+            o.verbose = true;
+        } else {
+            usage();
+            return 2;
+        }
+    }
+    if (o.stations < 1 || o.boards < 1 || o.runs < 1) {
+        usage();
+        return 2;
+    }
+
+    Result sum[2];
+    bool verbose = o.verbose;
+    for (int run = 0; run < o.runs; run++) {
+        uint32_t seed = o.seed + run;
+        o.verbose = verbose && !o.fifo;
+        Result planned = runBench(o, true, seed);
+        o.verbose = verbose && o.fifo;
+        Result fifo = runBench(o, false, seed);
+        printf("seed %u: scheduled ", seed);
+        printTime(planned.makespan);
+        printf(" (planned ");
+        printTime(planned.predicted);
+        printf(", %d switches), first free ", planned.switches);
+        printTime(fifo.makespan);
+        printf(" (%d switches)\n", fifo.switches);
+        sum[0].makespan += planned.makespan;
+        sum[0].total += planned.total;
+        sum[0].switches += planned.switches;
+        sum[1].makespan += fifo.makespan;
+        sum[1].total += fifo.total;
+        sum[1].switches += fifo.switches;
+    }
+
+    double boards = (double)o.boards * o.runs;
+    printf("%d stations, %d boards, switch %.0fs, handling %.0fs, standby %.0fC, %d runs\n", o.stations, o.boards,
+           o.settings.switchTime, o.settings.handling, o.standby, o.runs);
+    const char* names[] = {"scheduled", "first free"};
+    for (int i = 0; i < 2; i++) {
+        printf("%-10s  makespan ", names[i]);
+        printTime(sum[i].makespan / o.runs);
+        printf(", mean release ");
+        printTime(sum[i].total / boards);
+        printf(", %.1f switches\n", (double)sum[i].switches / o.runs);
+    }
+    printf("the scheduled bench is done %.1f%% sooner\n", 100 * (1 - sum[0].makespan / sum[1].makespan));
+    return 0;
+}